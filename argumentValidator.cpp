@@ -1,95 +1,279 @@
-/**
- * @file argumentValidator.cpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief Implementation of the argument validator utility class
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-
-#include <string>
-#include "argumentValidator.hpp"
-
-using namespace std;
-
-argumentValidator::argumentValidator()
-{
-    // -- Default constructor
-}
-
-void argumentValidator::requiredArgsPresent(uint16_t args)
-{
-    // -- Depending on the type of filter and number of filters, command line arguments should be between 6 and 9
-    if (args < 6 || args > 9)
-    {
-        cout << "Error! incorrect number of commandline arguments: The following arguments are required in the specified order\n\n"
-             << "- input_filename: specifies the name of the input wav file. The extension \".wav\" must be included.\n\n"
-             << "- output_filename: specifies the name of the output wav file. The extension \".wav\" must be included.\n\n"
-             << "- default_filter: specifies if a default filter is used or custom coefficients are to be used. Options include:"
-             << "y (default filter), n (custom coefficients)\n\n"
-             << "- filter_count: Specifies the number of filters to be applied."
-             << "- filter_types: this argument is only valid if using a default filter. Specifies the types of filters to be used, up to a maximum"
-             << " of 4 can be supplied. The options include: lp, hp, bp, bs.\n\n"
-             << "- coefficient_filename: this argument is only valid if using custom coefficients. Specifies the name of the text file with the coefficient values. "
-             << "The extension \".txt\" must be included.\n\n";
-        exit(1);
-    }
-}
-
-int16_t argumentValidator::validFilterCount(string filterCountString)
-{
-    // -- Parse and ensure filterCount is <= 0
-    int16_t filterCount = -1;
-    try
-    {
-        filterCount = (int16_t)stoi(filterCountString);
-    }
-    catch (const invalid_argument &)
-    {
-        cout << "Error! Invalid argument for filter_count. Please make sure its an integer greater than or equal to 0";
-        exit(1);
-    }
-    catch (const out_of_range &)
-    {
-        cout << "Error! Filter_count is out of range for a int16_t";
-        exit(1);
-    }
-
-    if (filterCount <= 0)
-    {
-        cout << "Error! filter_count is not an integer greater than or equal to 0";
-        exit(1);
-    }
-
-    return filterCount;
-}
-
-void argumentValidator::validFilterCountAndNumOfArgs(uint16_t filterCount, uint16_t args)
-{
-    // -- For default fiters, make sure the the number of commandline arguments corresponds to filter count
-    if ((filterCount == 1 && args != 6) ||
-        (filterCount == 2 && args != 7) ||
-        (filterCount == 3 && args != 8) ||
-        (filterCount == 4 && args != 9))
-    {
-        cout << "Error! The number of arguments provided does not correspond properly with the filter_count supplied";
-        exit(1);
-    }
-}
-
-void argumentValidator::validSetOfCoefficients(uint16_t numSetOfCoefficients, uint16_t filterCount)
-{
-    // -- For custom fiters, make sure the the number of parsed sets of coefficients corresponds to filter count
-    if (numSetOfCoefficients != filterCount)
-    {
-        cout << "Error! The number of set of coefficients parsed ("
-             << numSetOfCoefficients
-             << ") does not correspond with the filter_count ("
-             << filterCount
-             << ") supplied";
-        exit(1);
-    }
+/**
+ * @file argumentValidator.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the argument validator utility class
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include <string>
+#include "argumentValidator.hpp"
+#include "filterError.hpp"
+
+using namespace std;
+
+argumentValidator::argumentValidator()
+{
+    // -- Default constructor
+}
+
+runOptions argumentValidator::extractOptions(int &argc, char *argv[])
+{
+    runOptions options;
+    int remaining = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+
+        // -- Positional arguments are kept in their original order
+        if (arg.rfind("--", 0) != 0)
+        {
+            argv[remaining++] = argv[i];
+            continue;
+        }
+
+        size_t separator = arg.find('=');
+        string name = arg.substr(0, separator);
+        string value = (separator == string::npos) ? "" : arg.substr(separator + 1);
+
+        if (name == "--partition-size")
+        {
+            // -- The partition size must be a power of 2 so that it can be used as the fft block size
+            uint64_t partitionSize = 0;
+            try
+            {
+                partitionSize = stoull(value);
+            }
+            catch (const exception &)
+            {
+                partitionSize = 0;
+            }
+
+            if (partitionSize < 2 || partitionSize > (1u << 20) || (partitionSize & (partitionSize - 1)) != 0)
+            {
+                throw filterError("Error! Invalid value for --partition-size. Please make sure its a power of 2 between 2 and 1048576");
+            }
+            options.partitionSize = (uint32_t)partitionSize;
+        }
+        else if (name == "--simd")
+        {
+            if (value != "scalar" && value != "sse2" && value != "avx2" && value != "avx512")
+            {
+                throw filterError("Error! Invalid value for --simd. Options include: scalar, sse2, avx2, avx512");
+            }
+            options.simd = value;
+        }
+        else if (name == "--q15")
+        {
+            options.q15 = true;
+        }
+        else if (name == "--no-fuse")
+        {
+            options.fuseStages = false;
+        }
+        else if (name == "--stream")
+        {
+            options.stream = true;
+        }
+        else if (name == "--pipeline")
+        {
+            // -- The pipeline passes blocks between the filters, so it always streams
+            options.stream = true;
+            options.pipeline = true;
+        }
+        else if (name == "--batch")
+        {
+            options.batch = true;
+        }
+        else if (name == "--dither")
+        {
+            options.dither = true;
+        }
+        else if (name == "--quiet")
+        {
+            options.quiet = true;
+        }
+        else if (name == "--stats")
+        {
+            options.stats = true;
+            options.statsFile = value;
+        }
+        else if (name == "--channels")
+        {
+            // -- Comma separated list of channel numbers, starting at 1
+            size_t start = 0;
+            while (start <= value.size())
+            {
+                size_t end = value.find(',', start);
+                if (end == string::npos)
+                {
+                    end = value.size();
+                }
+
+                int64_t channel = 0;
+                try
+                {
+                    size_t used = 0;
+                    channel = stoll(value.substr(start, end - start), &used);
+                    channel = (used == end - start) ? channel : 0;
+                }
+                catch (const exception &)
+                {
+                    channel = 0;
+                }
+
+                if (channel < 1 || channel > 65535)
+                {
+                    throw filterError("Error! Invalid value for --channels. Please make sure its a comma separated list of channel numbers, starting at 1");
+                }
+                options.channels.push_back((uint32_t)channel);
+                start = end + 1;
+            }
+        }
+        else if (name == "--threads")
+        {
+            int64_t threads = -1;
+            try
+            {
+                threads = stoll(value);
+            }
+            catch (const exception &)
+            {
+                threads = -1;
+            }
+
+            if (threads < 0 || threads > 1024)
+            {
+                throw filterError("Error! Invalid value for --threads. Please make sure its an integer between 0 and 1024");
+            }
+            options.threads = (uint32_t)threads;
+        }
+        else if (name == "--ripple" || name == "--attenuation" || name == "--transition")
+        {
+            // -- Targets of the designed filters, positive numbers of dB or Hz
+            double target = 0;
+            try
+            {
+                size_t used = 0;
+                target = stod(value, &used);
+                target = (used == value.size()) ? target : 0;
+            }
+            catch (const exception &)
+            {
+                target = 0;
+            }
+
+            if (!(target > 0) || target > 1e9)
+            {
+                throw filterError("Error! Invalid value for " + name + ". Please make sure its a positive number");
+            }
+            double &field = (name == "--ripple") ? options.passbandRipple : (name == "--attenuation") ? options.stopbandAttenuation : options.transitionWidth;
+            field = target;
+        }
+        else if (name == "--equiripple")
+        {
+            options.equiripple = true;
+        }
+        else if (name == "--no-multirate")
+        {
+            options.multirate = false;
+        }
+        else if (name == "--q15-headroom")
+        {
+            int32_t headroomBits = -1;
+            try
+            {
+                headroomBits = stoi(value);
+            }
+            catch (const exception &)
+            {
+                headroomBits = -1;
+            }
+
+            if (headroomBits < 0 || headroomBits > 15)
+            {
+                throw filterError("Error! Invalid value for --q15-headroom. Please make sure its an integer between 0 and 15");
+            }
+            options.q15 = true;
+            options.q15HeadroomBits = headroomBits;
+        }
+        else
+        {
+            throw filterError("Error! Unknown option " + name);
+        }
+    }
+
+    argc = remaining;
+    return options;
+}
+
+void argumentValidator::requiredArgsPresent(uint16_t args)
+{
+    // -- Depending on the type of filter and number of filters, command line arguments should be between 6 and 9
+    if (args < 6 || args > 9)
+    {
+        throw filterError("Error! incorrect number of commandline arguments: The following arguments are required in the specified order\n\n"
+                          "- input_filename: specifies the name of the input wav file. The extension \".wav\" must be included.\n\n"
+                          "- output_filename: specifies the name of the output wav file. The extension \".wav\" must be included.\n\n"
+                          "- default_filter: specifies if a default filter is used or custom coefficients are to be used. Options include:"
+                          "y (default filter), n (custom coefficients), d (filters designed for the sample rate of the file)\n\n"
+                          "- filter_count: Specifies the number of filters to be applied."
+                          "- filter_types: this argument is only valid if using a default filter. Specifies the types of filters to be used, up to a maximum"
+                          " of 4 can be supplied. The options include: lp, hp, bp, bs, and lp-iir, hp-iir, bp-iir, bs-iir for iir filters.\n\n"
+                          "- filter_specs: this argument is only valid if using designed filters. Specifies the filters to be designed, up to a maximum"
+                          " of 4 can be supplied. The options include: lp:F, hp:F, bp:F1-F2, bs:F1-F2 with the cutoffs F in Hz, or lp-iir:F and so on for iir filters.\n\n"
+                          "- coefficient_filename: this argument is only valid if using custom coefficients. Specifies the name of the text file with the coefficient values. "
+                          "The extension \".txt\" must be included.\n\n");
+    }
+}
+
+int16_t argumentValidator::validFilterCount(string filterCountString)
+{
+    // -- Parse and ensure filterCount is <= 0
+    int16_t filterCount = -1;
+    try
+    {
+        filterCount = (int16_t)stoi(filterCountString);
+    }
+    catch (const invalid_argument &)
+    {
+        throw filterError("Error! Invalid argument for filter_count. Please make sure its an integer greater than or equal to 0");
+    }
+    catch (const out_of_range &)
+    {
+        throw filterError("Error! Filter_count is out of range for a int16_t");
+    }
+
+    if (filterCount <= 0)
+    {
+        throw filterError("Error! filter_count is not an integer greater than or equal to 0");
+    }
+
+    return filterCount;
+}
+
+void argumentValidator::validFilterCountAndNumOfArgs(uint16_t filterCount, uint16_t args)
+{
+    // -- For default fiters, make sure the the number of commandline arguments corresponds to filter count
+    if ((filterCount == 1 && args != 6) ||
+        (filterCount == 2 && args != 7) ||
+        (filterCount == 3 && args != 8) ||
+        (filterCount == 4 && args != 9))
+    {
+        throw filterError("Error! The number of arguments provided does not correspond properly with the filter_count supplied");
+    }
+}
+
+void argumentValidator::validSetOfCoefficients(uint16_t numSetOfCoefficients, uint16_t filterCount)
+{
+    // -- For custom fiters, make sure the the number of parsed sets of coefficients corresponds to filter count
+    if (numSetOfCoefficients != filterCount)
+    {
+        throw filterError("Error! The number of set of coefficients parsed (" + to_string(numSetOfCoefficients) + ") does not correspond with the filter_count (" + to_string(filterCount) + ") supplied");
+    }
 }
\ No newline at end of file
@@ -1,75 +1,211 @@
-/**
- * @file argumentValidator.hpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief Class definition for the argument validator utility class
- * 
- * This is a helper class which contains functions that help validate the command line arguments
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-
-#pragma once
-
-#include <fstream>
-#include <iostream>
-#include <string>
-#include <cstdint>
-
-using namespace std;
-
-class argumentValidator
-{
-public:
-    /**
-    * @brief Default constructor to create an argumentValidator object
-    * 
-     */
-    argumentValidator();
-
-    /**
-     * @brief Confirms that there are the appropriate amount of command line arguments
-     * 
-     * Checks that args is between the minimum and maximum allowable number of arguments.
-     * If not, print error statements
-     * 
-     * @param args Number of command line arguments supplied
-     */
-    void requiredArgsPresent(uint16_t args);
-
-    /**
-     * @brief Confirms that the filter count supplied is valid
-     * 
-     * Pareses and confirms that the filter count supplied is a valid integer greater than
-     * or equal to 0. If not, print error statements
-     * 
-     * @param filterCountString command line argument corresponding to the filter count
-     * @return Filter Count as an integer 
-     */
-    int16_t validFilterCount(string filterCountString);
-
-    /**
-     * @brief Confirms the number of command line arguments supplied corresponds to filter count
-     * 
-     * When default filters are chosen, the number of supplied arguments should correspond to the
-     * filter count supplied. If not, print error statements
-     * 
-     * @param filterCount Filter count supplied 
-     * @param args Number of command line arguments supplied
-     */
-    void validFilterCountAndNumOfArgs(uint16_t filterCount, uint16_t args);
-
-    /**
-     * @brief Confirms that number of custom coefficient sets correspons to filter count
-     * 
-     * When custom filters are chosen, the number of parsed sets of coefficients should correspond to 
-     * the filter count supplied. If not, print error statements
-     * 
-     * @param numSetOfCoefficients Number of parsed sets of coefficients
-     * @param filterCount Filter count supplied 
-     */
-    void validSetOfCoefficients(uint16_t numSetOfCoefficients, uint16_t filterCount);
-};
+/**
+ * @file argumentValidator.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition for the argument validator utility class
+ * 
+ * This is a helper class which contains functions that help validate the command line arguments
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @brief Optional settings supplied on the command line as --name=value
+ * 
+ */
+struct runOptions
+{
+    /**
+     * @brief Partition size of the partitioned convolution, 0 if not used
+     * 
+     */
+    uint32_t partitionSize = 0;
+
+    /**
+     * @brief Instruction set requested for the fir kernels, empty to use the best supported one
+     * 
+     */
+    string simd = "";
+
+    /**
+     * @brief Filter in Q15 fixed point instead of double precision
+     * 
+     */
+    bool q15 = false;
+
+    /**
+     * @brief Number of bits the Q15 coefficients are scaled down, -1 to choose automatically
+     * 
+     */
+    int32_t q15HeadroomBits = -1;
+
+    /**
+     * @brief Allow neighbouring filters to be fused into one filter
+     * 
+     */
+    bool fuseStages = true;
+
+    /**
+     * @brief Filter the audio data block by block while reading it, instead of reading the whole file first
+     * 
+     */
+    bool stream = false;
+
+    /**
+     * @brief When streaming, run every filter on a thread of its own
+     * 
+     */
+    bool pipeline = false;
+
+    /**
+     * @brief Number of threads filtering each file, 0 for one thread per processor core.
+     *        In batch mode the number of files filtered at once
+     * 
+     */
+    uint32_t threads = 1;
+
+    /**
+     * @brief The input file is a manifest of files to be filtered and the output file receives the throughput report
+     * 
+     */
+    bool batch = false;
+
+    /**
+     * @brief Channels to be filtered, starting at 1, empty to filter every channel
+     * 
+     */
+    vector<uint32_t> channels;
+
+    /**
+     * @brief Add triangular dither to integer output samples before rounding them
+     * 
+     */
+    bool dither = false;
+
+    /**
+     * @brief Do not print the parsed coefficients
+     * 
+     */
+    bool quiet = false;
+
+    /**
+     * @brief Largest passband ripple of the designed filters, in dB
+     * 
+     */
+    double passbandRipple = 0.1;
+
+    /**
+     * @brief Smallest stopband attenuation of the designed filters, in dB
+     * 
+     */
+    double stopbandAttenuation = 60;
+
+    /**
+     * @brief Width of the transition bands of the designed filters, in Hz
+     * 
+     */
+    double transitionWidth = 100;
+
+    /**
+     * @brief Design the filters with the Parks-McClellan algorithm instead of a Kaiser window
+     * 
+     */
+    bool equiripple = false;
+
+    /**
+     * @brief Let designed low pass and band pass filters run at a reduced rate when their passband permits
+     * 
+     */
+    bool multirate = true;
+
+    /**
+     * @brief Collect the performance statistics of the run and write them as JSON
+     * 
+     */
+    bool stats = false;
+
+    /**
+     * @brief File receiving the statistics, empty to print them with the other messages
+     * 
+     */
+    string statsFile;
+};
+
+class argumentValidator
+{
+public:
+    /**
+    * @brief Default constructor to create an argumentValidator object
+    * 
+     */
+    argumentValidator();
+
+    /**
+     * @brief Extracts the optional settings from the command line arguments
+     * 
+     * Parses every argument starting with "--" and removes it from the argument list, so that the
+     * remaining arguments can be validated in their fixed positions. If an option is unknown or its
+     * value is invalid, throw a filterError
+     * 
+     * @param argc Number of command line arguments, updated to the number of remaining arguments
+     * @param argv Array of command line arguments, the options are removed from it
+     * @return The parsed settings
+     */
+    runOptions extractOptions(int &argc, char *argv[]);
+
+    /**
+     * @brief Confirms that there are the appropriate amount of command line arguments
+     * 
+     * Checks that args is between the minimum and maximum allowable number of arguments.
+     * If not, throw a filterError
+     * 
+     * @param args Number of command line arguments supplied
+     */
+    void requiredArgsPresent(uint16_t args);
+
+    /**
+     * @brief Confirms that the filter count supplied is valid
+     * 
+     * Pareses and confirms that the filter count supplied is a valid integer greater than
+     * or equal to 0. If not, throw a filterError
+     * 
+     * @param filterCountString command line argument corresponding to the filter count
+     * @return Filter Count as an integer 
+     */
+    int16_t validFilterCount(string filterCountString);
+
+    /**
+     * @brief Confirms the number of command line arguments supplied corresponds to filter count
+     * 
+     * When default filters are chosen, the number of supplied arguments should correspond to the
+     * filter count supplied. If not, throw a filterError
+     * 
+     * @param filterCount Filter count supplied 
+     * @param args Number of command line arguments supplied
+     */
+    void validFilterCountAndNumOfArgs(uint16_t filterCount, uint16_t args);
+
+    /**
+     * @brief Confirms that number of custom coefficient sets correspons to filter count
+     * 
+     * When custom filters are chosen, the number of parsed sets of coefficients should correspond to 
+     * the filter count supplied. If not, throw a filterError
+     * 
+     * @param numSetOfCoefficients Number of parsed sets of coefficients
+     * @param filterCount Filter count supplied 
+     */
+    void validSetOfCoefficients(uint16_t numSetOfCoefficients, uint16_t filterCount);
+};
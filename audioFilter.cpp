@@ -1,179 +1,592 @@
-/**
- * @file audioFilter.cpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief This file contains the entry point of this audio filtering program
- * 
- * This audio filtering program is a simple FIR filter that allows the user to filter specified frequencies from an input audio wave file.
- * This program comes equipped with 4 different sets of filter coefficients that the user can select from, along with the ability to specify
- * custom filters by providing a coefficients file. The user can also run the input wav file through multiple iterations of processing for further
- * customization of the frequency filtering.
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-
-#include <iostream>
-#include <string>
-#include <vector>
-#include <cstdio>
-#include <cstdint>
-#include "wavFile.hpp"
-#include "wavHeader.hpp"
-#include "firFilter.hpp"
-#include "coeffFileParser.hpp"
-#include "argumentValidator.hpp"
-#include "defaultFilterCoeffs.hpp"
-
-using namespace std;
-
-/**
- * @brief Defines the length of the coefficient sets for the default filters
- * 
- */
-constexpr uint16_t Default_Filter_Coeffs_Len = 51;
-
-/**
- * @brief Entry point of this program
- * 
- * @param argc Number of command line arguments
- * @param argv Array of command line arguments: 
- *        argv[1] Specifies the name of the input wav file
- *        argv[2] Specifies the name of the output wav file
- *        argv[3] Specifies if default filters are to used or custom coefficients are to be used. Options include: y (default filter), n (custom coefficients)
- *        argv[4] Specifies the number of filters to be applied. If default filters are used, only have a maximum of 4 filters can be applied. If this value
- *                is 0, then the input wav file is simply copied to the output file without modification.
- *        argv[5] If using default filters, specifies the first type of filter to be used. The options include: lp, hp, bp, bs.
- *                If using custom coefficients, specifies the name of the text file with the coefficient values. Each set of coefficients should be enclosed 
- *                in square brackets and individual coefficients should be seperated by commas. Each set of coefficients should be seperated by commas and the
- *                number of sets of coefficients should equal the value of argv[4]
- *        argv[6-8] Optional arguments if using default filters. Specifies type of filters to be used. The options include: lp, hp, bp, bs 
- * @return Program exit code
- */
-int main(int argc, char *argv[])
-{
-    string inputFile, outputFile, defaultFilter;
-    int16_t filterCount;
-    argumentValidator validator;
-
-    // -- Check if all required arguments are present
-    validator.requiredArgsPresent((uint16_t)argc);
-
-    inputFile = argv[1];
-    outputFile = argv[2];
-    defaultFilter = argv[3];
-
-    // -- Make sure filter count is a valid integer
-    filterCount = validator.validFilterCount(argv[4]);
-
-    // -- Open the input file
-    FILE *fp = fopen(argv[1], "rb"); // -- read in binary mode
-    if (fp == NULL)
-    {
-        cout << "Error! could not open file "
-             << inputFile
-             << ": please make sure that this is the correct filename\n ";
-        exit(1);
-    }
-
-    // -- Create an instance of the wavFile class using the input wave file
-    wavFile wav(fp);
-    fclose(fp);
-
-    // -- Only if the filter count is greater than 0, then complete further processing
-    if (filterCount > 0)
-    {
-        if (defaultFilter == "y" || defaultFilter == "Y")
-        {
-            // -- Default filters chosen
-
-            // -- Make sure the filter count agrees with the number of arguments
-            validator.validFilterCountAndNumOfArgs(filterCount, (uint16_t)argc);
-
-            // -- For each default filter chosen, process the input audio of the wavefile
-            for (int16_t i = 5; i < argc; i++)
-            {
-                string filterType;
-                filterType = argv[i];
-
-                // -- Depending on the filter specified, perform that processing
-                if (filterType == "lp" || filterType == "LP" || filterType == "Lp" || filterType == "lP")
-                {
-                    // -- Process the wav file with a Lowpass filter
-                    wav.processFirFilter(lowPassCoeffs, Default_Filter_Coeffs_Len);
-                }
-                else if (filterType == "hp" || filterType == "HP" || filterType == "Hp" || filterType == "hP")
-                {
-                    // -- Process the wav file with a Highpass filter
-                    wav.processFirFilter(highPassCoeffs, Default_Filter_Coeffs_Len);
-                }
-                else if (filterType == "bp" || filterType == "BP" || filterType == "Bp" || filterType == "bP")
-                {
-                    // -- Process the wav file with a Bandpass filter
-                    wav.processFirFilter(speechRangeCoeffs, Default_Filter_Coeffs_Len);
-                }
-                else if (filterType == "bs" || filterType == "BS" || filterType == "Bs" || filterType == "bS")
-                {
-                    // -- Process the wav file with a Bandstop filter
-                    wav.processFirFilter(noSpeechRangeCoeffs, Default_Filter_Coeffs_Len);
-                }
-                else
-                {
-                    cout << "Error! invalid filter type chosen for argument "
-                         << i + 1
-                         << ". Make sure filter_type is only one of the following lp, hp, bp, bs";
-                    exit(1);
-                }
-
-                // -- For the next round of processing, the current output data should become the next input audio data
-                copy(wav.outputData.begin(), wav.outputData.end(), wav.audioData.begin());
-            }
-        }
-        else if (defaultFilter == "n" || defaultFilter == "N")
-        {
-            // -- Custom filters chosen
-            string coefficientFile;
-            coeffFileParser fileParser;
-            vector<vector<double>> coefficientsVector;
-
-            coefficientFile = argv[5];
-
-            // -- Parse the coefficients file
-            coefficientsVector = fileParser.parseCoeffs(coefficientFile);
-
-            // -- Check that the number of set of coefficients is equal to the number of filters supplied in the commandline
-            uint16_t coefficientsVectorSize = (uint16_t)coefficientsVector.size();
-            validator.validSetOfCoefficients(coefficientsVectorSize, filterCount);
-
-            for (uint16_t i = 0; i < coefficientsVectorSize; i++)
-            {
-                // -- Get the number of coefficients in each set
-                uint16_t coeffsNum = (uint16_t)coefficientsVector[i].size();
-
-                // -- Process the wav file with each set of custom coefficients
-                wav.processFirFilter(coefficientsVector[i], coeffsNum);
-            }
-        }
-        else
-        {
-            cout << "Error! invalid value for default filter. Make sure default_filter is only one of the following "
-                 << "y (default filter), n (custom coefficients)";
-            exit(1);
-        }
-    }
-
-    // -- Create a new wav file and see if it was successful
-    fp = fopen(argv[2], "wb"); // -- Write in binary mode
-    if (fp == NULL)
-    {
-        cout << "Error! could not create file "
-             << argv[2];
-        exit(1);
-    }
-
-    // -- Write the contents of the output audio file
-    wav.writeWavFile(fp);
-    fclose(fp);
-}
\ No newline at end of file
+/**
+ * @file audioFilter.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief This file contains the entry point of this audio filtering program
+ * 
+ * This audio filtering program is a simple FIR filter that allows the user to filter specified frequencies from an input audio wave file.
+ * This program comes equipped with 4 different sets of filter coefficients that the user can select from, along with the ability to specify
+ * custom filters by providing a coefficients file, or designing filters for the sample rate of the input file from their cutoff frequencies.
+ * The user can also run the input wav file through multiple iterations of processing for further
+ * customization of the frequency filtering.
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cctype>
+#include <algorithm>
+#include "wavFile.hpp"
+#include "wavStream.hpp"
+#include "wavHeader.hpp"
+#include "firFilter.hpp"
+#include "firKernels.hpp"
+#include "filterChain.hpp"
+#include "filterError.hpp"
+#include "filterDesigner.hpp"
+#include "threadPool.hpp"
+#include "runStats.hpp"
+#include "batchProcessor.hpp"
+#include "coeffFileParser.hpp"
+#include "argumentValidator.hpp"
+#include "defaultFilterCoeffs.hpp"
+
+using namespace std;
+
+/**
+ * @brief Apply one filter to the audio data with the engine chosen on the command line
+ * 
+ * @param wav The wav file to be processed
+ * @param filterCoeffs Set of filter coefficients
+ * @param filterCoeffsLen Number of filter coefficients
+ * @param options Settings parsed from the command line
+ * @param filterNumber Position of the filter in the chain, starting at 1
+ */
+static void applyFilter(wavFile &wav, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, const runOptions &options, uint32_t filterNumber)
+{
+    if (options.q15)
+    {
+        // -- Fixed point filtering, report how close it is to the double precision output
+        double snr = wav.processQ15Filter(filterCoeffs, filterCoeffsLen, options.q15HeadroomBits);
+        cout << "Filter "
+             << filterNumber
+             << ": Q15 signal to noise ratio versus double precision: "
+             << snr
+             << " dB\n";
+    }
+    else
+    {
+        wav.processFirFilter(filterCoeffs, filterCoeffsLen, options.partitionSize);
+    }
+}
+
+/**
+ * @brief Warn about output samples that did not fit in the sample format and were clipped
+ * 
+ * @param clippedSamples Number of saturated output samples
+ */
+static void reportClipping(uint64_t clippedSamples)
+{
+    if (clippedSamples > 0)
+    {
+        cout << "Warning! "
+             << clippedSamples
+             << " output samples were outside the range of the sample format and have been clipped\n";
+    }
+}
+
+/**
+ * @brief Write the statistics of the run to the file chosen with --stats, or with the other messages
+ * 
+ * @param stats Statistics of the run
+ * @param options Settings parsed from the command line
+ */
+static void writeStats(runStats &stats, const runOptions &options)
+{
+    if (options.statsFile.empty())
+    {
+        stats.writeJson(cout);
+        return;
+    }
+
+    ofstream statsOutput(options.statsFile);
+    if (!statsOutput.is_open())
+    {
+        throw filterError("Error! could not create file " + options.statsFile);
+    }
+    stats.writeJson(statsOutput);
+}
+
+/**
+ * @brief Design the filters given on the command line for the sample rate of the input file and compile them
+ * 
+ * @param specs Specifications of the filters in the order they are to be applied
+ * @param samplesPerSecond Sample rate of the input file
+ * @param options Settings parsed from the command line
+ * @param stats Statistics of the run, NULL if not collected
+ * @param multirateStages Receives the filters of the multirate filters, which are applied after the fir filters
+ * @param iirStages Receives the sections of the iir filters, which are applied after the multirate filters
+ * @return Sets of filter coefficients in the order they are to be applied
+ */
+static vector<vector<double>> designFilters(const vector<filterSpec> &specs, uint32_t samplesPerSecond, const runOptions &options, runStats *stats,
+                                            vector<multirateStage> &multirateStages, vector<vector<biquadSection>> &iirStages)
+{
+    scopedTimer designTimer(stats, (stats != NULL) ? stats->addPhase("design filters") : 0);
+    vector<vector<double>> stages = filterDesigner::designStages(specs, samplesPerSecond);
+    multirateStages = filterDesigner::designMultirateStages(specs, samplesPerSecond);
+    iirStages = filterDesigner::designIirStages(specs, samplesPerSecond);
+    designTimer.stop();
+
+    uint64_t firCount = 0;
+    uint64_t multirateCount = 0;
+    uint64_t iirCount = 0;
+    for (uint64_t i = 0; i < specs.size() && !options.quiet; i++)
+    {
+        cout << "Designed filter "
+             << filterDesigner::describeSpec(specs[i])
+             << " with ";
+        if (specs[i].method == designMethod::iir)
+        {
+            cout << iirStages[iirCount++].size() << " biquad sections";
+        }
+        else if (filterDesigner::getDecimationFactor(specs[i], samplesPerSecond) > 1)
+        {
+            // -- Run at a reduced rate, the narrow filter is designed for that rate
+            const multirateStage &stage = multirateStages[multirateCount++];
+            cout << stage.antiAliasCoeffs.size()
+                 << " anti-alias coefficients and "
+                 << stage.narrowCoeffs.size()
+                 << " coefficients at "
+                 << samplesPerSecond / (double)stage.factor
+                 << " Hz, decimated by "
+                 << stage.factor;
+        }
+        else
+        {
+            cout << stages[firCount++].size() << " coefficients";
+        }
+        cout << " for "
+             << samplesPerSecond
+             << " Hz\n";
+    }
+
+    filterChain chain;
+    return chain.compile(stages, options.fuseStages);
+}
+
+/**
+ * @brief Filter the wav file, or the wav files of a batch, as given on the command line
+ * 
+ * @param argc Number of command line arguments
+ * @param argv Array of command line arguments: 
+ *        argv[1] Specifies the name of the input wav file, or - to read it from the standard input
+ *        argv[2] Specifies the name of the output wav file, or - to write it to the standard output
+ *        argv[3] Specifies if default filters are to used or custom coefficients are to be used. Options include: y (default filter), n (custom coefficients),
+ *                d (filters designed for the sample rate of the input file)
+ *        argv[4] Specifies the number of filters to be applied. If default filters are used, only have a maximum of 4 filters can be applied. If this value
+ *                is 0, then the input wav file is simply copied to the output file without modification.
+ *        argv[5] If using default filters, specifies the first type of filter to be used. The options include: lp, hp, bp, bs.
+ *                lp-iir, hp-iir, bp-iir and bs-iir apply a cascade of biquad sections with a similar magnitude response instead.
+ *                If using custom coefficients, specifies the name of the text file with the coefficient values. Each set of coefficients should be enclosed 
+ *                in square brackets and individual coefficients should be seperated by commas. Each set of coefficients should be seperated by commas and the
+ *                number of sets of coefficients should equal the value of argv[4]. A coefficient bank written by coeffBankConverter
+ *                can be given in place of the text file. If designing filters, specifies the first filter to be designed. The options include:
+ *                lp:F, hp:F, bp:F1-F2, bs:F1-F2 with the cutoff frequencies F in Hz, in the middle of the transition bands.
+ *                A type ending in -iir, such as lp-iir:F, designs a cascade of biquad sections instead.
+ *                The iir filters are applied after the fir filters, which gives the same output up to rounding
+ *        argv[6-8] Optional arguments if using default filters. Specifies type of filters to be used. The options include: lp, hp, bp, bs 
+ *                  If designing filters, specifies the further filters to be designed
+ *        Options of the form --name=value can be given anywhere on the command line:
+ *        --partition-size=N Applies the filters with the partitioned convolution, using partitions of N coefficients
+ *        --simd=LEVEL Limits the fir kernels to the instruction set LEVEL: scalar, sse2, avx2 or avx512
+ *        --q15 Filters in Q15 fixed point and reports the signal to noise ratio versus double precision
+ *        --q15-headroom=B Filters in Q15 fixed point with the coefficients scaled down by B bits
+ *        --no-fuse Applies every filter in a separate pass instead of fusing neighbouring filters
+ *        --threads=N Filters each file with N threads, 0 for one thread per processor core. The channels and the
+ *                    segments of each channel are spread over the threads
+ *        --stream Filters the audio data one block at a time while it is read, keeping memory use independent of the file length
+ *        --pipeline Streams with reading, every filter and writing running on threads of their own
+ *        --channels=LIST Filters only the channels in the comma separated LIST, starting at 1, and copies the others unchanged
+ *        --dither Adds triangular dither of up to 1 least significant bit to integer output samples before rounding
+ *        --ripple=DB Sets the largest passband ripple of the designed filters, 0.1 dB by default
+ *        --attenuation=DB Sets the smallest stopband attenuation of the designed filters, 60 dB by default
+ *        --transition=HZ Sets the width of the transition bands of the designed filters, 100 Hz by default
+ *        --equiripple Designs the filters with the Parks-McClellan algorithm, which takes longer than the Kaiser window but
+ *                     usually needs fewer coefficients
+ *        --no-multirate Runs every designed filter at the sample rate of the input file, instead of running narrow low pass
+ *                       and band pass filters at a reduced rate
+ *        --quiet Does not print the parsed or designed coefficients
+ *        --stats[=FILE] Writes the time, samples, bytes, multiply-accumulates and peak memory of every phase of the run
+ *                       as JSON to FILE, or prints them after the other messages
+ *        --batch Treats argv[1] as a manifest listing an input and an output wav file per line, and writes the
+ *                throughput of every file to argv[2], or to the standard output if it is -. The filters are set
+ *                up once and the files are filtered concurrently, --threads=N sets the number of files filtered at once
+ * @return Program exit code
+ */
+static int runFilter(int argc, char *argv[])
+{
+    string inputFile, outputFile, defaultFilter;
+    int16_t filterCount;
+    argumentValidator validator;
+    runOptions options;
+    runStats stats;
+
+    // -- Kept until the end, as a coefficient bank stays mapped while the filters use its derived data
+    coeffFileParser fileParser;
+
+    // -- Take out the optional settings, leaving the positional arguments
+    options = validator.extractOptions(argc, argv);
+    runStats *statsPtr = options.stats ? &stats : NULL;
+
+    // -- Restrict the fir kernels to an older instruction set if requested
+    if (options.simd == "scalar")
+    {
+        firKernels::setSimdLevel(simdLevel::scalar);
+    }
+    else if (options.simd == "sse2")
+    {
+        firKernels::setSimdLevel(simdLevel::sse2);
+    }
+    else if (options.simd == "avx2")
+    {
+        firKernels::setSimdLevel(simdLevel::avx2);
+    }
+    else if (options.simd == "avx512")
+    {
+        firKernels::setSimdLevel(simdLevel::avx512);
+    }
+
+    // -- Check if all required arguments are present
+    validator.requiredArgsPresent((uint16_t)argc);
+
+    inputFile = argv[1];
+    outputFile = argv[2];
+    defaultFilter = argv[3];
+
+    // -- When the output wav file goes to the standard output, messages go to the standard error instead
+    if (outputFile == "-" && !options.batch)
+    {
+        cout.rdbuf(cerr.rdbuf());
+    }
+
+    // -- Make sure filter count is a valid integer
+    filterCount = validator.validFilterCount(argv[4]);
+
+    // -- Sets of filter coefficients in the order they are to be applied
+    vector<vector<double>> stages;
+
+    // -- Filters run at a reduced rate, applied after the fir filters
+    vector<multirateStage> multirateStages;
+
+    // -- Sections of the iir filters, applied after the multirate filters
+    vector<vector<biquadSection>> iirStages;
+
+    // -- Filters to be designed once the sample rate of the input file is known
+    vector<filterSpec> designSpecs;
+
+    // -- Only if the filter count is greater than 0, then complete further processing
+    if (filterCount > 0)
+    {
+        if (defaultFilter == "y" || defaultFilter == "Y")
+        {
+            // -- Default filters chosen
+
+            // -- Make sure the filter count agrees with the number of arguments
+            validator.validFilterCountAndNumOfArgs(filterCount, (uint16_t)argc);
+
+            // -- Look up the coefficients of each default filter chosen
+            for (int16_t i = 5; i < argc; i++)
+            {
+                // -- Filter types are matched regardless of case
+                string lowerType = argv[i];
+                transform(lowerType.begin(), lowerType.end(), lowerType.begin(), [](unsigned char c) { return (char)tolower(c); });
+
+                // -- Depending on the filter specified, use its coefficients
+                if (lowerType == "lp")
+                {
+                    // -- Lowpass filter
+                    stages.push_back(vector<double>(lowPassCoeffs.begin(), lowPassCoeffs.end()));
+                }
+                else if (lowerType == "hp")
+                {
+                    // -- Highpass filter
+                    stages.push_back(vector<double>(highPassCoeffs.begin(), highPassCoeffs.end()));
+                }
+                else if (lowerType == "bp")
+                {
+                    // -- Bandpass filter
+                    stages.push_back(vector<double>(speechRangeCoeffs.begin(), speechRangeCoeffs.end()));
+                }
+                else if (lowerType == "bs")
+                {
+                    // -- Bandstop filter
+                    stages.push_back(vector<double>(noSpeechRangeCoeffs.begin(), noSpeechRangeCoeffs.end()));
+                }
+                else if (lowerType == "lp-iir" || lowerType == "hp-iir" || lowerType == "bp-iir" || lowerType == "bs-iir")
+                {
+                    // -- Iir counterpart of a default filter, whose frequencies move with the sample rate like the tables
+                    const filterSpec &spec = (lowerType == "lp-iir")   ? lowPassIirSpec
+                                             : (lowerType == "hp-iir") ? highPassIirSpec
+                                             : (lowerType == "bp-iir") ? speechRangeIirSpec
+                                                                       : noSpeechRangeIirSpec;
+                    iirStages.push_back(filterDesigner::designIir(spec, Default_Iir_Sample_Rate));
+                }
+                else
+                {
+                    throw filterError("Error! invalid filter type chosen for argument " + to_string(i + 1) + ". Make sure filter_type is only one of the following "
+                                      "lp, hp, bp, bs, lp-iir, hp-iir, bp-iir, bs-iir");
+                }
+            }
+        }
+        else if (defaultFilter == "n" || defaultFilter == "N")
+        {
+            // -- Custom filters chosen
+            string coefficientFile;
+
+            coefficientFile = argv[5];
+            fileParser.setQuiet(options.quiet);
+
+            // -- Parse the coefficients file
+            scopedTimer parseTimer(statsPtr, options.stats ? stats.addPhase("parse coefficients") : 0);
+            stages = fileParser.parseCoeffs(coefficientFile);
+            parseTimer.stop();
+
+            // -- Let the filters use the Q15 coefficients and spectra stored in a coefficient bank
+            if (fileParser.getBank() != NULL)
+            {
+                firFilter::setCoeffPlans(&fileParser.getBank()->getPlans());
+            }
+
+            // -- Check that the number of set of coefficients is equal to the number of filters supplied in the commandline
+            uint16_t coefficientsVectorSize = (uint16_t)stages.size();
+            validator.validSetOfCoefficients(coefficientsVectorSize, filterCount);
+        }
+        else if (defaultFilter == "d" || defaultFilter == "D")
+        {
+            // -- Designed filters chosen, they are designed and compiled once the input file has been opened
+            validator.validFilterCountAndNumOfArgs(filterCount, (uint16_t)argc);
+            for (int16_t i = 5; i < argc; i++)
+            {
+                filterSpec spec = filterDesigner::parseSpec(argv[i]);
+                spec.passbandRipple = options.passbandRipple;
+                spec.stopbandAttenuation = options.stopbandAttenuation;
+                spec.transitionWidth = options.transitionWidth;
+                if (spec.method != designMethod::iir)
+                {
+                    spec.method = options.equiripple ? designMethod::equiripple : designMethod::kaiser;
+                }
+                spec.multirate = options.multirate;
+                designSpecs.push_back(spec);
+            }
+        }
+        else
+        {
+            throw filterError("Error! invalid value for default filter. Make sure default_filter is only one of the following "
+                              "y (default filter), n (custom coefficients), d (designed filters)");
+        }
+
+        // -- Drop the filters that do nothing and fuse neighbouring filters where that saves passes over the audio data
+        if (designSpecs.empty())
+        {
+            scopedTimer compileTimer(statsPtr, options.stats ? stats.addPhase("compile filters") : 0);
+            filterChain chain;
+            stages = chain.compile(stages, options.fuseStages);
+        }
+    }
+
+    // -- Describe the run, so the statistics of different runs can be told apart
+    stats.setField("input", inputFile);
+    stats.setField("output", outputFile);
+    stats.setField("mode", options.batch ? "batch" : (options.pipeline ? "pipeline" : (options.stream ? "stream" : "memory")));
+    stats.setField("simd", firKernels::getSimdLevelName(firKernels::getSimdLevel()));
+
+    if (options.batch)
+    {
+        // -- Filter every file listed in the manifest with the same filters, one file per thread
+        batchProcessor batch;
+        vector<batchJob> jobs = batch.readManifest(inputFile);
+        if (!designSpecs.empty())
+        {
+            batch.setDesignSpecs(&designSpecs);
+        }
+        batch.setIirStages(&iirStages);
+        batch.setCoeffBank(fileParser.getBank());
+        threadPool pool(options.threads);
+        double wallSeconds = batch.processJobs(jobs, stages, options, pool, statsPtr);
+        bool failed = false;
+        for (uint64_t i = 0; i < jobs.size(); i++)
+        {
+            stats.addSamples(jobs[i].samples);
+            failed = failed || !jobs[i].error.empty();
+        }
+
+        if (outputFile == "-")
+        {
+            batch.writeReport(jobs, wallSeconds, cout);
+        }
+        else
+        {
+            ofstream report(outputFile);
+            if (!report.is_open())
+            {
+                throw filterError("Error! could not create file " + outputFile);
+            }
+            batch.writeReport(jobs, wallSeconds, report);
+        }
+
+        if (options.stats)
+        {
+            writeStats(stats, options);
+        }
+
+        // -- The report lists the files that failed, so they only change the exit code
+        return failed ? 1 : 0;
+    }
+
+    // -- Open the input file, "-" reads the input from the standard input
+    FILE *fp = (inputFile == "-") ? stdin : fopen(argv[1], "rb"); // -- read in binary mode
+    if (fp == NULL)
+    {
+        throw filterError("Error! could not open file " + inputFile + ": please make sure that this is the correct filename\n ");
+    }
+
+    if (options.stream)
+    {
+        // -- Create the output file, "-" writes the output to the standard output
+        FILE *outputFp = (outputFile == "-") ? stdout : fopen(argv[2], "wb"); // -- Write in binary mode
+        if (outputFp == NULL)
+        {
+            if (fp != stdin)
+            {
+                fclose(fp);
+            }
+            throw filterError("Error! could not create file " + outputFile);
+        }
+
+        try
+        {
+            // -- Filter the input file one block at a time, without holding the whole file in memory
+            wavStream stream(fp, outputFp, statsPtr);
+            if (fileParser.getBank() != NULL)
+            {
+                fileParser.getBank()->checkSampleRate(stream.getSamplesPerSecond());
+            }
+            if (!designSpecs.empty())
+            {
+                stages = designFilters(designSpecs, stream.getSamplesPerSecond(), options, statsPtr, multirateStages, iirStages);
+            }
+            stream.setMultirateStages(multirateStages);
+            stream.setIirStages(iirStages);
+            stream.setChannels(options.channels);
+            stream.setDither(options.dither);
+            stats.addSamples(stream.processStream(stages, options.partitionSize, options.q15, options.q15HeadroomBits, options.pipeline));
+            reportClipping(stream.getClippedSamples());
+        }
+        catch (const filterError &)
+        {
+            // -- The output file is created before the input header is read, so it is removed again on errors
+            // -- as an output file left behind would look like a filtered file
+            if (outputFp != stdout)
+            {
+                fclose(outputFp);
+                remove(outputFile.c_str());
+            }
+            if (fp != stdin)
+            {
+                fclose(fp);
+            }
+            throw;
+        }
+
+        if (outputFp != stdout)
+        {
+            fclose(outputFp);
+        }
+        if (fp != stdin)
+        {
+            fclose(fp);
+        }
+
+        if (options.stats)
+        {
+            writeStats(stats, options);
+        }
+        return 0;
+    }
+
+    // -- Create an instance of the wavFile class using the input wave file
+    wavFile wav(fp, statsPtr);
+    stats.addSamples(wav.getNumberOfSamples());
+    if (fp != stdin)
+    {
+        fclose(fp);
+    }
+
+    if (fileParser.getBank() != NULL)
+    {
+        fileParser.getBank()->checkSampleRate(wav.getSamplesPerSecond());
+    }
+    if (!designSpecs.empty())
+    {
+        stages = designFilters(designSpecs, wav.getSamplesPerSecond(), options, statsPtr, multirateStages, iirStages);
+    }
+
+    // -- Split the filtering of the file over several threads if requested, each channel is filtered on its own
+    threadPool pool(options.threads);
+    wav.setThreadPool(&pool);
+    wav.setChannels(options.channels);
+    wav.setDither(options.dither);
+
+    for (uint32_t i = 0; i < (uint32_t)stages.size(); i++)
+    {
+        // -- Process the wav file with each set of coefficients
+        applyFilter(wav, stages[i], (uint32_t)stages[i].size(), options, i + 1);
+
+        // -- For the next round of processing, the current output data should become the next input audio data
+        wav.nextStage();
+    }
+
+    for (uint32_t i = 0; i < (uint32_t)multirateStages.size(); i++)
+    {
+        wav.processMultirateFilter(multirateStages[i]);
+        wav.nextStage();
+    }
+
+    for (uint32_t i = 0; i < (uint32_t)iirStages.size(); i++)
+    {
+        wav.processIirFilter(iirStages[i]);
+        wav.nextStage();
+    }
+
+    // -- Create a new wav file and see if it was successful
+    fp = (outputFile == "-") ? stdout : fopen(argv[2], "wb+"); // -- Write in binary mode, also readable so it can be mapped
+    if (fp == NULL)
+    {
+        throw filterError("Error! could not create file " + outputFile);
+    }
+
+    // -- Write the contents of the output audio file
+    wav.writeWavFile(fp);
+    reportClipping(wav.getClippedSamples());
+    if (fp != stdout)
+    {
+        fclose(fp);
+    }
+
+    if (options.stats)
+    {
+        writeStats(stats, options);
+    }
+    return 0;
+}
+
+/**
+ * @brief Entry point of this program
+ * 
+ * The filtering is done by the classes of the library, which throw a filterError when they run into an error.
+ * The error message is printed and the program exits with 1
+ * 
+ * @param argc Number of command line arguments
+ * @param argv Array of command line arguments, see runFilter
+ * @return Program exit code
+ */
+int main(int argc, char *argv[])
+{
+    try
+    {
+        return runFilter(argc, argv);
+    }
+    catch (const filterError &error)
+    {
+        cout << error.what();
+        return 1;
+    }
+}
@@ -0,0 +1,324 @@
+/**
+ * @file batchProcessor.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the batchProcessor class
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "batchProcessor.hpp"
+#include "filterError.hpp"
+#include "wavFile.hpp"
+#include "wavStream.hpp"
+#include "filterChain.hpp"
+
+using namespace std;
+
+batchProcessor::batchProcessor()
+{
+    // -- Default constructor
+    designSpecs = NULL;
+    iirStages = NULL;
+    bank = NULL;
+}
+
+void batchProcessor::setDesignSpecs(const vector<filterSpec> *specs)
+{
+    designSpecs = specs;
+}
+
+void batchProcessor::setIirStages(const vector<vector<biquadSection>> *iirStages)
+{
+    this->iirStages = iirStages;
+}
+
+void batchProcessor::setCoeffBank(coeffBank *bank)
+{
+    this->bank = bank;
+}
+
+void batchProcessor::designStages(uint32_t samplesPerSecond, const runOptions &options, vector<vector<double>> &firStages, vector<multirateStage> &multirateStages,
+                                  vector<vector<biquadSection>> &iirStages)
+{
+    // -- Files sharing a sample rate get the remembered designs
+    filterChain chain;
+    firStages = chain.compile(filterDesigner::designStages(*designSpecs, samplesPerSecond), options.fuseStages);
+    multirateStages = filterDesigner::designMultirateStages(*designSpecs, samplesPerSecond);
+    iirStages = filterDesigner::designIirStages(*designSpecs, samplesPerSecond);
+}
+
+vector<batchJob> batchProcessor::readManifest(const string &manifestFile)
+{
+    vector<batchJob> jobs;
+    ifstream manifest(manifestFile);
+    if (!manifest.is_open())
+    {
+        throw filterError("Error! could not open manifest file " + manifestFile + ": please make sure that this is the correct filename\n ");
+    }
+
+    string line;
+    uint32_t lineNumber = 0;
+    while (getline(manifest, line))
+    {
+        lineNumber++;
+
+        // -- Manifests written on windows end their lines with a carriage return
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        istringstream fields(line);
+        batchJob job;
+        string extra;
+        if (!(fields >> job.inputFile) || job.inputFile[0] == '#')
+        {
+            continue;
+        }
+
+        if (!(fields >> job.outputFile) || (fields >> extra))
+        {
+            throw filterError("Error! line " + to_string(lineNumber) + " of manifest file " + manifestFile + " must hold an input file name and an output file name");
+        }
+
+        // -- The longest files are started first, and a file that cannot be opened is started last and reported as failed
+        ifstream input(job.inputFile, ios::binary | ios::ate);
+        if (input.is_open())
+        {
+            job.inputBytes = (uint64_t)input.tellg();
+        }
+
+        jobs.push_back(job);
+    }
+
+    if (jobs.empty())
+    {
+        throw filterError("Error! manifest file " + manifestFile + " does not list any files");
+    }
+
+    return jobs;
+}
+
+void batchProcessor::processJob(batchJob &job, const vector<vector<double>> &stages, const runOptions &options, runStats *stats)
+{
+    auto start = chrono::steady_clock::now();
+
+    // -- The other files of the batch go on being filtered, so the files are closed on errors too
+    FILE *fp = NULL;
+    FILE *outputFp = NULL;
+    try
+    {
+        fp = fopen(job.inputFile.c_str(), "rb");
+        if (fp == NULL)
+        {
+            throw filterError("Error! could not open file " + job.inputFile + ": please make sure that this is the correct filename");
+        }
+
+        if (options.stream)
+        {
+            outputFp = fopen(job.outputFile.c_str(), "wb");
+            if (outputFp == NULL)
+            {
+                throw filterError("Error! could not create file " + job.outputFile);
+            }
+
+            wavStream stream(fp, outputFp, stats);
+            if (bank != NULL)
+            {
+                bank->checkSampleRate(stream.getSamplesPerSecond());
+            }
+            vector<vector<double>> designedStages;
+            vector<multirateStage> jobMultirateStages;
+            vector<vector<biquadSection>> jobIirStages = (iirStages != NULL) ? *iirStages : vector<vector<biquadSection>>();
+            if (designSpecs != NULL)
+            {
+                designStages(stream.getSamplesPerSecond(), options, designedStages, jobMultirateStages, jobIirStages);
+            }
+            const vector<vector<double>> &jobStages = (designSpecs != NULL) ? designedStages : stages;
+            stream.setMultirateStages(jobMultirateStages);
+            stream.setIirStages(jobIirStages);
+            stream.setChannels(options.channels);
+            stream.setDither(options.dither);
+            job.samples = stream.processStream(jobStages, options.partitionSize, options.q15, options.q15HeadroomBits, options.pipeline);
+            job.clippedSamples = stream.getClippedSamples();
+        }
+        else
+        {
+            wavFile wav(fp, stats);
+            fclose(fp);
+            fp = NULL;
+            wav.setChannels(options.channels);
+            wav.setDither(options.dither);
+            if (bank != NULL)
+            {
+                bank->checkSampleRate(wav.getSamplesPerSecond());
+            }
+            vector<vector<double>> designedStages;
+            vector<multirateStage> jobMultirateStages;
+            vector<vector<biquadSection>> jobIirStages = (iirStages != NULL) ? *iirStages : vector<vector<biquadSection>>();
+            if (designSpecs != NULL)
+            {
+                designStages(wav.getSamplesPerSecond(), options, designedStages, jobMultirateStages, jobIirStages);
+            }
+            const vector<vector<double>> &jobStages = (designSpecs != NULL) ? designedStages : stages;
+
+            // -- The threads of the pool are busy with other files, so every file is filtered by a single thread
+            for (uint64_t i = 0; i < jobStages.size(); i++)
+            {
+                if (options.q15)
+                {
+                    wav.processQ15Filter(jobStages[i], (uint32_t)jobStages[i].size(), options.q15HeadroomBits);
+                }
+                else
+                {
+                    wav.processFirFilter(jobStages[i], (uint32_t)jobStages[i].size(), options.partitionSize);
+                }
+                wav.nextStage();
+            }
+            for (uint64_t i = 0; i < jobMultirateStages.size(); i++)
+            {
+                wav.processMultirateFilter(jobMultirateStages[i]);
+                wav.nextStage();
+            }
+            for (uint64_t i = 0; i < jobIirStages.size(); i++)
+            {
+                wav.processIirFilter(jobIirStages[i]);
+                wav.nextStage();
+            }
+
+            outputFp = fopen(job.outputFile.c_str(), "wb+");
+            if (outputFp == NULL)
+            {
+                throw filterError("Error! could not create file " + job.outputFile);
+            }
+
+            wav.writeWavFile(outputFp);
+            job.samples = wav.getNumberOfSamples();
+            job.clippedSamples = wav.getClippedSamples();
+        }
+    }
+    catch (const filterError &error)
+    {
+        // -- A bad file is listed in the report instead of stopping the batch
+        job.error = error.what();
+        job.error.erase(job.error.find_last_not_of(" \r\n") + 1);
+
+        // -- An output file left behind would look like a filtered file
+        if (outputFp != NULL)
+        {
+            fclose(outputFp);
+            outputFp = NULL;
+            remove(job.outputFile.c_str());
+        }
+    }
+    catch (...)
+    {
+        if (outputFp != NULL)
+        {
+            fclose(outputFp);
+        }
+        if (fp != NULL)
+        {
+            fclose(fp);
+        }
+        throw;
+    }
+
+    if (outputFp != NULL)
+    {
+        fclose(outputFp);
+    }
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+
+    job.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+double batchProcessor::processJobs(vector<batchJob> &jobs, const vector<vector<double>> &stages, const runOptions &options, threadPool &pool, runStats *stats)
+{
+    // -- Longest files first, as a long file started last would keep one thread busy after all others are done
+    vector<uint64_t> order(jobs.size());
+    for (uint64_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) { return jobs[a].inputBytes > jobs[b].inputBytes; });
+
+    auto start = chrono::steady_clock::now();
+
+    pool.parallelFor(order.size(), [&](uint64_t task) { processJob(jobs[order[task]], stages, options, stats); });
+
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void batchProcessor::writeReport(const vector<batchJob> &jobs, double wallSeconds, ostream &report)
+{
+    uint64_t totalSamples = 0;
+    uint64_t totalBytes = 0;
+    double totalSeconds = 0;
+    uint64_t failedFiles = 0;
+
+    for (uint64_t i = 0; i < jobs.size(); i++)
+    {
+        const batchJob &job = jobs[i];
+        double seconds = max(job.seconds, 1e-9);
+        if (!job.error.empty())
+        {
+            report << job.inputFile
+                   << " -> "
+                   << job.outputFile
+                   << ": failed: "
+                   << job.error
+                   << "\n";
+            failedFiles++;
+            continue;
+        }
+
+        report << job.inputFile
+               << " -> "
+               << job.outputFile
+               << ": "
+               << job.samples
+               << " samples in "
+               << job.seconds
+               << " s, "
+               << job.samples / seconds / 1e6
+               << " Msamples/s, "
+               << job.inputBytes / seconds / 1e6
+               << " MB/s, "
+               << job.clippedSamples
+               << " samples clipped\n";
+
+        totalSamples += job.samples;
+        totalBytes += job.inputBytes;
+        totalSeconds += job.seconds;
+    }
+
+    // -- The sum of the times of the files over the wall time tells how well the threads were kept busy
+    wallSeconds = max(wallSeconds, 1e-9);
+    report << "Total: "
+           << jobs.size()
+           << " files, "
+           << failedFiles
+           << " failed, "
+           << totalSamples
+           << " samples in "
+           << wallSeconds
+           << " s, "
+           << totalSamples / wallSeconds / 1e6
+           << " Msamples/s, "
+           << totalBytes / wallSeconds / 1e6
+           << " MB/s, "
+           << totalSeconds / wallSeconds
+           << " files filtered at once on average\n";
+}
@@ -0,0 +1,191 @@
+/**
+ * @file batchProcessor.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition to filter many wav files with the same chain of filters
+ * 
+ * The files to be filtered are listed in a manifest, one pair of input and output file names per line.
+ * The filter coefficients are parsed and compiled once for all files, and the files are filtered
+ * concurrently, one file per task of a thread pool. The files are ordered from the longest to the
+ * shortest, so the long files are started first and the short ones fill up the threads that finish early.
+ * The time taken by each file is measured to report the throughput. Designed filters are designed for the
+ * sample rate of each file instead, once per sample rate.
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include "threadPool.hpp"
+#include "runStats.hpp"
+#include "argumentValidator.hpp"
+#include "filterDesigner.hpp"
+#include "coeffBank.hpp"
+
+using namespace std;
+
+/**
+ * @brief One file of a batch, along with the measurements taken while filtering it
+ * 
+ */
+struct batchJob
+{
+    /**
+     * @brief Name of the input wav file
+     * 
+     */
+    string inputFile;
+
+    /**
+     * @brief Name of the output wav file
+     * 
+     */
+    string outputFile;
+
+    /**
+     * @brief Size of the input file in bytes
+     * 
+     */
+    uint64_t inputBytes = 0;
+
+    /**
+     * @brief Number of samples filtered
+     * 
+     */
+    uint64_t samples = 0;
+
+    /**
+     * @brief Number of output samples saturated to the range of the sample format
+     * 
+     */
+    uint64_t clippedSamples = 0;
+
+    /**
+     * @brief Time taken to read, filter and write the file, in seconds
+     * 
+     */
+    double seconds = 0;
+
+    /**
+     * @brief Description of the error that stopped the file from being filtered, empty if it was filtered
+     * 
+     */
+    string error;
+};
+
+class batchProcessor
+{
+public:
+    /**
+     * @brief Default constructor to create a new batch processor object
+     * 
+     */
+    batchProcessor();
+
+    /**
+     * @brief Read the list of files to be filtered
+     * 
+     * Every line holds the name of an input wav file and the name of its output wav file, separated by
+     * spaces or tabs. Empty lines and lines starting with # are skipped. File names cannot contain spaces
+     * 
+     * @param manifestFile Name of the manifest file
+     * @return The files to be filtered, in the order of the manifest
+     */
+    vector<batchJob> readManifest(const string &manifestFile);
+
+    /**
+     * @brief Design the filters for the sample rate of each file, in place of the stages given to processJobs
+     * 
+     * @param specs Specifications of the filters in the order they are to be applied, NULL to use the stages.
+     *              Must stay valid while the files are filtered
+     */
+    void setDesignSpecs(const vector<filterSpec> *specs);
+
+    /**
+     * @brief Choose the iir filters applied after the stages given to processJobs, when the filters are not designed
+     * 
+     * @param iirStages Sections of each iir filter, NULL for none. Must stay valid while the files are filtered
+     */
+    void setIirStages(const vector<vector<biquadSection>> *iirStages);
+
+    /**
+     * @brief Choose the coefficient bank the stages given to processJobs were read from, whose sample rate every
+     * file must have
+     * 
+     * @param bank The coefficient bank, NULL if the stages were not read from one. Must stay valid while the files
+     *             are filtered
+     */
+    void setCoeffBank(coeffBank *bank);
+
+    /**
+     * @brief Filter every file with the chain of filters
+     * 
+     * Each file is filtered by one thread of the pool, in the same way as a single file given on the
+     * command line, so the output files are the same as filtering the files one by one. A file that cannot be
+     * filtered does not stop the others, its error is kept in the job instead
+     * 
+     * @param jobs Files to be filtered, the measurements or the error are filled in
+     * @param stages Sets of filter coefficients in the order they are to be applied
+     * @param options Settings parsed from the command line
+     * @param pool Pool of threads filtering the files
+     * @param stats Statistics receiving the phases of every file, added up over the files, NULL to not collect any
+     * @return Time taken to filter all files, in seconds
+     */
+    double processJobs(vector<batchJob> &jobs, const vector<vector<double>> &stages, const runOptions &options, threadPool &pool, runStats *stats = NULL);
+
+    /**
+     * @brief Write the throughput of every file and of the whole batch, and the error of every file that failed
+     * 
+     * @param jobs Files filtered by processJobs
+     * @param wallSeconds Time taken to filter all files, in seconds
+     * @param report Stream the report is written to
+     */
+    void writeReport(const vector<batchJob> &jobs, double wallSeconds, ostream &report);
+
+private:
+    /**
+     * @brief Read, filter and write one file
+     * 
+     * @param job File to be filtered, the measurements are filled in, or the error if a filterError stops it
+     * @param stages Sets of filter coefficients in the order they are to be applied
+     * @param options Settings parsed from the command line
+     * @param stats Statistics of the run, NULL if not collected
+     */
+    void processJob(batchJob &job, const vector<vector<double>> &stages, const runOptions &options, runStats *stats);
+
+    /**
+     * @brief Design the filters for the sample rate of a file and compile the fir filters
+     * 
+     * @param samplesPerSecond Sample rate of the file
+     * @param options Settings parsed from the command line
+     * @param firStages Receives the sets of filter coefficients in the order they are to be applied
+     * @param multirateStages Receives the filters of each multirate filter, applied after the fir filters
+     * @param iirStages Receives the sections of each iir filter, applied after the multirate filters
+     */
+    void designStages(uint32_t samplesPerSecond, const runOptions &options, vector<vector<double>> &firStages, vector<multirateStage> &multirateStages,
+                      vector<vector<biquadSection>> &iirStages);
+
+    /**
+     * @brief Specifications of the filters designed for each file, NULL to use the stages given to processJobs
+     * 
+     */
+    const vector<filterSpec> *designSpecs;
+
+    /**
+     * @brief Sections of the iir filters applied after the stages given to processJobs, NULL for none
+     * 
+     */
+    const vector<vector<biquadSection>> *iirStages;
+
+    /**
+     * @brief Coefficient bank the stages given to processJobs were read from, NULL if none
+     * 
+     */
+    coeffBank *bank;
+};
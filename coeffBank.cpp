@@ -0,0 +1,363 @@
+/**
+ * @file coeffBank.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the binary coefficient bank
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <complex>
+#include "coeffBank.hpp"
+#include "filterError.hpp"
+
+using namespace std;
+
+/**
+ * @brief Round an offset up to the alignment of the arrays of a bank
+ *
+ * @param offset Offset in bytes
+ * @return The next aligned offset
+ */
+static uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + Coeff_Bank_Alignment - 1) / Coeff_Bank_Alignment * Coeff_Bank_Alignment;
+}
+
+coeffBank::coeffBank()
+{
+    // -- Default constructor
+    data = NULL;
+    size = 0;
+    sampleRate = 0;
+}
+
+bool coeffBank::isBank(const unsigned char *data, uint64_t size)
+{
+    return size >= sizeof(Coeff_Bank_Magic) && memcmp(data, Coeff_Bank_Magic, sizeof(Coeff_Bank_Magic)) == 0;
+}
+
+uint64_t coeffBank::checksum(const unsigned char *data, uint64_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    uint64_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    if (i < size)
+    {
+        uint64_t word = 0;
+        memcpy(&word, data + i, size - i);
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void coeffBank::writeBank(const string &outputFile, const vector<vector<double>> &filterCoeffs, const coeffBankOptions &options)
+{
+    coeffBankHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Coeff_Bank_Magic, sizeof(header.magic));
+    header.version = Coeff_Bank_Version;
+    header.setCount = (uint32_t)filterCoeffs.size();
+    header.sampleRate = options.sampleRate;
+    header.entrySize = sizeof(coeffBankEntry);
+
+    // -- Derive the data of each set from the coefficients as they are stored, so a bank of float32
+    // -- coefficients gives the same results with and without its derived data
+    vector<vector<double>> storedCoeffs = filterCoeffs;
+    if (options.float32)
+    {
+        for (uint64_t i = 0; i < storedCoeffs.size(); i++)
+        {
+            for (uint64_t j = 0; j < storedCoeffs[i].size(); j++)
+            {
+                storedCoeffs[i][j] = (double)(float)storedCoeffs[i][j];
+            }
+        }
+    }
+
+    // -- Lay out the arrays after the entries, each at an aligned offset
+    vector<coeffBankEntry> entries(filterCoeffs.size());
+    vector<q15Coeffs> quantised(filterCoeffs.size());
+    vector<vector<vector<complex<double>>>> spectra(filterCoeffs.size());
+    uint64_t offset = alignOffset(sizeof(coeffBankHeader) + entries.size() * sizeof(coeffBankEntry));
+    for (uint64_t i = 0; i < entries.size(); i++)
+    {
+        const vector<double> &coeffs = storedCoeffs[i];
+        uint32_t coeffsLen = (uint32_t)coeffs.size();
+        coeffBankEntry &entry = entries[i];
+        memset(&entry, 0, sizeof(entry));
+
+        entry.coeffsLen = coeffsLen;
+        entry.coeffsType = (uint32_t)(options.float32 ? coeffType::float32 : coeffType::float64);
+        entry.coeffsOffset = offset;
+        offset = alignOffset(offset + (uint64_t)coeffsLen * (options.float32 ? sizeof(float) : sizeof(double)));
+
+        if (options.q15)
+        {
+            quantised[i] = firFilter::quantiseQ15(coeffs, coeffsLen, -1);
+            entry.q15CoeffsLen = (uint32_t)quantised[i].coeffs.size();
+            entry.q15Shift = quantised[i].shift;
+            entry.q15Offset = offset;
+            offset = alignOffset(offset + entry.q15CoeffsLen * sizeof(int16_t));
+        }
+
+        if (options.spectra)
+        {
+            vector<uint32_t> fftSizes = firFilter::getFftSizes(coeffsLen);
+            entry.spectrumCount = (uint32_t)fftSizes.size();
+            entry.firstFftSize = fftSizes[0];
+            entry.spectraOffset = offset;
+            for (uint32_t fftSize : fftSizes)
+            {
+                spectra[i].push_back(firFilter::computeCoeffsSpectrum(coeffs, coeffsLen, fftSize));
+                offset = alignOffset(offset + (fftSize / 2 + 1) * sizeof(complex<double>));
+            }
+        }
+    }
+    header.fileSize = offset;
+
+    // -- Fill in the arrays and their checksums
+    vector<unsigned char> image(header.fileSize, 0);
+    for (uint64_t i = 0; i < entries.size(); i++)
+    {
+        coeffBankEntry &entry = entries[i];
+        unsigned char *coeffsData = &image[entry.coeffsOffset];
+        for (uint32_t j = 0; j < entry.coeffsLen; j++)
+        {
+            if (options.float32)
+            {
+                float value = (float)storedCoeffs[i][j];
+                memcpy(coeffsData + j * sizeof(float), &value, sizeof(float));
+            }
+            else
+            {
+                memcpy(coeffsData + j * sizeof(double), &storedCoeffs[i][j], sizeof(double));
+            }
+        }
+        entry.coeffsChecksum = checksum(coeffsData, (uint64_t)entry.coeffsLen * (options.float32 ? sizeof(float) : sizeof(double)));
+
+        // -- The derived data is checksummed as one run of bytes, from the first array to the end of the last
+        uint64_t derivedStart = 0;
+        uint64_t derivedEnd = 0;
+        if (entry.q15CoeffsLen > 0)
+        {
+            memcpy(&image[entry.q15Offset], &quantised[i].coeffs[0], entry.q15CoeffsLen * sizeof(int16_t));
+            derivedStart = entry.q15Offset;
+            derivedEnd = entry.q15Offset + entry.q15CoeffsLen * sizeof(int16_t);
+        }
+        uint64_t spectrumOffset = entry.spectraOffset;
+        for (uint64_t k = 0; k < spectra[i].size(); k++)
+        {
+            uint64_t byteCount = spectra[i][k].size() * sizeof(complex<double>);
+            memcpy(&image[spectrumOffset], &spectra[i][k][0], byteCount);
+            derivedStart = (derivedEnd == 0) ? spectrumOffset : derivedStart;
+            derivedEnd = spectrumOffset + byteCount;
+            spectrumOffset = alignOffset(derivedEnd);
+        }
+        entry.derivedChecksum = checksum(&image[0] + derivedStart, derivedEnd - derivedStart);
+    }
+
+    if (!entries.empty())
+    {
+        memcpy(&image[sizeof(coeffBankHeader)], &entries[0], entries.size() * sizeof(coeffBankEntry));
+    }
+    header.entriesChecksum = checksum(&image[sizeof(coeffBankHeader)], entries.size() * sizeof(coeffBankEntry));
+    header.headerChecksum = checksum((const unsigned char *)&header, offsetof(coeffBankHeader, headerChecksum));
+    memcpy(&image[0], &header, sizeof(header));
+
+    FILE *fp = fopen(outputFile.c_str(), "wb");
+    if (fp == NULL)
+    {
+        throw filterError("Error! could not create file " + outputFile);
+    }
+    bool written = fwrite(&image[0], 1, image.size(), fp) == image.size();
+    written = (fclose(fp) == 0) && written;
+    if (!written)
+    {
+        throw filterError("Error! could not write coefficients bank " + outputFile);
+    }
+}
+
+void coeffBank::fail(const string &message)
+{
+    throw filterError("Error! coefficients bank " + sourceName + ": " + message);
+}
+
+const unsigned char *coeffBank::getArray(uint64_t offset, uint64_t byteCount, uint32_t setNumber, const string &name)
+{
+    if (offset % Coeff_Bank_Alignment != 0 || offset > size || byteCount > size - offset)
+    {
+        fail("the " + name + " of coefficient set " + to_string(setNumber) + " lie outside the bank");
+    }
+    return data + offset;
+}
+
+void coeffBank::load(const unsigned char *data, uint64_t size, const string &sourceName)
+{
+    this->data = data;
+    this->size = size;
+    this->sourceName = sourceName;
+    coeffSets.clear();
+    plans.clear();
+
+    // -- Check the header, then the entries, before using any offset taken from them
+    coeffBankHeader header;
+    if (size < sizeof(header))
+    {
+        fail("the file is too short for the header");
+    }
+    memcpy(&header, data, sizeof(header));
+    if (!isBank(data, size))
+    {
+        fail("the file does not start with the magic of a coefficients bank");
+    }
+    if (header.version != Coeff_Bank_Version)
+    {
+        fail("unsupported version " + to_string(header.version) + ", expected version " + to_string(Coeff_Bank_Version));
+    }
+    if (header.headerChecksum != checksum(data, offsetof(coeffBankHeader, headerChecksum)))
+    {
+        fail("the checksum of the header does not match");
+    }
+    if (header.fileSize != size)
+    {
+        fail("the file is " + to_string(size) + " bytes long, the header gives " + to_string(header.fileSize) + " bytes");
+    }
+    if (header.entrySize != sizeof(coeffBankEntry) || header.setCount == 0 || header.setCount > (size - sizeof(header)) / sizeof(coeffBankEntry))
+    {
+        fail("the header gives an invalid number of coefficient sets");
+    }
+    const unsigned char *entriesData = data + sizeof(header);
+    if (header.entriesChecksum != checksum(entriesData, (uint64_t)header.setCount * sizeof(coeffBankEntry)))
+    {
+        fail("the checksum of the coefficient set entries does not match");
+    }
+    sampleRate = header.sampleRate;
+
+    coeffSets.resize(header.setCount);
+    plans.resize(header.setCount);
+    for (uint32_t i = 0; i < header.setCount; i++)
+    {
+        coeffBankEntry entry;
+        memcpy(&entry, entriesData + i * sizeof(coeffBankEntry), sizeof(entry));
+        uint32_t setNumber = i + 1;
+
+        if (entry.coeffsLen == 0)
+        {
+            fail("coefficient set " + to_string(setNumber) + " is empty");
+        }
+        if (entry.coeffsType != (uint32_t)coeffType::float64 && entry.coeffsType != (uint32_t)coeffType::float32)
+        {
+            fail("coefficient set " + to_string(setNumber) + " has an unknown storage type " + to_string(entry.coeffsType));
+        }
+
+        // -- The coefficients are copied out of the bank, float64 coefficients in a single copy
+        bool isFloat32 = entry.coeffsType == (uint32_t)coeffType::float32;
+        uint64_t coeffsBytes = (uint64_t)entry.coeffsLen * (isFloat32 ? sizeof(float) : sizeof(double));
+        const unsigned char *coeffsData = getArray(entry.coeffsOffset, coeffsBytes, setNumber, "coefficients");
+        if (entry.coeffsChecksum != checksum(coeffsData, coeffsBytes))
+        {
+            fail("the checksum of coefficient set " + to_string(setNumber) + " does not match");
+        }
+        vector<double> &coeffs = coeffSets[i];
+        coeffs.resize(entry.coeffsLen);
+        if (isFloat32)
+        {
+            const float *values = (const float *)coeffsData;
+            for (uint32_t j = 0; j < entry.coeffsLen; j++)
+            {
+                coeffs[j] = values[j];
+            }
+        }
+        else
+        {
+            memcpy(&coeffs[0], coeffsData, coeffsBytes);
+        }
+        for (uint32_t j = 0; j < entry.coeffsLen; j++)
+        {
+            if (!isfinite(coeffs[j]))
+            {
+                fail("coefficient " + to_string(j + 1) + " of coefficient set " + to_string(setNumber) + " is not a finite number");
+            }
+        }
+
+        coeffPlan &plan = plans[i];
+        plan.coeffs = &coeffs[0];
+        plan.coeffsLen = entry.coeffsLen;
+
+        // -- The derived data is used in place
+        uint64_t derivedStart = 0;
+        uint64_t derivedEnd = 0;
+        if (entry.q15CoeffsLen > 0)
+        {
+            if (entry.q15CoeffsLen != entry.coeffsLen + entry.coeffsLen % 2 || entry.q15Shift > 15)
+            {
+                fail("the Q15 coefficients of coefficient set " + to_string(setNumber) + " do not match the coefficients");
+            }
+            uint64_t byteCount = entry.q15CoeffsLen * sizeof(int16_t);
+            plan.q15Coeffs = (const int16_t *)getArray(entry.q15Offset, byteCount, setNumber, "Q15 coefficients");
+            plan.q15CoeffsLen = entry.q15CoeffsLen;
+            plan.q15Shift = entry.q15Shift;
+            derivedStart = entry.q15Offset;
+            derivedEnd = entry.q15Offset + byteCount;
+        }
+        if (entry.spectrumCount > 0)
+        {
+            vector<uint32_t> fftSizes = firFilter::getFftSizes(entry.coeffsLen);
+            if (entry.spectrumCount > fftSizes.size() || entry.firstFftSize != fftSizes[0])
+            {
+                fail("the spectra of coefficient set " + to_string(setNumber) + " do not match the coefficients");
+            }
+            plan.firstFftSize = entry.firstFftSize;
+            uint64_t spectrumOffset = entry.spectraOffset;
+            for (uint32_t k = 0; k < entry.spectrumCount; k++)
+            {
+                uint64_t byteCount = (fftSizes[k] / 2 + 1) * sizeof(complex<double>);
+                plan.spectra.push_back((const complex<double> *)getArray(spectrumOffset, byteCount, setNumber, "spectra"));
+                derivedStart = (derivedEnd == 0) ? spectrumOffset : derivedStart;
+                derivedEnd = spectrumOffset + byteCount;
+                spectrumOffset = alignOffset(derivedEnd);
+            }
+        }
+        if (entry.derivedChecksum != checksum(data + derivedStart, derivedEnd - derivedStart))
+        {
+            fail("the checksum of the derived data of coefficient set " + to_string(setNumber) + " does not match");
+        }
+    }
+}
+
+const vector<vector<double>> &coeffBank::getCoeffSets()
+{
+    return coeffSets;
+}
+
+const vector<coeffPlan> &coeffBank::getPlans()
+{
+    return plans;
+}
+
+uint32_t coeffBank::getSampleRate()
+{
+    return sampleRate;
+}
+
+void coeffBank::checkSampleRate(uint32_t samplesPerSecond)
+{
+    if (sampleRate != 0 && sampleRate != samplesPerSecond)
+    {
+        fail("the coefficients were designed for a sample rate of " + to_string(sampleRate) + " Hz, but the audio data has a sample rate of " +
+             to_string(samplesPerSecond) + " Hz. Please convert the coefficients again with --sample-rate=" + to_string(samplesPerSecond) +
+             " or without --sample-rate");
+    }
+}
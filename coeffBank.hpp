@@ -0,0 +1,358 @@
+/**
+ * @file coeffBank.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition for the binary coefficient bank
+ *
+ * A coefficient bank holds sets of filter coefficients in a binary file that is mapped and used in place, so
+ * loading it takes no parsing. Next to the coefficients it can store data derived from them, the coefficients
+ * quantised to Q15 and their spectra for the fft based convolution, which the filters then use instead of
+ * computing it. Banks are written from coefficients text files by the coeffBankConverter program.
+ *
+ * All numbers are stored little endian. The file starts with a coeffBankHeader, followed by one coeffBankEntry
+ * per set of coefficients. Every array the entries point to starts at a multiple of Coeff_Bank_Alignment bytes:
+ * the coefficients as float64 or float32, the Q15 coefficients as int16 and the spectra as pairs of float64,
+ * the real and imaginary part of each bin. The header, the entries and every array are protected by checksums,
+ * which are checked when the bank is loaded.
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "firFilter.hpp"
+
+using namespace std;
+
+/**
+ * @brief First bytes of every coefficient bank
+ *
+ */
+constexpr char Coeff_Bank_Magic[8] = {'C', 'O', 'E', 'F', 'B', 'A', 'N', 'K'};
+
+/**
+ * @brief Version of the coefficient bank format
+ *
+ */
+constexpr uint32_t Coeff_Bank_Version = 1;
+
+/**
+ * @brief Alignment of the arrays of a coefficient bank in bytes, a cache line
+ *
+ */
+constexpr uint64_t Coeff_Bank_Alignment = 64;
+
+/**
+ * @brief Storage type of the coefficients of a set
+ *
+ */
+enum class coeffType : uint32_t
+{
+    float64 = 0,
+    float32 = 1
+};
+
+/**
+ * @brief Header at the start of a coefficient bank
+ *
+ */
+struct coeffBankHeader
+{
+    /**
+     * @brief Coeff_Bank_Magic
+     *
+     */
+    char magic[8];
+
+    /**
+     * @brief Coeff_Bank_Version
+     *
+     */
+    uint32_t version;
+
+    /**
+     * @brief Number of sets of coefficients
+     *
+     */
+    uint32_t setCount;
+
+    /**
+     * @brief Sample rate the coefficients were designed for, 0 if not given
+     *
+     */
+    uint32_t sampleRate;
+
+    /**
+     * @brief Size of one coeffBankEntry in bytes
+     *
+     */
+    uint32_t entrySize;
+
+    /**
+     * @brief Size of the whole bank in bytes
+     *
+     */
+    uint64_t fileSize;
+
+    /**
+     * @brief Checksum of the entries
+     *
+     */
+    uint64_t entriesChecksum;
+
+    /**
+     * @brief Reserved, written as 0
+     *
+     */
+    uint64_t reserved[2];
+
+    /**
+     * @brief Checksum of the header up to this field
+     *
+     */
+    uint64_t headerChecksum;
+};
+
+/**
+ * @brief Description of one set of coefficients of a coefficient bank. Offsets are from the start of the bank
+ *
+ */
+struct coeffBankEntry
+{
+    /**
+     * @brief Number of coefficients
+     *
+     */
+    uint32_t coeffsLen;
+
+    /**
+     * @brief Storage type of the coefficients, a coeffType
+     *
+     */
+    uint32_t coeffsType;
+
+    /**
+     * @brief Offset and checksum of the coefficients
+     *
+     */
+    uint64_t coeffsOffset;
+    uint64_t coeffsChecksum;
+
+    /**
+     * @brief Number of Q15 coefficients, padded to an even number, 0 if they are not stored
+     *
+     */
+    uint32_t q15CoeffsLen;
+
+    /**
+     * @brief Number of fractional bits of the Q15 coefficients
+     *
+     */
+    uint32_t q15Shift;
+
+    /**
+     * @brief Offset of the Q15 coefficients
+     *
+     */
+    uint64_t q15Offset;
+
+    /**
+     * @brief Number of stored spectra, 0 if they are not stored
+     *
+     */
+    uint32_t spectrumCount;
+
+    /**
+     * @brief Fft size of the first spectrum, each further spectrum is for twice the fft size of the previous one
+     *
+     */
+    uint32_t firstFftSize;
+
+    /**
+     * @brief Offset of the first spectrum, each further spectrum starts at the next aligned offset
+     *
+     */
+    uint64_t spectraOffset;
+
+    /**
+     * @brief Checksum of the Q15 coefficients followed by the spectra
+     *
+     */
+    uint64_t derivedChecksum;
+};
+
+static_assert(sizeof(coeffBankHeader) == 64, "the coefficient bank header must be 64 bytes");
+static_assert(sizeof(coeffBankEntry) == 64, "a coefficient bank entry must be 64 bytes");
+
+/**
+ * @brief What a coefficient bank is written with
+ *
+ */
+struct coeffBankOptions
+{
+    /**
+     * @brief Sample rate the coefficients were designed for, 0 if not known
+     *
+     */
+    uint32_t sampleRate = 0;
+
+    /**
+     * @brief Store the coefficients as float32 instead of float64, halving their size but rounding them
+     *
+     */
+    bool float32 = false;
+
+    /**
+     * @brief Store the coefficients quantised to Q15, with the headroom chosen automatically
+     *
+     */
+    bool q15 = false;
+
+    /**
+     * @brief Store the spectra of the coefficients for every fft size the fft based convolution chooses from
+     *
+     */
+    bool spectra = false;
+};
+
+class coeffBank
+{
+public:
+    /**
+     * @brief Default constructor to create an empty coefficient bank object
+     *
+     */
+    coeffBank();
+
+    /**
+     * @brief The plans of a bank point into the bank, so it cannot be copied
+     *
+     */
+    coeffBank(const coeffBank &obj) = delete;
+    coeffBank &operator=(const coeffBank &obj) = delete;
+
+    /**
+     * @brief Checks if data starts like a coefficient bank
+     *
+     * @param data Start of the data
+     * @param size Number of bytes of the data
+     * @return True if the data starts with the magic of a coefficient bank
+     */
+    static bool isBank(const unsigned char *data, uint64_t size);
+
+    /**
+     * @brief Write sets of coefficients to a coefficient bank, along with the derived data chosen in the options
+     *
+     * @param outputFile Name of the bank file
+     * @param filterCoeffs The list of sets of coefficients
+     * @param options What is stored in the bank
+     */
+    static void writeBank(const string &outputFile, const vector<vector<double>> &filterCoeffs, const coeffBankOptions &options);
+
+    /**
+     * @brief Load a coefficient bank held in memory, usually mapped, checking its structure and checksums
+     *
+     * The coefficients are copied out of the bank, the derived data is used in place, so the data must stay
+     * valid while the plans are used. Errors are thrown as a filterError
+     *
+     * @param data Start of the bank, aligned to at least 16 bytes
+     * @param size Number of bytes of the bank
+     * @param sourceName Name of the bank, used in error messages
+     */
+    void load(const unsigned char *data, uint64_t size, const string &sourceName);
+
+    /**
+     * @brief Gets the sets of coefficients of the loaded bank
+     *
+     * @return The list of sets of coefficients
+     */
+    const vector<vector<double>> &getCoeffSets();
+
+    /**
+     * @brief Gets the derived data of every set of coefficients, to be given to firFilter::setCoeffPlans
+     *
+     * @return One plan per set of coefficients
+     */
+    const vector<coeffPlan> &getPlans();
+
+    /**
+     * @brief Gets the sample rate the coefficients were designed for
+     *
+     * @return The sample rate, 0 if not given
+     */
+    uint32_t getSampleRate();
+
+    /**
+     * @brief Check that the coefficients were designed for the sample rate of the audio data to be filtered
+     *
+     * A bank without a sample rate fits any audio data. A different sample rate is thrown as a filterError
+     *
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     */
+    void checkSampleRate(uint32_t samplesPerSecond);
+
+    /**
+     * @brief Compute the checksum used by coefficient banks, 64 bit FNV-1a over the data taken as 64 bit little
+     * endian words, the last word padded with zeros
+     *
+     * @param data Start of the data
+     * @param size Number of bytes of the data
+     * @return The checksum
+     */
+    static uint64_t checksum(const unsigned char *data, uint64_t size);
+
+private:
+    /**
+     * @brief Throw a filterError for an error in the bank
+     *
+     * @param message Description of the error
+     */
+    [[noreturn]] void fail(const string &message);
+
+    /**
+     * @brief Check that an array of an entry lies within the bank and is aligned
+     *
+     * @param offset Offset of the array
+     * @param byteCount Number of bytes of the array
+     * @param setNumber Number of the set of coefficients, starting at 1, for the error messages
+     * @param name Name of the array, for the error messages
+     * @return Start of the array
+     */
+    const unsigned char *getArray(uint64_t offset, uint64_t byteCount, uint32_t setNumber, const string &name);
+
+    /**
+     * @brief Start and number of bytes of the loaded bank
+     *
+     */
+    const unsigned char *data;
+    uint64_t size;
+
+    /**
+     * @brief Name of the loaded bank, for the error messages
+     *
+     */
+    string sourceName;
+
+    /**
+     * @brief Sample rate the coefficients were designed for, 0 if not given
+     *
+     */
+    uint32_t sampleRate;
+
+    /**
+     * @brief Sets of coefficients of the loaded bank
+     *
+     */
+    vector<vector<double>> coeffSets;
+
+    /**
+     * @brief Derived data of every set of coefficients
+     *
+     */
+    vector<coeffPlan> plans;
+};
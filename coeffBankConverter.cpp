@@ -0,0 +1,121 @@
+/**
+ * @file coeffBankConverter.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief This file contains the entry point of the coefficient bank converter
+ *
+ * The converter turns a coefficients text file into a binary coefficient bank (see coeffBank.hpp), which the
+ * audio filtering program loads in place of the text file without parsing. The data derived from the
+ * coefficients, the Q15 coefficients and the spectra of the fft based convolution, can be stored in the bank
+ * so the filters do not have to compute it.
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include "coeffBank.hpp"
+#include "filterError.hpp"
+#include "coeffFileParser.hpp"
+
+using namespace std;
+
+/**
+ * @brief Convert the coefficients file given on the command line to a coefficient bank
+ *
+ * @param argc Number of command line arguments
+ * @param argv Array of command line arguments:
+ *        argv[1] Name of the coefficients text file, in the format read by the audio filtering program
+ *        argv[2] Name of the coefficient bank to be written
+ *        Options can be given anywhere on the command line:
+ *        --float32 Stores the coefficients as float32, rounding them, instead of float64
+ *        --q15 Stores the coefficients quantised to Q15 with the headroom chosen automatically
+ *        --spectra Stores the spectra of the coefficients for every fft size the fft based convolution chooses from
+ *        --sample-rate=HZ Records the sample rate the coefficients were designed for, files of another sample rate are
+ *                         then refused
+ * @return Program exit code
+ */
+static int runConverter(int argc, char *argv[])
+{
+    coeffBankOptions options;
+    vector<string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        size_t equals = arg.find('=');
+        string name = arg.substr(0, equals);
+        string value = (equals == string::npos) ? "" : arg.substr(equals + 1);
+
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            files.push_back(arg);
+        }
+        else if (arg == "--float32")
+        {
+            options.float32 = true;
+        }
+        else if (arg == "--q15")
+        {
+            options.q15 = true;
+        }
+        else if (arg == "--spectra")
+        {
+            options.spectra = true;
+        }
+        else if (name == "--sample-rate")
+        {
+            char *end = NULL;
+            unsigned long rate = strtoul(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0' || rate == 0 || rate > UINT32_MAX)
+            {
+                throw filterError("Error! Invalid value for --sample-rate. Please make sure its a positive whole number");
+            }
+            options.sampleRate = (uint32_t)rate;
+        }
+        else
+        {
+            throw filterError("Error! Unknown option " + arg);
+        }
+    }
+
+    if (files.size() != 2)
+    {
+        throw filterError("Error! Please provide the coefficients file and the coefficient bank to be written: "
+                          "coeffBankConverter <coefficients file> <bank file> [--float32] [--q15] [--spectra] [--sample-rate=HZ]");
+    }
+
+    coeffFileParser parser;
+    parser.setQuiet(true);
+    vector<vector<double>> filterCoeffs = parser.parseCoeffs(files[0]);
+    coeffBank::writeBank(files[1], filterCoeffs, options);
+
+    cout << "Wrote " << filterCoeffs.size() << " coefficient sets to " << files[1] << "\n";
+    return 0;
+}
+
+/**
+ * @brief Entry point of the coefficient bank converter
+ *
+ * @param argc Number of command line arguments
+ * @param argv Array of command line arguments, see runConverter
+ * @return Program exit code
+ */
+int main(int argc, char *argv[])
+{
+    try
+    {
+        return runConverter(argc, argv);
+    }
+    catch (const filterError &error)
+    {
+        cout << error.what();
+        return 1;
+    }
+}
@@ -1,234 +1,248 @@
-/**
- * @file coeffFileParser.cpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief Implementation  of the coefficient file parser class
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-
-#include <fstream>
-#include <iostream>
-#include <string>
-#include <vector>
-#include <sstream>
-#include <tuple>
-#include <cstdio>
-#include <cstring>
-#include "coeffFileParser.hpp"
-
-using namespace std;
-
-coeffFileParser::coeffFileParser()
-{
-    // -- Default constructor
-}
-
-void coeffFileParser::deleteTempFile(string tempFile)
-{
-    int32_t deleteStatus = -1;
-    const char *cTempFile = tempFile.c_str();
-
-    // -- Delete the temp file and check that it was successful
-    deleteStatus = remove(cTempFile);
-    if (deleteStatus != 0)
-    {
-        // -- This is not a terminating error, but the user should know
-        cout << "Error Unable to delete file "
-             << tempFile;
-    }
-}
-
-void coeffFileParser::preProcessInputFile(string inputFile, string tempFile)
-{
-    string s;
-    string tempString;
-
-    // -- Make sure coefficients file is able to be read
-    ifstream input(inputFile);
-    if (!input.is_open())
-    {
-        cout << "Error Unable to open file "
-             << inputFile
-             << ". Please make sure the file name is correct";
-        exit(1);
-    }
-
-    input.clear();
-    input.seekg(0);
-
-    // -- Store the contents of the coefficients file into a temp file, removing all spaces
-    ofstream temp(tempFile);
-    if (!temp.is_open())
-    {
-        cout << "Error Unable to create file "
-             << tempFile;
-        exit(1);
-    }
-
-    temp.clear();
-
-    while (getline(input, s))
-    {
-        stringstream stream(s);
-
-        while (getline(stream, tempString, ' '))
-        {
-            temp << tempString;
-        }
-    }
-
-    input.close();
-    temp.close();
-}
-
-tuple<vector<string>, int32_t> coeffFileParser::getNextCoeffsSetString(string line)
-{
-    vector<string> coeffStrings;
-    int32_t index1, index2, index3;
-
-    index1 = (int32_t)line.find("[");
-    index2 = (int32_t)line.find("],");
-    index3 = (int32_t)line.find("]");
-
-    // -- Check if matching [] brackets exist that encapsulate a set of coefficients
-    if (index1 != 0 || index1 == -1 || (index2 == -1 && index3 == -1))
-    {
-        return make_tuple(coeffStrings, -1);
-    }
-
-    // -- Get the next set of coefficients string
-    int32_t length, start, end;
-    string set;
-    start = index1 + 1;
-    end = index2 - 1;
-    length = end - start;
-    set = line.substr(start, length);
-
-    // -- Parse the set string to get individual coefficient strings and store them in a vector
-    stringstream coeffStream(set);
-    string coeff;
-    while (getline(coeffStream, coeff, ','))
-    {
-        coeffStrings.push_back(coeff);
-    }
-
-    // -- Return the coeffStrings and the index position of the beginning of the next set of coefficients
-    // -- from the input line
-    int32_t newIndex;
-    if (index2 != -1)
-    {
-        newIndex = index2 + 2;
-    }
-    else
-    {
-        newIndex = index3 + 1;
-    }
-
-    return make_tuple(coeffStrings, newIndex);
-}
-
-vector<vector<double>> coeffFileParser::parseCoeffs(string inputFile)
-{
-    uint16_t numCoeffSets = 0;
-    string line = "";
-    string tempFile = "tempCoeffs.txt";
-    vector<vector<double>> filterCoeffs;
-
-    // -- Pre-process the contents of the input file and copy it into the temp file
-    preProcessInputFile(inputFile, tempFile);
-
-    // -- Read the temp file
-    ifstream temp(tempFile);
-    if (!temp.is_open())
-    {
-        cout << "Error Unable to open file "
-             << tempFile;
-        exit(1);
-    }
-    temp.clear();
-    temp.seekg(0);
-    getline(temp, line);
-
-    while (line.length() > 0)
-    {
-        numCoeffSets++;
-        // -- Get the next set of coefficients as strings
-        vector<string> coeffStrings;
-        int32_t newIndex = -1;
-        double coeffValue = 0.0;
-        tie(coeffStrings, newIndex) = getNextCoeffsSetString(line);
-
-        if (newIndex == -1)
-        {
-            // -- Unable to find matching[] brackets that encapsulate the current set of coefficients
-            cout << "Error! Unable to find matching[] brackets that encapsulate the set of coefficients in coefficient set "
-                 << numCoeffSets;
-            temp.close();
-            exit(1);
-        }
-
-        // -- Convert coeffStrings to double values and store the values in a vector
-        vector<double> coeffValues;
-        for (int32_t i = 0; i < (int32_t)coeffStrings.size(); i++)
-        {
-            try
-            {
-                coeffValue = (double)stod(coeffStrings[i]);
-            }
-            catch (const invalid_argument &)
-            {
-                cout << "Error! Invalid coefficient value found in coefficient set "
-                     << numCoeffSets;
-                temp.close();
-                exit(1);
-            }
-            catch (const out_of_range &)
-            {
-                cout << "Error! A coefficient value is out of range for a double in coefficient set "
-                     << numCoeffSets;
-                temp.close();
-                exit(1);
-            }
-            coeffValues.push_back(coeffValue);
-        }
-
-        // -- Store the coeffValues vector into the return vector
-        filterCoeffs.push_back(coeffValues);
-
-        // -- Set the new starting point of the line to be parsed on the next iteration
-        line = line.substr(newIndex);
-    }
-
-    // -- Try to delete the temp file
-    temp.close();
-    deleteTempFile(tempFile);
-
-    // -- Print coefficients parsed for user to view
-    for (int32_t i = 0; i < (int32_t)filterCoeffs.size(); i++)
-    {
-        cout << "\nCoefficient Set "
-             << i + 1
-             << ": [ ";
-
-        for (int32_t j = 0; j < (int32_t)filterCoeffs[i].size(); j++)
-        {
-            if (j == (int32_t)filterCoeffs[i].size() - 1)
-            {
-                cout << filterCoeffs[i][j];
-            }
-            else
-            {
-                cout << filterCoeffs[i][j]
-                     << ", ";
-            }
-        }
-
-        cout << " ]\n\n";
-    }
-
-    return filterCoeffs;
-}
\ No newline at end of file
+/**
+ * @file coeffFileParser.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation  of the coefficient file parser class
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <charconv>
+#include <iostream>
+#include "coeffFileParser.hpp"
+#include "filterError.hpp"
+#include "mappedFile.hpp"
+
+using namespace std;
+
+coeffFileParser::coeffFileParser()
+{
+    // -- Default constructor
+    quiet = false;
+    position = NULL;
+    end = NULL;
+    lineNumber = 1;
+    lineStart = NULL;
+    bankLoaded = false;
+}
+
+void coeffFileParser::setQuiet(bool quiet)
+{
+    this->quiet = quiet;
+}
+
+coeffBank *coeffFileParser::getBank()
+{
+    return bankLoaded ? &bank : NULL;
+}
+
+void coeffFileParser::fail(const char *errorPosition, const string &message)
+{
+    // -- Columns count characters from 1, a tab counts as one
+    throw filterError("Error! line " + to_string(lineNumber) + ", column " + to_string(errorPosition - lineStart + 1) + " of coefficients file " + sourceName + ": " + message);
+}
+
+void coeffFileParser::skipWhitespace()
+{
+    while (position < end)
+    {
+        char c = *position;
+        if (c == '\n')
+        {
+            lineNumber++;
+            lineStart = position + 1;
+        }
+        else if (c != ' ' && c != '\t' && c != '\r')
+        {
+            return;
+        }
+        position++;
+    }
+}
+
+double coeffFileParser::parseCoeff(uint64_t setNumber)
+{
+    // -- from_chars does not take a leading plus sign, which the coefficients files may use
+    const char *start = position;
+    if (position < end && *position == '+')
+    {
+        position++;
+    }
+
+    double value = 0;
+    from_chars_result result = from_chars(position, end, value);
+    if (result.ec == errc::invalid_argument || result.ptr == position)
+    {
+        fail(start, "invalid coefficient value in coefficient set " + to_string(setNumber));
+    }
+    if (result.ec == errc::result_out_of_range)
+    {
+        fail(start, "coefficient value is out of range for a double in coefficient set " + to_string(setNumber));
+    }
+    if (!isfinite(value))
+    {
+        fail(start, "coefficient value is not a finite number in coefficient set " + to_string(setNumber));
+    }
+
+    position = result.ptr;
+    return value;
+}
+
+vector<vector<double>> coeffFileParser::parseCoeffsText(const char *text, uint64_t length, const string &sourceName)
+{
+    vector<vector<double>> filterCoeffs;
+    this->sourceName = sourceName;
+    position = text;
+    end = text + length;
+    lineNumber = 1;
+    lineStart = text;
+
+    // -- Skip the byte order mark some editors put at the start of UTF-8 files
+    if (length >= 3 && memcmp(text, "\xEF\xBB\xBF", 3) == 0)
+    {
+        position += 3;
+    }
+
+    skipWhitespace();
+    while (position < end)
+    {
+        uint64_t setNumber = filterCoeffs.size() + 1;
+        if (*position != '[')
+        {
+            fail(position, "expected [ at the start of coefficient set " + to_string(setNumber));
+        }
+        position++;
+
+        // -- Coefficients separated by commas, a comma before the closing bracket is allowed
+        vector<double> coeffValues;
+        skipWhitespace();
+        while (position < end && *position != ']')
+        {
+            coeffValues.push_back(parseCoeff(setNumber));
+            skipWhitespace();
+            if (position < end && *position == ',')
+            {
+                position++;
+                skipWhitespace();
+            }
+            else if (position < end && *position != ']')
+            {
+                fail(position, "expected , or ] after coefficient " + to_string(coeffValues.size()) + " of coefficient set " + to_string(setNumber));
+            }
+        }
+        if (position == end)
+        {
+            fail(position, "unable to find the ] that closes coefficient set " + to_string(setNumber));
+        }
+        if (coeffValues.empty())
+        {
+            fail(position, "coefficient set " + to_string(setNumber) + " is empty");
+        }
+        position++;
+        filterCoeffs.push_back(move(coeffValues));
+
+        // -- Sets are separated by commas, a comma after the last set is allowed
+        skipWhitespace();
+        if (position < end && *position == ',')
+        {
+            position++;
+            skipWhitespace();
+        }
+        else if (position < end)
+        {
+            fail(position, "expected , after coefficient set " + to_string(setNumber));
+        }
+    }
+
+    if (filterCoeffs.empty())
+    {
+        fail(position, "no coefficient sets found");
+    }
+
+    printCoeffs(filterCoeffs);
+    return filterCoeffs;
+}
+
+vector<vector<double>> coeffFileParser::parseCoeffs(string inputFile)
+{
+    // -- Make sure coefficients file is able to be read
+    FILE *fp = fopen(inputFile.c_str(), "rb");
+    if (fp == NULL)
+    {
+        throw filterError("Error Unable to open file " + inputFile + ". Please make sure the file name is correct");
+    }
+
+    // -- Parse regular files in place in a mapping, read other files such as pipes into memory. Both are kept,
+    // -- as the derived data of a coefficient bank is used in place
+    inputMap.unmap();
+    contents.clear();
+    bankLoaded = false;
+    const char *text = NULL;
+    uint64_t length = 0;
+    if (inputMap.mapInput(fp))
+    {
+        text = (const char *)inputMap.getData();
+        length = inputMap.getSize();
+    }
+    else
+    {
+        char block[65536];
+        uint64_t count;
+        while ((count = fread(block, 1, sizeof(block), fp)) > 0)
+        {
+            contents.insert(contents.end(), block, block + count);
+        }
+        text = contents.data();
+        length = contents.size();
+    }
+    fclose(fp);
+
+    if (coeffBank::isBank((const unsigned char *)text, length))
+    {
+        bank.load((const unsigned char *)text, length, inputFile);
+        bankLoaded = true;
+        printCoeffs(bank.getCoeffSets());
+        return bank.getCoeffSets();
+    }
+
+    return parseCoeffsText(text, length, inputFile);
+}
+
+void coeffFileParser::printCoeffs(const vector<vector<double>> &filterCoeffs)
+{
+    if (quiet)
+    {
+        return;
+    }
+
+    // -- Print coefficients parsed for user to view
+    for (uint64_t i = 0; i < filterCoeffs.size(); i++)
+    {
+        cout << "\nCoefficient Set "
+             << i + 1
+             << ": [ ";
+
+        for (uint64_t j = 0; j < filterCoeffs[i].size(); j++)
+        {
+            if (j == filterCoeffs[i].size() - 1)
+            {
+                cout << filterCoeffs[i][j];
+            }
+            else
+            {
+                cout << filterCoeffs[i][j]
+                     << ", ";
+            }
+        }
+
+        cout << " ]\n\n";
+    }
+}
@@ -1,78 +1,152 @@
-/**
- * @file coeffFileParser.hpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief Class definition for the coefficient file parser class
- * 
- * This is a helper class to help parse the file that contains the list of sets of Coefficients
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-
-#pragma once
-
-#include <fstream>
-#include <iostream>
-#include <string>
-#include <tuple>
-#include <cstdint>
-
-using namespace std;
-
-class coeffFileParser
-{
-public:
-    /**
-     * @brief Default constructor to create a coeff File Parser object
-     * 
-     */
-    coeffFileParser();
-
-    /**
-     * @brief Parses the coefficients text file  
-     * 
-     * Parses the coefficients text file and returns the sets of coefficients.
-     * 
-     * @param inputFile The name of the coefficients text file
-     * @return The list of sets of coefficients
-     */
-    vector<vector<double>> parseCoeffs(string inputFile);
-
-private:
-    /**
-     * @brief Delete the temp file
-     * 
-     * While parsing the coefficients text file, a temporary file is created.
-     * Delete that file once it is no longer needed
-     * 
-     * @param tempFile The Name of the temporary file
-     */
-    void deleteTempFile(string tempFile);
-
-    /**
-     * @brief Prepare the contents of the coefficients text file to be parsed
-     * 
-     * Reads the contents of the coefficients text file and writes it to a temporary
-     * file after removing all whitespaces. This temporary file is then used to further
-     * process the coefficient data
-     * 
-     * @param inputFile The name of the coefficients text file
-     * @param tempFile The name of the temporary file
-     */
-    void preProcessInputFile(string inputFile, string tempFile);
-
-    /**
-     * @brief Get the next of coefficients as a string
-     * 
-     * Parses the input string to determine what the next set of coefficients is
-     * 
-     * @param line a string containing the contents of the temporary file to be parsed
-     * @return a tuple containing a vector of strings of the current set of coefficients
-     *         and the index for the start of the next set of coefficients in the input
-     *         string
-     */
-    tuple<vector<string>, int32_t> getNextCoeffsSetString(string line);
-};
+/**
+ * @file coeffFileParser.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition for the coefficient file parser class
+ * 
+ * This is a helper class to help parse the file that contains the list of sets of Coefficients.
+ * Each set of coefficients is enclosed in square brackets, with the coefficients separated by commas,
+ * and the sets are separated by commas. Spaces, tabs and line breaks (LF or CRLF) may appear anywhere
+ * between the brackets, commas and coefficients. The file is read into memory, or mapped, and parsed in
+ * a single pass, converting the coefficients with from_chars. A binary coefficient bank (see coeffBank.hpp) is
+ * recognised by its first bytes and used in place, without parsing
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "coeffBank.hpp"
+#include "mappedFile.hpp"
+
+using namespace std;
+
+class coeffFileParser
+{
+public:
+    /**
+     * @brief Default constructor to create a coeff File Parser object
+     * 
+     */
+    coeffFileParser();
+
+    /**
+     * @brief Parses the coefficients text file, or loads the coefficient bank
+     * 
+     * Parses the coefficients text file and returns the sets of coefficients. Unless quiet, the
+     * coefficients are printed for the user to view. Errors in the file are thrown as a filterError
+     * giving the line and column of the error. A coefficient bank is loaded with coeffBank::load and
+     * stays mapped until the parser is destroyed or parses another file
+     * 
+     * @param inputFile The name of the coefficients text file or coefficient bank
+     * @return The list of sets of coefficients
+     */
+    vector<vector<double>> parseCoeffs(string inputFile);
+
+    /**
+     * @brief Parses coefficients text held in memory
+     * 
+     * Same as parseCoeffs, for text that is not read from a file
+     * 
+     * @param text Start of the text
+     * @param length Number of characters of the text
+     * @param sourceName Name of the text, used in error messages
+     * @return The list of sets of coefficients
+     */
+    vector<vector<double>> parseCoeffsText(const char *text, uint64_t length, const string &sourceName);
+
+    /**
+     * @brief Choose whether the parsed coefficients are printed
+     * 
+     * @param quiet True to not print the coefficients
+     */
+    void setQuiet(bool quiet);
+
+    /**
+     * @brief Gets the coefficient bank loaded by the last call of parseCoeffs
+     * 
+     * @return The loaded bank, whose plans can be given to firFilter::setCoeffPlans, NULL if a text file was parsed
+     */
+    coeffBank *getBank();
+
+private:
+    /**
+     * @brief Skip the spaces, tabs and line breaks at the current position, counting the lines
+     * 
+     */
+    void skipWhitespace();
+
+    /**
+     * @brief Parse the coefficient at the current position
+     * 
+     * @param setNumber Number of the set of coefficients, starting at 1, for the error messages
+     * @return Value of the coefficient
+     */
+    double parseCoeff(uint64_t setNumber);
+
+    /**
+     * @brief Throw a filterError for an error at the given position of the text
+     * 
+     * @param errorPosition Position of the error in the text
+     * @param message Description of the error
+     */
+    [[noreturn]] void fail(const char *errorPosition, const string &message);
+
+    /**
+     * @brief Print the parsed coefficients for the user to view
+     * 
+     * @param filterCoeffs The list of sets of coefficients
+     */
+    void printCoeffs(const vector<vector<double>> &filterCoeffs);
+
+    /**
+     * @brief Whether the parsed coefficients are not printed
+     * 
+     */
+    bool quiet;
+
+    /**
+     * @brief Name of the text being parsed, for the error messages
+     * 
+     */
+    string sourceName;
+
+    /**
+     * @brief Current position in the text and end of the text
+     * 
+     */
+    const char *position;
+    const char *end;
+
+    /**
+     * @brief Line of the current position, starting at 1, and start of that line
+     * 
+     */
+    uint64_t lineNumber;
+    const char *lineStart;
+
+    /**
+     * @brief Mapping of the file, or its contents when it cannot be mapped
+     * 
+     */
+    mappedFile inputMap;
+    vector<char> contents;
+
+    /**
+     * @brief Coefficient bank loaded from the file
+     * 
+     */
+    coeffBank bank;
+
+    /**
+     * @brief Whether the last file was a coefficient bank
+     * 
+     */
+    bool bankLoaded;
+};
@@ -1,246 +1,278 @@
-/**
- * @file defaultFilterCoeffs.hpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief Header file that contains the definitions for the default filter coefficients
- * 
- * The default set of coefficients include options for the following frequency filtering:
- * 
- * low pass filter ("lp"): cuts off at 1000 Hz
- * high pass filter ("hp"): cuts off below 5000 Hz
- * speech filter ("bp"): a bandpass filter that filters out everything but speech frequencies  (80 - 450 Hz)
- * no speech filter ("bs"): a bandstop filter that filters out frequencies around the speech frequencies (80 - 450 Hz)
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-
-#pragma once
-
-#include <vector>
-#include <cstdio>
-#include <cstdint>
-
-using namespace std;
-
-// -- Coefficients for filtering speech level frequencies ( a bandpass filter between 80 - 450 Hz)
-vector<double> speechRangeCoeffs =
-    {
-        -0.000157,
-        -0.000214,
-        -0.000232,
-        -0.000186,
-        -0.000043,
-        0.000230,
-        0.000667,
-        0.001302,
-        0.002164,
-        0.003276,
-        0.004653,
-        0.006301,
-        0.008211,
-        0.010362,
-        0.012719,
-        0.015235,
-        0.017849,
-        0.020492,
-        0.023087,
-        0.025552,
-        0.027806,
-        0.029773,
-        0.031383,
-        0.032577,
-        0.033312,
-        0.033560,
-        0.033312,
-        0.032577,
-        0.031383,
-        0.029773,
-        0.027806,
-        0.025552,
-        0.023087,
-        0.020492,
-        0.017849,
-        0.015235,
-        0.012719,
-        0.010362,
-        0.008211,
-        0.006301,
-        0.004653,
-        0.003276,
-        0.002164,
-        0.001302,
-        0.000667,
-        0.000230,
-        -0.000043,
-        -0.000186,
-        -0.000232,
-        -0.000214,
-        -0.000157};
-
-// -- Coefficients for filtering out speech level frequencies ( a bandstop filter between 80 - 450 Hz)
-vector<double> noSpeechRangeCoeffs =
-    {
-        0.000157,
-        0.000214,
-        0.000232,
-        0.000186,
-        0.000043,
-        -0.000230,
-        -0.000667,
-        -0.001302,
-        -0.002164,
-        -0.003276,
-        -0.004653,
-        -0.006301,
-        -0.008211,
-        -0.010362,
-        -0.012719,
-        -0.015235,
-        -0.017849,
-        -0.020492,
-        -0.023087,
-        -0.025552,
-        -0.027806,
-        -0.029773,
-        -0.031383,
-        -0.032577,
-        -0.033312,
-        0.966440,
-        -0.033312,
-        -0.032577,
-        -0.031383,
-        -0.029773,
-        -0.027806,
-        -0.025552,
-        -0.023087,
-        -0.020492,
-        -0.017849,
-        -0.015235,
-        -0.012719,
-        -0.010362,
-        -0.008211,
-        -0.006301,
-        -0.004653,
-        -0.003276,
-        -0.002164,
-        -0.001302,
-        -0.000667,
-        -0.000230,
-        0.000043,
-        0.000186,
-        0.000232,
-        0.000214,
-        0.000157};
-
-// -- Coefficients for a high pass filter  ( cuts off below 5000 Hz  )
-vector<double> highPassCoeffs =
-    {
-        0.000227,
-        -0.000166,
-        -0.000733,
-        0.000080,
-        0.001589,
-        0.000479,
-        -0.002726,
-        -0.001872,
-        0.003868,
-        0.004456,
-        -0.004481,
-        -0.008481,
-        0.003757,
-        0.013974,
-        -0.000613,
-        -0.020667,
-        -0.006371,
-        0.027983,
-        0.019325,
-        -0.035099,
-        -0.042770,
-        0.041084,
-        0.092590,
-        -0.045081,
-        -0.313633,
-        0.546485,
-        -0.313633,
-        -0.045081,
-        0.092590,
-        0.041084,
-        -0.042770,
-        -0.035099,
-        0.019325,
-        0.027983,
-        -0.006371,
-        -0.020667,
-        -0.000613,
-        0.013974,
-        0.003757,
-        -0.008481,
-        -0.004481,
-        0.004456,
-        0.003868,
-        -0.001872,
-        -0.002726,
-        0.000479,
-        0.001589,
-        0.000080,
-        -0.000733,
-        -0.000166,
-        0.000227};
-
-// -- Coefficients for a low pass filter  ( cuts off at 1000 Hz  )
-vector<double> lowPassCoeffs =
-    {
-        0.000193,
-        0.000247,
-        0.000201,
-        -0.000016,
-        -0.000470,
-        -0.001206,
-        -0.002230,
-        -0.003487,
-        -0.004850,
-        -0.006110,
-        -0.006987,
-        -0.007146,
-        -0.006229,
-        -0.003897,
-        0.000123,
-        0.005987,
-        0.013702,
-        0.023088,
-        0.033781,
-        0.045242,
-        0.056795,
-        0.067684,
-        0.077143,
-        0.084473,
-        0.089114,
-        0.090703,
-        0.089114,
-        0.084473,
-        0.077143,
-        0.067684,
-        0.056795,
-        0.045242,
-        0.033781,
-        0.023088,
-        0.013702,
-        0.005987,
-        0.000123,
-        -0.003897,
-        -0.006229,
-        -0.007146,
-        -0.006987,
-        -0.006110,
-        -0.004850,
-        -0.003487,
-        -0.002230,
-        -0.001206,
-        -0.000470,
-        -0.000016,
-        0.000201,
-        0.000247,
-        0.000193};
\ No newline at end of file
+/**
+ * @file defaultFilterCoeffs.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Header file that contains the definitions for the default filter coefficients
+ * 
+ * The default set of coefficients include options for the following frequency filtering:
+ * 
+ * low pass filter ("lp"): cuts off at 1000 Hz
+ * high pass filter ("hp"): cuts off below 5000 Hz
+ * speech filter ("bp"): a bandpass filter that filters out everything but speech frequencies  (80 - 450 Hz)
+ * no speech filter ("bs"): a bandstop filter that filters out frequencies around the speech frequencies (80 - 450 Hz)
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdio>
+#include <cstdint>
+#include "filterDesigner.hpp"
+
+using namespace std;
+
+// -- Number of coefficients of each default filter
+constexpr uint32_t Default_Filter_Coeffs_Len = 51;
+
+// -- The tables are constexpr so they are placed in read-only data and need no initialisation at startup.
+// -- firKernels.cpp instantiates a kernel for each of them with the coefficients as compile time constants
+
+// -- Coefficients for filtering speech level frequencies ( a bandpass filter between 80 - 450 Hz)
+constexpr array<double, Default_Filter_Coeffs_Len> speechRangeCoeffs =
+    {
+        -0.000157,
+        -0.000214,
+        -0.000232,
+        -0.000186,
+        -0.000043,
+        0.000230,
+        0.000667,
+        0.001302,
+        0.002164,
+        0.003276,
+        0.004653,
+        0.006301,
+        0.008211,
+        0.010362,
+        0.012719,
+        0.015235,
+        0.017849,
+        0.020492,
+        0.023087,
+        0.025552,
+        0.027806,
+        0.029773,
+        0.031383,
+        0.032577,
+        0.033312,
+        0.033560,
+        0.033312,
+        0.032577,
+        0.031383,
+        0.029773,
+        0.027806,
+        0.025552,
+        0.023087,
+        0.020492,
+        0.017849,
+        0.015235,
+        0.012719,
+        0.010362,
+        0.008211,
+        0.006301,
+        0.004653,
+        0.003276,
+        0.002164,
+        0.001302,
+        0.000667,
+        0.000230,
+        -0.000043,
+        -0.000186,
+        -0.000232,
+        -0.000214,
+        -0.000157};
+
+// -- Coefficients for filtering out speech level frequencies ( a bandstop filter between 80 - 450 Hz)
+constexpr array<double, Default_Filter_Coeffs_Len> noSpeechRangeCoeffs =
+    {
+        0.000157,
+        0.000214,
+        0.000232,
+        0.000186,
+        0.000043,
+        -0.000230,
+        -0.000667,
+        -0.001302,
+        -0.002164,
+        -0.003276,
+        -0.004653,
+        -0.006301,
+        -0.008211,
+        -0.010362,
+        -0.012719,
+        -0.015235,
+        -0.017849,
+        -0.020492,
+        -0.023087,
+        -0.025552,
+        -0.027806,
+        -0.029773,
+        -0.031383,
+        -0.032577,
+        -0.033312,
+        0.966440,
+        -0.033312,
+        -0.032577,
+        -0.031383,
+        -0.029773,
+        -0.027806,
+        -0.025552,
+        -0.023087,
+        -0.020492,
+        -0.017849,
+        -0.015235,
+        -0.012719,
+        -0.010362,
+        -0.008211,
+        -0.006301,
+        -0.004653,
+        -0.003276,
+        -0.002164,
+        -0.001302,
+        -0.000667,
+        -0.000230,
+        0.000043,
+        0.000186,
+        0.000232,
+        0.000214,
+        0.000157};
+
+// -- Coefficients for a high pass filter  ( cuts off below 5000 Hz  )
+constexpr array<double, Default_Filter_Coeffs_Len> highPassCoeffs =
+    {
+        0.000227,
+        -0.000166,
+        -0.000733,
+        0.000080,
+        0.001589,
+        0.000479,
+        -0.002726,
+        -0.001872,
+        0.003868,
+        0.004456,
+        -0.004481,
+        -0.008481,
+        0.003757,
+        0.013974,
+        -0.000613,
+        -0.020667,
+        -0.006371,
+        0.027983,
+        0.019325,
+        -0.035099,
+        -0.042770,
+        0.041084,
+        0.092590,
+        -0.045081,
+        -0.313633,
+        0.546485,
+        -0.313633,
+        -0.045081,
+        0.092590,
+        0.041084,
+        -0.042770,
+        -0.035099,
+        0.019325,
+        0.027983,
+        -0.006371,
+        -0.020667,
+        -0.000613,
+        0.013974,
+        0.003757,
+        -0.008481,
+        -0.004481,
+        0.004456,
+        0.003868,
+        -0.001872,
+        -0.002726,
+        0.000479,
+        0.001589,
+        0.000080,
+        -0.000733,
+        -0.000166,
+        0.000227};
+
+// -- Coefficients for a low pass filter  ( cuts off at 1000 Hz  )
+constexpr array<double, Default_Filter_Coeffs_Len> lowPassCoeffs =
+    {
+        0.000193,
+        0.000247,
+        0.000201,
+        -0.000016,
+        -0.000470,
+        -0.001206,
+        -0.002230,
+        -0.003487,
+        -0.004850,
+        -0.006110,
+        -0.006987,
+        -0.007146,
+        -0.006229,
+        -0.003897,
+        0.000123,
+        0.005987,
+        0.013702,
+        0.023088,
+        0.033781,
+        0.045242,
+        0.056795,
+        0.067684,
+        0.077143,
+        0.084473,
+        0.089114,
+        0.090703,
+        0.089114,
+        0.084473,
+        0.077143,
+        0.067684,
+        0.056795,
+        0.045242,
+        0.033781,
+        0.023088,
+        0.013702,
+        0.005987,
+        0.000123,
+        -0.003897,
+        -0.006229,
+        -0.007146,
+        -0.006987,
+        -0.006110,
+        -0.004850,
+        -0.003487,
+        -0.002230,
+        -0.001206,
+        -0.000470,
+        -0.000016,
+        0.000201,
+        0.000247,
+        0.000193};
+
+// -- Number of default filters
+constexpr uint32_t Default_Filter_Count = 4;
+
+// -- All default filters, in the order of the kernels instantiated for them in firKernels.inl
+constexpr const array<double, Default_Filter_Coeffs_Len> *defaultFilters[Default_Filter_Count] =
+    {
+        &lowPassCoeffs,
+        &highPassCoeffs,
+        &speechRangeCoeffs,
+        &noSpeechRangeCoeffs};
+
+// -- The iir counterparts of the default filters (lp-iir, hp-iir, bp-iir, bs-iir) are designed at this sample rate,
+// -- so like the coefficient tables their frequencies move with the sample rate of the file
+constexpr uint32_t Default_Iir_Sample_Rate = 44100;
+
+// -- Low and high pass filters with the passband and stopband edges of lowPassCoeffs and highPassCoeffs at 44100 Hz:
+// -- within 0.5 dB up to 980 Hz and 60 dB down from 3590 Hz, and 60 dB down up to 8400 Hz and within 0.5 dB from 11020 Hz
+constexpr filterSpec lowPassIirSpec = {filterBand::lowPass, 2285, 0, 2610, 0.5, 60, designMethod::iir};
+constexpr filterSpec highPassIirSpec = {filterBand::highPass, 9710, 0, 2620, 0.5, 60, designMethod::iir};
+
+// -- 51 coefficients cannot resolve the speech range at 44100 Hz, so the tables only roughly follow it, while 10 to
+// -- 12 biquad sections pass or stop 80 - 450 Hz with transition bands of 100 Hz
+constexpr filterSpec speechRangeIirSpec = {filterBand::bandPass, 80, 450, 100, 0.5, 60, designMethod::iir};
+constexpr filterSpec noSpeechRangeIirSpec = {filterBand::bandStop, 80, 450, 100, 0.5, 60, designMethod::iir};
@@ -0,0 +1,166 @@
+/**
+ * @file fftTransform.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the fft transform class
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <cmath>
+#include <utility>
+#include "fftTransform.hpp"
+
+using namespace std;
+
+fftTransform::fftTransform()
+{
+    // -- Default constructor
+    fftSize = 0;
+}
+
+fftTransform::fftTransform(const fftTransform &obj)
+{
+    // -- Copy constructor
+    fftSize = obj.fftSize;
+    twiddles = obj.twiddles;
+    splitTwiddles = obj.splitTwiddles;
+    bitReversal = obj.bitReversal;
+    workBuffer = obj.workBuffer;
+}
+
+void fftTransform::setSize(uint32_t size)
+{
+    if (size == fftSize)
+    {
+        return;
+    }
+
+    // -- The real transform of size N is computed with a complex transform of size N / 2
+    uint32_t halfSize = size / 2;
+    uint32_t bits = 0;
+    const double pi = acos(-1.0);
+
+    fftSize = size;
+    while ((1u << bits) < halfSize)
+    {
+        bits++;
+    }
+
+    twiddles.resize(halfSize / 2);
+    for (uint32_t k = 0; k < halfSize / 2; k++)
+    {
+        twiddles[k] = polar(1.0, -2.0 * pi * k / halfSize);
+    }
+
+    splitTwiddles.resize(halfSize + 1);
+    for (uint32_t k = 0; k <= halfSize; k++)
+    {
+        splitTwiddles[k] = polar(1.0, -2.0 * pi * k / size);
+    }
+
+    bitReversal.resize(halfSize);
+    for (uint32_t k = 0; k < halfSize; k++)
+    {
+        uint32_t reversed = 0;
+        for (uint32_t b = 0; b < bits; b++)
+        {
+            reversed |= ((k >> b) & 1u) << (bits - 1 - b);
+        }
+        bitReversal[k] = reversed;
+    }
+
+    workBuffer.resize(halfSize);
+}
+
+uint32_t fftTransform::getSize()
+{
+    return fftSize;
+}
+
+void fftTransform::transform(complex<double> *data, bool inverseTransform)
+{
+    uint32_t halfSize = fftSize / 2;
+
+    // -- Reorder the input so the butterflies can be computed in place
+    for (uint32_t k = 0; k < halfSize; k++)
+    {
+        if (k < bitReversal[k])
+        {
+            swap(data[k], data[bitReversal[k]]);
+        }
+    }
+
+    for (uint32_t len = 2; len <= halfSize; len <<= 1)
+    {
+        uint32_t half = len / 2;
+        uint32_t step = halfSize / len;
+        double sign = inverseTransform ? -1.0 : 1.0;
+
+        for (uint32_t i = 0; i < halfSize; i += len)
+        {
+            for (uint32_t j = 0; j < half; j++)
+            {
+                // -- The complex multiplication is written out, as the std::complex operator also handles
+                // -- infinities and NaNs which stops the compiler from vectorising the loop
+                double wRe = twiddles[j * step].real();
+                double wIm = sign * twiddles[j * step].imag();
+                double xRe = data[i + j + half].real();
+                double xIm = data[i + j + half].imag();
+                complex<double> u = data[i + j];
+                complex<double> v(xRe * wRe - xIm * wIm, xRe * wIm + xIm * wRe);
+                data[i + j] = u + v;
+                data[i + j + half] = u - v;
+            }
+        }
+    }
+}
+
+void fftTransform::forward(const double *input, complex<double> *output)
+{
+    uint32_t halfSize = fftSize / 2;
+
+    // -- Pack the even samples into the real part and the odd samples into the imaginary part
+    for (uint32_t k = 0; k < halfSize; k++)
+    {
+        workBuffer[k] = complex<double>(input[2 * k], input[2 * k + 1]);
+    }
+
+    transform(&workBuffer[0], false);
+
+    // -- Split the packed spectrum into the spectrum of the real signal
+    for (uint32_t k = 0; k <= halfSize; k++)
+    {
+        complex<double> z = workBuffer[k % halfSize];
+        complex<double> zMirror = conj(workBuffer[(halfSize - k) % halfSize]);
+        complex<double> even = 0.5 * (z + zMirror);
+        complex<double> odd = complex<double>(0.0, -0.5) * (z - zMirror);
+        output[k] = even + splitTwiddles[k] * odd;
+    }
+}
+
+void fftTransform::inverse(const complex<double> *input, double *output)
+{
+    uint32_t halfSize = fftSize / 2;
+
+    // -- Recombine the spectrum of the real signal into the packed spectrum
+    for (uint32_t k = 0; k < halfSize; k++)
+    {
+        complex<double> x = input[k];
+        complex<double> xMirror = conj(input[halfSize - k]);
+        complex<double> even = x + xMirror;
+        complex<double> odd = (x - xMirror) * conj(splitTwiddles[k]);
+        workBuffer[k] = even + complex<double>(0.0, 1.0) * odd;
+    }
+
+    transform(&workBuffer[0], true);
+
+    // -- Unpack the even and odd samples
+    for (uint32_t k = 0; k < halfSize; k++)
+    {
+        output[2 * k] = workBuffer[k].real();
+        output[2 * k + 1] = workBuffer[k].imag();
+    }
+}
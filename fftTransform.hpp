@@ -0,0 +1,118 @@
+/**
+ * @file fftTransform.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition for the in-tree fast fourier transform
+ *
+ * This class implements a radix-2 fast fourier transform of real valued signals. It is used by the
+ * fir filter to perform block convolution in the frequency domain when the filter is long enough
+ * for the direct form convolution to become too expensive.
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+class fftTransform
+{
+public:
+    /**
+     * @brief Default constructor to create a new fft Transform object
+     *
+     */
+    fftTransform();
+
+    /**
+     * @brief Copy constructor
+     *
+     * @param obj The source fft transform to be copied over
+     */
+    fftTransform(const fftTransform &obj);
+
+    /**
+     * @brief Prepare the transform for a given size
+     *
+     * Precomputes the twiddle factors and bit reversal table used by the transform. The size
+     * must be a power of 2 and at least 4. Nothing is recomputed if the size has not changed
+     *
+     * @param size Number of real samples transformed at one time
+     */
+    void setSize(uint32_t size);
+
+    /**
+     * @brief Gets the number of real samples transformed at one time
+     *
+     * @return Returns fftSize
+     */
+    uint32_t getSize();
+
+    /**
+     * @brief Forward transform of a block of real samples
+     *
+     * As the input is real, only the first size / 2 + 1 frequency bins are computed. The remaining
+     * bins are the complex conjugates of these
+     *
+     * @param input Pointer to size real input samples
+     * @param output Pointer to size / 2 + 1 complex output bins
+     */
+    void forward(const double *input, complex<double> *output);
+
+    /**
+     * @brief Inverse transform back to a block of real samples
+     *
+     * The output is not normalised, so a forward transform followed by an inverse transform
+     * scales the signal by size
+     *
+     * @param input Pointer to size / 2 + 1 complex frequency bins
+     * @param output Pointer to size real output samples
+     */
+    void inverse(const complex<double> *input, double *output);
+
+private:
+    /**
+     * @brief In place radix-2 transform of the packed half size complex sequence
+     *
+     * @param data Sequence of size / 2 complex values
+     * @param inverseTransform Uses the conjugate twiddle factors when true
+     */
+    void transform(complex<double> *data, bool inverseTransform);
+
+    /**
+     * @brief Number of real samples transformed at one time
+     *
+     */
+    uint32_t fftSize;
+
+    /**
+     * @brief Twiddle factors for the half size complex transform
+     *
+     */
+    vector<complex<double>> twiddles;
+
+    /**
+     * @brief Twiddle factors used to split the half size transform into the real transform
+     *
+     */
+    vector<complex<double>> splitTwiddles;
+
+    /**
+     * @brief Bit reversal permutation for the half size complex transform
+     *
+     */
+    vector<uint32_t> bitReversal;
+
+    /**
+     * @brief Scratch buffer holding the packed complex sequence
+     *
+     */
+    vector<complex<double>> workBuffer;
+};
@@ -0,0 +1,820 @@
+/**
+ * @file filterBenchmark.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief This file contains the entry point of the benchmark program
+ *
+ * The benchmark program measures the throughput of the parts of the audio filtering program that decide how
+ * fast it runs: the fir filter across numbers of coefficients and block sizes, the iir filter across numbers
+ * of biquad sections and channels, designed filters run directly and at a reduced rate, filtering whole
+ * generated wav files of different lengths, chains of 1 to 16 filters and parsing small and very large
+ * coefficients files.
+ * The results are written as JSON, and can be compared against the results of an earlier run to flag the
+ * benchmarks that got slower.
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#include <map>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <functional>
+#include "wavFile.hpp"
+#include "firFilter.hpp"
+#include "iirFilter.hpp"
+#include "multirateFilter.hpp"
+#include "firKernels.hpp"
+#include "filterChain.hpp"
+#include "filterError.hpp"
+#include "filterDesigner.hpp"
+#include "coeffFileParser.hpp"
+#include "defaultFilterCoeffs.hpp"
+
+using namespace std;
+
+/**
+ * @brief Sample rate of the generated wav files
+ *
+ */
+constexpr uint32_t Benchmark_Sample_Rate = 44100;
+
+/**
+ * @brief Default percentage by which a benchmark has to be slower than the baseline to be flagged
+ *
+ */
+constexpr double Default_Regression_Threshold = 10.0;
+
+/**
+ * @brief Result of one benchmark
+ *
+ */
+struct benchmarkResult
+{
+    /**
+     * @brief Name of the benchmark, the same from one run to the next
+     *
+     */
+    string name;
+
+    /**
+     * @brief Unit of the value. Every value is a throughput, so higher is better
+     *
+     */
+    string unit;
+
+    /**
+     * @brief Best throughput over the runs of the benchmark
+     *
+     */
+    double value;
+};
+
+/**
+ * @brief Settings parsed from the command line
+ *
+ */
+struct benchmarkOptions
+{
+    /**
+     * @brief File receiving the results as JSON, - for the standard output
+     *
+     */
+    string outputFile = "-";
+
+    /**
+     * @brief File holding the results of an earlier run to compare against, empty to not compare
+     *
+     */
+    string baselineFile;
+
+    /**
+     * @brief Percentage by which a benchmark has to be slower than the baseline to be flagged
+     *
+     */
+    double threshold = Default_Regression_Threshold;
+
+    /**
+     * @brief Minimum time each benchmark is run for, in seconds
+     *
+     */
+    double minSeconds = 0.5;
+
+    /**
+     * @brief Directory the generated wav and coefficients files are written to
+     *
+     */
+    string workDir = ".";
+
+    /**
+     * @brief Only run the benchmarks whose name contains this text
+     *
+     */
+    string filter;
+};
+
+/**
+ * @brief Run a benchmark repeatedly and measure its best throughput
+ *
+ * The benchmark is run at least twice and until minSeconds have passed. The best run is kept, as it is the
+ * one least disturbed by other work on the machine
+ *
+ * @param run Runs the benchmark once and returns the amount of work done, such as the number of samples filtered
+ * @param minSeconds Minimum time to run the benchmark for
+ * @return Best amount of work per second
+ */
+static double measure(const function<uint64_t()> &run, double minSeconds)
+{
+    double best = 0;
+    double total = 0;
+    uint32_t runs = 0;
+
+    while (runs < 2 || total < minSeconds)
+    {
+        auto start = chrono::steady_clock::now();
+        uint64_t work = run();
+        double seconds = max(chrono::duration<double>(chrono::steady_clock::now() - start).count(), 1e-9);
+        best = max(best, work / seconds);
+        total += seconds;
+        runs++;
+    }
+    return best;
+}
+
+/**
+ * @brief Generate a reproducible test signal, a mix of tones and noise at about half of full scale
+ *
+ * @param count Number of samples
+ * @return Samples between -32768 and 32767
+ */
+static vector<double> generateSignal(uint64_t count)
+{
+    mt19937 generator(1234);
+    uniform_real_distribution<double> noise(-2000.0, 2000.0);
+    vector<double> samples(count);
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        double t = (double)i / Benchmark_Sample_Rate;
+        samples[i] = round(8000.0 * sin(2 * M_PI * 440.0 * t) + 6000.0 * sin(2 * M_PI * 3150.0 * t) + noise(generator));
+    }
+    return samples;
+}
+
+/**
+ * @brief Generate reproducible filter coefficients without any structure the specialised kernels could use
+ *
+ * @param coeffsLen Number of coefficients
+ * @return Coefficients whose sum is about 1
+ */
+static vector<double> generateCoeffs(uint32_t coeffsLen)
+{
+    mt19937 generator(coeffsLen);
+    uniform_real_distribution<double> coeff(0.0, 2.0 / coeffsLen);
+    vector<double> coeffs(coeffsLen);
+
+    for (uint32_t i = 0; i < coeffsLen; i++)
+    {
+        coeffs[i] = coeff(generator);
+    }
+    return coeffs;
+}
+
+/**
+ * @brief Write a mono 16 bit wav file holding the test signal
+ *
+ * @param fileName Name of the wav file
+ * @param seconds Length of the audio data in seconds
+ */
+static void writeTestWav(const string &fileName, uint32_t seconds)
+{
+    vector<double> signal = generateSignal((uint64_t)seconds * Benchmark_Sample_Rate);
+    vector<int16_t> samples(signal.begin(), signal.end());
+    uint32_t dataSize = (uint32_t)(samples.size() * sizeof(int16_t));
+    uint32_t chunkSize = 36 + dataSize;
+    uint32_t formatSize = 16;
+    uint16_t audioFormat = 1;
+    uint16_t numChannels = 1;
+    uint32_t sampleRate = Benchmark_Sample_Rate;
+    uint32_t byteRate = Benchmark_Sample_Rate * sizeof(int16_t);
+    uint16_t blockAlign = sizeof(int16_t);
+    uint16_t bitsPerSample = 16;
+
+    FILE *fp = fopen(fileName.c_str(), "wb");
+    if (fp == NULL)
+    {
+        throw filterError("Error! could not create file " + fileName);
+    }
+
+    // -- Canonical 44 byte header followed by the samples
+    fwrite("RIFF", 1, 4, fp);
+    fwrite(&chunkSize, sizeof(chunkSize), 1, fp);
+    fwrite("WAVEfmt ", 1, 8, fp);
+    fwrite(&formatSize, sizeof(formatSize), 1, fp);
+    fwrite(&audioFormat, sizeof(audioFormat), 1, fp);
+    fwrite(&numChannels, sizeof(numChannels), 1, fp);
+    fwrite(&sampleRate, sizeof(sampleRate), 1, fp);
+    fwrite(&byteRate, sizeof(byteRate), 1, fp);
+    fwrite(&blockAlign, sizeof(blockAlign), 1, fp);
+    fwrite(&bitsPerSample, sizeof(bitsPerSample), 1, fp);
+    fwrite("data", 1, 4, fp);
+    fwrite(&dataSize, sizeof(dataSize), 1, fp);
+    if (fwrite(&samples[0], sizeof(int16_t), samples.size(), fp) != samples.size())
+    {
+        throw filterError("Error! could not write audio data into file " + fileName);
+    }
+    fclose(fp);
+}
+
+/**
+ * @brief Write a coefficients file in the format read by coeffFileParser
+ *
+ * @param fileName Name of the coefficients file
+ * @param setCount Number of sets of coefficients
+ * @param coeffsLen Number of coefficients of each set
+ */
+static void writeCoeffsFile(const string &fileName, uint32_t setCount, uint32_t coeffsLen)
+{
+    ofstream file(fileName);
+    if (!file.is_open())
+    {
+        throw filterError("Error! could not create file " + fileName);
+    }
+
+    file.precision(17);
+    for (uint32_t set = 0; set < setCount; set++)
+    {
+        vector<double> coeffs = generateCoeffs(coeffsLen + set);
+        file << "[";
+        for (uint32_t i = 0; i < coeffs.size(); i++)
+        {
+            file << coeffs[i] << ((i + 1 < coeffs.size()) ? ",\n" : "");
+        }
+        file << ((set + 1 < setCount) ? "],\n" : "]\n");
+    }
+}
+
+/**
+ * @brief Filter a wav file with a chain of filters, as the audio filtering program does without --stream
+ *
+ * @param inputFile Name of the input wav file
+ * @param outputFile Name of the output wav file
+ * @param stages Sets of filter coefficients in the order they are applied
+ * @return Number of samples filtered
+ */
+static uint64_t filterWavFile(const string &inputFile, const string &outputFile, const vector<vector<double>> &stages)
+{
+    FILE *fp = fopen(inputFile.c_str(), "rb");
+    if (fp == NULL)
+    {
+        throw filterError("Error! could not open file " + inputFile);
+    }
+    wavFile wav(fp);
+    fclose(fp);
+
+    for (uint64_t i = 0; i < stages.size(); i++)
+    {
+        wav.processFirFilter(stages[i], (uint32_t)stages[i].size());
+        wav.nextStage();
+    }
+
+    fp = fopen(outputFile.c_str(), "wb+");
+    if (fp == NULL)
+    {
+        throw filterError("Error! could not create file " + outputFile);
+    }
+    wav.writeWavFile(fp);
+    fclose(fp);
+    return wav.getNumberOfSamples();
+}
+
+/**
+ * @brief Checks if a benchmark was chosen on the command line
+ *
+ * @param name Name of the benchmark
+ * @param options Settings parsed from the command line
+ * @return True if the benchmark is to be run
+ */
+static bool selected(const string &name, const benchmarkOptions &options)
+{
+    return options.filter.empty() || name.find(options.filter) != string::npos;
+}
+
+/**
+ * @brief Add the result of a benchmark and show its progress
+ *
+ * @param results Results so far
+ * @param name Name of the benchmark
+ * @param unit Unit of the value
+ * @param value Best throughput
+ */
+static void addResult(vector<benchmarkResult> &results, const string &name, const string &unit, double value)
+{
+    results.push_back({name, unit, value});
+    cerr << name << ": " << value << " " << unit << "\n";
+}
+
+/**
+ * @brief Fir filter throughput across numbers of coefficients and block sizes
+ *
+ * Each run filters about 64k samples one block at a time with the engine the audio filtering program would use
+ *
+ * @param options Settings parsed from the command line
+ * @param results Receives the results
+ */
+static void benchmarkFir(const benchmarkOptions &options, vector<benchmarkResult> &results)
+{
+    const uint32_t coeffsLens[] = {8, 32, 128, 512, 2048, 8192, 32768, 65536};
+    const uint32_t blockSizes[] = {256, 4096, Benchmark_Sample_Rate};
+
+    for (uint32_t coeffsLen : coeffsLens)
+    {
+        vector<double> coeffs = generateCoeffs(coeffsLen);
+        for (uint32_t blockSize : blockSizes)
+        {
+            string name = "fir/taps=" + to_string(coeffsLen) + "/block=" + to_string(blockSize);
+            if (!selected(name, options))
+            {
+                continue;
+            }
+
+            uint64_t blockCount = max((uint64_t)1, ((uint64_t)1 << 16) / blockSize);
+            vector<double> block = generateSignal(blockSize);
+            double value = measure([&]()
+                                   {
+                                       firFilter filter;
+                                       for (uint64_t i = 0; i < blockCount; i++)
+                                       {
+                                           filter.applyBestFilter(block, coeffs, coeffsLen, blockSize, 0);
+                                       }
+                                       return blockCount * blockSize; },
+                                   options.minSeconds);
+            addResult(results, name, "Msamples/s", value / 1e6);
+        }
+    }
+}
+
+/**
+ * @brief Iir filter throughput across numbers of biquad sections and channels filtered together
+ *
+ * The sections are taken in turn from a designed low pass filter, so every cascade is stable. Each run filters
+ * about 64k frames in blocks of a second
+ *
+ * @param options Settings parsed from the command line
+ * @param results Receives the results
+ */
+static void benchmarkIir(const benchmarkOptions &options, vector<benchmarkResult> &results)
+{
+    const uint32_t sectionCounts[] = {2, 4, 8, 16};
+    const uint32_t channelCounts[] = {1, 2, 4};
+    vector<biquadSection> designed = filterDesigner::designIir(filterDesigner::parseSpec("lp-iir:1000"), Benchmark_Sample_Rate);
+
+    for (uint32_t sectionCount : sectionCounts)
+    {
+        vector<biquadSection> sections;
+        for (uint32_t i = 0; i < sectionCount; i++)
+        {
+            sections.push_back(designed[i % designed.size()]);
+        }
+        for (uint32_t channelCount : channelCounts)
+        {
+            string name = "iir/sections=" + to_string(sectionCount) + "/channels=" + to_string(channelCount);
+            if (!selected(name, options))
+            {
+                continue;
+            }
+
+            uint64_t blockCount = max((uint64_t)1, ((uint64_t)1 << 16) / Benchmark_Sample_Rate);
+            vector<vector<double>> block(channelCount, generateSignal(Benchmark_Sample_Rate));
+            double value = measure([&]()
+                                   {
+                                       iirFilter filter;
+                                       for (uint64_t i = 0; i < blockCount; i++)
+                                       {
+                                           filter.applyIirFilter(block, sections);
+                                       }
+                                       return blockCount * Benchmark_Sample_Rate * channelCount; },
+                                   options.minSeconds);
+            addResult(results, name, "Msamples/s", value / 1e6);
+        }
+    }
+}
+
+/**
+ * @brief Throughput of designed low pass and band pass filters, run at the sample rate and at a reduced rate
+ *
+ * Each run filters about 64k samples in blocks of a second
+ *
+ * @param options Settings parsed from the command line
+ * @param results Receives the results
+ */
+static void benchmarkMultirate(const benchmarkOptions &options, vector<benchmarkResult> &results)
+{
+    const char *specs[] = {"lp:1000", "bp:80-450"};
+
+    for (const char *text : specs)
+    {
+        filterSpec spec = filterDesigner::parseSpec(text);
+        string name = "multirate/" + string(text);
+        if (!selected(name, options))
+        {
+            continue;
+        }
+
+        uint64_t blockCount = max((uint64_t)1, ((uint64_t)1 << 16) / Benchmark_Sample_Rate);
+        vector<double> block = generateSignal(Benchmark_Sample_Rate);
+        spec.multirate = false;
+        vector<double> coeffs = filterDesigner::design(spec, Benchmark_Sample_Rate);
+        double value = measure([&]()
+                               {
+                                   firFilter filter;
+                                   for (uint64_t i = 0; i < blockCount; i++)
+                                   {
+                                       filter.applyBestFilter(block, coeffs, (uint32_t)coeffs.size(), Benchmark_Sample_Rate, 0);
+                                   }
+                                   return blockCount * Benchmark_Sample_Rate; },
+                               options.minSeconds);
+        addResult(results, name + "/direct", "Msamples/s", value / 1e6);
+
+        spec.multirate = true;
+        multirateStage stage = filterDesigner::designMultirate(spec, Benchmark_Sample_Rate);
+        vector<vector<double>> channels(1, block);
+        value = measure([&]()
+                        {
+                            multirateFilter filter;
+                            for (uint64_t i = 0; i < blockCount; i++)
+                            {
+                                filter.applyMultirateFilter(channels, stage);
+                            }
+                            return blockCount * Benchmark_Sample_Rate; },
+                        options.minSeconds);
+        addResult(results, name + "/reduced-rate", "Msamples/s", value / 1e6);
+    }
+}
+
+/**
+ * @brief Throughput of reading, filtering and writing whole wav files of different lengths
+ *
+ * @param options Settings parsed from the command line
+ * @param results Receives the results
+ */
+static void benchmarkFiles(const benchmarkOptions &options, vector<benchmarkResult> &results)
+{
+    const uint32_t lengths[] = {1, 10, 60};
+    vector<vector<double>> stages(1, vector<double>(lowPassCoeffs.begin(), lowPassCoeffs.end()));
+    string outputFile = options.workDir + "/benchmark_output.wav";
+
+    for (uint32_t seconds : lengths)
+    {
+        string name = "file/seconds=" + to_string(seconds);
+        if (!selected(name, options))
+        {
+            continue;
+        }
+
+        string inputFile = options.workDir + "/benchmark_" + to_string(seconds) + "s.wav";
+        writeTestWav(inputFile, seconds);
+        double value = measure([&]()
+                               { return filterWavFile(inputFile, outputFile, stages); },
+                               options.minSeconds);
+        addResult(results, name, "Msamples/s", value / 1e6);
+        remove(inputFile.c_str());
+        remove(outputFile.c_str());
+    }
+}
+
+/**
+ * @brief Throughput of chains of 1 to 16 default filters over a 10 second wav file, with and without fusing
+ *
+ * @param options Settings parsed from the command line
+ * @param results Receives the results
+ */
+static void benchmarkChains(const benchmarkOptions &options, vector<benchmarkResult> &results)
+{
+    const uint32_t depths[] = {1, 2, 4, 8, 16};
+    string inputFile = options.workDir + "/benchmark_chain.wav";
+    string outputFile = options.workDir + "/benchmark_output.wav";
+    bool written = false;
+
+    for (uint32_t depth : depths)
+    {
+        for (bool fuse : {false, true})
+        {
+            string name = "chain/depth=" + to_string(depth) + (fuse ? "/fused" : "/separate");
+            if (!selected(name, options))
+            {
+                continue;
+            }
+            if (!written)
+            {
+                writeTestWav(inputFile, 10);
+                written = true;
+            }
+
+            // -- Cycle through the default filters, compiled as the audio filtering program does
+            vector<vector<double>> stages;
+            for (uint32_t i = 0; i < depth; i++)
+            {
+                const array<double, Default_Filter_Coeffs_Len> &coeffs = *defaultFilters[i % Default_Filter_Count];
+                stages.push_back(vector<double>(coeffs.begin(), coeffs.end()));
+            }
+            filterChain chain;
+            stages = chain.compile(stages, fuse);
+
+            double value = measure([&]()
+                                   { return filterWavFile(inputFile, outputFile, stages); },
+                                   options.minSeconds);
+            addResult(results, name, "Msamples/s", value / 1e6);
+        }
+    }
+
+    if (written)
+    {
+        remove(inputFile.c_str());
+        remove(outputFile.c_str());
+    }
+}
+
+/**
+ * @brief Throughput of parsing small and very large coefficients files
+ *
+ * @param options Settings parsed from the command line
+ * @param results Receives the results
+ */
+static void benchmarkParsing(const benchmarkOptions &options, vector<benchmarkResult> &results)
+{
+    struct parseCase
+    {
+        string name;
+        uint32_t setCount;
+        uint32_t coeffsLen;
+    };
+    const parseCase cases[] = {{"small", 4, 64}, {"medium", 4, 4096}, {"large", 16, 65536}};
+
+    for (const parseCase &parse : cases)
+    {
+        string name = "parse/" + parse.name + "/sets=" + to_string(parse.setCount) + "/taps=" + to_string(parse.coeffsLen);
+        if (!selected(name, options))
+        {
+            continue;
+        }
+
+        string coeffsFile = options.workDir + "/benchmark_coeffs.txt";
+        writeCoeffsFile(coeffsFile, parse.setCount, parse.coeffsLen);
+
+        // -- Printing the coefficients is not part of what is measured
+        double value = measure([&]()
+                               {
+                                   coeffFileParser parser;
+                                   parser.setQuiet(true);
+                                   vector<vector<double>> stages = parser.parseCoeffs(coeffsFile);
+                                   return (uint64_t)parse.setCount * parse.coeffsLen; },
+                               options.minSeconds);
+
+        addResult(results, name, "Mcoeffs/s", value / 1e6);
+        remove(coeffsFile.c_str());
+    }
+}
+
+/**
+ * @brief Write the results as JSON
+ *
+ * @param results Results of the benchmarks
+ * @param output Stream receiving the JSON document
+ */
+static void writeJson(const vector<benchmarkResult> &results, ostream &output)
+{
+    output.precision(6);
+    output << "{\n"
+           << "  \"simd\": \"" << firKernels::getSimdLevelName(firKernels::getSimdLevel()) << "\",\n"
+           << "  \"results\": [\n";
+    for (uint64_t i = 0; i < results.size(); i++)
+    {
+        output << "    {\"name\": \"" << results[i].name
+               << "\", \"unit\": \"" << results[i].unit
+               << "\", \"value\": " << results[i].value
+               << ((i + 1 < results.size()) ? "},\n" : "}\n");
+    }
+    output << "  ]\n"
+           << "}\n";
+}
+
+/**
+ * @brief Read the results of an earlier run written by writeJson
+ *
+ * @param fileName Name of the JSON file
+ * @return Value of every benchmark by name
+ */
+static map<string, double> readBaseline(const string &fileName)
+{
+    ifstream file(fileName);
+    if (!file.is_open())
+    {
+        throw filterError("Error! could not open baseline file " + fileName);
+    }
+
+    // -- Each result is an object holding a name and a value, the other fields are not needed
+    stringstream contents;
+    contents << file.rdbuf();
+    string json = contents.str();
+    map<string, double> baseline;
+    size_t position = 0;
+
+    while ((position = json.find("\"name\"", position)) != string::npos)
+    {
+        size_t nameStart = json.find('"', json.find(':', position)) + 1;
+        size_t nameEnd = json.find('"', nameStart);
+        size_t valueStart = json.find("\"value\"", nameEnd);
+        if (nameStart == 0 || nameEnd == string::npos || valueStart == string::npos)
+        {
+            throw filterError("Error! baseline file " + fileName + " is not a benchmark result");
+        }
+
+        valueStart = json.find(':', valueStart) + 1;
+        baseline[json.substr(nameStart, nameEnd - nameStart)] = strtod(json.c_str() + valueStart, NULL);
+        position = valueStart;
+    }
+    return baseline;
+}
+
+/**
+ * @brief Compare the results against a baseline, listing every benchmark that got slower by more than the threshold
+ *
+ * @param results Results of this run
+ * @param baseline Results of the earlier run by name
+ * @param threshold Percentage by which a benchmark has to be slower to be flagged
+ * @return Number of regressions
+ */
+static uint32_t compareResults(const vector<benchmarkResult> &results, const map<string, double> &baseline, double threshold)
+{
+    uint32_t regressions = 0;
+
+    for (const benchmarkResult &result : results)
+    {
+        auto found = baseline.find(result.name);
+        if (found == baseline.end() || found->second <= 0)
+        {
+            cerr << "new         " << result.name << ": " << result.value << " " << result.unit << "\n";
+            continue;
+        }
+
+        double change = 100.0 * (result.value - found->second) / found->second;
+        bool regressed = change < -threshold;
+        regressions += regressed ? 1 : 0;
+        cerr << (regressed ? "REGRESSION  " : (change > threshold ? "improvement " : "ok          "))
+             << result.name << ": "
+             << found->second << " -> " << result.value << " " << result.unit
+             << " (" << (change >= 0 ? "+" : "") << change << "%)\n";
+    }
+
+    cerr << regressions << " of " << results.size() << " benchmarks regressed by more than " << threshold << "%\n";
+    return regressions;
+}
+
+/**
+ * @brief Run the benchmarks chosen on the command line and write their results
+ *
+ * @param argc Number of command line arguments
+ * @param argv Array of command line arguments:
+ *        argv[1] Optional name of the JSON file receiving the results, - or none for the standard output
+ *        Options of the form --name=value can be given anywhere on the command line:
+ *        --compare=FILE Compares the results against the results of an earlier run in FILE, exiting with 2 on regressions
+ *        --threshold=PCT Percentage by which a benchmark has to be slower than the baseline to be flagged, 10 by default
+ *        --min-time=S Runs every benchmark for at least S seconds, 0.5 by default
+ *        --work-dir=DIR Writes the generated files to DIR, the current directory by default
+ *        --filter=TEXT Only runs the benchmarks whose name contains TEXT
+ *        --simd=LEVEL Limits the fir kernels to the instruction set LEVEL: scalar, sse2, avx2 or avx512
+ * @return Program exit code
+ */
+static int runBenchmarks(int argc, char *argv[])
+{
+    benchmarkOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        size_t equals = arg.find('=');
+        string name = arg.substr(0, equals);
+        string value = (equals == string::npos) ? "" : arg.substr(equals + 1);
+
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            options.outputFile = arg;
+        }
+        else if (name == "--compare")
+        {
+            options.baselineFile = value;
+        }
+        else if (name == "--threshold" || name == "--min-time")
+        {
+            char *end = NULL;
+            double number = strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || number < 0)
+            {
+                throw filterError("Error! Invalid value for " + name + ". Please make sure its a positive number");
+            }
+            (name == "--threshold" ? options.threshold : options.minSeconds) = number;
+        }
+        else if (name == "--work-dir")
+        {
+            options.workDir = value;
+        }
+        else if (name == "--filter")
+        {
+            options.filter = value;
+        }
+        else if (name == "--simd")
+        {
+            if (value == "scalar")
+            {
+                firKernels::setSimdLevel(simdLevel::scalar);
+            }
+            else if (value == "sse2")
+            {
+                firKernels::setSimdLevel(simdLevel::sse2);
+            }
+            else if (value == "avx2")
+            {
+                firKernels::setSimdLevel(simdLevel::avx2);
+            }
+            else if (value == "avx512")
+            {
+                firKernels::setSimdLevel(simdLevel::avx512);
+            }
+            else
+            {
+                throw filterError("Error! Invalid value for --simd. Options include: scalar, sse2, avx2, avx512");
+            }
+        }
+        else
+        {
+            throw filterError("Error! Unknown option " + name);
+        }
+    }
+
+    // -- Read the baseline first, so a wrong file name does not waste a whole run
+    map<string, double> baseline;
+    if (!options.baselineFile.empty())
+    {
+        baseline = readBaseline(options.baselineFile);
+    }
+
+    vector<benchmarkResult> results;
+    benchmarkFir(options, results);
+    benchmarkIir(options, results);
+    benchmarkMultirate(options, results);
+    benchmarkFiles(options, results);
+    benchmarkChains(options, results);
+    benchmarkParsing(options, results);
+
+    if (options.outputFile == "-")
+    {
+        writeJson(results, cout);
+    }
+    else
+    {
+        ofstream output(options.outputFile);
+        if (!output.is_open())
+        {
+            throw filterError("Error! could not create file " + options.outputFile);
+        }
+        writeJson(results, output);
+    }
+
+    if (!options.baselineFile.empty() && compareResults(results, baseline, options.threshold) > 0)
+    {
+        return 2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Entry point of the benchmark program
+ *
+ * @param argc Number of command line arguments
+ * @param argv Array of command line arguments, see runBenchmarks
+ * @return Program exit code: 0 on success, 1 on errors and 2 on regressions
+ */
+int main(int argc, char *argv[])
+{
+    try
+    {
+        return runBenchmarks(argc, argv);
+    }
+    catch (const filterError &error)
+    {
+        cout << error.what();
+        return 1;
+    }
+}
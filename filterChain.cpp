@@ -0,0 +1,218 @@
+/**
+ * @file filterChain.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the filter chain compiler
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <cmath>
+#include <complex>
+#include <algorithm>
+#include "filterChain.hpp"
+#include "fftTransform.hpp"
+#include "firKernels.hpp"
+#include "sampleCodec.hpp"
+#include "filterError.hpp"
+
+using namespace std;
+
+filterChain::filterChain()
+{
+    // -- Default constructor
+}
+
+bool filterChain::isIdentity(const vector<double> &coeffs)
+{
+    if (coeffs.empty() || coeffs[0] != 1.0)
+    {
+        return false;
+    }
+
+    for (uint64_t j = 1; j < coeffs.size(); j++)
+    {
+        if (coeffs[j] != 0.0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+vector<double> filterChain::convolveCoeffs(const vector<double> &first, const vector<double> &second)
+{
+    vector<double> result;
+    if (first.empty() || second.empty())
+    {
+        return result;
+    }
+
+    uint64_t resultLen = first.size() + second.size() - 1;
+    result.assign(resultLen, 0);
+
+    if ((double)first.size() * second.size() <= 1e6)
+    {
+        // -- Short sets are cheaper to convolve directly
+        for (uint64_t i = 0; i < first.size(); i++)
+        {
+            for (uint64_t j = 0; j < second.size(); j++)
+            {
+                result[i + j] += first[i] * second[j];
+            }
+        }
+        return result;
+    }
+
+    // -- Multiply the spectra of the zero padded sets
+    uint32_t fftSize = 4;
+    while (fftSize < resultLen)
+    {
+        fftSize <<= 1;
+    }
+
+    fftTransform fft;
+    fft.setSize(fftSize);
+    vector<double> buffer(fftSize, 0);
+    vector<complex<double>> firstSpectrum(fftSize / 2 + 1);
+    vector<complex<double>> secondSpectrum(fftSize / 2 + 1);
+
+    copy(first.begin(), first.end(), buffer.begin());
+    fft.forward(&buffer[0], &firstSpectrum[0]);
+    fill(buffer.begin(), buffer.end(), 0);
+    copy(second.begin(), second.end(), buffer.begin());
+    fft.forward(&buffer[0], &secondSpectrum[0]);
+
+    for (uint32_t k = 0; k < firstSpectrum.size(); k++)
+    {
+        firstSpectrum[k] *= secondSpectrum[k] / (double)fftSize;
+    }
+    fft.inverse(&firstSpectrum[0], &buffer[0]);
+
+    copy(buffer.begin(), buffer.begin() + resultLen, result.begin());
+    return result;
+}
+
+double filterChain::estimateCost(uint64_t coeffsLen)
+{
+    // -- The direct form costs one multiply-accumulate per coefficient. From the crossover on the fft based
+    // -- convolution is used, whose cost grows with the logarithm of the fft size
+    double crossover = firKernels::getFftCrossoverCoeffsLen();
+    if (coeffsLen < crossover)
+    {
+        return (double)coeffsLen;
+    }
+
+    return crossover * log2(4.0 * coeffsLen) / log2(4.0 * crossover);
+}
+
+vector<vector<double>> filterChain::compile(const vector<vector<double>> &stages, bool fuseStages)
+{
+    vector<vector<double>> compiled;
+
+    for (uint64_t i = 0; i < stages.size(); i++)
+    {
+        // -- Filters that do not change the audio data are not worth a pass
+        if (isIdentity(stages[i]))
+        {
+            continue;
+        }
+
+        // -- Fuse the filter into the previous one when one pass with the fused filter is cheaper than two passes
+        if (fuseStages && !compiled.empty())
+        {
+            vector<double> &previous = compiled.back();
+            double separateCost = estimateCost(previous.size()) + estimateCost(stages[i].size()) + 2 * Filter_Pass_Cost;
+            double fusedCost = estimateCost(previous.size() + stages[i].size() - 1) + Filter_Pass_Cost;
+
+            if (fusedCost <= separateCost)
+            {
+                previous = convolveCoeffs(previous, stages[i]);
+                continue;
+            }
+        }
+
+        compiled.push_back(stages[i]);
+    }
+
+    return compiled;
+}
+
+filterChain filterChain::build(const vector<vector<double>> &coeffSets, bool fuseStages, uint32_t partitionSize)
+{
+    for (uint64_t i = 0; i < coeffSets.size(); i++)
+    {
+        if (coeffSets[i].empty())
+        {
+            throw filterError("Error! coefficient set " + to_string(i + 1) + " is empty");
+        }
+    }
+    if (partitionSize != 0 && (partitionSize < 2 || (partitionSize & (partitionSize - 1)) != 0))
+    {
+        throw filterError("Error! Invalid partition size " + to_string(partitionSize) + ". Please make sure its a power of 2 of at least 2");
+    }
+
+    filterChain chain;
+    chain.stages = chain.compile(coeffSets, fuseStages);
+    chain.filters.resize(chain.stages.size());
+    chain.partitionSize = partitionSize;
+    return chain;
+}
+
+void filterChain::process(const double *input, double *output, uint64_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    workingData.assign(input, input + count);
+    for (uint64_t i = 0; i < stages.size(); i++)
+    {
+        // -- The buffer of the direct form is sized to the block, as the sample rate is not known
+        workingData = filters[i].applyBestFilter(workingData, stages[i], (uint32_t)stages[i].size(), 0, partitionSize);
+    }
+    copy(workingData.begin(), workingData.end(), output);
+}
+
+void filterChain::process(const int16_t *input, int16_t *output, uint64_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    workingData.resize(count);
+    sampleCodec::unpack(sampleFormat::int16, (const unsigned char *)input, 1, &workingData[0], count);
+    for (uint64_t i = 0; i < stages.size(); i++)
+    {
+        workingData = filters[i].applyBestFilter(workingData, stages[i], (uint32_t)stages[i].size(), 0, partitionSize);
+    }
+
+    // -- Quantise once, after the last filter
+    packState state;
+    sampleCodec::pack(sampleFormat::int16, &workingData[0], (unsigned char *)output, 1, count, state);
+    clippedSamples += state.clippedSamples;
+}
+
+void filterChain::reset()
+{
+    for (uint64_t i = 0; i < filters.size(); i++)
+    {
+        filters[i].reset();
+    }
+    clippedSamples = 0;
+}
+
+const vector<vector<double>> &filterChain::getStages()
+{
+    return stages;
+}
+
+uint64_t filterChain::getClippedSamples()
+{
+    return clippedSamples;
+}
@@ -0,0 +1,179 @@
+/**
+ * @file filterChain.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition for the filter chain compiler
+ *
+ * This class turns the list of filters requested on the command line into the list of filters that is
+ * actually applied. As applying fir filters one after the other is the same as applying a single fir
+ * filter whose coefficients are the convolution of the coefficients of each filter, neighbouring filters
+ * are fused into one filter whenever that is estimated to be cheaper, saving a full pass over the audio
+ * data per fused filter. Filters that do not change the audio data are dropped.
+ *
+ * A built filter chain also filters a signal on its own, one block of samples at a time, so programs can use
+ * the filters without going through wav files:
+ *
+ *     filterChain chain = filterChain::build(coeffSets);
+ *     chain.process(&input[0], &output[0], input.size());
+ *
+ * Errors, such as an empty set of coefficients, are thrown as a filterError.
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "firFilter.hpp"
+
+using namespace std;
+
+/**
+ * @brief Estimated cost of one pass over the audio data, in multiply-accumulates per sample
+ *
+ * Covers reading and writing the samples and converting them to and from double precision
+ *
+ */
+constexpr double Filter_Pass_Cost = 8.0;
+
+class filterChain
+{
+public:
+    /**
+     * @brief Default constructor to create a new filter chain object
+     *
+     */
+    filterChain();
+
+    /**
+     * @brief Compile the requested filters into the filters to be applied
+     *
+     * Drops the filters that do not change the audio data and, if fuseStages is set, fuses neighbouring
+     * filters whenever the estimated cost of the fused filter is lower than the cost of applying them
+     * separately. The products of a fused filter are rounded in a different order than those of the original
+     * filters, so the output can differ slightly from applying the filters separately
+     *
+     * @param stages Sets of filter coefficients in the order they are to be applied
+     * @param fuseStages Whether neighbouring filters may be fused
+     * @return Sets of filter coefficients to be applied
+     */
+    vector<vector<double>> compile(const vector<vector<double>> &stages, bool fuseStages);
+
+    /**
+     * @brief Checks if a set of filter coefficients leaves the audio data unchanged
+     *
+     * @param coeffs Set of filter coefficients
+     * @return True if the first coefficient is 1 and all others are 0
+     */
+    static bool isIdentity(const vector<double> &coeffs);
+
+    /**
+     * @brief Convolve two sets of filter coefficients
+     *
+     * Long sets are convolved with the fft, short sets directly
+     *
+     * @param first First set of filter coefficients
+     * @param second Second set of filter coefficients
+     * @return The coefficients of the filter equivalent to applying first and then second
+     */
+    static vector<double> convolveCoeffs(const vector<double> &first, const vector<double> &second);
+
+    /**
+     * @brief Estimated cost of applying a filter with the given number of coefficients
+     *
+     * @param coeffsLen Number of filter coefficients
+     * @return Estimated multiply-accumulates per sample, excluding Filter_Pass_Cost
+     */
+    static double estimateCost(uint64_t coeffsLen);
+
+    /**
+     * @brief Build a filter chain that filters a signal one block at a time
+     *
+     * The sets of coefficients are compiled as with compile. Every filter keeps the history of the previous block,
+     * so the output does not depend on how the signal is split into blocks
+     *
+     * @param coeffSets Sets of filter coefficients in the order they are to be applied
+     * @param fuseStages Whether neighbouring filters may be fused
+     * @param partitionSize Partition size of the partitioned convolution, 0 to choose the engine from the number of coefficients
+     * @return The filter chain, ready to filter the first block of a signal
+     */
+    static filterChain build(const vector<vector<double>> &coeffSets, bool fuseStages = true, uint32_t partitionSize = 0);
+
+    /**
+     * @brief Filter the next block of the signal in double precision
+     *
+     * The samples are not rounded. The input and output may be the same array
+     *
+     * @param input Array of count input samples
+     * @param output Array of count output samples
+     * @param count Number of samples
+     */
+    void process(const double *input, double *output, uint64_t count);
+
+    /**
+     * @brief Filter the next block of a signal of 16 bit samples
+     *
+     * The block is filtered in double precision and rounded once at the end, saturating the samples that
+     * do not fit in 16 bits. The input and output may be the same array
+     *
+     * @param input Array of count input samples
+     * @param output Array of count output samples
+     * @param count Number of samples
+     */
+    void process(const int16_t *input, int16_t *output, uint64_t count);
+
+    /**
+     * @brief Clear the history of every filter, so the next block starts a new signal
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Gets the sets of filter coefficients the chain applies
+     *
+     * @return Compiled sets of filter coefficients
+     */
+    const vector<vector<double>> &getStages();
+
+    /**
+     * @brief Gets the number of 16 bit output samples that were saturated since the chain was built or reset
+     *
+     * @return Number of saturated samples
+     */
+    uint64_t getClippedSamples();
+
+private:
+    /**
+     * @brief Compiled sets of filter coefficients
+     *
+     */
+    vector<vector<double>> stages;
+
+    /**
+     * @brief One filter per set of coefficients, holding its history
+     *
+     */
+    vector<firFilter> filters;
+
+    /**
+     * @brief Partition size of the partitioned convolution, 0 if not used
+     *
+     */
+    uint32_t partitionSize = 0;
+
+    /**
+     * @brief Block of samples being filtered
+     *
+     */
+    vector<double> workingData;
+
+    /**
+     * @brief Number of saturated 16 bit output samples
+     *
+     */
+    uint64_t clippedSamples = 0;
+};
@@ -0,0 +1,1116 @@
+/**
+ * @file filterDesigner.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the fir filter design engine
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <map>
+#include <cmath>
+#include <mutex>
+#include <tuple>
+#include <cctype>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <complex>
+#include <sstream>
+#include <algorithm>
+#include "filterDesigner.hpp"
+#include "fftTransform.hpp"
+#include "filterError.hpp"
+
+using namespace std;
+
+/**
+ * @brief Key of a remembered design: the fields of the specification followed by the sample rate
+ *
+ */
+typedef tuple<int, double, double, double, double, double, int, uint32_t> designKey;
+
+/**
+ * @brief Designs remembered by filterDesigner::design, and the lock protecting them. A design is remembered as
+ * soon as it is started, so threads asking for a filter being designed wait for it instead of designing it again
+ *
+ */
+static map<designKey, shared_future<vector<double>>> designs;
+static mutex designsLock;
+
+/**
+ * @brief Number of grid points per coefficient of the equiripple design
+ *
+ */
+constexpr uint32_t Equiripple_Grid_Density = 16;
+
+/**
+ * @brief Largest number of exchanges of the equiripple design
+ *
+ */
+constexpr uint32_t Equiripple_Max_Iterations = 100;
+
+/**
+ * @brief Compute sin(pi x) / (pi x)
+ *
+ * @param x Argument
+ * @return The normalised sinc of x
+ */
+static double sinc(double x)
+{
+    if (x == 0)
+    {
+        return 1.0;
+    }
+    return sin(M_PI * x) / (M_PI * x);
+}
+
+/**
+ * @brief Compute the modified Bessel function of the first kind of order 0, used by the Kaiser window
+ *
+ * @param x Argument
+ * @return I0(x)
+ */
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (uint32_t k = 1; k < 500; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-17)
+        {
+            break;
+        }
+    }
+    return sum;
+}
+
+/**
+ * @brief Compute the barycentric weights 1 / prod(x[k] - x[j]) of interpolation points, scaled by a common factor
+ * so they neither overflow nor underflow
+ *
+ * @param x Interpolation points
+ * @param count Number of points
+ * @return The weights
+ */
+static vector<double> barycentricWeights(const vector<double> &x, uint32_t count)
+{
+    vector<double> logWeights(count);
+    vector<double> weights(count);
+    double maxLog = -HUGE_VAL;
+    for (uint32_t k = 0; k < count; k++)
+    {
+        double logWeight = 0;
+        double sign = 1;
+        for (uint32_t j = 0; j < count; j++)
+        {
+            if (j != k)
+            {
+                double difference = x[k] - x[j];
+                logWeight -= log(fabs(difference));
+                sign = (difference < 0) ? -sign : sign;
+            }
+        }
+        logWeights[k] = logWeight;
+        weights[k] = sign;
+        maxLog = max(maxLog, logWeight);
+    }
+
+    for (uint32_t k = 0; k < count; k++)
+    {
+        weights[k] *= exp(logWeights[k] - maxLog);
+    }
+    return weights;
+}
+
+/**
+ * @brief Group roots of a digital filter into the factors of its biquad sections
+ *
+ * Complex roots come with their conjugate, so the root in the upper half plane stands for both. Real roots are
+ * paired with their neighbours, an odd real root is left on its own in a first order factor
+ *
+ * @param roots Roots of the filter
+ * @param factors Receives the coefficients c1 and c2 of each factor 1 + c1 z^-1 + c2 z^-2
+ * @param representatives Receives one root of each factor
+ */
+static void factorRoots(const vector<complex<double>> &roots, vector<pair<double, double>> &factors, vector<complex<double>> &representatives)
+{
+    vector<double> realRoots;
+    for (uint64_t i = 0; i < roots.size(); i++)
+    {
+        if (fabs(roots[i].imag()) <= 1e-10)
+        {
+            realRoots.push_back(roots[i].real());
+        }
+        else if (roots[i].imag() > 0)
+        {
+            factors.push_back({-2 * roots[i].real(), norm(roots[i])});
+            representatives.push_back(roots[i]);
+        }
+    }
+
+    sort(realRoots.begin(), realRoots.end());
+    for (uint64_t i = 0; i < realRoots.size(); i += 2)
+    {
+        if (i + 1 < realRoots.size())
+        {
+            factors.push_back({-(realRoots[i] + realRoots[i + 1]), realRoots[i] * realRoots[i + 1]});
+        }
+        else
+        {
+            factors.push_back({-realRoots[i], 0.0});
+        }
+        representatives.push_back(realRoots[i]);
+    }
+}
+
+/**
+ * @brief Pair up the poles and zeros of a digital filter into biquad sections
+ *
+ * Each pair of poles is given the pair of zeros closest to it, which keeps the gain of every section moderate.
+ * The sections are applied from the poles furthest from the unit circle to the closest, so the sharpest
+ * resonances come last, and each section is scaled to a gain of 1 at the reference frequency
+ *
+ * @param poles Poles of the filter
+ * @param zeros Zeros of the filter, as many as poles
+ * @param referenceFrequency Frequency in the passband, as a fraction of the sample rate
+ * @return The sections
+ */
+static vector<biquadSection> pairSections(const vector<complex<double>> &poles, const vector<complex<double>> &zeros, double referenceFrequency)
+{
+    vector<pair<double, double>> poleFactors, zeroFactors;
+    vector<complex<double>> poleRoots, zeroRoots;
+    factorRoots(poles, poleFactors, poleRoots);
+    factorRoots(zeros, zeroFactors, zeroRoots);
+
+    vector<uint64_t> order(poleFactors.size());
+    for (uint64_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) { return abs(poleRoots[a]) < abs(poleRoots[b]); });
+
+    // -- The closest poles to the unit circle choose their zeros first
+    vector<biquadSection> sections(order.size());
+    vector<bool> used(zeroFactors.size(), false);
+    complex<double> reference = polar(1.0, -2 * M_PI * referenceFrequency);
+    for (uint64_t k = order.size(); k-- > 0;)
+    {
+        uint64_t pole = order[k];
+        uint64_t closest = zeroFactors.size();
+        for (uint64_t z = 0; z < zeroFactors.size(); z++)
+        {
+            if (!used[z] && (closest == zeroFactors.size() || abs(zeroRoots[z] - poleRoots[pole]) < abs(zeroRoots[closest] - poleRoots[pole])))
+            {
+                closest = z;
+            }
+        }
+        pair<double, double> zero = (closest < zeroFactors.size()) ? zeroFactors[closest] : pair<double, double>(0.0, 0.0);
+        if (closest < zeroFactors.size())
+        {
+            used[closest] = true;
+        }
+
+        // -- Gain at the reference frequency, keeping its sign where the response is real
+        biquadSection &section = sections[k];
+        complex<double> response = (1.0 + zero.first * reference + zero.second * reference * reference) /
+                                   (1.0 + poleFactors[pole].first * reference + poleFactors[pole].second * reference * reference);
+        double gain = (fabs(response.imag()) <= 1e-9 * abs(response)) ? response.real() : abs(response);
+        section.b0 = 1 / gain;
+        section.b1 = zero.first / gain;
+        section.b2 = zero.second / gain;
+        section.a1 = poleFactors[pole].first;
+        section.a2 = poleFactors[pole].second;
+    }
+    return sections;
+}
+
+filterSpec filterDesigner::parseSpec(const string &text)
+{
+    string invalid = "Error! invalid filter design " + text + ". Make sure it is one of lp:F, hp:F, bp:F1-F2, bs:F1-F2 with the cutoff frequencies F in Hz, "
+                     "or lp-iir:F, hp-iir:F, bp-iir:F1-F2, bs-iir:F1-F2 for iir filters";
+    filterSpec spec;
+
+    size_t colon = text.find(':');
+    if (colon == string::npos)
+    {
+        throw filterError(invalid);
+    }
+    // -- The type is case insensitive, as for the default filters
+    string type = text.substr(0, colon);
+    transform(type.begin(), type.end(), type.begin(), [](unsigned char c) { return (char)tolower(c); });
+    string frequencies = text.substr(colon + 1);
+    if (type.size() > 4 && type.compare(type.size() - 4, 4, "-iir") == 0)
+    {
+        spec.method = designMethod::iir;
+        type.erase(type.size() - 4);
+    }
+
+    if (type == "lp" || type == "hp")
+    {
+        spec.band = (type == "lp") ? filterBand::lowPass : filterBand::highPass;
+    }
+    else if (type == "bp" || type == "bs")
+    {
+        spec.band = (type == "bp") ? filterBand::bandPass : filterBand::bandStop;
+    }
+    else
+    {
+        throw filterError(invalid);
+    }
+
+    // -- One cutoff for low and high pass filters, two separated by a dash for band pass and band stop filters
+    bool twoCutoffs = spec.band == filterBand::bandPass || spec.band == filterBand::bandStop;
+    const char *start = frequencies.c_str();
+    char *end = NULL;
+    spec.lowCutoff = strtod(start, &end);
+    if (end == start || spec.lowCutoff <= 0 || !isfinite(spec.lowCutoff))
+    {
+        throw filterError(invalid);
+    }
+    if (twoCutoffs)
+    {
+        if (*end != '-')
+        {
+            throw filterError(invalid);
+        }
+        start = end + 1;
+        spec.highCutoff = strtod(start, &end);
+        if (end == start || spec.highCutoff <= spec.lowCutoff || !isfinite(spec.highCutoff))
+        {
+            throw filterError(invalid);
+        }
+    }
+    if (*end != '\0')
+    {
+        throw filterError(invalid);
+    }
+
+    return spec;
+}
+
+string filterDesigner::describeSpec(const filterSpec &spec)
+{
+    ostringstream description;
+    string method = (spec.method == designMethod::iir) ? "-iir:" : ":";
+    switch (spec.band)
+    {
+    case filterBand::lowPass:
+        description << "lp" << method << spec.lowCutoff;
+        break;
+    case filterBand::highPass:
+        description << "hp" << method << spec.lowCutoff;
+        break;
+    case filterBand::bandPass:
+        description << "bp" << method << spec.lowCutoff << "-" << spec.highCutoff;
+        break;
+    case filterBand::bandStop:
+        description << "bs" << method << spec.lowCutoff << "-" << spec.highCutoff;
+        break;
+    }
+    return description.str();
+}
+
+vector<designBand> filterDesigner::getBands(const filterSpec &spec, uint32_t samplesPerSecond)
+{
+    if (!(spec.transitionWidth > 0) || !(spec.passbandRipple > 0) || !(spec.stopbandAttenuation > 0))
+    {
+        throw filterError("Error! the transition width, passband ripple and stopband attenuation of filter " + describeSpec(spec) + " must be positive");
+    }
+
+    // -- A peak to peak ripple of R dB allows the gain to lie between 1 - d and 1 + d with 20 log10((1 + d) / (1 - d)) = R
+    double rippleGain = pow(10.0, spec.passbandRipple / 20.0);
+    double passDeviation = (rippleGain - 1) / (rippleGain + 1);
+    double stopDeviation = pow(10.0, -spec.stopbandAttenuation / 20.0);
+
+    double rate = (double)samplesPerSecond;
+    double halfWidth = spec.transitionWidth / 2 / rate;
+    double low = spec.lowCutoff / rate;
+    double high = spec.highCutoff / rate;
+
+    vector<designBand> bands;
+    switch (spec.band)
+    {
+    case filterBand::lowPass:
+        bands.push_back({0.0, low - halfWidth, 1.0, passDeviation});
+        bands.push_back({low + halfWidth, 0.5, 0.0, stopDeviation});
+        break;
+    case filterBand::highPass:
+        bands.push_back({0.0, low - halfWidth, 0.0, stopDeviation});
+        bands.push_back({low + halfWidth, 0.5, 1.0, passDeviation});
+        break;
+    case filterBand::bandPass:
+        bands.push_back({0.0, low - halfWidth, 0.0, stopDeviation});
+        bands.push_back({low + halfWidth, high - halfWidth, 1.0, passDeviation});
+        bands.push_back({high + halfWidth, 0.5, 0.0, stopDeviation});
+        break;
+    case filterBand::bandStop:
+        bands.push_back({0.0, low - halfWidth, 1.0, passDeviation});
+        bands.push_back({low + halfWidth, high - halfWidth, 0.0, stopDeviation});
+        bands.push_back({high + halfWidth, 0.5, 1.0, passDeviation});
+        break;
+    }
+
+    // -- Every band must keep some width once the transition bands are taken out
+    for (uint64_t i = 0; i < bands.size(); i++)
+    {
+        if (!(bands[i].end > bands[i].start))
+        {
+            throw filterError("Error! filter " + describeSpec(spec) + " with a transition width of " + to_string((uint32_t)spec.transitionWidth) +
+                              " Hz does not fit a sample rate of " + to_string(samplesPerSecond) + " Hz. Please make sure the cutoffs are at least half "
+                              "the transition width away from 0 Hz, from each other and from half the sample rate");
+        }
+    }
+
+    return bands;
+}
+
+bool filterDesigner::meetsSpec(const vector<double> &coeffs, const filterSpec &spec, uint32_t samplesPerSecond)
+{
+    vector<designBand> bands = getBands(spec, samplesPerSecond);
+
+    // -- Sample the frequency response finely enough to see every ripple
+    uint32_t fftSize = 1024;
+    while (fftSize < 16 * coeffs.size())
+    {
+        fftSize <<= 1;
+    }
+    fftTransform fft;
+    fft.setSize(fftSize);
+    vector<double> buffer(fftSize, 0);
+    vector<complex<double>> response(fftSize / 2 + 1);
+    copy(coeffs.begin(), coeffs.end(), buffer.begin());
+    fft.forward(&buffer[0], &response[0]);
+
+    for (uint64_t i = 0; i < bands.size(); i++)
+    {
+        // -- A slight tolerance keeps rounding errors from failing a design that meets its specification exactly
+        double allowed = bands[i].deviation * (1 + 1e-6);
+        uint32_t first = (uint32_t)ceil(bands[i].start * fftSize);
+        uint32_t last = min((uint32_t)floor(bands[i].end * fftSize), fftSize / 2);
+        for (uint32_t k = first; k <= last; k++)
+        {
+            if (fabs(abs(response[k]) - bands[i].gain) > allowed)
+            {
+                return false;
+            }
+        }
+
+        // -- The band edges rarely lie on the grid, and the gain is furthest from the band at an edge
+        for (double edge : {bands[i].start, bands[i].end})
+        {
+            complex<double> gain = 0;
+            for (uint64_t j = 0; j < coeffs.size(); j++)
+            {
+                gain += coeffs[j] * polar(1.0, -2 * M_PI * edge * (double)j);
+            }
+            if (fabs(abs(gain) - bands[i].gain) > allowed)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+vector<double> filterDesigner::designKaiser(const filterSpec &spec, uint32_t samplesPerSecond, uint32_t coeffsLen)
+{
+    vector<designBand> bands = getBands(spec, samplesPerSecond);
+    double deviation = bands[0].deviation;
+    for (uint64_t i = 1; i < bands.size(); i++)
+    {
+        deviation = min(deviation, bands[i].deviation);
+    }
+
+    // -- Kaiser's formula for the window shape giving the attenuation
+    double attenuation = -20.0 * log10(deviation);
+    double beta = 0;
+    if (attenuation > 50)
+    {
+        beta = 0.1102 * (attenuation - 8.7);
+    }
+    else if (attenuation >= 21)
+    {
+        beta = 0.5842 * pow(attenuation - 21, 0.4) + 0.07886 * (attenuation - 21);
+    }
+
+    // -- The ideal response is a sum of low pass filters with the cutoffs in the middle of the transition bands
+    double low = spec.lowCutoff / samplesPerSecond;
+    double high = spec.highCutoff / samplesPerSecond;
+    double centre = (coeffsLen - 1) / 2.0;
+    double windowScale = besselI0(beta);
+    vector<double> coeffs(coeffsLen);
+    for (uint32_t n = 0; n < coeffsLen; n++)
+    {
+        double m = n - centre;
+        double impulse = (m == 0) ? 1.0 : 0.0;
+        double ideal = 0;
+        switch (spec.band)
+        {
+        case filterBand::lowPass:
+            ideal = 2 * low * sinc(2 * low * m);
+            break;
+        case filterBand::highPass:
+            ideal = impulse - 2 * low * sinc(2 * low * m);
+            break;
+        case filterBand::bandPass:
+            ideal = 2 * high * sinc(2 * high * m) - 2 * low * sinc(2 * low * m);
+            break;
+        case filterBand::bandStop:
+            ideal = impulse - 2 * high * sinc(2 * high * m) + 2 * low * sinc(2 * low * m);
+            break;
+        }
+
+        double position = (coeffsLen > 1) ? 2.0 * n / (coeffsLen - 1) - 1.0 : 0.0;
+        coeffs[n] = ideal * besselI0(beta * sqrt(max(0.0, 1.0 - position * position))) / windowScale;
+    }
+
+    return coeffs;
+}
+
+vector<double> filterDesigner::designEquiripple(const vector<designBand> &bands, uint32_t coeffsLen)
+{
+    // -- A symmetric filter of odd length 2L + 1 has the real gain A(f) = sum of a[k] cos(2 pi k f) for k = 0 to L.
+    // -- The exchange finds the L + 2 frequencies where the weighted error alternates with the largest magnitude
+    uint32_t halfLen = (coeffsLen - 1) / 2;
+    uint32_t basisCount = halfLen + 1;
+    uint32_t extremaCount = halfLen + 2;
+
+    // -- Dense grid over the bands, in x = cos(2 pi f), with the desired gain and the weight of every point
+    double totalWidth = 0;
+    for (uint64_t i = 0; i < bands.size(); i++)
+    {
+        totalWidth += bands[i].end - bands[i].start;
+    }
+    vector<double> gridX, gridGain, gridWeight;
+    vector<uint32_t> gridBand;
+    for (uint32_t i = 0; i < (uint32_t)bands.size(); i++)
+    {
+        double width = bands[i].end - bands[i].start;
+        uint32_t points = max((uint32_t)ceil(Equiripple_Grid_Density * basisCount * width / totalWidth), 2u);
+        for (uint32_t j = 0; j <= points; j++)
+        {
+            double f = bands[i].start + width * j / points;
+            gridX.push_back(cos(2 * M_PI * f));
+            gridGain.push_back(bands[i].gain);
+            gridWeight.push_back(1.0 / bands[i].deviation);
+            gridBand.push_back(i);
+        }
+    }
+    uint32_t gridLen = (uint32_t)gridX.size();
+
+    vector<uint32_t> extrema(extremaCount);
+    for (uint32_t k = 0; k < extremaCount; k++)
+    {
+        extrema[k] = (uint32_t)((uint64_t)k * (gridLen - 1) / (extremaCount - 1));
+    }
+
+    vector<double> x(extremaCount), values(basisCount), weightedValues(basisCount), weights, error(gridLen);
+    for (uint32_t iteration = 0; iteration < Equiripple_Max_Iterations; iteration++)
+    {
+        // -- The levelled error delta of the best approximation on the current extrema
+        for (uint32_t k = 0; k < extremaCount; k++)
+        {
+            x[k] = gridX[extrema[k]];
+        }
+        weights = barycentricWeights(x, extremaCount);
+        double numerator = 0;
+        double denominator = 0;
+        for (uint32_t k = 0; k < extremaCount; k++)
+        {
+            numerator += weights[k] * gridGain[extrema[k]];
+            denominator += weights[k] * ((k % 2 == 0) ? 1.0 : -1.0) / gridWeight[extrema[k]];
+        }
+        double delta = numerator / denominator;
+
+        // -- Interpolate the gain through the first L + 1 extrema, where it is off by exactly delta
+        weights = barycentricWeights(x, basisCount);
+        for (uint32_t k = 0; k < basisCount; k++)
+        {
+            values[k] = gridGain[extrema[k]] - ((k % 2 == 0) ? 1.0 : -1.0) * delta / gridWeight[extrema[k]];
+        }
+        for (uint32_t k = 0; k < basisCount; k++)
+        {
+            weightedValues[k] = weights[k] * values[k];
+        }
+        double maxError = 0;
+        for (uint32_t i = 0; i < gridLen; i++)
+        {
+            double sum = 0;
+            double weightSum = 0;
+            double gain = NAN;
+            for (uint32_t k = 0; k < basisCount; k++)
+            {
+                double difference = gridX[i] - x[k];
+                if (difference == 0)
+                {
+                    gain = values[k];
+                    break;
+                }
+                double inverse = 1.0 / difference;
+                sum += weightedValues[k] * inverse;
+                weightSum += weights[k] * inverse;
+            }
+            if (isnan(gain))
+            {
+                gain = sum / weightSum;
+            }
+            error[i] = gridWeight[i] * (gridGain[i] - gain);
+            maxError = max(maxError, fabs(error[i]));
+        }
+
+        // -- Done once the error no longer exceeds the levelled error
+        if (maxError <= fabs(delta) * (1 + 1e-6))
+        {
+            break;
+        }
+
+        // -- The local extrema of the error within each band, alternating in sign
+        vector<uint32_t> candidates;
+        for (uint32_t i = 0; i < gridLen; i++)
+        {
+            bool hasLeft = i > 0 && gridBand[i - 1] == gridBand[i];
+            bool hasRight = i + 1 < gridLen && gridBand[i + 1] == gridBand[i];
+            double e = error[i];
+            bool isExtremum = (e >= 0) ? ((!hasLeft || e >= error[i - 1]) && (!hasRight || e > error[i + 1]))
+                                       : ((!hasLeft || e <= error[i - 1]) && (!hasRight || e < error[i + 1]));
+            if (!isExtremum)
+            {
+                continue;
+            }
+
+            if (!candidates.empty() && (error[candidates.back()] >= 0) == (e >= 0))
+            {
+                // -- Of two neighbouring extrema of the same sign, keep the larger one
+                if (fabs(e) > fabs(error[candidates.back()]))
+                {
+                    candidates.back() = i;
+                }
+            }
+            else
+            {
+                candidates.push_back(i);
+            }
+        }
+
+        // -- Drop the smallest extrema until there are L + 2. An extremum inside the list is dropped along with
+        // -- the smaller of its neighbours, which keeps the signs alternating
+        while (candidates.size() > extremaCount)
+        {
+            uint64_t smallest = 0;
+            for (uint64_t k = 1; k < candidates.size(); k++)
+            {
+                if (fabs(error[candidates[k]]) < fabs(error[candidates[smallest]]))
+                {
+                    smallest = k;
+                }
+            }
+
+            if (candidates.size() == extremaCount + 1 || smallest == 0 || smallest == candidates.size() - 1)
+            {
+                bool dropFirst = fabs(error[candidates.front()]) < fabs(error[candidates.back()]);
+                if (smallest == 0 || (smallest != candidates.size() - 1 && dropFirst))
+                {
+                    candidates.erase(candidates.begin());
+                }
+                else
+                {
+                    candidates.pop_back();
+                }
+                continue;
+            }
+
+            candidates.erase(candidates.begin() + smallest);
+            uint64_t smaller = (fabs(error[candidates[smallest - 1]]) < fabs(error[candidates[smallest]])) ? smallest - 1 : smallest;
+            candidates.erase(candidates.begin() + smaller);
+        }
+        if (candidates.size() < extremaCount || candidates == extrema)
+        {
+            break;
+        }
+        extrema = candidates;
+    }
+
+    // -- Sample the gain at the frequencies k / N, which gives the coefficients by an inverse dft
+    for (uint32_t k = 0; k < extremaCount; k++)
+    {
+        x[k] = gridX[extrema[k]];
+    }
+    weights = barycentricWeights(x, extremaCount);
+    double numerator = 0;
+    double denominator = 0;
+    for (uint32_t k = 0; k < extremaCount; k++)
+    {
+        numerator += weights[k] * gridGain[extrema[k]];
+        denominator += weights[k] * ((k % 2 == 0) ? 1.0 : -1.0) / gridWeight[extrema[k]];
+    }
+    double delta = numerator / denominator;
+    weights = barycentricWeights(x, basisCount);
+    for (uint32_t k = 0; k < basisCount; k++)
+    {
+        values[k] = gridGain[extrema[k]] - ((k % 2 == 0) ? 1.0 : -1.0) * delta / gridWeight[extrema[k]];
+    }
+
+    vector<double> samples(basisCount);
+    for (uint32_t j = 0; j < basisCount; j++)
+    {
+        double sampleX = cos(2 * M_PI * j / coeffsLen);
+        double sum = 0;
+        double weightSum = 0;
+        samples[j] = NAN;
+        for (uint32_t k = 0; k < basisCount; k++)
+        {
+            double difference = sampleX - x[k];
+            if (difference == 0)
+            {
+                samples[j] = values[k];
+                break;
+            }
+            sum += weights[k] * values[k] / difference;
+            weightSum += weights[k] / difference;
+        }
+        if (isnan(samples[j]))
+        {
+            samples[j] = sum / weightSum;
+        }
+    }
+
+    vector<double> coeffs(coeffsLen);
+    for (uint32_t m = 0; m <= halfLen; m++)
+    {
+        double sum = samples[0];
+        for (uint32_t j = 1; j < basisCount; j++)
+        {
+            sum += 2 * samples[j] * cos(2 * M_PI * (double)((uint64_t)j * m % coeffsLen) / coeffsLen);
+        }
+        coeffs[halfLen + m] = sum / coeffsLen;
+        coeffs[halfLen - m] = sum / coeffsLen;
+    }
+
+    return coeffs;
+}
+
+uint32_t filterDesigner::findShortest(const function<bool(uint32_t)> &meetsLen, double estimate, uint32_t step, uint32_t longest)
+{
+    uint32_t shortest = 3;
+    if (longest < shortest)
+    {
+        return 0;
+    }
+    uint32_t coeffsLen = (uint32_t)min(max(ceil(estimate), (double)shortest), (double)longest);
+    if ((coeffsLen - shortest) % step != 0)
+    {
+        coeffsLen--;
+    }
+
+    // -- Find a length meeting the specification and a shorter one that does not, doubling the distance from the
+    // -- estimate, which is usually off by a few percent, then halve the range between them
+    uint32_t firstDistance = max(coeffsLen / 64 / step * step, step);
+    uint32_t meets = 0;
+    uint32_t fails = 0;
+    if (meetsLen(coeffsLen))
+    {
+        meets = coeffsLen;
+        for (uint32_t distance = firstDistance; meets > shortest; distance *= 2)
+        {
+            uint32_t shorter = (meets - shortest > distance) ? meets - distance : shortest;
+            if (!meetsLen(shorter))
+            {
+                fails = shorter;
+                break;
+            }
+            meets = shorter;
+        }
+        if (fails == 0)
+        {
+            return meets;
+        }
+    }
+    else
+    {
+        fails = coeffsLen;
+        for (uint32_t distance = firstDistance; meets == 0; distance *= 2)
+        {
+            if (fails + step > longest)
+            {
+                return 0;
+            }
+            uint32_t longer = (uint32_t)min((uint64_t)fails + distance, (uint64_t)longest - (longest - fails) % step);
+            if (meetsLen(longer))
+            {
+                meets = longer;
+            }
+            else
+            {
+                fails = longer;
+            }
+        }
+    }
+
+    while (meets - fails > step)
+    {
+        uint32_t middle = fails + (meets - fails) / step / 2 * step;
+        if (meetsLen(middle))
+        {
+            meets = middle;
+        }
+        else
+        {
+            fails = middle;
+        }
+    }
+    return meets;
+}
+
+double filterDesigner::estimateLen(const filterSpec &spec, uint32_t samplesPerSecond)
+{
+    vector<designBand> bands = getBands(spec, samplesPerSecond);
+    double deviation = bands[0].deviation;
+    for (uint64_t i = 1; i < bands.size(); i++)
+    {
+        deviation = min(deviation, bands[i].deviation);
+    }
+
+    // -- Kaiser's formula for the window
+    double transition = spec.transitionWidth / samplesPerSecond;
+    double attenuation = -20.0 * log10(deviation);
+    return ((attenuation > 21) ? (attenuation - 7.95) / (14.36 * transition) : 0.9222 / transition) + 1;
+}
+
+vector<double> filterDesigner::designShortest(const filterSpec &spec, uint32_t samplesPerSecond)
+{
+    vector<designBand> bands = getBands(spec, samplesPerSecond);
+    double passDeviation = 1;
+    double stopDeviation = 1;
+    for (uint64_t i = 0; i < bands.size(); i++)
+    {
+        double &deviation = (bands[i].gain > 0) ? passDeviation : stopDeviation;
+        deviation = min(deviation, bands[i].deviation);
+    }
+    double transition = spec.transitionWidth / samplesPerSecond;
+
+    // -- Filters passing half the sample rate need an odd number of coefficients. The lengths are estimated with
+    // -- Kaiser's formulas for the window and for equiripple filters
+    uint32_t step = (bands.back().gain > 0) ? 2 : 1;
+    double kaiserEstimate = estimateLen(spec, samplesPerSecond);
+    uint32_t kaiserLen = findShortest([&](uint32_t len) { return meetsSpec(designKaiser(spec, samplesPerSecond, len), spec, samplesPerSecond); },
+                                      kaiserEstimate, step, Max_Designed_Coeffs_Len - (step - 1));
+    if (kaiserLen == 0)
+    {
+        throw filterError("Error! filter " + describeSpec(spec) + " needs more than " + to_string(Max_Designed_Coeffs_Len) + " coefficients to meet its "
+                          "specification. Please make sure the transition width is wide enough");
+    }
+    if (spec.method == designMethod::kaiser)
+    {
+        return designKaiser(spec, samplesPerSecond, kaiserLen);
+    }
+
+    // -- Equiripple filters have an odd number of coefficients. The exchange does not always converge for long
+    // -- filters with very narrow bands, so the Kaiser window design is kept unless an equiripple filter is shorter
+    double equirippleEstimate = (-20.0 * log10(sqrt(passDeviation * stopDeviation)) - 13.0) / (14.6 * transition) + 1;
+    uint32_t longest = min(kaiserLen - 1, Max_Equiripple_Coeffs_Len);
+    longest -= (longest % 2 == 0) ? 1 : 0;
+    uint32_t equirippleLen = findShortest([&](uint32_t len) { return meetsSpec(designEquiripple(bands, len), spec, samplesPerSecond); },
+                                          equirippleEstimate, 2, longest);
+    if (equirippleLen == 0)
+    {
+        return designKaiser(spec, samplesPerSecond, kaiserLen);
+    }
+    return designEquiripple(bands, equirippleLen);
+}
+
+vector<double> filterDesigner::design(const filterSpec &spec, uint32_t samplesPerSecond)
+{
+    designKey key((int)spec.band, spec.lowCutoff, spec.highCutoff, spec.transitionWidth, spec.passbandRipple,
+                  spec.stopbandAttenuation, (int)spec.method, samplesPerSecond);
+    promise<vector<double>> designed;
+    shared_future<vector<double>> coeffs;
+    bool designing = false;
+    {
+        lock_guard<mutex> guard(designsLock);
+        auto found = designs.find(key);
+        if (found != designs.end())
+        {
+            coeffs = found->second;
+        }
+        else
+        {
+            coeffs = designed.get_future().share();
+            designs[key] = coeffs;
+            designing = true;
+        }
+    }
+
+    // -- Designed without holding the lock, so different filters are designed at the same time
+    if (designing)
+    {
+        try
+        {
+            designed.set_value(designShortest(spec, samplesPerSecond));
+        }
+        catch (...)
+        {
+            // -- Not remembered, the threads waiting for it get the error as well
+            {
+                lock_guard<mutex> guard(designsLock);
+                designs.erase(key);
+            }
+            designed.set_exception(current_exception());
+        }
+    }
+    return coeffs.get();
+}
+
+vector<vector<double>> filterDesigner::designStages(const vector<filterSpec> &specs, uint32_t samplesPerSecond)
+{
+    vector<vector<double>> stages;
+    for (uint64_t i = 0; i < specs.size(); i++)
+    {
+        if (specs[i].method != designMethod::iir && getDecimationFactor(specs[i], samplesPerSecond) == 1)
+        {
+            stages.push_back(design(specs[i], samplesPerSecond));
+        }
+    }
+    return stages;
+}
+
+bool filterDesigner::getMultirateSpecs(const filterSpec &spec, uint32_t samplesPerSecond, uint32_t factor, filterSpec &antiAlias, filterSpec &narrow)
+{
+    // -- Edges of the highest passband and of the stopband above it
+    double stopEdge = ((spec.band == filterBand::lowPass) ? spec.lowCutoff : spec.highCutoff) + spec.transitionWidth / 2;
+    double passEdge = stopEdge - spec.transitionWidth;
+
+    // -- Frequencies from the reduced rate less the stopband edge fall below the stopband edge once decimated,
+    // -- and the narrow filter needs its stopband edge below half the reduced rate
+    double reducedRate = (double)samplesPerSecond / factor;
+    double antiAliasStop = reducedRate - stopEdge;
+    if (!(antiAliasStop > passEdge) || !(stopEdge < reducedRate / 2))
+    {
+        return false;
+    }
+
+    antiAlias = spec;
+    antiAlias.band = filterBand::lowPass;
+    antiAlias.lowCutoff = (passEdge + antiAliasStop) / 2;
+    antiAlias.highCutoff = 0;
+    antiAlias.transitionWidth = antiAliasStop - passEdge;
+    antiAlias.passbandRipple = spec.passbandRipple / 4;
+    antiAlias.multirate = false;
+
+    // -- The passband gain of the other filters, up to half their ripple above 1, can lift the stopband of a filter,
+    // -- so each filter attenuates by that much more
+    antiAlias.stopbandAttenuation = spec.stopbandAttenuation + spec.passbandRipple / 2;
+
+    narrow = spec;
+    narrow.lowCutoff *= factor;
+    narrow.highCutoff *= factor;
+    narrow.transitionWidth *= factor;
+    narrow.passbandRipple = spec.passbandRipple / 2;
+    narrow.stopbandAttenuation = spec.stopbandAttenuation + spec.passbandRipple / 4;
+    narrow.multirate = false;
+    return true;
+}
+
+uint32_t filterDesigner::getDecimationFactor(const filterSpec &spec, uint32_t samplesPerSecond)
+{
+    if (!spec.multirate || spec.method == designMethod::iir || (spec.band != filterBand::lowPass && spec.band != filterBand::bandPass))
+    {
+        return 1;
+    }
+
+    // -- The decimation and the interpolation each take the anti-alias filter divided by the factor per sample,
+    // -- and the narrow filter takes its coefficients divided by the factor
+    uint32_t bestFactor = 1;
+    double bestCost = estimateLen(spec, samplesPerSecond) / 2;
+    filterSpec antiAlias;
+    filterSpec narrow;
+    for (uint32_t factor = 2; getMultirateSpecs(spec, samplesPerSecond, factor, antiAlias, narrow); factor++)
+    {
+        double cost = (2 * estimateLen(antiAlias, samplesPerSecond) + estimateLen(narrow, samplesPerSecond)) / factor;
+        if (cost < bestCost)
+        {
+            bestFactor = factor;
+            bestCost = cost;
+        }
+    }
+    return bestFactor;
+}
+
+multirateStage filterDesigner::designMultirate(const filterSpec &spec, uint32_t samplesPerSecond)
+{
+    multirateStage stage;
+    uint32_t factor = getDecimationFactor(spec, samplesPerSecond);
+    filterSpec antiAlias;
+    filterSpec narrow;
+    if (factor > 1 && getMultirateSpecs(spec, samplesPerSecond, factor, antiAlias, narrow))
+    {
+        stage.factor = factor;
+        stage.antiAliasCoeffs = design(antiAlias, samplesPerSecond);
+        stage.narrowCoeffs = design(narrow, samplesPerSecond);
+    }
+    return stage;
+}
+
+vector<multirateStage> filterDesigner::designMultirateStages(const vector<filterSpec> &specs, uint32_t samplesPerSecond)
+{
+    vector<multirateStage> stages;
+    for (uint64_t i = 0; i < specs.size(); i++)
+    {
+        if (getDecimationFactor(specs[i], samplesPerSecond) > 1)
+        {
+            stages.push_back(designMultirate(specs[i], samplesPerSecond));
+        }
+    }
+    return stages;
+}
+
+vector<biquadSection> filterDesigner::designIir(const filterSpec &spec, uint32_t samplesPerSecond)
+{
+    vector<designBand> bands = getBands(spec, samplesPerSecond);
+
+    // -- Edges of the passbands and stopbands on the analog frequency axis of the bilinear transform
+    auto warp = [](double frequency) { return tan(M_PI * frequency); };
+    double passLow = 0, passHigh = 0, stopLow = 0, stopHigh = 0;
+    double ratio = 0;
+    double referenceFrequency = 0;
+    switch (spec.band)
+    {
+    case filterBand::lowPass:
+        passHigh = warp(bands[0].end);
+        ratio = warp(bands[1].start) / passHigh;
+        break;
+    case filterBand::highPass:
+        passLow = warp(bands[1].start);
+        ratio = passLow / warp(bands[0].end);
+        referenceFrequency = 0.5;
+        break;
+    case filterBand::bandPass:
+        stopLow = warp(bands[0].end);
+        passLow = warp(bands[1].start);
+        passHigh = warp(bands[1].end);
+        stopHigh = warp(bands[2].start);
+        ratio = min((passLow * passHigh - stopLow * stopLow) / stopLow, (stopHigh * stopHigh - passLow * passHigh) / stopHigh) / (passHigh - passLow);
+        referenceFrequency = atan(sqrt(passLow * passHigh)) / M_PI;
+        break;
+    case filterBand::bandStop:
+        passLow = warp(bands[0].end);
+        stopLow = warp(bands[1].start);
+        stopHigh = warp(bands[1].end);
+        passHigh = warp(bands[2].start);
+        ratio = min(stopLow / fabs(passLow * passHigh - stopLow * stopLow), stopHigh / fabs(stopHigh * stopHigh - passLow * passHigh)) * (passHigh - passLow);
+        break;
+    }
+
+    // -- Lowest order of the low pass prototype, with its passband edge at 1, whose stopband starts at ratio
+    double attenuation = pow(10.0, spec.stopbandAttenuation / 10.0) - 1;
+    double ripple = pow(10.0, spec.passbandRipple / 10.0) - 1;
+    double order = ceil(acosh(sqrt(attenuation / ripple)) / acosh(ratio) - 1e-9);
+    if (!(order <= Max_Iir_Order))
+    {
+        throw filterError("Error! iir filter " + describeSpec(spec) + " needs a higher order than " + to_string(Max_Iir_Order) + " to meet its specification. "
+                          "Please make sure the transition width is wide enough");
+    }
+    uint32_t prototypeOrder = (uint32_t)max(order, 1.0);
+
+    // -- Chebyshev type II prototype: the poles are the inverses of the Chebyshev type I poles and the zeros lie on
+    // -- the imaginary axis, both scaled so the stopband starts at ratio. Odd orders have a zero at infinity
+    vector<complex<double>> prototypePoles;
+    vector<complex<double>> prototypeZeros;
+    uint32_t infiniteZeros = 0;
+    double mu = asinh(sqrt(attenuation)) / prototypeOrder;
+    for (uint32_t k = 0; k < prototypeOrder; k++)
+    {
+        double theta = M_PI * (2 * k + 1) / (2.0 * prototypeOrder);
+        prototypePoles.push_back(ratio / complex<double>(-sinh(mu) * sin(theta), cosh(mu) * cos(theta)));
+        if (2 * k + 1 == prototypeOrder)
+        {
+            infiniteZeros++;
+        }
+        else
+        {
+            prototypeZeros.push_back(complex<double>(0, ratio / cos(theta)));
+        }
+    }
+
+    // -- Transform the prototype into the analog filter, then map it with the bilinear transform z = (1 + s) / (1 - s)
+    double centre = passLow * passHigh;
+    double width = passHigh - passLow;
+    auto bilinear = [](complex<double> root) { return (1.0 + root) / (1.0 - root); };
+    auto transform = [&](const vector<complex<double>> &roots, vector<complex<double>> &digital)
+    {
+        for (uint64_t i = 0; i < roots.size(); i++)
+        {
+            complex<double> p = roots[i];
+            switch (spec.band)
+            {
+            case filterBand::lowPass:
+                digital.push_back(bilinear(p * passHigh));
+                break;
+            case filterBand::highPass:
+                digital.push_back(bilinear(passLow / p));
+                break;
+            case filterBand::bandPass:
+            {
+                complex<double> root = sqrt(p * p * width * width - 4.0 * centre);
+                digital.push_back(bilinear((p * width + root) / 2.0));
+                digital.push_back(bilinear((p * width - root) / 2.0));
+                break;
+            }
+            case filterBand::bandStop:
+            {
+                complex<double> root = sqrt(width * width - 4.0 * p * p * centre);
+                digital.push_back(bilinear((width + root) / (2.0 * p)));
+                digital.push_back(bilinear((width - root) / (2.0 * p)));
+                break;
+            }
+            }
+        }
+    };
+    vector<complex<double>> poles;
+    vector<complex<double>> zeros;
+    transform(prototypePoles, poles);
+    transform(prototypeZeros, zeros);
+
+    // -- Zeros at infinity of the prototype end up at half the sample rate for low pass filters, at 0 Hz for high
+    // -- pass filters, at both for band pass filters and in the middle of the stopband for band stop filters
+    for (uint32_t i = 0; i < infiniteZeros; i++)
+    {
+        switch (spec.band)
+        {
+        case filterBand::lowPass:
+            zeros.push_back(-1.0);
+            break;
+        case filterBand::highPass:
+            zeros.push_back(1.0);
+            break;
+        case filterBand::bandPass:
+            zeros.push_back(1.0);
+            zeros.push_back(-1.0);
+            break;
+        case filterBand::bandStop:
+            zeros.push_back(bilinear(complex<double>(0, sqrt(centre))));
+            zeros.push_back(bilinear(complex<double>(0, -sqrt(centre))));
+            break;
+        }
+    }
+
+    return pairSections(poles, zeros, referenceFrequency);
+}
+
+vector<vector<biquadSection>> filterDesigner::designIirStages(const vector<filterSpec> &specs, uint32_t samplesPerSecond)
+{
+    vector<vector<biquadSection>> stages;
+    for (uint64_t i = 0; i < specs.size(); i++)
+    {
+        if (specs[i].method == designMethod::iir)
+        {
+            stages.push_back(designIir(specs[i], samplesPerSecond));
+        }
+    }
+    return stages;
+}
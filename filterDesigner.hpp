@@ -0,0 +1,356 @@
+/**
+ * @file filterDesigner.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition for the fir filter design engine
+ *
+ * The default filters are fixed tables designed for one sample rate. This class designs low pass, high pass,
+ * band pass and band stop filters for the sample rate of the file being filtered instead, from the cutoff
+ * frequencies, the width of the transition bands, the passband ripple and the stopband attenuation. The filter
+ * is designed with a Kaiser window or with the Parks-McClellan (equiripple) algorithm, starting from the
+ * estimated number of coefficients and searching for the smallest number of coefficients whose frequency
+ * response meets the specification. Designs are remembered per specification and sample rate, so the files of a
+ * batch sharing a sample rate design each filter once.
+ *
+ * The same specifications can be met by an iir filter instead, a cascade of biquad sections designed from an
+ * analog Chebyshev type II prototype of the lowest order meeting them, which has a flat passband and an
+ * equiripple stopband.
+ *
+ * Low pass and band pass filters whose passband lies well below half the sample rate are run as a multirate
+ * filter instead when that takes far fewer multiplications per sample: decimated after an anti-alias filter, the
+ * filter is designed for the reduced rate, and the output is interpolated back to the sample rate of the file.
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include "iirFilter.hpp"
+#include "multirateFilter.hpp"
+
+using namespace std;
+
+/**
+ * @brief Largest number of coefficients of a designed filter
+ *
+ */
+constexpr uint32_t Max_Designed_Coeffs_Len = 1u << 20;
+
+/**
+ * @brief Largest number of coefficients of an equiripple filter, whose design takes time growing with the
+ * square of the number of coefficients
+ *
+ */
+constexpr uint32_t Max_Equiripple_Coeffs_Len = 8191;
+
+/**
+ * @brief Largest order of the analog prototype of an iir filter. Band pass and band stop filters have a biquad
+ * section per order of the prototype, low and high pass filters a section per two orders
+ *
+ */
+constexpr uint32_t Max_Iir_Order = 64;
+
+/**
+ * @brief Shape of the frequency response of a designed filter
+ *
+ */
+enum class filterBand
+{
+    lowPass,
+    highPass,
+    bandPass,
+    bandStop
+};
+
+/**
+ * @brief Method a filter is designed with
+ *
+ */
+enum class designMethod
+{
+    kaiser,
+    equiripple,
+    iir
+};
+
+/**
+ * @brief Specification of a designed filter
+ *
+ */
+struct filterSpec
+{
+    /**
+     * @brief Shape of the frequency response
+     *
+     */
+    filterBand band = filterBand::lowPass;
+
+    /**
+     * @brief Cutoff of a low or high pass filter, or lower cutoff of a band pass or band stop filter, in Hz.
+     * The cutoffs lie in the middle of the transition bands
+     *
+     */
+    double lowCutoff = 0;
+
+    /**
+     * @brief Upper cutoff of a band pass or band stop filter, in Hz
+     *
+     */
+    double highCutoff = 0;
+
+    /**
+     * @brief Width of every transition band between a passband and a stopband, in Hz
+     *
+     */
+    double transitionWidth = 100;
+
+    /**
+     * @brief Largest peak to peak ripple of the passbands, in dB
+     *
+     */
+    double passbandRipple = 0.1;
+
+    /**
+     * @brief Smallest attenuation of the stopbands, in dB
+     *
+     */
+    double stopbandAttenuation = 60;
+
+    /**
+     * @brief Method the filter is designed with
+     *
+     */
+    designMethod method = designMethod::kaiser;
+
+    /**
+     * @brief Let a fir filter run at a reduced rate when its passband permits
+     *
+     */
+    bool multirate = true;
+};
+
+/**
+ * @brief Passband or stopband of a designed filter
+ *
+ */
+struct designBand
+{
+    /**
+     * @brief Start and end of the band, as a fraction of the sample rate
+     *
+     */
+    double start;
+    double end;
+
+    /**
+     * @brief Desired gain, 1 in a passband and 0 in a stopband
+     *
+     */
+    double gain;
+
+    /**
+     * @brief Largest allowed deviation of the gain
+     *
+     */
+    double deviation;
+};
+
+class filterDesigner
+{
+public:
+    /**
+     * @brief Parse the specification of a filter given on the command line
+     *
+     * The specification is the type of filter followed by its cutoffs in Hz: lp:F, hp:F, bp:F1-F2 or bs:F1-F2.
+     * A type ending in -iir, such as lp-iir:F, chooses the iir method. The other fields keep their default values.
+     * Errors are thrown as a filterError
+     *
+     * @param text The specification
+     * @return The parsed specification
+     */
+    static filterSpec parseSpec(const string &text);
+
+    /**
+     * @brief Describe a specification in the form parseSpec takes
+     *
+     * @param spec The specification
+     * @return The description, such as bp:80-450
+     */
+    static string describeSpec(const filterSpec &spec);
+
+    /**
+     * @brief Design the filter with the smallest number of coefficients meeting a specification
+     *
+     * Designs are remembered, so designing the same specification for the same sample rate again returns the
+     * remembered coefficients. Can be called from several threads at once. Specifications that do not fit the
+     * sample rate are thrown as a filterError
+     *
+     * @param spec Specification of the filter
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @return The filter coefficients
+     */
+    static vector<double> design(const filterSpec &spec, uint32_t samplesPerSecond);
+
+    /**
+     * @brief Design a fir filter for each specification, skipping the specifications with the iir method and
+     * those run as a multirate filter
+     *
+     * @param specs Specifications of the filters in the order they are to be applied
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @return Sets of filter coefficients in the order they are to be applied
+     */
+    static vector<vector<double>> designStages(const vector<filterSpec> &specs, uint32_t samplesPerSecond);
+
+    /**
+     * @brief Design the iir filter of the lowest order meeting a specification
+     *
+     * The filter is a Chebyshev type II filter, mapped to the sample rate with the bilinear transform, whose
+     * poles and zeros are paired up into biquad sections. Each section has a gain of 1 in the middle of the
+     * passband. Specifications that do not fit the sample rate, or need a prototype of more than Max_Iir_Order,
+     * are thrown as a filterError
+     *
+     * @param spec Specification of the filter, whatever its method
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @return Sections of the filter, in the order they are applied
+     */
+    static vector<biquadSection> designIir(const filterSpec &spec, uint32_t samplesPerSecond);
+
+    /**
+     * @brief Design an iir filter for each specification with the iir method
+     *
+     * @param specs Specifications of the filters, designStages designs those with another method
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @return Sections of each iir filter
+     */
+    static vector<vector<biquadSection>> designIirStages(const vector<filterSpec> &specs, uint32_t samplesPerSecond);
+
+    /**
+     * @brief Gets the factor by which a filter is decimated when run as a multirate filter
+     *
+     * Only fir low pass and band pass filters allowing it are run at a reduced rate. The factor keeps the
+     * stopband edge above the passband below half the reduced rate, and is chosen to take the fewest estimated
+     * multiplications per sample. It is only used if that is less than half of those of the filter at the
+     * sample rate of the audio data
+     *
+     * @param spec Specification of the filter
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @return The factor, 1 if the filter runs at the sample rate of the audio data
+     */
+    static uint32_t getDecimationFactor(const filterSpec &spec, uint32_t samplesPerSecond);
+
+    /**
+     * @brief Design the filters of a multirate filter meeting a specification
+     *
+     * The passband ripple is split between the filters, a quarter for the decimation and for the interpolation
+     * and half for the narrow filter. The anti-alias filter stops every frequency that would fall below the
+     * stopband edge once decimated, and each filter attenuates by the stopband attenuation of the specification
+     * along with the passband ripple of the others
+     *
+     * @param spec Specification of the filter
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @return The filters, with a factor of 1 and no coefficients if the filter runs at the sample rate of the audio data
+     */
+    static multirateStage designMultirate(const filterSpec &spec, uint32_t samplesPerSecond);
+
+    /**
+     * @brief Design a multirate filter for each specification run at a reduced rate
+     *
+     * @param specs Specifications of the filters
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @return Filters of each multirate filter
+     */
+    static vector<multirateStage> designMultirateStages(const vector<filterSpec> &specs, uint32_t samplesPerSecond);
+
+    /**
+     * @brief Checks if the frequency response of a set of coefficients meets a specification
+     *
+     * @param coeffs Set of filter coefficients
+     * @param spec Specification of the filter
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @return True if the gain stays within the allowed deviation throughout every passband and stopband
+     */
+    static bool meetsSpec(const vector<double> &coeffs, const filterSpec &spec, uint32_t samplesPerSecond);
+
+private:
+    /**
+     * @brief Gets the passbands and stopbands of a specification
+     *
+     * @param spec Specification of the filter
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @return The bands, from the lowest frequency
+     */
+    static vector<designBand> getBands(const filterSpec &spec, uint32_t samplesPerSecond);
+
+    /**
+     * @brief Estimate the number of coefficients of a Kaiser window design meeting a specification
+     *
+     * @param spec Specification of the filter
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @return The estimated number of coefficients
+     */
+    static double estimateLen(const filterSpec &spec, uint32_t samplesPerSecond);
+
+    /**
+     * @brief Gets the specifications of the filters of a multirate filter
+     *
+     * Both are designed for the sample rate of the audio data, the narrow filter with its frequencies
+     * multiplied by the factor, which gives the same coefficients as designing it for the reduced rate
+     *
+     * @param spec Specification of the filter
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @param factor Decimation factor
+     * @param antiAlias Receives the specification of the anti-alias filter
+     * @param narrow Receives the specification of the narrow filter
+     * @return False if the factor leaves no room for the transition band of the anti-alias filter
+     */
+    static bool getMultirateSpecs(const filterSpec &spec, uint32_t samplesPerSecond, uint32_t factor, filterSpec &antiAlias, filterSpec &narrow);
+
+    /**
+     * @brief Design the filter with the smallest number of coefficients meeting a specification, without
+     * looking up the remembered designs
+     *
+     * @param spec Specification of the filter
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @return The filter coefficients
+     */
+    static vector<double> designShortest(const filterSpec &spec, uint32_t samplesPerSecond);
+
+    /**
+     * @brief Search for the smallest number of coefficients meeting a specification, from an estimate
+     *
+     * @param meetsLen Designs a filter with the given number of coefficients and checks if it meets the specification
+     * @param estimate Estimated number of coefficients
+     * @param step Distance between two numbers of coefficients tried, 2 for odd numbers of coefficients only
+     * @param longest Largest number of coefficients tried
+     * @return The smallest number of coefficients found, 0 if none up to longest meets the specification
+     */
+    static uint32_t findShortest(const function<bool(uint32_t)> &meetsLen, double estimate, uint32_t step, uint32_t longest);
+
+    /**
+     * @brief Design a filter with a Kaiser window
+     *
+     * @param spec Specification of the filter
+     * @param samplesPerSecond Sample rate of the audio data to be filtered
+     * @param coeffsLen Number of coefficients
+     * @return The filter coefficients
+     */
+    static vector<double> designKaiser(const filterSpec &spec, uint32_t samplesPerSecond, uint32_t coeffsLen);
+
+    /**
+     * @brief Design an equiripple filter with the Parks-McClellan algorithm
+     *
+     * The gain is weighted by the inverse of the allowed deviation of each band, so the filter meets its
+     * specification when the weighted error is at most 1
+     *
+     * @param bands Passbands and stopbands of the filter
+     * @param coeffsLen Number of coefficients, odd
+     * @return The filter coefficients
+     */
+    static vector<double> designEquiripple(const vector<designBand> &bands, uint32_t coeffsLen);
+};
@@ -0,0 +1,34 @@
+/**
+ * @file filterError.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition of the error thrown by the filtering library
+ *
+ * The classes of the library do not end the program when they run into an error, such as a file that cannot
+ * be read, a malformed wav file header or coefficients file, or an invalid command line. They throw a filterError
+ * instead, whose message is the one the command line program prints before exiting
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#pragma once
+
+#include <string>
+#include <stdexcept>
+
+using namespace std;
+
+class filterError : public runtime_error
+{
+public:
+    /**
+     * @brief Construct a new filter error object
+     *
+     * @param message Description of the error
+     */
+    explicit filterError(const string &message) : runtime_error(message)
+    {
+    }
+};
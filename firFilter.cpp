@@ -1,70 +1,528 @@
-/**
- * @file firFilter.cpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief Implementation of the fir filter class
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-#include <cmath>
-#include <iostream>
-#include "firFilter.hpp"
-
-using namespace std;
-
-firFilter::firFilter()
-{
-    // -- Default constructor
-}
-
-firFilter::firFilter(const firFilter &obj)
-{
-    // -- Copy constructor
-    filterBuffer = obj.filterBuffer;
-    sampleBuffLen = obj.sampleBuffLen;
-}
-
-vector<int16_t> firFilter::applyFirFilter(vector<int16_t> inputSamples, vector<double> filterCoeffs, uint16_t filterCoeffsLen, uint32_t samplesPerSecond)
-{
-    uint64_t k;
-    double accumulatedValue;       // -- Accumulated value
-    vector<int16_t> outputSamples; // -- Output vector
-    outputSamples.resize(inputSamples.size());
-
-    // -- The number of samples to be processed at one time have been chosen to be the number of samples in one second
-    filterBuffer.resize(filterCoeffsLen - 1 + samplesPerSecond);
-    // -- Initialize inputSamples buffer
-    fill(filterBuffer.begin(), filterBuffer.end(), 0);
-
-    // -- Put the inputSamples at the end of the buffer
-    for (uint64_t i = 0; i < inputSamples.size(); i++)
-    {
-        filterBuffer[(filterCoeffsLen - 1) + i] = inputSamples[i];
-    }
-
-    // -- Apply the chosen filter coefficients to each sample and accumulate the value for
-    // -- each output sample
-    for (uint64_t i = 0; i < inputSamples.size(); i++)
-    {
-        k = filterCoeffsLen - 1 + i;
-        accumulatedValue = 0;
-
-        for (int j = 0; j < filterCoeffsLen; j++)
-        {
-            accumulatedValue += (filterCoeffs[j]) * (filterBuffer[k - j]);
-        }
-        outputSamples[i] = (int16_t)round(accumulatedValue);
-    }
-
-    // -- Move the last of the current sample batch to beginning of the filter buffer for
-    // -- the next batch of samples
-    for (uint64_t i = 0; i < filterCoeffsLen; i++)
-    {
-        filterBuffer[i] = filterBuffer[inputSamples.size() + i];
-    }
-
-    return outputSamples;
-}
+/**
+ * @file firFilter.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the fir filter class
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include "firFilter.hpp"
+#include "firKernels.hpp"
+#include "filterError.hpp"
+
+using namespace std;
+
+/**
+ * @brief Plans set with setCoeffPlans, shared by every fir filter
+ * 
+ */
+static const vector<coeffPlan> *coeffPlans = NULL;
+
+firFilter::firFilter()
+{
+    // -- Default constructor
+    sampleBuffLen = 0;
+    partitionSize = 0;
+    partitionCount = 0;
+    delayLineHead = 0;
+    partitionFill = 0;
+    q15HeadroomBits = -1;
+}
+
+firFilter::firFilter(const firFilter &obj) : fft(obj.fft), partitionFft(obj.partitionFft)
+{
+    // -- Copy constructor
+    filterBuffer = obj.filterBuffer;
+    sampleBuffLen = obj.sampleBuffLen;
+    analysedCoeffs = obj.analysedCoeffs;
+    analysis = obj.analysis;
+    fftCoeffs = obj.fftCoeffs;
+    coeffsSpectrum = obj.coeffsSpectrum;
+    blockSpectrum = obj.blockSpectrum;
+    blockBuffer = obj.blockBuffer;
+    partitionCoeffs = obj.partitionCoeffs;
+    partitionSize = obj.partitionSize;
+    partitionCount = obj.partitionCount;
+    partitionSpectra = obj.partitionSpectra;
+    delayLine = obj.delayLine;
+    delayLineHead = obj.delayLineHead;
+    delayLineSum = obj.delayLineSum;
+    partitionWindow = obj.partitionWindow;
+    partitionFill = obj.partitionFill;
+    q15Buffer = obj.q15Buffer;
+    q15SourceCoeffs = obj.q15SourceCoeffs;
+    q15HeadroomBits = obj.q15HeadroomBits;
+    q15Quantised = obj.q15Quantised;
+}
+
+void firFilter::reset()
+{
+    // -- The history is kept at the start of the filter buffer, so clearing the buffer clears the history
+    filterBuffer.clear();
+    sampleBuffLen = 0;
+
+    // -- The partitioned convolution keeps its history in the delay line
+    delayLine.clear();
+    q15Buffer.clear();
+}
+
+vector<double> firFilter::applyFirFilter(const vector<double> &inputSamples, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t samplesPerSecond)
+{
+    vector<double> outputSamples; // -- Output vector
+    outputSamples.resize(inputSamples.size());
+
+    if (inputSamples.empty())
+    {
+        return outputSamples;
+    }
+
+    // -- The number of samples to be processed at one time have been chosen to be the number of samples in one second.
+    // -- The first filterCoeffsLen - 1 samples of the buffer hold the end of the previous batch
+    sampleBuffLen = max((uint64_t)samplesPerSecond, (uint64_t)inputSamples.size());
+    filterBuffer.resize(filterCoeffsLen - 1 + sampleBuffLen, 0);
+
+    // -- Put the inputSamples at the end of the buffer
+    for (uint64_t i = 0; i < inputSamples.size(); i++)
+    {
+        filterBuffer[(filterCoeffsLen - 1) + i] = inputSamples[i];
+    }
+
+    // -- Only analyse the structure of the coefficients when they have changed
+    if (!(analysedCoeffs.size() == filterCoeffsLen && equal(analysedCoeffs.begin(), analysedCoeffs.end(), filterCoeffs.begin())))
+    {
+        analysedCoeffs.assign(filterCoeffs.begin(), filterCoeffs.begin() + filterCoeffsLen);
+        analysis = firKernels::analyseCoeffs(&filterCoeffs[0], filterCoeffsLen);
+    }
+
+    // -- Apply the chosen filter coefficients to each sample and accumulate the value for
+    // -- each output sample, using the vectorised kernel selected for this processor and,
+    // -- when the coefficients are symmetric, antisymmetric or sparse, for their structure
+    if (analysis.structure == coeffStructure::general && analysis.defaultFilter < 0)
+    {
+        firKernels::applyDirect(&filterBuffer[0], &filterCoeffs[0], filterCoeffsLen, &outputSamples[0], inputSamples.size());
+    }
+    else
+    {
+        firKernels::applyAnalysed(&filterBuffer[0], analysis, &outputSamples[0], inputSamples.size());
+    }
+
+    // -- Move the last of the current sample batch to beginning of the filter buffer for
+    // -- the next batch of samples
+    for (uint64_t i = 0; i < (uint64_t)filterCoeffsLen - 1; i++)
+    {
+        filterBuffer[i] = filterBuffer[inputSamples.size() + i];
+    }
+
+    return outputSamples;
+}
+
+void firFilter::prepareFft(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint64_t batchLen)
+{
+    // -- Only recompute the spectrum when the coefficients have changed
+    if (fftCoeffs.size() == filterCoeffsLen && equal(fftCoeffs.begin(), fftCoeffs.end(), filterCoeffs.begin()))
+    {
+        return;
+    }
+    fftCoeffs.assign(filterCoeffs.begin(), filterCoeffs.begin() + filterCoeffsLen);
+
+    // -- Each block of fftSize samples produces fftSize - filterCoeffsLen + 1 output samples. Choose the
+    // -- fft size with the lowest cost for a batch of batchLen samples
+    vector<uint32_t> fftSizes = getFftSizes(filterCoeffsLen);
+    uint32_t bestSize = fftSizes[0];
+    double bestCost = -1;
+    for (uint32_t size : fftSizes)
+    {
+        uint64_t blocks = (max(batchLen, (uint64_t)1) + size - filterCoeffsLen) / (size - filterCoeffsLen + 1);
+        double cost = blocks * size * log2((double)size);
+        if (bestCost < 0 || cost < bestCost)
+        {
+            bestCost = cost;
+            bestSize = size;
+        }
+    }
+
+    fft.setSize(bestSize);
+    blockBuffer.resize(bestSize);
+    blockSpectrum.resize(bestSize / 2 + 1);
+    coeffsSpectrum.resize(bestSize / 2 + 1);
+
+    // -- Use the spectrum computed ahead of time if there is one for this fft size
+    const coeffPlan *plan = findPlan(filterCoeffs, filterCoeffsLen);
+    if (plan != NULL && plan->firstFftSize != 0)
+    {
+        for (uint64_t i = 0; i < plan->spectra.size(); i++)
+        {
+            if ((uint64_t)plan->firstFftSize << i == bestSize)
+            {
+                copy(plan->spectra[i], plan->spectra[i] + coeffsSpectrum.size(), coeffsSpectrum.begin());
+                return;
+            }
+        }
+    }
+
+    transformCoeffs(fft, fftCoeffs, filterCoeffsLen, blockBuffer, &coeffsSpectrum[0]);
+}
+
+void firFilter::transformCoeffs(fftTransform &fft, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, vector<double> &buffer, complex<double> *spectrum)
+{
+    uint32_t fftSize = fft.getSize();
+    fill(buffer.begin(), buffer.end(), 0);
+    copy(filterCoeffs.begin(), filterCoeffs.begin() + filterCoeffsLen, buffer.begin());
+    fft.forward(&buffer[0], spectrum);
+    for (uint32_t k = 0; k < fftSize / 2 + 1; k++)
+    {
+        spectrum[k] /= (double)fftSize;
+    }
+}
+
+vector<uint32_t> firFilter::getFftSizes(uint32_t filterCoeffsLen)
+{
+    // -- From the smallest power of 2 holding twice the coefficients, up to 16 times that size
+    uint32_t fftSize = 4;
+    while (fftSize < 2 * filterCoeffsLen)
+    {
+        fftSize <<= 1;
+    }
+
+    vector<uint32_t> fftSizes;
+    for (uint32_t size = fftSize; size <= 16 * fftSize && size <= (1u << 22); size <<= 1)
+    {
+        fftSizes.push_back(size);
+    }
+    if (fftSizes.empty())
+    {
+        fftSizes.push_back(fftSize);
+    }
+    return fftSizes;
+}
+
+vector<complex<double>> firFilter::computeCoeffsSpectrum(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t fftSize)
+{
+    fftTransform fft;
+    fft.setSize(fftSize);
+    vector<double> buffer(fftSize);
+    vector<complex<double>> spectrum(fftSize / 2 + 1);
+    transformCoeffs(fft, filterCoeffs, filterCoeffsLen, buffer, &spectrum[0]);
+    return spectrum;
+}
+
+vector<double> firFilter::applyFftFilter(const vector<double> &inputSamples, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen)
+{
+    vector<double> outputSamples; // -- Output vector
+    outputSamples.resize(inputSamples.size());
+
+    prepareFft(filterCoeffs, filterCoeffsLen, inputSamples.size());
+
+    uint64_t inputLen = inputSamples.size();
+    uint64_t historyLen = filterCoeffsLen - 1;
+    uint32_t fftSize = fft.getSize();
+    uint32_t blockOutputLen = fftSize - historyLen;
+
+    // -- Same buffer layout as the direct form: the history followed by the input samples
+    sampleBuffLen = inputLen;
+    filterBuffer.resize(historyLen + sampleBuffLen, 0);
+    for (uint64_t i = 0; i < inputLen; i++)
+    {
+        filterBuffer[historyLen + i] = inputSamples[i];
+    }
+
+    // -- Overlap-save: each block of fftSize buffer samples yields blockOutputLen valid output samples,
+    // -- the first historyLen samples of the circular convolution are discarded
+    for (uint64_t start = 0; start < inputLen; start += blockOutputLen)
+    {
+        uint64_t available = min((uint64_t)fftSize, historyLen + inputLen - start);
+        copy(filterBuffer.begin() + start, filterBuffer.begin() + start + available, blockBuffer.begin());
+        fill(blockBuffer.begin() + available, blockBuffer.end(), 0);
+
+        fft.forward(&blockBuffer[0], &blockSpectrum[0]);
+        for (uint32_t k = 0; k < blockSpectrum.size(); k++)
+        {
+            blockSpectrum[k] *= coeffsSpectrum[k];
+        }
+        fft.inverse(&blockSpectrum[0], &blockBuffer[0]);
+
+        uint64_t count = min((uint64_t)blockOutputLen, inputLen - start);
+        for (uint64_t i = 0; i < count; i++)
+        {
+            outputSamples[start + i] = blockBuffer[historyLen + i];
+        }
+    }
+
+    // -- Move the last of the current sample batch to beginning of the filter buffer for
+    // -- the next batch of samples
+    for (uint64_t i = 0; i < historyLen; i++)
+    {
+        filterBuffer[i] = filterBuffer[inputLen + i];
+    }
+
+    return outputSamples;
+}
+
+void firFilter::preparePartitions(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t partitionSize)
+{
+    // -- Only recompute the partition spectra when the coefficients or the partition size have changed
+    if (!(this->partitionSize == partitionSize && partitionCoeffs.size() == filterCoeffsLen &&
+          equal(partitionCoeffs.begin(), partitionCoeffs.end(), filterCoeffs.begin())))
+    {
+        partitionCoeffs.assign(filterCoeffs.begin(), filterCoeffs.begin() + filterCoeffsLen);
+        this->partitionSize = partitionSize;
+        partitionCount = (filterCoeffsLen + partitionSize - 1) / partitionSize;
+        partitionFft.setSize(2 * partitionSize);
+
+        // -- Transform each zero padded partition, folding in the normalisation of the inverse transform
+        vector<double> partitionBuffer(2 * partitionSize);
+        partitionSpectra.resize((uint64_t)partitionCount * (partitionSize + 1));
+        for (uint32_t p = 0; p < partitionCount; p++)
+        {
+            uint32_t start = p * partitionSize;
+            uint32_t count = min(partitionSize, filterCoeffsLen - start);
+
+            fill(partitionBuffer.begin(), partitionBuffer.end(), 0);
+            copy(partitionCoeffs.begin() + start, partitionCoeffs.begin() + start + count, partitionBuffer.begin());
+            partitionFft.forward(&partitionBuffer[0], &partitionSpectra[(uint64_t)p * (partitionSize + 1)]);
+        }
+        for (uint64_t k = 0; k < partitionSpectra.size(); k++)
+        {
+            partitionSpectra[k] /= (double)(2 * partitionSize);
+        }
+
+        delayLine.clear();
+    }
+
+    // -- Start with an empty history
+    if (delayLine.empty())
+    {
+        delayLine.assign((uint64_t)partitionCount * (partitionSize + 1), 0);
+        delayLineSum.assign(partitionSize + 1, 0);
+        partitionWindow.assign(2 * partitionSize, 0);
+        delayLineHead = 0;
+        partitionFill = 0;
+    }
+}
+
+void firFilter::startPartitionBlock()
+{
+    uint32_t bins = partitionSize + 1;
+
+    // -- The completed block becomes the previous block of the input window
+    copy(partitionWindow.begin() + partitionSize, partitionWindow.end(), partitionWindow.begin());
+    fill(partitionWindow.begin() + partitionSize, partitionWindow.end(), 0);
+    partitionFill = 0;
+
+    // -- The slot of the oldest block is reused for the new block
+    delayLineHead = (delayLineHead + 1) % partitionCount;
+    fill(delayLine.begin() + (uint64_t)delayLineHead * bins, delayLine.begin() + (uint64_t)(delayLineHead + 1) * bins, 0);
+
+    // -- Partition p is applied to the input block that is p blocks old
+    fill(delayLineSum.begin(), delayLineSum.end(), 0);
+    for (uint32_t p = 1; p < partitionCount; p++)
+    {
+        const complex<double> *block = &delayLine[(uint64_t)((delayLineHead + partitionCount - p) % partitionCount) * bins];
+        const complex<double> *spectrum = &partitionSpectra[(uint64_t)p * bins];
+        for (uint32_t k = 0; k < bins; k++)
+        {
+            delayLineSum[k] += block[k] * spectrum[k];
+        }
+    }
+}
+
+vector<double> firFilter::applyPartitionedFilter(const vector<double> &inputSamples, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t partitionSize)
+{
+    vector<double> outputSamples; // -- Output vector
+    outputSamples.resize(inputSamples.size());
+
+    preparePartitions(filterCoeffs, filterCoeffsLen, partitionSize);
+
+    uint32_t bins = partitionSize + 1;
+    vector<complex<double>> outputSpectrum(bins);
+    vector<double> outputBlock(2 * partitionSize);
+
+    // -- Fill the current input block. Each time new samples arrive the output of the current block is
+    // -- recomputed, so samples are output without waiting for the block to be complete
+    uint64_t pos = 0;
+    while (pos < inputSamples.size())
+    {
+        uint32_t count = (uint32_t)min((uint64_t)(partitionSize - partitionFill), inputSamples.size() - pos);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            partitionWindow[partitionSize + partitionFill + i] = inputSamples[pos + i];
+        }
+
+        complex<double> *block = &delayLine[(uint64_t)delayLineHead * bins];
+        partitionFft.forward(&partitionWindow[0], block);
+        for (uint32_t k = 0; k < bins; k++)
+        {
+            outputSpectrum[k] = delayLineSum[k] + block[k] * partitionSpectra[k];
+        }
+        partitionFft.inverse(&outputSpectrum[0], &outputBlock[0]);
+
+        // -- The second half of the circular convolution holds the valid output samples
+        for (uint32_t i = 0; i < count; i++)
+        {
+            outputSamples[pos + i] = outputBlock[partitionSize + partitionFill + i];
+        }
+
+        partitionFill += count;
+        pos += count;
+        if (partitionFill == partitionSize)
+        {
+            startPartitionBlock();
+        }
+    }
+
+    return outputSamples;
+}
+
+vector<double> firFilter::applyBestFilter(const vector<double> &inputSamples, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t samplesPerSecond, uint32_t partitionSize)
+{
+    // -- Long filters are cheaper to apply in the frequency domain
+    if (partitionSize > 0)
+    {
+        return applyPartitionedFilter(inputSamples, filterCoeffs, filterCoeffsLen, partitionSize);
+    }
+    else if (filterCoeffsLen >= firKernels::getFftCrossoverCoeffsLen())
+    {
+        return applyFftFilter(inputSamples, filterCoeffs, filterCoeffsLen);
+    }
+
+    return applyFirFilter(inputSamples, filterCoeffs, filterCoeffsLen, samplesPerSecond);
+}
+
+q15Coeffs firFilter::quantiseQ15(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, int32_t headroomBits)
+{
+    q15Coeffs quantised;
+    double maxCoeff = 0;
+    double sumCoeffs = 0;
+
+    for (uint32_t j = 0; j < filterCoeffsLen; j++)
+    {
+        maxCoeff = max(maxCoeff, fabs(filterCoeffs[j]));
+        sumCoeffs += fabs(filterCoeffs[j]);
+    }
+
+    if (headroomBits < 0)
+    {
+        // -- Every coefficient must fit in 16 bits, and the sum of all products of a 16 bit input with the
+        // -- coefficients must fit in the 32 bit accumulator
+        headroomBits = 0;
+        while (headroomBits < 15 && (ldexp(maxCoeff, 15 - headroomBits) > 32767.0 || ldexp(sumCoeffs, 15 - headroomBits) > 65535.0))
+        {
+            headroomBits++;
+        }
+    }
+    int32_t requestedBits = headroomBits;
+    headroomBits = min(headroomBits, (int32_t)15);
+
+    // -- The kernels accumulate in 32 bits, which holds the sum of the products of the quantised coefficients with
+    // -- any 16 bit input as long as the magnitudes of the quantised coefficients add up to at most 65535. Rounding
+    // -- can take the sum past the estimate above, so it is checked on the quantised coefficients
+    while (true)
+    {
+        quantised.shift = (uint32_t)(15 - headroomBits);
+
+        // -- Pad to an even number of coefficients, as the kernels use the coefficients in pairs.
+        // -- -32768 is avoided so that a pair of products can never overflow
+        quantised.coeffs.assign(filterCoeffsLen + (filterCoeffsLen % 2), 0);
+        uint64_t sumQuantised = 0;
+        for (uint32_t j = 0; j < filterCoeffsLen; j++)
+        {
+            double scaled = round(ldexp(filterCoeffs[j], (int)quantised.shift));
+            quantised.coeffs[j] = (int16_t)max(-32767.0, min(32767.0, scaled));
+            sumQuantised += (uint64_t)abs(quantised.coeffs[j]);
+        }
+
+        if (sumQuantised <= 65535 || headroomBits == 15)
+        {
+            break;
+        }
+        headroomBits++;
+    }
+
+    if (requestedBits >= 0 && headroomBits != min(requestedBits, (int32_t)15))
+    {
+        throw filterError("Error! a Q15 headroom of " + to_string(requestedBits) + " bits lets the 32 bit accumulator overflow for these coefficients. "
+                          "Please give --q15-headroom=" + to_string(headroomBits) + " or more, or leave it out to choose the headroom automatically");
+    }
+
+    return quantised;
+}
+
+vector<int16_t> firFilter::applyQ15Filter(const vector<int16_t> &inputSamples, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, int32_t headroomBits)
+{
+    vector<int16_t> outputSamples; // -- Output vector
+    outputSamples.resize(inputSamples.size());
+
+    // -- Only quantise again when the coefficients or the headroom have changed
+    if (!(q15HeadroomBits == headroomBits && q15SourceCoeffs.size() == filterCoeffsLen &&
+          equal(q15SourceCoeffs.begin(), q15SourceCoeffs.end(), filterCoeffs.begin())))
+    {
+        q15SourceCoeffs.assign(filterCoeffs.begin(), filterCoeffs.begin() + filterCoeffsLen);
+        q15HeadroomBits = headroomBits;
+
+        // -- Coefficients quantised ahead of time always have the headroom chosen automatically
+        const coeffPlan *plan = (headroomBits < 0) ? findPlan(filterCoeffs, filterCoeffsLen) : NULL;
+        if (plan != NULL && plan->q15Coeffs != NULL)
+        {
+            q15Quantised.coeffs.assign(plan->q15Coeffs, plan->q15Coeffs + plan->q15CoeffsLen);
+            q15Quantised.shift = plan->q15Shift;
+        }
+        else
+        {
+            q15Quantised = quantiseQ15(filterCoeffs, filterCoeffsLen, headroomBits);
+        }
+    }
+
+    if (inputSamples.empty())
+    {
+        return outputSamples;
+    }
+
+    // -- Same buffer layout as the direct form, with a history of the padded number of coefficients - 1
+    uint64_t historyLen = q15Quantised.coeffs.size() - 1;
+    q15Buffer.resize(historyLen + inputSamples.size(), 0);
+    copy(inputSamples.begin(), inputSamples.end(), q15Buffer.begin() + historyLen);
+
+    firKernels::applyQ15(&q15Buffer[0], &q15Quantised.coeffs[0], (uint32_t)q15Quantised.coeffs.size(), q15Quantised.shift, &outputSamples[0], inputSamples.size());
+
+    // -- Move the last of the current sample batch to beginning of the filter buffer for
+    // -- the next batch of samples
+    copy(q15Buffer.begin() + inputSamples.size(), q15Buffer.begin() + inputSamples.size() + historyLen, q15Buffer.begin());
+
+    return outputSamples;
+}
+
+uint32_t firFilter::getQ15Shift()
+{
+    return q15Quantised.shift;
+}
+
+void firFilter::setCoeffPlans(const vector<coeffPlan> *plans)
+{
+    coeffPlans = plans;
+}
+
+const coeffPlan *firFilter::findPlan(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen)
+{
+    if (coeffPlans == NULL)
+    {
+        return NULL;
+    }
+
+    // -- Filters are given copies of the coefficients, and fused filters have coefficients of their own,
+    // -- so the plans are matched by value
+    for (uint64_t i = 0; i < coeffPlans->size(); i++)
+    {
+        const coeffPlan &plan = (*coeffPlans)[i];
+        if (plan.coeffsLen == filterCoeffsLen && equal(filterCoeffs.begin(), filterCoeffs.begin() + filterCoeffsLen, plan.coeffs))
+        {
+            return &plan;
+        }
+    }
+    return NULL;
+}
@@ -1,67 +1,425 @@
-/**
- * @file firFilter.hpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief Class definition to create a fir filter 
- * 
- * This class initializes the fir filter and processes data given different filter coefficients
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-#pragma once
-
-#include <vector>
-#include <algorithm>
-#include <cstddef>
-#include <cstdint>
-#include "firFilter.hpp"
-
-using namespace std;
-
-class firFilter
-{
-public:
-    /**
-     * @brief Default constructor to create a new fir Filter object
-     * 
-     */
-    firFilter();
-
-    /**
-     * @brief Copy constructor
-     * 
-     * @param obj The source fir filter to be copied over
-     */
-    firFilter(const firFilter &obj);
-
-    /**
-     * @brief Process the input data with the chosen filter coefficients
-     * 
-     * Applies the fir filter to all input samples. The fir filter is configured to use the specified filter
-     * coefficients. The filter buffer used for processing is dependant on the number of input samples and 
-     * samples per second of the input audio file. Once each sample is processed, its stored in an output vector
-     * 
-     * @param inputSamples Vector of input samples to be processed
-     * @param filterCoeffs Specified coefficients used to configure the fir filter
-     * @param filterCoeffsLen Number of coefficients
-     * @param samplesPerSecond Samples per second of the input audio file 
-     * @return Vector of the processed output samples.
-     */
-    vector<int16_t> applyFirFilter(vector<int16_t> inputSamples, vector<double> filterCoeffs, uint16_t filterCoeffsLen, uint32_t samplesPerSecond);
-
-private:
-    /**
-     * @brief Buffer used for filtering
-     * 
-     */
-    vector<double> filterBuffer;
-
-    /**
-     * @brief Number of samples filtered per batch
-     * 
-     */
-    uint64_t sampleBuffLen;
-};
+/**
+ * @file firFilter.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition to create a fir filter 
+ * 
+ * This class initializes the fir filter and processes data given different filter coefficients
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#pragma once
+
+#include <vector>
+#include <complex>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "fftTransform.hpp"
+#include "firKernels.hpp"
+
+using namespace std;
+
+/**
+ * @brief Default partition size of the partitioned convolution
+ * 
+ */
+constexpr uint32_t Default_Partition_Size = 1024;
+
+/**
+ * @brief Filter coefficients quantised to Q15 fixed point
+ * 
+ */
+struct q15Coeffs
+{
+    /**
+     * @brief Quantised coefficients, padded with a zero to an even number of coefficients
+     * 
+     */
+    vector<int16_t> coeffs;
+
+    /**
+     * @brief Number of fractional bits, the value of a coefficient is coeffs[j] / 2^shift
+     * 
+     */
+    uint32_t shift = 15;
+};
+
+/**
+ * @brief Data derived from a set of filter coefficients ahead of time, such as stored in a coefficient bank,
+ * which a filter uses instead of computing it when it is given the same coefficients
+ * 
+ */
+struct coeffPlan
+{
+    /**
+     * @brief Coefficients the data was derived from
+     * 
+     */
+    const double *coeffs = NULL;
+    uint32_t coeffsLen = 0;
+
+    /**
+     * @brief Coefficients quantised to Q15 with the headroom chosen automatically, padded to an even number
+     * of coefficients, NULL if not stored
+     * 
+     */
+    const int16_t *q15Coeffs = NULL;
+    uint32_t q15CoeffsLen = 0;
+    uint32_t q15Shift = 15;
+
+    /**
+     * @brief Spectra of the coefficients for the fft sizes firstFftSize, 2 * firstFftSize and so on, scaled
+     * as for the fft based convolution, each of fft size / 2 + 1 bins
+     * 
+     */
+    uint32_t firstFftSize = 0;
+    vector<const complex<double> *> spectra;
+};
+
+class firFilter
+{
+public:
+    /**
+     * @brief Default constructor to create a new fir Filter object
+     * 
+     */
+    firFilter();
+
+    /**
+     * @brief Copy constructor
+     * 
+     * @param obj The source fir filter to be copied over
+     */
+    firFilter(const firFilter &obj);
+
+    /**
+     * @brief Clear the history of previously filtered samples
+     * 
+     * Must be called before filtering a new signal so that the samples of the previous signal
+     * do not leak into the start of the new one
+     * 
+     */
+    void reset();
+
+    /**
+     * @brief Process the input data with the chosen filter coefficients
+     * 
+     * Applies the fir filter to all input samples. The fir filter is configured to use the specified filter
+     * coefficients. The filter buffer used for processing is dependant on the number of input samples and 
+     * samples per second of the input audio file. Once each sample is processed, its stored in an output vector.
+     * The last samples of each batch are kept as the history for the next batch. The samples are not rounded,
+     * they are quantised when they are stored
+     * 
+     * @param inputSamples Vector of input samples to be processed
+     * @param filterCoeffs Specified coefficients used to configure the fir filter
+     * @param filterCoeffsLen Number of coefficients
+     * @param samplesPerSecond Samples per second of the input audio file 
+     * @return Vector of the processed output samples.
+     */
+    vector<double> applyFirFilter(const vector<double> &inputSamples, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t samplesPerSecond);
+
+    /**
+     * @brief Process the input data with the chosen filter coefficients using fft based convolution
+     * 
+     * Produces the same output as applyFirFilter using overlap-save block convolution in the frequency
+     * domain. The fft size is chosen from the number of coefficients and the spectrum of the coefficients
+     * is only recomputed when the coefficients change. Due to the different order of the floating point
+     * operations, an output sample can differ slightly from the direct form output, so that the stored
+     * samples differ by at most 1 (one least significant bit) when the value lies next to a rounding boundary
+     * 
+     * @param inputSamples Vector of input samples to be processed
+     * @param filterCoeffs Specified coefficients used to configure the fir filter
+     * @param filterCoeffsLen Number of coefficients
+     * @return Vector of the processed output samples.
+     */
+    vector<double> applyFftFilter(const vector<double> &inputSamples, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen);
+
+    /**
+     * @brief Process the input data with the chosen filter coefficients using uniformly partitioned convolution
+     * 
+     * The coefficients are split into partitions of partitionSize coefficients, each of which is applied
+     * in the frequency domain with an fft of 2 * partitionSize samples. The spectra of the previous input
+     * blocks are kept in a frequency domain delay line, so the fft size and scratch memory only depend on
+     * the partition size and not on the number of coefficients. The output is the same as applyFftFilter,
+     * within 1 least significant bit of the direct form output
+     * 
+     * @param inputSamples Vector of input samples to be processed
+     * @param filterCoeffs Specified coefficients used to configure the fir filter
+     * @param filterCoeffsLen Number of coefficients
+     * @param partitionSize Number of coefficients per partition, must be a power of 2 and at least 2
+     * @return Vector of the processed output samples.
+     */
+    vector<double> applyPartitionedFilter(const vector<double> &inputSamples, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t partitionSize);
+
+    /**
+     * @brief Process the input data with the convolution engine best suited to the chosen filter coefficients
+     * 
+     * Sets of at least firKernels::getFftCrossoverCoeffsLen() coefficients are applied with applyFftFilter and
+     * shorter sets with applyFirFilter, unless a partition size is given in which case applyPartitionedFilter
+     * is used. The same engine must be used for every batch of a signal, as each engine keeps its own history
+     * 
+     * @param inputSamples Vector of input samples to be processed
+     * @param filterCoeffs Specified coefficients used to configure the fir filter
+     * @param filterCoeffsLen Number of coefficients
+     * @param samplesPerSecond Samples per second of the input audio file
+     * @param partitionSize Partition size of the partitioned convolution, 0 to choose the engine from filterCoeffsLen
+     * @return Vector of the processed output samples.
+     */
+    vector<double> applyBestFilter(const vector<double> &inputSamples, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t samplesPerSecond, uint32_t partitionSize);
+
+    /**
+     * @brief Quantise a set of filter coefficients to Q15 fixed point
+     * 
+     * The coefficients are scaled by 2^(15 - headroomBits) and rounded. Without headroom bits, the smallest
+     * number of headroom bits is chosen for which no coefficient overflows 16 bits and the 32 bit accumulator
+     * cannot overflow for any 16 bit input. Headroom bits given that let the accumulator overflow are thrown
+     * as a filterError naming the smallest number of headroom bits that does not
+     * 
+     * @param filterCoeffs Specified coefficients used to configure the fir filter
+     * @param filterCoeffsLen Number of coefficients
+     * @param headroomBits Number of bits the coefficients are scaled below Q15, or -1 to choose automatically
+     * @return The quantised coefficients
+     */
+    static q15Coeffs quantiseQ15(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, int32_t headroomBits);
+
+    /**
+     * @brief Process the input data with the chosen filter coefficients in Q15 fixed point
+     * 
+     * The coefficients are quantised with quantiseQ15 and the convolution is done with 16 x 16 bit
+     * multiplies accumulated in 32 bits, keeping the samples as 16 bit integers throughout. The output
+     * is saturated to 16 bits
+     * 
+     * @param inputSamples Vector of input samples to be processed
+     * @param filterCoeffs Specified coefficients used to configure the fir filter
+     * @param filterCoeffsLen Number of coefficients
+     * @param headroomBits Number of bits the coefficients are scaled below Q15, or -1 to choose automatically
+     * @return Vector of the processed output samples.
+     */
+    vector<int16_t> applyQ15Filter(const vector<int16_t> &inputSamples, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, int32_t headroomBits);
+
+    /**
+     * @brief Gets the number of fractional bits of the coefficients last used by applyQ15Filter
+     * 
+     * @return Returns the shift of the quantised coefficients
+     */
+    uint32_t getQ15Shift();
+
+    /**
+     * @brief Set the data derived ahead of time that every fir filter uses for the coefficients it matches
+     * 
+     * The plans are only read, they must be set before filtering starts and stay valid while filtering
+     * 
+     * @param plans Plans of the sets of coefficients, NULL to derive everything when it is needed
+     */
+    static void setCoeffPlans(const vector<coeffPlan> *plans);
+
+    /**
+     * @brief Gets the fft sizes the fft based convolution chooses from for a number of coefficients
+     * 
+     * @param filterCoeffsLen Number of coefficients
+     * @return The fft sizes, from the smallest, each twice the previous one
+     */
+    static vector<uint32_t> getFftSizes(uint32_t filterCoeffsLen);
+
+    /**
+     * @brief Compute the spectrum of the coefficients used by the fft based convolution
+     * 
+     * @param filterCoeffs Specified coefficients used to configure the fir filter
+     * @param filterCoeffsLen Number of coefficients
+     * @param fftSize Size of the fft, one of the sizes of getFftSizes
+     * @return The fftSize / 2 + 1 bins of the spectrum, already scaled for the inverse transform
+     */
+    static vector<complex<double>> computeCoeffsSpectrum(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t fftSize);
+
+private:
+    /**
+     * @brief Find the plan set with setCoeffPlans for a set of coefficients
+     * 
+     * @param filterCoeffs Specified coefficients used to configure the fir filter
+     * @param filterCoeffsLen Number of coefficients
+     * @return The plan of the coefficients, NULL if there is none
+     */
+    static const coeffPlan *findPlan(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen);
+
+    /**
+     * @brief Transform the zero padded coefficients, folding in the normalisation of the inverse transform
+     * 
+     * @param fft Transform of the fft size
+     * @param filterCoeffs Specified coefficients used to configure the fir filter
+     * @param filterCoeffsLen Number of coefficients
+     * @param buffer Time domain scratch buffer of the fft size
+     * @param spectrum Receives the fft size / 2 + 1 bins of the spectrum
+     */
+    static void transformCoeffs(fftTransform &fft, const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, vector<double> &buffer, complex<double> *spectrum);
+
+    /**
+     * @brief Prepare the fft and the spectrum of the filter coefficients
+     * 
+     * The fft size is chosen for the length of the first batch filtered with the coefficients
+     * 
+     * @param filterCoeffs Specified coefficients used to configure the fir filter
+     * @param filterCoeffsLen Number of coefficients
+     * @param batchLen Number of samples in the batch to be filtered
+     */
+    void prepareFft(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint64_t batchLen);
+
+    /**
+     * @brief Prepare the spectra of the coefficient partitions and clear the frequency domain delay line
+     * 
+     * @param filterCoeffs Specified coefficients used to configure the fir filter
+     * @param filterCoeffsLen Number of coefficients
+     * @param partitionSize Number of coefficients per partition
+     */
+    void preparePartitions(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t partitionSize);
+
+    /**
+     * @brief Start a new input block of the partitioned convolution
+     * 
+     * Advances the frequency domain delay line and sums the contribution of all but the first
+     * partition, as those only depend on previous, complete input blocks
+     * 
+     */
+    void startPartitionBlock();
+
+    /**
+     * @brief Buffer used for filtering
+     * 
+     */
+    vector<double> filterBuffer;
+
+    /**
+     * @brief Number of samples filtered per batch
+     * 
+     */
+    uint64_t sampleBuffLen;
+
+    /**
+     * @brief Coefficients the analysis was computed for
+     * 
+     */
+    vector<double> analysedCoeffs;
+
+    /**
+     * @brief Structure of the coefficients used by applyFirFilter
+     * 
+     */
+    coeffAnalysis analysis;
+
+    /**
+     * @brief Transform used by the fft based convolution
+     * 
+     */
+    fftTransform fft;
+
+    /**
+     * @brief Coefficients the spectrum was computed for
+     * 
+     */
+    vector<double> fftCoeffs;
+
+    /**
+     * @brief Spectrum of the coefficients, already scaled for the inverse transform
+     * 
+     */
+    vector<complex<double>> coeffsSpectrum;
+
+    /**
+     * @brief Spectrum of the current input block
+     * 
+     */
+    vector<complex<double>> blockSpectrum;
+
+    /**
+     * @brief Time domain scratch buffer of one fft block
+     * 
+     */
+    vector<double> blockBuffer;
+
+    /**
+     * @brief Transform used by the partitioned convolution
+     * 
+     */
+    fftTransform partitionFft;
+
+    /**
+     * @brief Coefficients the partition spectra were computed for
+     * 
+     */
+    vector<double> partitionCoeffs;
+
+    /**
+     * @brief Number of coefficients per partition
+     * 
+     */
+    uint32_t partitionSize;
+
+    /**
+     * @brief Number of partitions
+     * 
+     */
+    uint32_t partitionCount;
+
+    /**
+     * @brief Spectra of the coefficient partitions, partitionSize + 1 bins each
+     * 
+     */
+    vector<complex<double>> partitionSpectra;
+
+    /**
+     * @brief Frequency domain delay line holding the spectra of the last partitionCount input blocks
+     * 
+     */
+    vector<complex<double>> delayLine;
+
+    /**
+     * @brief Position of the current input block in the delay line
+     * 
+     */
+    uint32_t delayLineHead;
+
+    /**
+     * @brief Summed contribution of the previous input blocks to the current output block
+     * 
+     */
+    vector<complex<double>> delayLineSum;
+
+    /**
+     * @brief The previous input block followed by the current, partly filled, input block
+     * 
+     */
+    vector<double> partitionWindow;
+
+    /**
+     * @brief Number of samples in the current input block
+     * 
+     */
+    uint32_t partitionFill;
+
+    /**
+     * @brief Buffer used for fixed point filtering, holding the history followed by the input samples
+     * 
+     */
+    vector<int16_t> q15Buffer;
+
+    /**
+     * @brief Coefficients the quantised coefficients were computed for
+     * 
+     */
+    vector<double> q15SourceCoeffs;
+
+    /**
+     * @brief Headroom bits the quantised coefficients were computed with
+     * 
+     */
+    int32_t q15HeadroomBits;
+
+    /**
+     * @brief Quantised coefficients used by applyQ15Filter
+     * 
+     */
+    q15Coeffs q15Quantised;
+};
@@ -0,0 +1,473 @@
+/**
+ * @file firKernels.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the vectorised fir filter kernels
+ *
+ * Each instruction set defines its vector type and arithmetic in its own namespace and then includes
+ * firKernels.inl, so the kernels themselves are only written once. The instruction set is enabled per
+ * function with the target attribute, which lets the compiler use it without enabling it for the rest
+ * of the program.
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <cmath>
+#include <algorithm>
+#include "firKernels.hpp"
+#include "filterError.hpp"
+#include "defaultFilterCoeffs.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIR_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/**
+ * @brief Checks at compile time if a table of coefficients is equal to its mirror image
+ *
+ * @param coeffs Table of coefficients
+ * @return True if the coefficients are symmetric
+ */
+template <size_t CoeffsLen>
+constexpr bool isSymmetric(const array<double, CoeffsLen> &coeffs)
+{
+    for (size_t j = 0; j < CoeffsLen; j++)
+    {
+        if (coeffs[j] != coeffs[CoeffsLen - 1 - j])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Signature of the kernels instantiated for the default filters
+ *
+ */
+typedef void (*defaultFilterKernel)(const double *buffer, double *output, uint64_t count);
+
+namespace scalarKernels
+{
+#define SIMD_TARGET
+#define SIMD_INT16_LANES 1
+    constexpr uint32_t Lanes = 1;
+    typedef double vecD;
+
+    static inline vecD zero() { return 0.0; }
+    static inline vecD set1(double value) { return value; }
+    static inline vecD load(const double *p) { return *p; }
+    static inline vecD add(vecD a, vecD b) { return a + b; }
+    static inline vecD sub(vecD a, vecD b) { return a - b; }
+    static inline vecD mul(vecD a, vecD b) { return a * b; }
+    static inline vecD mulAdd(vecD a, vecD b, vecD c) { return a * b + c; }
+    static inline void store(vecD v, double *output) { *output = v; }
+
+#include "firKernels.inl"
+#undef SIMD_TARGET
+#undef SIMD_INT16_LANES
+}
+
+#ifdef FIR_KERNELS_X86
+namespace sse2Kernels
+{
+#define SIMD_TARGET __attribute__((target("sse2")))
+    constexpr uint32_t Lanes = 2;
+    typedef __m128d vecD;
+
+    SIMD_TARGET static inline vecD zero() { return _mm_setzero_pd(); }
+    SIMD_TARGET static inline vecD set1(double value) { return _mm_set1_pd(value); }
+    SIMD_TARGET static inline vecD load(const double *p) { return _mm_loadu_pd(p); }
+    SIMD_TARGET static inline vecD add(vecD a, vecD b) { return _mm_add_pd(a, b); }
+    SIMD_TARGET static inline vecD sub(vecD a, vecD b) { return _mm_sub_pd(a, b); }
+    SIMD_TARGET static inline vecD mul(vecD a, vecD b) { return _mm_mul_pd(a, b); }
+    SIMD_TARGET static inline vecD mulAdd(vecD a, vecD b, vecD c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+
+    SIMD_TARGET static inline void store(vecD v, double *output) { _mm_storeu_pd(output, v); }
+
+#define SIMD_INT16_LANES 8
+    typedef __m128i vecI;
+
+    SIMD_TARGET static inline vecI zeroI() { return _mm_setzero_si128(); }
+    SIMD_TARGET static inline vecI loadI(const int16_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+    SIMD_TARGET static inline vecI addI(vecI a, vecI b) { return _mm_add_epi32(a, b); }
+    SIMD_TARGET static inline vecI setPair(int16_t a, int16_t b) { return _mm_set1_epi32((int32_t)(uint16_t)a | ((int32_t)b << 16)); }
+    SIMD_TARGET static inline vecI unpackLo(vecI a, vecI b) { return _mm_unpacklo_epi16(a, b); }
+    SIMD_TARGET static inline vecI unpackHi(vecI a, vecI b) { return _mm_unpackhi_epi16(a, b); }
+    SIMD_TARGET static inline vecI mulAddPairs(vecI a, vecI b) { return _mm_madd_epi16(a, b); }
+
+    SIMD_TARGET static inline void storeQ15(vecI lo, vecI hi, uint32_t shift, int16_t *output)
+    {
+        __m128i rounding = _mm_set1_epi32(shift > 0 ? (1 << (shift - 1)) : 0);
+        __m128i count = _mm_cvtsi32_si128((int32_t)shift);
+        lo = _mm_sra_epi32(_mm_add_epi32(lo, rounding), count);
+        hi = _mm_sra_epi32(_mm_add_epi32(hi, rounding), count);
+        _mm_storeu_si128((__m128i *)output, _mm_packs_epi32(lo, hi));
+    }
+
+#include "firKernels.inl"
+#undef SIMD_TARGET
+#undef SIMD_INT16_LANES
+}
+
+namespace avx2Kernels
+{
+#define SIMD_TARGET __attribute__((target("avx2,fma")))
+    constexpr uint32_t Lanes = 4;
+    typedef __m256d vecD;
+
+    SIMD_TARGET static inline vecD zero() { return _mm256_setzero_pd(); }
+    SIMD_TARGET static inline vecD set1(double value) { return _mm256_set1_pd(value); }
+    SIMD_TARGET static inline vecD load(const double *p) { return _mm256_loadu_pd(p); }
+    SIMD_TARGET static inline vecD add(vecD a, vecD b) { return _mm256_add_pd(a, b); }
+    SIMD_TARGET static inline vecD sub(vecD a, vecD b) { return _mm256_sub_pd(a, b); }
+    SIMD_TARGET static inline vecD mul(vecD a, vecD b) { return _mm256_mul_pd(a, b); }
+    SIMD_TARGET static inline vecD mulAdd(vecD a, vecD b, vecD c) { return _mm256_fmadd_pd(a, b, c); }
+
+    SIMD_TARGET static inline void store(vecD v, double *output) { _mm256_storeu_pd(output, v); }
+
+#define SIMD_INT16_LANES 16
+    typedef __m256i vecI;
+
+    SIMD_TARGET static inline vecI zeroI() { return _mm256_setzero_si256(); }
+    SIMD_TARGET static inline vecI loadI(const int16_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+    SIMD_TARGET static inline vecI addI(vecI a, vecI b) { return _mm256_add_epi32(a, b); }
+    SIMD_TARGET static inline vecI setPair(int16_t a, int16_t b) { return _mm256_set1_epi32((int32_t)(uint16_t)a | ((int32_t)b << 16)); }
+    SIMD_TARGET static inline vecI unpackLo(vecI a, vecI b) { return _mm256_unpacklo_epi16(a, b); }
+    SIMD_TARGET static inline vecI unpackHi(vecI a, vecI b) { return _mm256_unpackhi_epi16(a, b); }
+    SIMD_TARGET static inline vecI mulAddPairs(vecI a, vecI b) { return _mm256_madd_epi16(a, b); }
+
+    SIMD_TARGET static inline void storeQ15(vecI lo, vecI hi, uint32_t shift, int16_t *output)
+    {
+        // -- The unpack and pack instructions both work within 128 bit lanes, so the pack restores the sample order
+        __m256i rounding = _mm256_set1_epi32(shift > 0 ? (1 << (shift - 1)) : 0);
+        __m128i count = _mm_cvtsi32_si128((int32_t)shift);
+        lo = _mm256_sra_epi32(_mm256_add_epi32(lo, rounding), count);
+        hi = _mm256_sra_epi32(_mm256_add_epi32(hi, rounding), count);
+        _mm256_storeu_si256((__m256i *)output, _mm256_packs_epi32(lo, hi));
+    }
+
+#include "firKernels.inl"
+#undef SIMD_TARGET
+#undef SIMD_INT16_LANES
+}
+
+namespace avx512Kernels
+{
+#define SIMD_TARGET __attribute__((target("avx512f,avx512vl,avx512bw,fma")))
+    constexpr uint32_t Lanes = 8;
+    typedef __m512d vecD;
+
+    SIMD_TARGET static inline vecD zero() { return _mm512_setzero_pd(); }
+    SIMD_TARGET static inline vecD set1(double value) { return _mm512_set1_pd(value); }
+    SIMD_TARGET static inline vecD load(const double *p) { return _mm512_loadu_pd(p); }
+    SIMD_TARGET static inline vecD add(vecD a, vecD b) { return _mm512_add_pd(a, b); }
+    SIMD_TARGET static inline vecD sub(vecD a, vecD b) { return _mm512_sub_pd(a, b); }
+    SIMD_TARGET static inline vecD mul(vecD a, vecD b) { return _mm512_mul_pd(a, b); }
+    SIMD_TARGET static inline vecD mulAdd(vecD a, vecD b, vecD c) { return _mm512_fmadd_pd(a, b, c); }
+
+    SIMD_TARGET static inline void store(vecD v, double *output) { _mm512_storeu_pd(output, v); }
+
+#define SIMD_INT16_LANES 32
+    typedef __m512i vecI;
+
+    SIMD_TARGET static inline vecI zeroI() { return _mm512_setzero_si512(); }
+    SIMD_TARGET static inline vecI loadI(const int16_t *p) { return _mm512_loadu_si512((const void *)p); }
+    SIMD_TARGET static inline vecI addI(vecI a, vecI b) { return _mm512_add_epi32(a, b); }
+    SIMD_TARGET static inline vecI setPair(int16_t a, int16_t b) { return _mm512_set1_epi32((int32_t)(uint16_t)a | ((int32_t)b << 16)); }
+    SIMD_TARGET static inline vecI unpackLo(vecI a, vecI b) { return _mm512_unpacklo_epi16(a, b); }
+    SIMD_TARGET static inline vecI unpackHi(vecI a, vecI b) { return _mm512_unpackhi_epi16(a, b); }
+    SIMD_TARGET static inline vecI mulAddPairs(vecI a, vecI b) { return _mm512_madd_epi16(a, b); }
+
+    SIMD_TARGET static inline void storeQ15(vecI lo, vecI hi, uint32_t shift, int16_t *output)
+    {
+        // -- The unpack and pack instructions both work within 128 bit lanes, so the pack restores the sample order.
+        // -- As for the conversions above, the zero masked shift avoids false uninitialised warnings in GCC
+        __m512i rounding = _mm512_set1_epi32(shift > 0 ? (1 << (shift - 1)) : 0);
+        __m128i count = _mm_cvtsi32_si128((int32_t)shift);
+        lo = _mm512_maskz_sra_epi32(0xFFFF, _mm512_add_epi32(lo, rounding), count);
+        hi = _mm512_maskz_sra_epi32(0xFFFF, _mm512_add_epi32(hi, rounding), count);
+        _mm512_storeu_si512((void *)output, _mm512_packs_epi32(lo, hi));
+    }
+
+#include "firKernels.inl"
+#undef SIMD_TARGET
+#undef SIMD_INT16_LANES
+}
+#endif
+
+/**
+ * @brief Signature of the direct form fir kernels
+ *
+ */
+typedef void (*directKernel)(const double *buffer, const double *coeffs, uint32_t coeffsLen, double *output, uint64_t count);
+
+/**
+ * @brief Signature of the fir kernels specialised for the structure of the coefficients
+ *
+ */
+typedef void (*analysedKernel)(const double *buffer, const coeffAnalysis &analysis, double *output, uint64_t count);
+
+/**
+ * @brief Signature of the Q15 fixed point fir kernels
+ *
+ */
+typedef void (*q15Kernel)(const int16_t *buffer, const int16_t *coeffs, uint32_t coeffsLen, uint32_t shift, int16_t *output, uint64_t count);
+
+/**
+ * @brief Instruction set of the selected kernels
+ *
+ */
+static simdLevel selectedLevel = simdLevel::scalar;
+
+/**
+ * @brief Selected direct form kernel
+ *
+ */
+static directKernel selectedDirectKernel = scalarKernels::applyDirect;
+
+/**
+ * @brief Selected kernel for folded (symmetric, antisymmetric and half-band) coefficients
+ *
+ */
+static analysedKernel selectedFoldedKernel = scalarKernels::applyFolded;
+
+/**
+ * @brief Selected kernel for sparse coefficients
+ *
+ */
+static analysedKernel selectedSparseKernel = scalarKernels::applySparse;
+
+/**
+ * @brief Selected kernels of the default filters
+ *
+ */
+static const defaultFilterKernel *selectedDefaultFilterKernels = scalarKernels::defaultFilterKernels;
+
+/**
+ * @brief Selected Q15 fixed point kernel
+ *
+ */
+static q15Kernel selectedQ15Kernel = scalarKernels::applyQ15;
+
+/**
+ * @brief Selects the best kernels when the program starts
+ *
+ */
+static const bool kernelsInitialised = (firKernels::setSimdLevel(firKernels::detectSimdLevel()), true);
+
+simdLevel firKernels::detectSimdLevel()
+{
+#ifdef FIR_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512bw"))
+    {
+        return simdLevel::avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return simdLevel::avx2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return simdLevel::sse2;
+    }
+#endif
+    return simdLevel::scalar;
+}
+
+void firKernels::setSimdLevel(simdLevel level)
+{
+    // -- Never select an instruction set the processor does not support
+    simdLevel supported = detectSimdLevel();
+    if (level > supported)
+    {
+        throw filterError("Error! The processor does not support the " + getSimdLevelName(level) +
+                          " instruction set. Please give --simd=" + getSimdLevelName(supported) + " or lower");
+    }
+
+    selectedLevel = level;
+    switch (level)
+    {
+#ifdef FIR_KERNELS_X86
+    case simdLevel::avx512:
+        selectedDirectKernel = avx512Kernels::applyDirect;
+        selectedFoldedKernel = avx512Kernels::applyFolded;
+        selectedSparseKernel = avx512Kernels::applySparse;
+        selectedDefaultFilterKernels = avx512Kernels::defaultFilterKernels;
+        selectedQ15Kernel = avx512Kernels::applyQ15;
+        break;
+    case simdLevel::avx2:
+        selectedDirectKernel = avx2Kernels::applyDirect;
+        selectedFoldedKernel = avx2Kernels::applyFolded;
+        selectedSparseKernel = avx2Kernels::applySparse;
+        selectedDefaultFilterKernels = avx2Kernels::defaultFilterKernels;
+        selectedQ15Kernel = avx2Kernels::applyQ15;
+        break;
+    case simdLevel::sse2:
+        selectedDirectKernel = sse2Kernels::applyDirect;
+        selectedFoldedKernel = sse2Kernels::applyFolded;
+        selectedSparseKernel = sse2Kernels::applySparse;
+        selectedDefaultFilterKernels = sse2Kernels::defaultFilterKernels;
+        selectedQ15Kernel = sse2Kernels::applyQ15;
+        break;
+#endif
+    default:
+        selectedLevel = simdLevel::scalar;
+        selectedDirectKernel = scalarKernels::applyDirect;
+        selectedFoldedKernel = scalarKernels::applyFolded;
+        selectedSparseKernel = scalarKernels::applySparse;
+        selectedDefaultFilterKernels = scalarKernels::defaultFilterKernels;
+        selectedQ15Kernel = scalarKernels::applyQ15;
+        break;
+    }
+}
+
+simdLevel firKernels::getSimdLevel()
+{
+    return selectedLevel;
+}
+
+string firKernels::getSimdLevelName(simdLevel level)
+{
+    switch (level)
+    {
+    case simdLevel::avx512:
+        return "avx512";
+    case simdLevel::avx2:
+        return "avx2";
+    case simdLevel::sse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+uint32_t firKernels::getFftCrossoverCoeffsLen()
+{
+    // -- Measured with the one second batches used by wavFile
+    switch (selectedLevel)
+    {
+    case simdLevel::avx512:
+        return 512;
+    case simdLevel::avx2:
+        return 256;
+    case simdLevel::sse2:
+        return 128;
+    default:
+        return 64;
+    }
+}
+
+void firKernels::applyDirect(const double *buffer, const double *coeffs, uint32_t coeffsLen, double *output, uint64_t count)
+{
+    selectedDirectKernel(buffer, coeffs, coeffsLen, output, count);
+}
+
+coeffAnalysis firKernels::analyseCoeffs(const double *coeffs, uint32_t coeffsLen)
+{
+    coeffAnalysis analysis;
+    bool symmetric = true;
+    bool antisymmetric = true;
+    uint32_t nonZero = 0;
+
+    analysis.coeffsLen = coeffsLen;
+
+    // -- Default filters have a kernel of their own
+    for (uint32_t k = 0; k < Default_Filter_Count; k++)
+    {
+        if (coeffsLen == Default_Filter_Coeffs_Len && equal(defaultFilters[k]->begin(), defaultFilters[k]->end(), coeffs))
+        {
+            analysis.defaultFilter = (int32_t)k;
+        }
+    }
+
+    for (uint32_t j = 0; j < coeffsLen; j++)
+    {
+        symmetric = symmetric && coeffs[j] == coeffs[coeffsLen - 1 - j];
+        antisymmetric = antisymmetric && coeffs[j] == -coeffs[coeffsLen - 1 - j];
+        nonZero += coeffs[j] != 0.0;
+    }
+
+    // -- A single coefficient is not worth folding
+    if (coeffsLen > 1 && (symmetric || antisymmetric))
+    {
+        analysis.structure = symmetric ? coeffStructure::symmetric : coeffStructure::antisymmetric;
+
+        // -- The centre tap of an odd length set has no mirror image, for antisymmetric sets it is 0
+        if (coeffsLen % 2 == 1)
+        {
+            analysis.centreCoeff = coeffs[coeffsLen / 2];
+        }
+
+        bool halfBand = symmetric && coeffsLen % 2 == 1 && coeffsLen >= 7;
+        for (uint32_t j = 0; j < coeffsLen / 2; j++)
+        {
+            if (coeffs[j] != 0.0)
+            {
+                analysis.taps.push_back(j);
+                analysis.tapCoeffs.push_back(coeffs[j]);
+            }
+
+            // -- Every second tap from the centre of a half-band filter is zero
+            if ((coeffsLen / 2 - j) % 2 == 0 && coeffs[j] != 0.0)
+            {
+                halfBand = false;
+            }
+        }
+
+        if (halfBand)
+        {
+            analysis.structure = coeffStructure::halfBand;
+        }
+        return analysis;
+    }
+
+    if (nonZero <= coeffsLen / 2)
+    {
+        analysis.structure = coeffStructure::sparse;
+        for (uint32_t j = 0; j < coeffsLen; j++)
+        {
+            if (coeffs[j] != 0.0)
+            {
+                analysis.taps.push_back(j);
+                analysis.tapCoeffs.push_back(coeffs[j]);
+            }
+        }
+    }
+
+    return analysis;
+}
+
+void firKernels::applyAnalysed(const double *buffer, const coeffAnalysis &analysis, double *output, uint64_t count)
+{
+    if (analysis.defaultFilter >= 0)
+    {
+        selectedDefaultFilterKernels[analysis.defaultFilter](buffer, output, count);
+        return;
+    }
+
+    switch (analysis.structure)
+    {
+    case coeffStructure::symmetric:
+    case coeffStructure::antisymmetric:
+    case coeffStructure::halfBand:
+        selectedFoldedKernel(buffer, analysis, output, count);
+        break;
+    case coeffStructure::sparse:
+        selectedSparseKernel(buffer, analysis, output, count);
+        break;
+    default:
+        break;
+    }
+}
+
+void firKernels::applyQ15(const int16_t *buffer, const int16_t *coeffs, uint32_t coeffsLen, uint32_t shift, int16_t *output, uint64_t count)
+{
+    selectedQ15Kernel(buffer, coeffs, coeffsLen, shift, output, count);
+}
@@ -0,0 +1,206 @@
+/**
+ * @file firKernels.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition for the vectorised fir filter kernels
+ *
+ * This class selects the fastest implementation of the direct form fir convolution that is supported
+ * by the processor the program runs on. Kernels are provided for plain C++, SSE2, AVX2 with FMA and
+ * AVX-512 (F, VL and BW), both for double precision and for Q15 fixed point coefficients. The selection is done once at startup using CPUID, so one executable runs on every processor
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @brief Instruction set used by the fir kernels
+ *
+ */
+enum class simdLevel
+{
+    scalar,
+    sse2,
+    avx2,
+    avx512
+};
+
+/**
+ * @brief Structure of a set of filter coefficients
+ *
+ */
+enum class coeffStructure
+{
+    general,
+    symmetric,
+    antisymmetric,
+    halfBand,
+    sparse
+};
+
+/**
+ * @brief Result of analysing a set of filter coefficients, used to pick the specialised kernel
+ *
+ */
+struct coeffAnalysis
+{
+    /**
+     * @brief Structure of the coefficients
+     *
+     */
+    coeffStructure structure = coeffStructure::general;
+
+    /**
+     * @brief Number of coefficients
+     *
+     */
+    uint32_t coeffsLen = 0;
+
+    /**
+     * @brief Taps that are multiplied. For the folded structures (symmetric, antisymmetric and half-band) only the
+     *        non-zero taps of the first half, each of which is applied to the sample at tap j and at tap coeffsLen - 1 - j.
+     *        For the sparse structure every non-zero tap
+     *
+     */
+    vector<uint32_t> taps;
+
+    /**
+     * @brief Coefficients of the taps
+     *
+     */
+    vector<double> tapCoeffs;
+
+    /**
+     * @brief Coefficient of the centre tap of folded structures with an odd number of coefficients, otherwise 0
+     *
+     */
+    double centreCoeff = 0;
+
+    /**
+     * @brief Index of the default filter in defaultFilters with the same coefficients, otherwise -1
+     *
+     */
+    int32_t defaultFilter = -1;
+};
+
+class firKernels
+{
+public:
+    /**
+     * @brief Finds the best instruction set supported by the processor
+     *
+     * @return The best supported simdLevel
+     */
+    static simdLevel detectSimdLevel();
+
+    /**
+     * @brief Selects the kernels of the given instruction set
+     *
+     * An instruction set the processor does not support is thrown as a filterError, leaving the
+     * selected kernels unchanged
+     *
+     * @param level Requested instruction set
+     */
+    static void setSimdLevel(simdLevel level);
+
+    /**
+     * @brief Gets the instruction set of the selected kernels
+     *
+     * @return Returns the selected simdLevel
+     */
+    static simdLevel getSimdLevel();
+
+    /**
+     * @brief Gets the name of an instruction set
+     *
+     * @param level Instruction set
+     * @return Name of the instruction set as used on the command line
+     */
+    static string getSimdLevelName(simdLevel level);
+
+    /**
+     * @brief Gets the number of filter coefficients from which the fft based convolution is used
+     *
+     * Below this number of coefficients the selected direct form kernel is faster than the fft based
+     * convolution. The wider the vectors of the instruction set, the later the crossover
+     *
+     * @return Number of coefficients
+     */
+    static uint32_t getFftCrossoverCoeffsLen();
+
+    /**
+     * @brief Direct form fir convolution
+     *
+     * Computes count output samples, where output sample i is the sum of coeffs[j] * buffer[coeffsLen - 1 + i - j]
+     * for every coefficient j. The buffer therefore holds coeffsLen - 1 history samples followed by the count
+     * input samples. Several output samples are computed at once, each with the coefficients applied in the same
+     * order as the plain C++ kernel. The SSE2 kernel gives the same output as the plain C++ kernel, the AVX2 and
+     * AVX-512 kernels use fused multiply-adds, which round less often, so once the output is quantised to
+     * samples it can differ by 1 least significant bit when the accumulated value lies next to a rounding boundary
+     *
+     * @param buffer History followed by the input samples
+     * @param coeffs Filter coefficients
+     * @param coeffsLen Number of coefficients
+     * @param output Array of count output samples
+     * @param count Number of output samples
+     */
+    static void applyDirect(const double *buffer, const double *coeffs, uint32_t coeffsLen, double *output, uint64_t count);
+
+    /**
+     * @brief Classifies a set of filter coefficients
+     *
+     * Coefficients equal to their mirror image are symmetric, and antisymmetric if equal to the negative of
+     * their mirror image (linear phase designs are one of these). Symmetric sets with an odd number of
+     * coefficients where every second tap from the centre is zero are half-band. Other sets where at most
+     * half of the coefficients are non-zero are sparse
+     *
+     * @param coeffs Filter coefficients
+     * @param coeffsLen Number of coefficients
+     * @return The structure of the coefficients along with the taps the specialised kernels multiply
+     */
+    static coeffAnalysis analyseCoeffs(const double *coeffs, uint32_t coeffsLen);
+
+    /**
+     * @brief Direct form fir convolution using the structure of the coefficients
+     *
+     * Same as applyDirect, with a kernel specialised for the structure found by analyseCoeffs. The folded kernel
+     * adds (or subtracts) the two samples sharing a coefficient before multiplying, halving the number of
+     * multiplies, and skips zero taps. The sparse kernel only multiplies the non-zero taps. As the products are
+     * accumulated in a different order, the quantised output can differ from applyDirect by 1 least significant
+     * bit when the accumulated value lies next to a rounding boundary. The default filters use kernels compiled for
+     * their coefficients, which give the same output as the kernel for their structure
+     *
+     * @param buffer History followed by the input samples
+     * @param analysis Analysis of the filter coefficients
+     * @param output Array of count output samples
+     * @param count Number of output samples
+     */
+    static void applyAnalysed(const double *buffer, const coeffAnalysis &analysis, double *output, uint64_t count);
+
+    /**
+     * @brief Direct form fir convolution in Q15 fixed point
+     *
+     * Computes count output samples, where output sample i is the sum of coeffs[j] * buffer[coeffsLen - 1 + i - j]
+     * for every coefficient j, shifted right by shift bits with rounding and saturated to 16 bits. The products
+     * are 16 x 16 bit multiplies accumulated in 32 bits, two coefficients at a time (pmaddwd), so coeffsLen must
+     * be even and no coefficient may be -32768. All kernels give the same output as long as the 32 bit
+     * accumulators do not overflow
+     *
+     * @param buffer History followed by the input samples
+     * @param coeffs Quantised filter coefficients
+     * @param coeffsLen Number of coefficients, must be even
+     * @param shift Number of fractional bits of the coefficients
+     * @param output Array of count output samples
+     * @param count Number of output samples
+     */
+    static void applyQ15(const int16_t *buffer, const int16_t *coeffs, uint32_t coeffsLen, uint32_t shift, int16_t *output, uint64_t count);
+};
@@ -0,0 +1,337 @@
+/**
+ * @file firKernels.inl
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Instruction set independent implementation of the fir kernels
+ *
+ * This file is included by firKernels.cpp once per instruction set, inside a namespace that defines:
+ *
+ * SIMD_TARGET  the function attribute enabling the instruction set
+ * vecD         a vector of Lanes doubles
+ * zero, set1, load, add, sub, mul, mulAdd  arithmetic on vecD
+ * store        stores the lanes of a vecD
+ *
+ * and the isSymmetric helper, the defaultFilterKernel signature and the tables of defaultFilterCoeffs.hpp
+ *
+ * and, when SIMD_INT16_LANES is greater than 1:
+ *
+ * vecI         a vector of SIMD_INT16_LANES 16 bit integers, or half as many 32 bit integers
+ * zeroI, loadI, addI  loading and adding vecI
+ * setPair      a pair of 16 bit coefficients repeated in every 32 bit lane
+ * unpackLo, unpackHi  interleave the 16 bit lanes of two vectors
+ * mulAddPairs  multiplies the 16 bit lanes and adds neighbouring products into 32 bit lanes (pmaddwd)
+ * storeQ15     rounds and shifts the two 32 bit accumulators, then packs them into saturated 16 bit samples
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+SIMD_TARGET static void applyDirect(const double *buffer, const double *coeffs, uint32_t coeffsLen, double *output, uint64_t count)
+{
+    const double *last = buffer + coeffsLen - 1;
+    uint64_t i = 0;
+
+    // -- Compute 4 vectors of output samples at once, so each coefficient is loaded once for 4 * Lanes samples
+    for (; i + 4 * Lanes <= count; i += 4 * Lanes)
+    {
+        vecD acc0 = zero(), acc1 = zero(), acc2 = zero(), acc3 = zero();
+        const double *x = last + i;
+
+        for (uint32_t j = 0; j < coeffsLen; j++)
+        {
+            vecD c = set1(coeffs[j]);
+            acc0 = mulAdd(c, load(x - j), acc0);
+            acc1 = mulAdd(c, load(x - j + Lanes), acc1);
+            acc2 = mulAdd(c, load(x - j + 2 * Lanes), acc2);
+            acc3 = mulAdd(c, load(x - j + 3 * Lanes), acc3);
+        }
+
+        store(acc0, output + i);
+        store(acc1, output + i + Lanes);
+        store(acc2, output + i + 2 * Lanes);
+        store(acc3, output + i + 3 * Lanes);
+    }
+
+    // -- One vector of output samples at a time
+    for (; i + Lanes <= count; i += Lanes)
+    {
+        vecD acc = zero();
+        const double *x = last + i;
+
+        for (uint32_t j = 0; j < coeffsLen; j++)
+        {
+            acc = mulAdd(set1(coeffs[j]), load(x - j), acc);
+        }
+
+        store(acc, output + i);
+    }
+
+    // -- Remaining output samples
+    for (; i < count; i++)
+    {
+        double acc = 0;
+        const double *x = last + i;
+
+        for (uint32_t j = 0; j < coeffsLen; j++)
+        {
+            acc += coeffs[j] * x[-(int64_t)j];
+        }
+
+        output[i] = acc;
+    }
+}
+
+SIMD_TARGET static void applyFolded(const double *buffer, const coeffAnalysis &analysis, double *output, uint64_t count)
+{
+    const double *last = buffer + analysis.coeffsLen - 1;
+    const uint32_t *taps = analysis.taps.data();
+    const double *tapCoeffs = analysis.tapCoeffs.data();
+    uint32_t tapCount = (uint32_t)analysis.taps.size();
+    uint32_t mirror = analysis.coeffsLen - 1;
+    uint32_t centre = analysis.coeffsLen / 2;
+    bool antisymmetric = analysis.structure == coeffStructure::antisymmetric;
+    uint64_t i = 0;
+
+    // -- The samples at tap j and tap coeffsLen - 1 - j share a coefficient, so they are combined before multiplying
+    for (; i + 4 * Lanes <= count; i += 4 * Lanes)
+    {
+        const double *x = last + i;
+        vecD c = set1(analysis.centreCoeff);
+        vecD acc0 = mul(c, load(x - centre));
+        vecD acc1 = mul(c, load(x - centre + Lanes));
+        vecD acc2 = mul(c, load(x - centre + 2 * Lanes));
+        vecD acc3 = mul(c, load(x - centre + 3 * Lanes));
+
+        for (uint32_t t = 0; t < tapCount; t++)
+        {
+            const double *near = x - taps[t];
+            const double *far = x - (mirror - taps[t]);
+            c = set1(tapCoeffs[t]);
+
+            if (antisymmetric)
+            {
+                acc0 = mulAdd(c, sub(load(near), load(far)), acc0);
+                acc1 = mulAdd(c, sub(load(near + Lanes), load(far + Lanes)), acc1);
+                acc2 = mulAdd(c, sub(load(near + 2 * Lanes), load(far + 2 * Lanes)), acc2);
+                acc3 = mulAdd(c, sub(load(near + 3 * Lanes), load(far + 3 * Lanes)), acc3);
+            }
+            else
+            {
+                acc0 = mulAdd(c, add(load(near), load(far)), acc0);
+                acc1 = mulAdd(c, add(load(near + Lanes), load(far + Lanes)), acc1);
+                acc2 = mulAdd(c, add(load(near + 2 * Lanes), load(far + 2 * Lanes)), acc2);
+                acc3 = mulAdd(c, add(load(near + 3 * Lanes), load(far + 3 * Lanes)), acc3);
+            }
+        }
+
+        store(acc0, output + i);
+        store(acc1, output + i + Lanes);
+        store(acc2, output + i + 2 * Lanes);
+        store(acc3, output + i + 3 * Lanes);
+    }
+
+    // -- Remaining output samples
+    for (; i < count; i++)
+    {
+        const double *x = last + i;
+        double acc = analysis.centreCoeff * x[-(int64_t)centre];
+
+        for (uint32_t t = 0; t < tapCount; t++)
+        {
+            double near = x[-(int64_t)taps[t]];
+            double far = x[-(int64_t)(mirror - taps[t])];
+            acc += tapCoeffs[t] * (antisymmetric ? near - far : near + far);
+        }
+
+        output[i] = acc;
+    }
+}
+
+SIMD_TARGET static void applySparse(const double *buffer, const coeffAnalysis &analysis, double *output, uint64_t count)
+{
+    const double *last = buffer + analysis.coeffsLen - 1;
+    const uint32_t *taps = analysis.taps.data();
+    const double *tapCoeffs = analysis.tapCoeffs.data();
+    uint32_t tapCount = (uint32_t)analysis.taps.size();
+    uint64_t i = 0;
+
+    // -- Only the non-zero taps are multiplied
+    for (; i + 4 * Lanes <= count; i += 4 * Lanes)
+    {
+        vecD acc0 = zero(), acc1 = zero(), acc2 = zero(), acc3 = zero();
+        const double *x = last + i;
+
+        for (uint32_t t = 0; t < tapCount; t++)
+        {
+            const double *tap = x - taps[t];
+            vecD c = set1(tapCoeffs[t]);
+            acc0 = mulAdd(c, load(tap), acc0);
+            acc1 = mulAdd(c, load(tap + Lanes), acc1);
+            acc2 = mulAdd(c, load(tap + 2 * Lanes), acc2);
+            acc3 = mulAdd(c, load(tap + 3 * Lanes), acc3);
+        }
+
+        store(acc0, output + i);
+        store(acc1, output + i + Lanes);
+        store(acc2, output + i + 2 * Lanes);
+        store(acc3, output + i + 3 * Lanes);
+    }
+
+    // -- Remaining output samples
+    for (; i < count; i++)
+    {
+        const double *x = last + i;
+        double acc = 0;
+
+        for (uint32_t t = 0; t < tapCount; t++)
+        {
+            acc += tapCoeffs[t] * x[-(int64_t)taps[t]];
+        }
+
+        output[i] = acc;
+    }
+}
+
+template <uint32_t CoeffsLen, const array<double, CoeffsLen> &Coeffs>
+SIMD_TARGET static void applyDefaultFilter(const double *buffer, double *output, uint64_t count)
+{
+    // -- The coefficients are compile time constants, so the tap loops are fully unrolled with the coefficients
+    // -- as immediate constants. Symmetric filters use the same folded arithmetic as applyFolded and give the
+    // -- same output, other filters the same arithmetic as applyDirect
+    constexpr bool folded = isSymmetric(Coeffs);
+    constexpr double centreCoeff = CoeffsLen % 2 == 1 ? Coeffs[CoeffsLen / 2] : 0.0;
+    constexpr uint32_t mirror = CoeffsLen - 1;
+    constexpr uint32_t centre = CoeffsLen / 2;
+    const double *last = buffer + CoeffsLen - 1;
+    uint64_t i = 0;
+
+    for (; i + 4 * Lanes <= count; i += 4 * Lanes)
+    {
+        const double *x = last + i;
+        vecD acc0, acc1, acc2, acc3;
+
+        if constexpr (folded)
+        {
+            vecD c = set1(centreCoeff);
+            acc0 = mul(c, load(x - centre));
+            acc1 = mul(c, load(x - centre + Lanes));
+            acc2 = mul(c, load(x - centre + 2 * Lanes));
+            acc3 = mul(c, load(x - centre + 3 * Lanes));
+
+#pragma GCC unroll 256
+            for (uint32_t j = 0; j < CoeffsLen / 2; j++)
+            {
+                if (Coeffs[j] != 0.0)
+                {
+                    const double *near = x - j;
+                    const double *far = x - (mirror - j);
+                    c = set1(Coeffs[j]);
+                    acc0 = mulAdd(c, add(load(near), load(far)), acc0);
+                    acc1 = mulAdd(c, add(load(near + Lanes), load(far + Lanes)), acc1);
+                    acc2 = mulAdd(c, add(load(near + 2 * Lanes), load(far + 2 * Lanes)), acc2);
+                    acc3 = mulAdd(c, add(load(near + 3 * Lanes), load(far + 3 * Lanes)), acc3);
+                }
+            }
+        }
+        else
+        {
+            acc0 = zero(), acc1 = zero(), acc2 = zero(), acc3 = zero();
+
+#pragma GCC unroll 256
+            for (uint32_t j = 0; j < CoeffsLen; j++)
+            {
+                vecD c = set1(Coeffs[j]);
+                acc0 = mulAdd(c, load(x - j), acc0);
+                acc1 = mulAdd(c, load(x - j + Lanes), acc1);
+                acc2 = mulAdd(c, load(x - j + 2 * Lanes), acc2);
+                acc3 = mulAdd(c, load(x - j + 3 * Lanes), acc3);
+            }
+        }
+
+        store(acc0, output + i);
+        store(acc1, output + i + Lanes);
+        store(acc2, output + i + 2 * Lanes);
+        store(acc3, output + i + 3 * Lanes);
+    }
+
+    // -- Remaining output samples
+    for (; i < count; i++)
+    {
+        const double *x = last + i;
+        double acc = 0;
+
+        if constexpr (folded)
+        {
+            acc = centreCoeff * x[-(int64_t)centre];
+            for (uint32_t j = 0; j < CoeffsLen / 2; j++)
+            {
+                if (Coeffs[j] != 0.0)
+                {
+                    acc += Coeffs[j] * (x[-(int64_t)j] + x[-(int64_t)(mirror - j)]);
+                }
+            }
+        }
+        else
+        {
+            for (uint32_t j = 0; j < CoeffsLen; j++)
+            {
+                acc += Coeffs[j] * x[-(int64_t)j];
+            }
+        }
+
+        output[i] = acc;
+    }
+}
+
+// -- One kernel per default filter, in the order of defaultFilters
+static const defaultFilterKernel defaultFilterKernels[Default_Filter_Count] =
+    {
+        applyDefaultFilter<Default_Filter_Coeffs_Len, lowPassCoeffs>,
+        applyDefaultFilter<Default_Filter_Coeffs_Len, highPassCoeffs>,
+        applyDefaultFilter<Default_Filter_Coeffs_Len, speechRangeCoeffs>,
+        applyDefaultFilter<Default_Filter_Coeffs_Len, noSpeechRangeCoeffs>};
+
+SIMD_TARGET static void applyQ15(const int16_t *buffer, const int16_t *coeffs, uint32_t coeffsLen, uint32_t shift, int16_t *output, uint64_t count)
+{
+    const int16_t *last = buffer + coeffsLen - 1;
+    uint64_t i = 0;
+
+#if SIMD_INT16_LANES > 1
+    // -- Each 32 bit lane accumulates the products of a pair of coefficients with the current and the previous
+    // -- sample of one output sample. Interleaving the samples spreads the output samples over two accumulators
+    for (; i + SIMD_INT16_LANES <= count; i += SIMD_INT16_LANES)
+    {
+        vecI accLo = zeroI(), accHi = zeroI();
+        const int16_t *x = last + i;
+
+        for (uint32_t j = 0; j < coeffsLen; j += 2)
+        {
+            vecI pair = setPair(coeffs[j], coeffs[j + 1]);
+            vecI current = loadI(x - j);
+            vecI previous = loadI(x - j - 1);
+            accLo = addI(accLo, mulAddPairs(unpackLo(current, previous), pair));
+            accHi = addI(accHi, mulAddPairs(unpackHi(current, previous), pair));
+        }
+
+        storeQ15(accLo, accHi, shift, output + i);
+    }
+#endif
+
+    // -- Remaining output samples
+    int64_t rounding = shift > 0 ? ((int64_t)1 << (shift - 1)) : 0;
+    for (; i < count; i++)
+    {
+        int64_t acc = 0;
+        const int16_t *x = last + i;
+
+        for (uint32_t j = 0; j < coeffsLen; j++)
+        {
+            acc += (int32_t)coeffs[j] * x[-(int64_t)j];
+        }
+
+        acc = (acc + rounding) >> shift;
+        output[i] = (int16_t)max((int64_t)INT16_MIN, min((int64_t)INT16_MAX, acc));
+    }
+}
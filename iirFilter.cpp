@@ -0,0 +1,232 @@
+/**
+ * @file iirFilter.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the iir filter class
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <algorithm>
+#include "iirFilter.hpp"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define IIR_FILTER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+iirFilter::iirFilter()
+{
+    // -- Default constructor
+}
+
+void iirFilter::reset()
+{
+    state.clear();
+}
+
+uint32_t iirFilter::getMultiplies(const vector<biquadSection> &sections)
+{
+    return 5 * (uint32_t)sections.size();
+}
+
+void iirFilter::applyIirFilter(vector<vector<double>> &channels, const vector<biquadSection> &sections)
+{
+    // -- The state starts at zero, as for a signal preceded by silence
+    uint64_t sectionCount = sections.size();
+    if (state.size() != channels.size() * sectionCount * 2)
+    {
+        state.assign(channels.size() * sectionCount * 2, 0);
+    }
+
+    for (uint64_t first = 0; first < channels.size(); first += Iir_Lanes)
+    {
+        uint32_t laneCount = (uint32_t)min((uint64_t)Iir_Lanes, channels.size() - first);
+        double *channelState = sectionCount > 0 ? &state[first * sectionCount * 2] : NULL;
+        if (laneCount == 1)
+        {
+            applyChannel(channels[first], sections, channelState);
+        }
+        else
+        {
+            applyLanes(&channels[first], laneCount, sections, channelState);
+        }
+    }
+}
+
+void iirFilter::applyChannel(vector<double> &samples, const vector<biquadSection> &sections, double *channelState)
+{
+    uint64_t sectionCount = sections.size();
+    uint64_t sampleCount = samples.size();
+    if (sectionCount == 0 || sampleCount == 0)
+    {
+        return;
+    }
+
+    // -- The coefficients and state of the sections side by side, one array per coefficient, last section first
+    sectionData.resize(sectionCount * 7);
+    double *b0 = &sectionData[0];
+    double *b1 = b0 + sectionCount;
+    double *b2 = b1 + sectionCount;
+    double *a1 = b2 + sectionCount;
+    double *a2 = a1 + sectionCount;
+    double *s1 = a2 + sectionCount;
+    double *s2 = s1 + sectionCount;
+    for (uint64_t k = 0; k < sectionCount; k++)
+    {
+        uint64_t r = sectionCount - 1 - k;
+        b0[r] = sections[k].b0;
+        b1[r] = sections[k].b1;
+        b2[r] = sections[k].b2;
+        a1[r] = sections[k].a1;
+        a2[r] = sections[k].a2;
+        s1[r] = channelState[2 * k];
+        s2[r] = channelState[2 * k + 1];
+    }
+
+    // -- At step n, section k filters sample n - k, which section k - 1 filtered at the step before. The sections
+    // -- of a step do not depend on each other, so their recursions overlap instead of one section waiting for the
+    // -- previous sample of the next. With the last section first, the samples of a step line up with the
+    // -- coefficients of their sections, so neighbouring sections are filtered together in a vector
+    double *data = &samples[0];
+    for (uint64_t n = 0; n < sampleCount + sectionCount - 1; n++)
+    {
+        uint64_t first = (n >= sampleCount) ? n - sampleCount + 1 : 0;
+        uint64_t last = min(n, sectionCount - 1);
+        uint64_t count = last - first + 1;
+        uint64_t r = sectionCount - 1 - last;
+        double *x = data + (n - last);
+        uint64_t j = 0;
+#ifdef IIR_FILTER_SSE2
+        // -- Two sections per vector, with the multiplications and additions of the scalar code in the same order
+        for (; j + 2 <= count; j += 2)
+        {
+            __m128d in = _mm_loadu_pd(x + j);
+            __m128d out = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(b0 + r + j), in), _mm_loadu_pd(s1 + r + j));
+            __m128d next = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_loadu_pd(b1 + r + j), in), _mm_mul_pd(_mm_loadu_pd(a1 + r + j), out)),
+                                      _mm_loadu_pd(s2 + r + j));
+            _mm_storeu_pd(s2 + r + j, _mm_sub_pd(_mm_mul_pd(_mm_loadu_pd(b2 + r + j), in), _mm_mul_pd(_mm_loadu_pd(a2 + r + j), out)));
+            _mm_storeu_pd(s1 + r + j, next);
+            _mm_storeu_pd(x + j, out);
+        }
+#endif
+        for (; j < count; j++)
+        {
+            double in = x[j];
+            double out = b0[r + j] * in + s1[r + j];
+            s1[r + j] = b1[r + j] * in - a1[r + j] * out + s2[r + j];
+            s2[r + j] = b2[r + j] * in - a2[r + j] * out;
+            x[j] = out;
+        }
+    }
+
+    for (uint64_t k = 0; k < sectionCount; k++)
+    {
+        channelState[2 * k] = s1[sectionCount - 1 - k];
+        channelState[2 * k + 1] = s2[sectionCount - 1 - k];
+    }
+}
+
+void iirFilter::applyLanes(vector<double> *channels, uint32_t laneCount, const vector<biquadSection> &sections, double *channelState)
+{
+    uint64_t sectionCount = sections.size();
+    uint64_t frameCount = channels[0].size();
+    if (sectionCount == 0 || frameCount == 0)
+    {
+        return;
+    }
+
+    // -- Interleave the channels, one per lane. Unused lanes filter silence
+    laneData.assign(frameCount * Iir_Lanes, 0);
+    for (uint32_t l = 0; l < laneCount; l++)
+    {
+        for (uint64_t n = 0; n < frameCount; n++)
+        {
+            laneData[n * Iir_Lanes + l] = channels[l][n];
+        }
+    }
+
+    // -- The coefficients of the sections side by side, each stored twice to fill a vector, followed by the state
+    // -- of every section and lane
+    sectionData.assign(sectionCount * (10 + 2 * Iir_Lanes), 0);
+    double *b0 = &sectionData[0];
+    double *b1 = b0 + 2 * sectionCount;
+    double *b2 = b1 + 2 * sectionCount;
+    double *a1 = b2 + 2 * sectionCount;
+    double *a2 = a1 + 2 * sectionCount;
+    double *s1 = a2 + 2 * sectionCount;
+    double *s2 = s1 + sectionCount * Iir_Lanes;
+    for (uint64_t k = 0; k < sectionCount; k++)
+    {
+        b0[2 * k] = b0[2 * k + 1] = sections[k].b0;
+        b1[2 * k] = b1[2 * k + 1] = sections[k].b1;
+        b2[2 * k] = b2[2 * k + 1] = sections[k].b2;
+        a1[2 * k] = a1[2 * k + 1] = sections[k].a1;
+        a2[2 * k] = a2[2 * k + 1] = sections[k].a2;
+        for (uint32_t l = 0; l < laneCount; l++)
+        {
+            s1[k * Iir_Lanes + l] = channelState[(l * sectionCount + k) * 2];
+            s2[k * Iir_Lanes + l] = channelState[(l * sectionCount + k) * 2 + 1];
+        }
+    }
+
+    // -- The sections are staggered as for a single channel, and every section applies the same operations to every
+    // -- lane in use, so the output of a channel does not depend on the channels it is filtered with
+    uint32_t usedLanes = (laneCount + 1) & ~1u;
+    double *data = &laneData[0];
+    for (uint64_t n = 0; n < frameCount + sectionCount - 1; n++)
+    {
+        uint64_t first = (n >= frameCount) ? n - frameCount + 1 : 0;
+        uint64_t last = min(n, sectionCount - 1);
+        for (uint64_t k = first; k <= last; k++)
+        {
+            double *frame = data + (n - k) * Iir_Lanes;
+            double *laneS1 = s1 + k * Iir_Lanes;
+            double *laneS2 = s2 + k * Iir_Lanes;
+#ifdef IIR_FILTER_SSE2
+            // -- Two lanes per vector, with the multiplications and additions of the scalar code in the same order
+            __m128d vb0 = _mm_loadu_pd(b0 + 2 * k), vb1 = _mm_loadu_pd(b1 + 2 * k), vb2 = _mm_loadu_pd(b2 + 2 * k);
+            __m128d va1 = _mm_loadu_pd(a1 + 2 * k), va2 = _mm_loadu_pd(a2 + 2 * k);
+            for (uint32_t l = 0; l < usedLanes; l += 2)
+            {
+                __m128d in = _mm_loadu_pd(frame + l);
+                __m128d out = _mm_add_pd(_mm_mul_pd(vb0, in), _mm_loadu_pd(laneS1 + l));
+                __m128d next = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(vb1, in), _mm_mul_pd(va1, out)), _mm_loadu_pd(laneS2 + l));
+                _mm_storeu_pd(laneS2 + l, _mm_sub_pd(_mm_mul_pd(vb2, in), _mm_mul_pd(va2, out)));
+                _mm_storeu_pd(laneS1 + l, next);
+                _mm_storeu_pd(frame + l, out);
+            }
+#else
+            for (uint32_t l = 0; l < usedLanes; l++)
+            {
+                double in = frame[l];
+                double out = b0[2 * k] * in + laneS1[l];
+                laneS1[l] = b1[2 * k] * in - a1[2 * k] * out + laneS2[l];
+                laneS2[l] = b2[2 * k] * in - a2[2 * k] * out;
+                frame[l] = out;
+            }
+#endif
+        }
+    }
+
+    for (uint64_t k = 0; k < sectionCount; k++)
+    {
+        for (uint32_t l = 0; l < laneCount; l++)
+        {
+            channelState[(l * sectionCount + k) * 2] = s1[k * Iir_Lanes + l];
+            channelState[(l * sectionCount + k) * 2 + 1] = s2[k * Iir_Lanes + l];
+        }
+    }
+
+    for (uint32_t l = 0; l < laneCount; l++)
+    {
+        for (uint64_t n = 0; n < frameCount; n++)
+        {
+            channels[l][n] = laneData[n * Iir_Lanes + l];
+        }
+    }
+}
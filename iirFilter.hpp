@@ -0,0 +1,119 @@
+/**
+ * @file iirFilter.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition for the iir filter, a cascade of biquad sections
+ *
+ * A few biquad sections reach the stopband attenuation of a fir filter with many coefficients, at the cost of
+ * a phase response that is not linear. Each section is applied in the transposed direct form II, which keeps two
+ * state values per section and channel. The recursion of a section makes every output sample depend on the one
+ * before it, so the samples of one section cannot be computed side by side. The sections are staggered instead,
+ * each filtering the sample before the one of the previous section, so the sections of a step are independent and
+ * are computed side by side. Up to Iir_Lanes channels are also filtered together, one channel per lane.
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @brief Number of channels filtered together by an iir filter
+ *
+ */
+constexpr uint32_t Iir_Lanes = 4;
+
+/**
+ * @brief One second order section, H(z) = (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2). First order
+ * sections have b2 and a2 set to 0
+ *
+ */
+struct biquadSection
+{
+    double b0;
+    double b1;
+    double b2;
+    double a1;
+    double a2;
+};
+
+class iirFilter
+{
+public:
+    /**
+     * @brief Default constructor to create a new iir filter object with an empty state
+     *
+     */
+    iirFilter();
+
+    /**
+     * @brief Clear the state, so the next block starts a new signal
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Apply a cascade of biquad sections to one block of every channel
+     *
+     * The state of every section and channel is kept from one block to the next, so the output does not depend on
+     * how the signal is split into blocks, nor on how many channels are filtered together
+     *
+     * @param channels Samples of the block, one vector per channel, all of the same length. Replaced by the
+     *                 filtered samples
+     * @param sections Sections of the cascade, in the order they are applied
+     */
+    void applyIirFilter(vector<vector<double>> &channels, const vector<biquadSection> &sections);
+
+    /**
+     * @brief Gets the number of multiplications per sample of a cascade
+     *
+     * @param sections Sections of the cascade
+     * @return 5 multiplications per section
+     */
+    static uint32_t getMultiplies(const vector<biquadSection> &sections);
+
+private:
+    /**
+     * @brief Apply the cascade to one channel, two sections per vector
+     *
+     * @param samples Samples of the channel, replaced by the filtered samples
+     * @param sections Sections of the cascade
+     * @param channelState Two state values per section of the channel
+     */
+    void applyChannel(vector<double> &samples, const vector<biquadSection> &sections, double *channelState);
+
+    /**
+     * @brief Apply the cascade to several channels at once, one channel per lane
+     *
+     * @param channels First of the channels, replaced by the filtered samples
+     * @param laneCount Number of channels, at most Iir_Lanes
+     * @param sections Sections of the cascade
+     * @param channelState Two state values per section of each channel, one channel after the other
+     */
+    void applyLanes(vector<double> *channels, uint32_t laneCount, const vector<biquadSection> &sections, double *channelState);
+
+    /**
+     * @brief State of the transposed direct form II, two values per section for every channel, one channel
+     * after the other
+     *
+     */
+    vector<double> state;
+
+    /**
+     * @brief Coefficients and state of the sections, one array per coefficient
+     *
+     */
+    vector<double> sectionData;
+
+    /**
+     * @brief Samples of the channels filtered together, interleaved one sample per lane
+     *
+     */
+    vector<double> laneData;
+};
@@ -0,0 +1,129 @@
+/**
+ * @file mappedFile.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the mappedFile class
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <cstdio>
+#include "mappedFile.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_POSIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+mappedFile::mappedFile()
+{
+    // -- Default constructor
+    data = NULL;
+    size = 0;
+}
+
+mappedFile::~mappedFile()
+{
+    unmap();
+}
+
+bool mappedFile::mapInput(FILE *fp)
+{
+    unmap();
+
+#ifdef MAPPED_FILE_POSIX
+    // -- Only regular files can be mapped
+    struct stat fileStat;
+    int fd = fileno(fp);
+    if (fd < 0 || fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode) || fileStat.st_size <= 0)
+    {
+        return false;
+    }
+
+    void *mapping = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // -- The audio data is read from start to end, so the kernel can read ahead and drop pages behind
+    madvise(mapping, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+
+    data = (unsigned char *)mapping;
+    size = (uint64_t)fileStat.st_size;
+    return true;
+#else
+    (void)fp;
+    return false;
+#endif
+}
+
+bool mappedFile::mapOutput(FILE *fp, uint64_t fileSize)
+{
+    unmap();
+
+#ifdef MAPPED_FILE_POSIX
+    struct stat fileStat;
+    int fd = fileno(fp);
+    if (fileSize == 0 || fd < 0 || fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+    {
+        return false;
+    }
+
+    // -- A shared writable mapping needs a file that is open for reading and writing
+    if ((fcntl(fd, F_GETFL) & O_ACCMODE) != O_RDWR)
+    {
+        return false;
+    }
+
+    // -- Size the file up front, the pages of the mapping are then filled in place
+    if (ftruncate(fd, (off_t)fileSize) != 0)
+    {
+        return false;
+    }
+
+    void *mapping = mmap(NULL, (size_t)fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+    madvise(mapping, (size_t)fileSize, MADV_SEQUENTIAL);
+
+    data = (unsigned char *)mapping;
+    size = fileSize;
+    return true;
+#else
+    (void)fp;
+    (void)fileSize;
+    return false;
+#endif
+}
+
+void mappedFile::unmap()
+{
+#ifdef MAPPED_FILE_POSIX
+    if (data != NULL)
+    {
+        munmap(data, (size_t)size);
+    }
+#endif
+    data = NULL;
+    size = 0;
+}
+
+unsigned char *mappedFile::getData()
+{
+    return data;
+}
+
+uint64_t mappedFile::getSize()
+{
+    return size;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file mappedFile.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition to map files into memory
+ * 
+ * This class maps an open file into memory, so that the audio data of a wav file can be used in place
+ * without reading it into a buffer first, and the output can be written without going through the
+ * buffering of the C library. Mapping is only possible for regular files on systems with mmap, for
+ * pipes and other systems the map functions return false and the caller falls back to fread and fwrite.
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+
+using namespace std;
+
+class mappedFile
+{
+public:
+    /**
+     * @brief Default constructor to create a new mapped file object, without a mapping
+     * 
+     */
+    mappedFile();
+
+    /**
+     * @brief Destructor, unmaps the file
+     * 
+     */
+    ~mappedFile();
+
+    /**
+     * @brief A mapping cannot be shared between two objects
+     * 
+     */
+    mappedFile(const mappedFile &obj) = delete;
+    mappedFile &operator=(const mappedFile &obj) = delete;
+
+    /**
+     * @brief Map the whole of a file read-only, with a hint that it is read sequentially
+     * 
+     * @param fp A pointer to the open file
+     * @return True if the file was mapped
+     */
+    bool mapInput(FILE *fp);
+
+    /**
+     * @brief Resize a file and map the whole of it for writing, with a hint that it is written sequentially
+     * 
+     * Anything written to the file through fp must be flushed before. The file must be open for reading
+     * and writing, as a shared writable mapping needs both
+     * 
+     * @param fp A pointer to the open file
+     * @param fileSize Size of the file in bytes
+     * @return True if the file was resized and mapped
+     */
+    bool mapOutput(FILE *fp, uint64_t fileSize);
+
+    /**
+     * @brief Unmap the file, writing the changes of an output mapping back to the file
+     * 
+     */
+    void unmap();
+
+    /**
+     * @brief Gets the start of the mapped file
+     * 
+     * @return Returns the mapped data, NULL if nothing is mapped
+     */
+    unsigned char *getData();
+
+    /**
+     * @brief Gets the size of the mapped file
+     * 
+     * @return Returns the number of mapped bytes
+     */
+    uint64_t getSize();
+
+private:
+    /**
+     * @brief Start of the mapped file
+     * 
+     */
+    unsigned char *data;
+
+    /**
+     * @brief Number of mapped bytes
+     * 
+     */
+    uint64_t size;
+};
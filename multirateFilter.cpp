@@ -0,0 +1,144 @@
+/**
+ * @file multirateFilter.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the multirate filter class
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "multirateFilter.hpp"
+#include "firKernels.hpp"
+
+using namespace std;
+
+multirateFilter::multirateFilter()
+{
+    // -- Default constructor
+}
+
+void multirateFilter::reset()
+{
+    histories.clear();
+}
+
+uint32_t multirateFilter::getMultiplies(const multirateStage &stage)
+{
+    uint64_t perFactor = 2 * stage.antiAliasCoeffs.size() + stage.narrowCoeffs.size();
+    return (uint32_t)((perFactor + stage.factor - 1) / stage.factor);
+}
+
+void multirateFilter::applyMultirateFilter(vector<vector<double>> &channels, const multirateStage &stage)
+{
+    uint64_t factor = stage.factor;
+    uint64_t phaseLen = (stage.antiAliasCoeffs.size() + factor - 1) / factor;
+
+    // -- The history starts at zero, as for a signal preceded by silence
+    if (histories.size() != channels.size())
+    {
+        histories.resize(channels.size());
+        for (uint64_t i = 0; i < channels.size(); i++)
+        {
+            histories[i].inputs.assign(stage.antiAliasCoeffs.size() - 1, 0);
+            histories[i].decimated.assign(stage.narrowCoeffs.size() - 1, 0);
+            histories[i].narrowed.assign(phaseLen, 0);
+            histories[i].phase = 0;
+        }
+    }
+
+    phaseCoeffs.assign(factor * phaseLen, 0);
+    for (uint64_t k = 0; k < stage.antiAliasCoeffs.size(); k++)
+    {
+        phaseCoeffs[(k % factor) * phaseLen + k / factor] = stage.antiAliasCoeffs[k];
+    }
+
+    for (uint64_t i = 0; i < channels.size(); i++)
+    {
+        applyChannel(channels[i], stage, histories[i]);
+    }
+}
+
+void multirateFilter::applyChannel(vector<double> &samples, const multirateStage &stage, channelHistory &history)
+{
+    uint64_t factor = stage.factor;
+    uint64_t sampleCount = samples.size();
+    uint64_t antiAliasLen = stage.antiAliasCoeffs.size();
+    uint64_t narrowLen = stage.narrowCoeffs.size();
+    uint64_t phaseLen = (antiAliasLen + factor - 1) / factor;
+    history.inputs.insert(history.inputs.end(), samples.begin(), samples.end());
+
+    // -- Samples of the block kept by the decimation
+    uint64_t firstKept = (factor - history.phase) % factor;
+    uint64_t keptCount = (firstKept < sampleCount) ? (sampleCount - firstKept + factor - 1) / factor : 0;
+
+    // -- Each decimated sample only needs every factor-th input sample for each phase of the anti-alias filter,
+    // -- so every phase is a filter over the input samples of that phase, and the decimation their sum
+    uint64_t decimatedStart = history.decimated.size();
+    history.decimated.resize(decimatedStart + keptCount, 0);
+    for (uint64_t r = 0; r < factor && r < antiAliasLen && keptCount > 0; r++)
+    {
+        uint64_t len = (antiAliasLen - r + factor - 1) / factor;
+        const double *phaseFirst = &history.inputs[antiAliasLen - 1 + firstKept - r - (len - 1) * factor];
+        phaseSamples.resize(len - 1 + keptCount);
+        for (uint64_t t = 0; t < phaseSamples.size(); t++)
+        {
+            phaseSamples[t] = phaseFirst[t * factor];
+        }
+        phaseOutput.resize(keptCount);
+        firKernels::applyDirect(phaseSamples.data(), &phaseCoeffs[r * phaseLen], (uint32_t)len, phaseOutput.data(), keptCount);
+        for (uint64_t i = 0; i < keptCount; i++)
+        {
+            history.decimated[decimatedStart + i] += phaseOutput[i];
+        }
+    }
+
+    // -- The narrow filter runs at the reduced rate
+    uint64_t narrowedStart = history.narrowed.size();
+    history.narrowed.resize(narrowedStart + keptCount);
+    if (keptCount > 0)
+    {
+        firKernels::applyDirect(&history.decimated[decimatedStart - (narrowLen - 1)], stage.narrowCoeffs.data(), (uint32_t)narrowLen,
+                                &history.narrowed[narrowedStart], keptCount);
+    }
+
+    // -- The interpolation fills in factor - 1 zeros between the narrowed samples, so of the coefficients of the
+    // -- anti-alias filter only those of the phase of an output sample meet a narrowed sample, and the output
+    // -- samples of each phase are a filter over the narrowed samples
+    for (uint64_t q = 0; q < factor; q++)
+    {
+        uint64_t first = (q + factor - history.phase) % factor;
+        if (first >= sampleCount)
+        {
+            continue;
+        }
+        uint64_t count = (sampleCount - first + factor - 1) / factor;
+        uint64_t len = (q < antiAliasLen) ? (antiAliasLen - q + factor - 1) / factor : 0;
+        if (len == 0)
+        {
+            for (uint64_t t = 0; t < count; t++)
+            {
+                samples[first + t * factor] = 0;
+            }
+            continue;
+        }
+
+        // -- The latest narrowed sample of the first output sample of the phase is the one before the block,
+        // -- unless a sample is kept before it
+        uint64_t latest = narrowedStart - 1 + ((first >= firstKept) ? 1 : 0);
+        phaseOutput.resize(count);
+        firKernels::applyDirect(&history.narrowed[latest - (len - 1)], &phaseCoeffs[q * phaseLen], (uint32_t)len, phaseOutput.data(), count);
+        for (uint64_t t = 0; t < count; t++)
+        {
+            samples[first + t * factor] = (double)factor * phaseOutput[t];
+        }
+    }
+
+    // -- Keep the samples the next block needs. A block can end within the factor samples of a narrowed sample,
+    // -- so the latest narrowed sample is kept along with the ones before it
+    history.inputs.erase(history.inputs.begin(), history.inputs.end() - (antiAliasLen - 1));
+    history.decimated.erase(history.decimated.begin(), history.decimated.end() - (narrowLen - 1));
+    history.narrowed.erase(history.narrowed.begin(), history.narrowed.end() - phaseLen);
+    history.phase = (uint32_t)((history.phase + sampleCount) % factor);
+}
@@ -0,0 +1,154 @@
+/**
+ * @file multirateFilter.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition for the multirate filter, which runs a narrow low frequency filter at a reduced rate
+ *
+ * A filter passing only low frequencies needs a number of coefficients that grows with the sample rate, while
+ * its output holds nothing above a small fraction of the sample rate. The multirate filter therefore keeps only
+ * every factor-th sample (decimation) after an anti-alias low pass filter, applies the narrow filter to the
+ * decimated samples, which needs factor times fewer coefficients, and fills the samples in between again
+ * (interpolation) with the same low pass filter. Both the decimation and the interpolation are polyphase: only
+ * the samples that are kept are computed, and each interpolated sample only uses the coefficients meeting the
+ * decimated samples, so every filter costs a factor fewer multiplications per sample.
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @brief Filters of a multirate filter
+ *
+ */
+struct multirateStage
+{
+    /**
+     * @brief Ratio of the sample rate of the audio data to the reduced rate
+     *
+     */
+    uint32_t factor = 1;
+
+    /**
+     * @brief Low pass filter at the sample rate of the audio data, applied before the decimation and, scaled by
+     * the factor, for the interpolation
+     *
+     */
+    vector<double> antiAliasCoeffs;
+
+    /**
+     * @brief Narrow filter at the reduced rate
+     *
+     */
+    vector<double> narrowCoeffs;
+};
+
+class multirateFilter
+{
+public:
+    /**
+     * @brief Default constructor to create a new multirate filter object with an empty history
+     *
+     */
+    multirateFilter();
+
+    /**
+     * @brief Clear the history, so the next block starts a new signal
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Apply a multirate filter to one block of every channel
+     *
+     * The history of every channel is kept from one block to the next, including which of the samples is kept
+     * by the decimation, so the output does not depend on how the signal is split into blocks
+     *
+     * @param channels Samples of the block, one vector per channel, all of the same length. Replaced by the
+     *                 filtered samples
+     * @param stage Filters of the multirate filter
+     */
+    void applyMultirateFilter(vector<vector<double>> &channels, const multirateStage &stage);
+
+    /**
+     * @brief Gets the number of multiplications per sample of a multirate filter
+     *
+     * @param stage Filters of the multirate filter
+     * @return The coefficients of the anti-alias filter twice and of the narrow filter, divided by the factor
+     */
+    static uint32_t getMultiplies(const multirateStage &stage);
+
+private:
+    /**
+     * @brief History of one channel
+     *
+     */
+    struct channelHistory
+    {
+        /**
+         * @brief Last samples of the audio data, followed by the samples of the current block
+         *
+         */
+        vector<double> inputs;
+
+        /**
+         * @brief Last decimated samples
+         *
+         */
+        vector<double> decimated;
+
+        /**
+         * @brief Last output samples of the narrow filter, the latest one included
+         *
+         */
+        vector<double> narrowed;
+
+        /**
+         * @brief Position of the next sample within the factor samples of a decimated sample, 0 for a sample
+         * that is kept
+         *
+         */
+        uint32_t phase;
+    };
+
+    /**
+     * @brief Apply the multirate filter to one channel
+     *
+     * @param samples Samples of the channel, replaced by the filtered samples
+     * @param stage Filters of the multirate filter
+     * @param history History of the channel
+     */
+    void applyChannel(vector<double> &samples, const multirateStage &stage, channelHistory &history);
+
+    /**
+     * @brief Coefficients of the anti-alias filter for each phase, every factor-th coefficient from the phase on,
+     * stored phaseLen apart
+     *
+     */
+    vector<double> phaseCoeffs;
+
+    /**
+     * @brief Samples of one phase of the block, the history of the phase filter included
+     *
+     */
+    vector<double> phaseSamples;
+
+    /**
+     * @brief Output of one phase filter
+     *
+     */
+    vector<double> phaseOutput;
+
+    /**
+     * @brief History of every channel
+     *
+     */
+    vector<channelHistory> histories;
+};
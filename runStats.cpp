@@ -0,0 +1,226 @@
+/**
+ * @file runStats.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the runStats and scopedTimer classes
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <cstdio>
+#include <algorithm>
+#include "runStats.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RUN_STATS_POSIX
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+/**
+ * @brief Write a string as a JSON string, escaping the characters JSON does not allow in strings
+ *
+ * @param output Stream receiving the JSON string
+ * @param text Text to be written
+ */
+static void writeJsonString(ostream &output, const string &text)
+{
+    output << '"';
+    for (uint64_t i = 0; i < text.size(); i++)
+    {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\')
+        {
+            output << '\\' << c;
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            output << escaped;
+        }
+        else
+        {
+            output << c;
+        }
+    }
+    output << '"';
+}
+
+runStats::runStats()
+{
+    samples = 0;
+    start = chrono::steady_clock::now();
+}
+
+uint32_t runStats::addPhase(const string &name, uint32_t coeffsLen, uint32_t multipliesPerSample)
+{
+    lock_guard<mutex> guard(lock);
+    for (uint32_t i = 0; i < (uint32_t)phases.size(); i++)
+    {
+        if (phases[i].name == name && phases[i].coeffsLen == coeffsLen && phases[i].multipliesPerSample == multipliesPerSample)
+        {
+            return i;
+        }
+    }
+
+    phaseStats phase;
+    phase.name = name;
+    phase.coeffsLen = coeffsLen;
+    phase.multipliesPerSample = multipliesPerSample;
+    phases.push_back(phase);
+    return (uint32_t)phases.size() - 1;
+}
+
+void runStats::record(uint32_t phase, double seconds, uint64_t samples, uint64_t bytes, uint64_t macs)
+{
+    uint64_t peakRss = getPeakRss();
+
+    lock_guard<mutex> guard(lock);
+    phaseStats &stats = phases[phase];
+    stats.calls++;
+    stats.seconds += seconds;
+    stats.samples += samples;
+    stats.bytes += bytes;
+    stats.macs += macs;
+    stats.peakRssBytes = max(stats.peakRssBytes, peakRss);
+}
+
+void runStats::addSamples(uint64_t samples)
+{
+    lock_guard<mutex> guard(lock);
+    this->samples += samples;
+}
+
+void runStats::setField(const string &name, const string &value)
+{
+    lock_guard<mutex> guard(lock);
+    for (uint64_t i = 0; i < fields.size(); i++)
+    {
+        if (fields[i].first == name)
+        {
+            fields[i].second = value;
+            return;
+        }
+    }
+    fields.push_back(make_pair(name, value));
+}
+
+uint64_t runStats::getPeakRss()
+{
+#ifdef RUN_STATS_POSIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;
+#else
+    // -- Linux and the BSDs report kilobytes
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+void runStats::writeJson(ostream &output)
+{
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    uint64_t peakRss = getPeakRss();
+
+    lock_guard<mutex> guard(lock);
+    uint64_t totalMacs = 0;
+    for (uint64_t i = 0; i < phases.size(); i++)
+    {
+        totalMacs += phases[i].macs;
+    }
+
+    // -- Rates of phases that took no measurable time are reported as 0
+    auto rate = [](double count, double seconds) { return seconds > 0 ? count / seconds : 0.0; };
+
+    output.precision(6);
+    output << "{\n";
+    for (uint64_t i = 0; i < fields.size(); i++)
+    {
+        output << "  ";
+        writeJsonString(output, fields[i].first);
+        output << ": ";
+        writeJsonString(output, fields[i].second);
+        output << ",\n";
+    }
+    output << "  \"wallSeconds\": " << wallSeconds << ",\n"
+           << "  \"samples\": " << samples << ",\n"
+           << "  \"samplesPerSecond\": " << rate((double)samples, wallSeconds) << ",\n"
+           << "  \"macs\": " << totalMacs << ",\n"
+           << "  \"macsPerSecond\": " << rate((double)totalMacs, wallSeconds) << ",\n"
+           << "  \"peakRssBytes\": " << peakRss << ",\n"
+           << "  \"phases\": [\n";
+    for (uint64_t i = 0; i < phases.size(); i++)
+    {
+        const phaseStats &phase = phases[i];
+        output << "    {\"name\": ";
+        writeJsonString(output, phase.name);
+        if (phase.coeffsLen > 0)
+        {
+            output << ", \"coeffs\": " << phase.coeffsLen;
+        }
+        if (phase.multipliesPerSample > 0)
+        {
+            output << ", \"multipliesPerSample\": " << phase.multipliesPerSample;
+        }
+        output << ", \"calls\": " << phase.calls
+               << ", \"seconds\": " << phase.seconds
+               << ", \"samples\": " << phase.samples
+               << ", \"samplesPerSecond\": " << rate((double)phase.samples, phase.seconds)
+               << ", \"bytes\": " << phase.bytes
+               << ", \"bytesPerSecond\": " << rate((double)phase.bytes, phase.seconds)
+               << ", \"macs\": " << phase.macs
+               << ", \"macsPerSecond\": " << rate((double)phase.macs, phase.seconds)
+               << ", \"peakRssBytes\": " << phase.peakRssBytes
+               << ((i + 1 < phases.size()) ? "},\n" : "}\n");
+    }
+    output << "  ]\n"
+           << "}\n";
+}
+
+scopedTimer::scopedTimer(runStats *stats, uint32_t phase)
+{
+    this->stats = stats;
+    this->phase = phase;
+    samples = 0;
+    bytes = 0;
+    macs = 0;
+    if (stats != NULL)
+    {
+        start = chrono::steady_clock::now();
+    }
+}
+
+scopedTimer::~scopedTimer()
+{
+    stop();
+}
+
+void scopedTimer::count(uint64_t samples, uint64_t bytes, uint64_t macs)
+{
+    this->samples += samples;
+    this->bytes += bytes;
+    this->macs += macs;
+}
+
+void scopedTimer::stop()
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    stats->record(phase, seconds, samples, bytes, macs);
+    stats = NULL;
+}
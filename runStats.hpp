@@ -0,0 +1,263 @@
+/**
+ * @file runStats.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition to collect the performance statistics of a run
+ *
+ * A run is split into phases: reading the header, reading the audio data, each filter and writing the
+ * output. Every phase adds up its time and the samples, bytes and multiply-accumulates it handled, measured
+ * with a scopedTimer around the work. The statistics are written as JSON, along with the peak resident
+ * memory of the process at the end of each phase. The filtering classes take a pointer to a runStats object,
+ * and collect nothing when it is NULL
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @brief Statistics of one phase of a run, added up over every time the phase ran
+ *
+ */
+struct phaseStats
+{
+    /**
+     * @brief Name of the phase
+     *
+     */
+    string name;
+
+    /**
+     * @brief Number of filter coefficients for the phases applying a filter, otherwise 0
+     *
+     */
+    uint32_t coeffsLen = 0;
+
+    /**
+     * @brief Number of multiplications per sample for the phases applying a filter whose cost is not given by
+     * a number of coefficients, such as an iir filter, otherwise 0
+     *
+     */
+    uint32_t multipliesPerSample = 0;
+
+    /**
+     * @brief Number of times the phase ran, such as once per block when streaming
+     *
+     */
+    uint64_t calls = 0;
+
+    /**
+     * @brief Time spent in the phase, in seconds
+     *
+     */
+    double seconds = 0;
+
+    /**
+     * @brief Number of samples handled
+     *
+     */
+    uint64_t samples = 0;
+
+    /**
+     * @brief Number of bytes read or written
+     *
+     */
+    uint64_t bytes = 0;
+
+    /**
+     * @brief Number of multiply-accumulates of the direct form filter, whichever convolution engine was used
+     *
+     */
+    uint64_t macs = 0;
+
+    /**
+     * @brief Peak resident memory of the process when the phase last ended, in bytes
+     *
+     */
+    uint64_t peakRssBytes = 0;
+};
+
+class runStats
+{
+public:
+    /**
+     * @brief Construct a new run statistics object, starting the wall clock of the run
+     *
+     */
+    runStats();
+
+    /**
+     * @brief Statistics are shared by pointer, so they cannot be copied
+     *
+     */
+    runStats(const runStats &obj) = delete;
+    runStats &operator=(const runStats &obj) = delete;
+
+    /**
+     * @brief Finds a phase by name, number of filter coefficients and multiplications per sample, adding it after
+     * the existing phases if there is none
+     *
+     * Files filtered at the same time add their statistics to the same phases, unless their filters differ in
+     * length, so the multiply-accumulates of a phase always belong to its number of coefficients
+     *
+     * @param name Name of the phase
+     * @param coeffsLen Number of filter coefficients for the phases applying a fir filter, otherwise 0
+     * @param multipliesPerSample Number of multiplications per sample for the phases applying another filter, otherwise 0
+     * @return Index of the phase
+     */
+    uint32_t addPhase(const string &name, uint32_t coeffsLen = 0, uint32_t multipliesPerSample = 0);
+
+    /**
+     * @brief Add one run of a phase to its statistics
+     *
+     * Can be called from several threads at once
+     *
+     * @param phase Index of the phase
+     * @param seconds Time the phase took
+     * @param samples Number of samples handled
+     * @param bytes Number of bytes read or written
+     * @param macs Number of multiply-accumulates
+     */
+    void record(uint32_t phase, double seconds, uint64_t samples, uint64_t bytes, uint64_t macs);
+
+    /**
+     * @brief Add samples to the number of input samples of the run, from which its throughput is computed
+     *
+     * @param samples Number of input samples
+     */
+    void addSamples(uint64_t samples);
+
+    /**
+     * @brief Set a text field describing the run, such as the name of the input file
+     *
+     * @param name Name of the field
+     * @param value Value of the field
+     */
+    void setField(const string &name, const string &value);
+
+    /**
+     * @brief Write the statistics of the run and of every phase as JSON
+     *
+     * The wall time of the run is taken when the statistics are written
+     *
+     * @param output Stream receiving the JSON
+     */
+    void writeJson(ostream &output);
+
+    /**
+     * @brief Gets the peak resident memory of the process so far
+     *
+     * @return Peak resident memory in bytes, 0 if the platform does not report it
+     */
+    static uint64_t getPeakRss();
+
+private:
+    /**
+     * @brief Protects the fields below
+     *
+     */
+    mutex lock;
+
+    /**
+     * @brief Statistics of every phase, in the order the phases were added. Adding a phase does not move the others
+     *
+     */
+    deque<phaseStats> phases;
+
+    /**
+     * @brief Text fields describing the run
+     *
+     */
+    vector<pair<string, string>> fields;
+
+    /**
+     * @brief Number of input samples of the run
+     *
+     */
+    uint64_t samples;
+
+    /**
+     * @brief Start of the run
+     *
+     */
+    chrono::steady_clock::time_point start;
+};
+
+/**
+ * @brief Measures the time of one run of a phase, from its construction until stop is called or it is destroyed
+ *
+ */
+class scopedTimer
+{
+public:
+    /**
+     * @brief Construct a new scoped timer object and start timing
+     *
+     * @param stats Statistics of the run, NULL to not measure anything
+     * @param phase Index of the phase, from runStats::addPhase
+     */
+    scopedTimer(runStats *stats, uint32_t phase);
+
+    /**
+     * @brief Destructor, records the phase unless stop was called
+     *
+     */
+    ~scopedTimer();
+
+    scopedTimer(const scopedTimer &obj) = delete;
+    scopedTimer &operator=(const scopedTimer &obj) = delete;
+
+    /**
+     * @brief Add to the work done in this run of the phase
+     *
+     * @param samples Number of samples handled
+     * @param bytes Number of bytes read or written
+     * @param macs Number of multiply-accumulates
+     */
+    void count(uint64_t samples, uint64_t bytes, uint64_t macs);
+
+    /**
+     * @brief Stop timing and record the phase
+     *
+     */
+    void stop();
+
+private:
+    /**
+     * @brief Statistics receiving the measurement, NULL once recorded or when not measuring
+     *
+     */
+    runStats *stats;
+
+    /**
+     * @brief Index of the phase
+     *
+     */
+    uint32_t phase;
+
+    /**
+     * @brief Work done so far, passed on to runStats::record
+     *
+     */
+    uint64_t samples;
+    uint64_t bytes;
+    uint64_t macs;
+
+    /**
+     * @brief Time the timer was started
+     *
+     */
+    chrono::steady_clock::time_point start;
+};
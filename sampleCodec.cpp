@@ -0,0 +1,558 @@
+/**
+ * @file sampleCodec.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the sampleCodec class
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include "sampleCodec.hpp"
+#include "firKernels.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SAMPLE_CODEC_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/**
+ * @brief Storage type of 24 bit samples, which are stored in 3 bytes
+ *
+ */
+struct packedInt24
+{
+};
+
+/**
+ * @brief Clamp a sample to the range of an integer storage type
+ *
+ * NaN, which a float input file can hold, is not ordered against the limits, so it is mapped to the lowest
+ * value explicitly, as the vectorised conversions do
+ *
+ * @param value Sample to be clamped
+ * @param lowest Lowest value of the storage type
+ * @param highest Highest value of the storage type
+ * @return The clamped sample
+ */
+static inline double clampSample(double value, double lowest, double highest)
+{
+    return isnan(value) ? lowest : min(max(value, lowest), highest);
+}
+
+/**
+ * @brief Loading and storing one sample of a storage type
+ *
+ */
+template <typename Storage>
+struct sampleTraits;
+
+template <>
+struct sampleTraits<int16_t>
+{
+    static constexpr uint32_t Bytes = 2;
+    static constexpr bool Integer = true;
+    static constexpr double Min = -32768.0;
+    static constexpr double Max = 32767.0;
+    static inline double load(const unsigned char *p)
+    {
+        int16_t sample;
+        memcpy(&sample, p, sizeof(sample));
+        return sample;
+    }
+    static inline void store(double value, unsigned char *p)
+    {
+        int16_t sample = (int16_t)round(clampSample(value, Min, Max));
+        memcpy(p, &sample, sizeof(sample));
+    }
+};
+
+template <>
+struct sampleTraits<packedInt24>
+{
+    static constexpr uint32_t Bytes = 3;
+    static constexpr bool Integer = true;
+    static constexpr double Min = -8388608.0;
+    static constexpr double Max = 8388607.0;
+    static inline double load(const unsigned char *p)
+    {
+        // -- Little endian, the sign comes from the most significant byte
+        return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)(int32_t)(int8_t)p[2] << 16));
+    }
+    static inline void store(double value, unsigned char *p)
+    {
+        uint32_t sample = (uint32_t)(int32_t)round(clampSample(value, Min, Max));
+        p[0] = (unsigned char)sample;
+        p[1] = (unsigned char)(sample >> 8);
+        p[2] = (unsigned char)(sample >> 16);
+    }
+};
+
+template <>
+struct sampleTraits<int32_t>
+{
+    static constexpr uint32_t Bytes = 4;
+    static constexpr bool Integer = true;
+    static constexpr double Min = -2147483648.0;
+    static constexpr double Max = 2147483647.0;
+    static inline double load(const unsigned char *p)
+    {
+        int32_t sample;
+        memcpy(&sample, p, sizeof(sample));
+        return sample;
+    }
+    static inline void store(double value, unsigned char *p)
+    {
+        int32_t sample = (int32_t)round(clampSample(value, Min, Max));
+        memcpy(p, &sample, sizeof(sample));
+    }
+};
+
+template <>
+struct sampleTraits<float>
+{
+    static constexpr uint32_t Bytes = 4;
+    static constexpr bool Integer = false;
+    static constexpr double Min = -numeric_limits<double>::infinity();
+    static constexpr double Max = numeric_limits<double>::infinity();
+    static inline double load(const unsigned char *p)
+    {
+        float sample;
+        memcpy(&sample, p, sizeof(sample));
+        return sample;
+    }
+    static inline void store(double value, unsigned char *p)
+    {
+        float sample = (float)value;
+        memcpy(p, &sample, sizeof(sample));
+    }
+};
+
+template <typename Storage>
+static void unpackScalar(const unsigned char *input, uint32_t stride, double *output, uint64_t count)
+{
+    uint64_t step = (uint64_t)stride * sampleTraits<Storage>::Bytes;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        output[i] = sampleTraits<Storage>::load(input + i * step);
+    }
+}
+
+/**
+ * @brief Triangular dither noise of up to 1 least significant bit, the sum of two uniform values between -0.5
+ *        and 0.5. The uniform values come from 4 xorshift128+ generators side by side, so the vectorised version
+ *        draws the noise of 4 samples at once and both versions give the same noise for the same seed
+ *
+ */
+struct ditherNoise
+{
+    /**
+     * @brief State of the generators, the first and second word of each of the 4 generators
+     *
+     */
+    alignas(32) uint64_t state[2][4];
+
+    /**
+     * @brief Noise of the current 4 samples and the number of them used so far
+     *
+     */
+    double values[4];
+    uint32_t used;
+
+    ditherNoise(uint64_t seed)
+    {
+        // -- Spread the seed over the state with splitmix64, which never leaves a generator all zero
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            seed += 0x9E3779B97F4A7C15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            state[i / 4][i % 4] = z ^ (z >> 31);
+        }
+        used = 4;
+    }
+
+    static inline double uniform(uint64_t random)
+    {
+        // -- The top 52 bits make up the mantissa of a double between 1 and 2
+        uint64_t bits = (random >> 12) | 0x3FF0000000000000ull;
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value - 1.5;
+    }
+
+    inline uint64_t nextRandom(uint32_t lane)
+    {
+        uint64_t x = state[0][lane];
+        uint64_t y = state[1][lane];
+        uint64_t random = x + y;
+        x ^= x << 23;
+        state[0][lane] = y;
+        state[1][lane] = x ^ y ^ (x >> 18) ^ (y >> 5);
+        return random;
+    }
+
+    inline double next()
+    {
+        if (used == 4)
+        {
+            for (uint32_t lane = 0; lane < 4; lane++)
+            {
+                double first = uniform(nextRandom(lane));
+                values[lane] = first + uniform(nextRandom(lane));
+            }
+            used = 0;
+        }
+        return values[used++];
+    }
+};
+
+template <typename Storage>
+static void packScalar(const double *input, unsigned char *output, uint32_t stride, uint64_t count, ditherNoise *noise, uint64_t &clipped)
+{
+    uint64_t step = (uint64_t)stride * sampleTraits<Storage>::Bytes;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        double value = input[i];
+        if (sampleTraits<Storage>::Integer)
+        {
+            value += (noise != NULL) ? noise->next() : 0;
+            clipped += (value >= sampleTraits<Storage>::Max + 0.5 || value <= sampleTraits<Storage>::Min - 0.5 || isnan(value));
+        }
+        sampleTraits<Storage>::store(value, output + i * step);
+    }
+}
+
+#ifdef SAMPLE_CODEC_X86
+namespace avx2Codec
+{
+#define SIMD_TARGET __attribute__((target("avx2")))
+
+    SIMD_TARGET static inline __m256d roundHalfAway(__m256d v)
+    {
+        // -- Truncate, then step away from zero when the remainder is at least a half, as round does
+        __m256d truncated = _mm256_round_pd(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        __m256d remainder = _mm256_sub_pd(v, truncated);
+        __m256d up = _mm256_and_pd(_mm256_cmp_pd(remainder, _mm256_set1_pd(0.5), _CMP_GE_OQ), _mm256_set1_pd(1.0));
+        __m256d down = _mm256_and_pd(_mm256_cmp_pd(remainder, _mm256_set1_pd(-0.5), _CMP_LE_OQ), _mm256_set1_pd(1.0));
+        return _mm256_sub_pd(_mm256_add_pd(truncated, up), down);
+    }
+
+    template <typename Storage>
+    SIMD_TARGET static inline __m128i saturateInt32(__m256d v)
+    {
+        // -- Clamp to the range of the storage type, round, and convert to 32 bit integers. The clamped and
+        // -- rounded values are exact in double precision, so the conversion does not round again
+        // -- NaN becomes the lowest value, as max returns its second operand when the first is NaN
+        v = _mm256_min_pd(_mm256_max_pd(v, _mm256_set1_pd(sampleTraits<Storage>::Min)), _mm256_set1_pd(sampleTraits<Storage>::Max));
+        return _mm256_cvttpd_epi32(roundHalfAway(v));
+    }
+
+    SIMD_TARGET static inline __m256i nextRandom(__m256i &state0, __m256i &state1)
+    {
+        // -- xorshift128+ on 4 generators at once
+        __m256i x = state0;
+        __m256i y = state1;
+        __m256i random = _mm256_add_epi64(x, y);
+        x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 23));
+        state0 = y;
+        state1 = _mm256_xor_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(_mm256_srli_epi64(x, 18), _mm256_srli_epi64(y, 5)));
+        return random;
+    }
+
+    SIMD_TARGET static inline __m256d uniform(__m256i random)
+    {
+        __m256i bits = _mm256_or_si256(_mm256_srli_epi64(random, 12), _mm256_set1_epi64x(0x3FF0000000000000ll));
+        return _mm256_sub_pd(_mm256_castsi256_pd(bits), _mm256_set1_pd(1.5));
+    }
+
+    /**
+     * @brief Dither, count the samples that clip and saturate 4 samples, keeping the state of the dither
+     *        generators in registers
+     *
+     */
+    template <typename Storage>
+    SIMD_TARGET static inline __m128i quantise(__m256d v, bool dither, __m256i &state0, __m256i &state1, uint64_t &clipped)
+    {
+        if (dither)
+        {
+            __m256d first = uniform(nextRandom(state0, state1));
+            v = _mm256_add_pd(v, _mm256_add_pd(first, uniform(nextRandom(state0, state1))));
+        }
+        // -- The unordered compare also counts NaN, which saturates to the lowest value
+        __m256d high = _mm256_cmp_pd(v, _mm256_set1_pd(sampleTraits<Storage>::Max + 0.5), _CMP_NLT_UQ);
+        __m256d low = _mm256_cmp_pd(v, _mm256_set1_pd(sampleTraits<Storage>::Min - 0.5), _CMP_LE_OQ);
+        clipped += __builtin_popcount(_mm256_movemask_pd(_mm256_or_pd(high, low)));
+        return saturateInt32<Storage>(v);
+    }
+
+    SIMD_TARGET static inline void storeInt32x8(__m256i samples, double *output)
+    {
+        _mm256_storeu_pd(output, _mm256_cvtepi32_pd(_mm256_castsi256_si128(samples)));
+        _mm256_storeu_pd(output + 4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(samples, 1)));
+    }
+
+    /**
+     * @brief Vectorised conversions of contiguous samples, 8 samples at a time. Returns the number of samples
+     *        converted, the remaining samples are converted by the scalar version
+     *
+     */
+    template <typename Storage>
+    SIMD_TARGET static uint64_t unpackBlock(const unsigned char *input, double *output, uint64_t count);
+
+    template <typename Storage>
+    SIMD_TARGET static uint64_t packBlock(const double *input, unsigned char *output, uint64_t count, ditherNoise *noise, uint64_t &clipped);
+
+    template <>
+    SIMD_TARGET uint64_t unpackBlock<int16_t>(const unsigned char *input, double *output, uint64_t count)
+    {
+        uint64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            storeInt32x8(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(input + 2 * i))), output + i);
+        }
+        return i;
+    }
+
+    template <>
+    SIMD_TARGET uint64_t packBlock<int16_t>(const double *input, unsigned char *output, uint64_t count, ditherNoise *noise, uint64_t &clipped)
+    {
+        __m256i state0 = (noise != NULL) ? _mm256_load_si256((const __m256i *)noise->state[0]) : _mm256_setzero_si256();
+        __m256i state1 = (noise != NULL) ? _mm256_load_si256((const __m256i *)noise->state[1]) : _mm256_setzero_si256();
+        uint64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i lo = quantise<int16_t>(_mm256_loadu_pd(input + i), noise != NULL, state0, state1, clipped);
+            __m128i hi = quantise<int16_t>(_mm256_loadu_pd(input + i + 4), noise != NULL, state0, state1, clipped);
+            _mm_storeu_si128((__m128i *)(output + 2 * i), _mm_packs_epi32(lo, hi));
+        }
+        if (noise != NULL)
+        {
+            _mm256_store_si256((__m256i *)noise->state[0], state0);
+            _mm256_store_si256((__m256i *)noise->state[1], state1);
+        }
+        return i;
+    }
+
+    template <>
+    SIMD_TARGET uint64_t unpackBlock<packedInt24>(const unsigned char *input, double *output, uint64_t count)
+    {
+        // -- Each 128 bit lane loads 4 samples, whose 3 bytes are moved into the top of a 32 bit lane and
+        // -- shifted down with sign extension. The loads read 4 bytes past the 8 samples, so 10 must be left
+        const __m256i spread = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                                -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        uint64_t i = 0;
+        for (; i + 10 <= count; i += 8)
+        {
+            const unsigned char *p = input + 3 * i;
+            __m256i bytes = _mm256_set_m128i(_mm_loadu_si128((const __m128i *)(p + 12)), _mm_loadu_si128((const __m128i *)p));
+            storeInt32x8(_mm256_srai_epi32(_mm256_shuffle_epi8(bytes, spread), 8), output + i);
+        }
+        return i;
+    }
+
+    template <>
+    SIMD_TARGET uint64_t packBlock<packedInt24>(const double *input, unsigned char *output, uint64_t count, ditherNoise *noise, uint64_t &clipped)
+    {
+        // -- The low 3 bytes of each 32 bit lane are packed into the first 12 bytes. Each store writes 4 bytes
+        // -- past its samples, which the next store or the scalar version overwrites, so 10 must be left
+        const __m128i low24 = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        __m256i state0 = (noise != NULL) ? _mm256_load_si256((const __m256i *)noise->state[0]) : _mm256_setzero_si256();
+        __m256i state1 = (noise != NULL) ? _mm256_load_si256((const __m256i *)noise->state[1]) : _mm256_setzero_si256();
+        uint64_t i = 0;
+        for (; i + 10 <= count; i += 8)
+        {
+            unsigned char *p = output + 3 * i;
+            __m128i lo = quantise<packedInt24>(_mm256_loadu_pd(input + i), noise != NULL, state0, state1, clipped);
+            __m128i hi = quantise<packedInt24>(_mm256_loadu_pd(input + i + 4), noise != NULL, state0, state1, clipped);
+            _mm_storeu_si128((__m128i *)p, _mm_shuffle_epi8(lo, low24));
+            _mm_storeu_si128((__m128i *)(p + 12), _mm_shuffle_epi8(hi, low24));
+        }
+        if (noise != NULL)
+        {
+            _mm256_store_si256((__m256i *)noise->state[0], state0);
+            _mm256_store_si256((__m256i *)noise->state[1], state1);
+        }
+        return i;
+    }
+
+    template <>
+    SIMD_TARGET uint64_t unpackBlock<int32_t>(const unsigned char *input, double *output, uint64_t count)
+    {
+        uint64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            storeInt32x8(_mm256_loadu_si256((const __m256i *)(input + 4 * i)), output + i);
+        }
+        return i;
+    }
+
+    template <>
+    SIMD_TARGET uint64_t packBlock<int32_t>(const double *input, unsigned char *output, uint64_t count, ditherNoise *noise, uint64_t &clipped)
+    {
+        __m256i state0 = (noise != NULL) ? _mm256_load_si256((const __m256i *)noise->state[0]) : _mm256_setzero_si256();
+        __m256i state1 = (noise != NULL) ? _mm256_load_si256((const __m256i *)noise->state[1]) : _mm256_setzero_si256();
+        uint64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            _mm_storeu_si128((__m128i *)(output + 4 * i), quantise<int32_t>(_mm256_loadu_pd(input + i), noise != NULL, state0, state1, clipped));
+            _mm_storeu_si128((__m128i *)(output + 4 * i + 16), quantise<int32_t>(_mm256_loadu_pd(input + i + 4), noise != NULL, state0, state1, clipped));
+        }
+        if (noise != NULL)
+        {
+            _mm256_store_si256((__m256i *)noise->state[0], state0);
+            _mm256_store_si256((__m256i *)noise->state[1], state1);
+        }
+        return i;
+    }
+
+    template <>
+    SIMD_TARGET uint64_t unpackBlock<float>(const unsigned char *input, double *output, uint64_t count)
+    {
+        uint64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const float *p = (const float *)(input + 4 * i);
+            _mm256_storeu_pd(output + i, _mm256_cvtps_pd(_mm_loadu_ps(p)));
+            _mm256_storeu_pd(output + i + 4, _mm256_cvtps_pd(_mm_loadu_ps(p + 4)));
+        }
+        return i;
+    }
+
+    template <>
+    SIMD_TARGET uint64_t packBlock<float>(const double *input, unsigned char *output, uint64_t count, ditherNoise *, uint64_t &)
+    {
+        // -- Float samples are neither dithered nor clipped
+        uint64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            float *p = (float *)(output + 4 * i);
+            _mm_storeu_ps(p, _mm256_cvtpd_ps(_mm256_loadu_pd(input + i)));
+            _mm_storeu_ps(p + 4, _mm256_cvtpd_ps(_mm256_loadu_pd(input + i + 4)));
+        }
+        return i;
+    }
+
+#undef SIMD_TARGET
+}
+#endif
+
+/**
+ * @brief Checks if the vectorised conversions can be used
+ *
+ * @return True if the selected fir kernels use AVX2 or AVX-512
+ */
+static bool useVectorised()
+{
+#ifdef SAMPLE_CODEC_X86
+    return firKernels::getSimdLevel() == simdLevel::avx2 || firKernels::getSimdLevel() == simdLevel::avx512;
+#else
+    return false;
+#endif
+}
+
+template <typename Storage>
+static void unpackAs(const unsigned char *input, uint32_t stride, double *output, uint64_t count)
+{
+    // -- Interleaved samples of several channels are taken out one at a time
+    uint64_t done = 0;
+#ifdef SAMPLE_CODEC_X86
+    if (stride == 1 && useVectorised())
+    {
+        done = avx2Codec::unpackBlock<Storage>(input, output, count);
+    }
+#endif
+    unpackScalar<Storage>(input + done * stride * sampleTraits<Storage>::Bytes, stride, output + done, count - done);
+}
+
+template <typename Storage>
+static void packAs(const double *input, unsigned char *output, uint32_t stride, uint64_t count, packState &state)
+{
+    // -- Float samples have no least significant bit to dither
+    ditherNoise noise(state.ditherSeed);
+    ditherNoise *dither = (state.dither && sampleTraits<Storage>::Integer) ? &noise : NULL;
+
+    uint64_t done = 0;
+#ifdef SAMPLE_CODEC_X86
+    if (stride == 1 && useVectorised())
+    {
+        done = avx2Codec::packBlock<Storage>(input, output, count, dither, state.clippedSamples);
+    }
+#endif
+    packScalar<Storage>(input + done, output + done * stride * sampleTraits<Storage>::Bytes, stride, count - done, dither, state.clippedSamples);
+}
+
+uint32_t sampleCodec::getBytesPerSample(sampleFormat format)
+{
+    switch (format)
+    {
+    case sampleFormat::int16:
+        return sampleTraits<int16_t>::Bytes;
+    case sampleFormat::int24:
+        return sampleTraits<packedInt24>::Bytes;
+    case sampleFormat::int32:
+        return sampleTraits<int32_t>::Bytes;
+    default:
+        return sampleTraits<float>::Bytes;
+    }
+}
+
+string sampleCodec::getFormatName(sampleFormat format)
+{
+    switch (format)
+    {
+    case sampleFormat::int16:
+        return "16 bit integer";
+    case sampleFormat::int24:
+        return "24 bit integer";
+    case sampleFormat::int32:
+        return "32 bit integer";
+    default:
+        return "32 bit float";
+    }
+}
+
+void sampleCodec::unpack(sampleFormat format, const unsigned char *input, uint32_t stride, double *output, uint64_t count)
+{
+    switch (format)
+    {
+    case sampleFormat::int16:
+        unpackAs<int16_t>(input, stride, output, count);
+        break;
+    case sampleFormat::int24:
+        unpackAs<packedInt24>(input, stride, output, count);
+        break;
+    case sampleFormat::int32:
+        unpackAs<int32_t>(input, stride, output, count);
+        break;
+    default:
+        unpackAs<float>(input, stride, output, count);
+        break;
+    }
+}
+
+void sampleCodec::pack(sampleFormat format, const double *input, unsigned char *output, uint32_t stride, uint64_t count, packState &state)
+{
+    switch (format)
+    {
+    case sampleFormat::int16:
+        packAs<int16_t>(input, output, stride, count, state);
+        break;
+    case sampleFormat::int24:
+        packAs<packedInt24>(input, output, stride, count, state);
+        break;
+    case sampleFormat::int32:
+        packAs<int32_t>(input, output, stride, count, state);
+        break;
+    default:
+        packAs<float>(input, output, stride, count, state);
+        break;
+    }
+}
@@ -0,0 +1,111 @@
+/**
+ * @file sampleCodec.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition to convert between the stored samples of a wav file and the samples the filters work on
+ *
+ * The filters work on double precision samples at the scale of the stored samples: 16 bit samples lie between
+ * -32768 and 32767, 24 bit samples between -8388608 and 8388607, 32 bit samples between -2^31 and 2^31 - 1 and
+ * float samples between -1 and 1. A block of stored samples is unpacked into a block of working samples before
+ * filtering and the filtered block is packed back, each in a single pass. The conversions are templated on the
+ * storage type, with vectorised versions for processors supporting AVX2 that convert 8 samples at a time,
+ * including the packed 3 byte samples of 24 bit files.
+ *
+ * @version 0.1
+ * @date 2021-12-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @brief Storage type of the samples of a wav file
+ *
+ */
+enum class sampleFormat
+{
+    int16,
+    int24,
+    int32,
+    float32
+};
+
+/**
+ * @brief Settings and results of converting working samples to stored samples
+ *
+ */
+struct packState
+{
+    /**
+     * @brief Add triangular (TPDF) dither of up to 1 least significant bit to integer samples before rounding
+     *
+     */
+    bool dither = false;
+
+    /**
+     * @brief Seed of the dither noise. The same samples packed with the same seed give the same output
+     *
+     */
+    uint64_t ditherSeed = 0;
+
+    /**
+     * @brief Number of integer samples saturated to the range of the storage type, added up over every call
+     *
+     */
+    uint64_t clippedSamples = 0;
+};
+
+class sampleCodec
+{
+public:
+    /**
+     * @brief Gets the number of bytes of one stored sample
+     *
+     * @param format Storage type of the samples
+     * @return Number of bytes per sample
+     */
+    static uint32_t getBytesPerSample(sampleFormat format);
+
+    /**
+     * @brief Gets the name of a storage type
+     *
+     * @param format Storage type of the samples
+     * @return Name of the storage type, as used in messages
+     */
+    static string getFormatName(sampleFormat format);
+
+    /**
+     * @brief Convert stored samples to working samples
+     *
+     * @param format Storage type of the samples
+     * @param input First stored sample
+     * @param stride Distance between two samples to be converted, in samples. The number of channels when
+     *               taking the samples of one channel out of interleaved audio data, otherwise 1
+     * @param output Array of count working samples
+     * @param count Number of samples
+     */
+    static void unpack(sampleFormat format, const unsigned char *input, uint32_t stride, double *output, uint64_t count);
+
+    /**
+     * @brief Convert working samples to stored samples
+     *
+     * Integer samples are optionally dithered, then rounded to the nearest integer, halves away from zero, and
+     * saturated to the range of the storage type. The samples that had to be saturated are counted. Float samples
+     * are rounded to the nearest float and may lie outside -1 to 1
+     *
+     * @param format Storage type of the samples
+     * @param input Array of count working samples
+     * @param output First stored sample
+     * @param stride Distance between two converted samples, in samples. The number of channels when putting the
+     *               samples of one channel into interleaved audio data, otherwise 1
+     * @param count Number of samples
+     * @param state Dither settings, receives the number of saturated samples
+     */
+    static void pack(sampleFormat format, const double *input, unsigned char *output, uint32_t stride, uint64_t count, packState &state);
+};
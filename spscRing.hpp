@@ -0,0 +1,229 @@
+/**
+ * @file spscRing.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition for a lock-free ring buffer between one producer and one consumer thread
+ * 
+ * The ring holds a fixed number of items. The producer thread adds items at the tail and the consumer
+ * thread takes them from the head, each only writing its own index, so no lock is needed. Items are
+ * swapped in and out of the slots instead of copied, so buffers such as vectors are handed back and
+ * forth without being reallocated. A producer that finds the ring full waits for the consumer, which
+ * keeps a fast producer from running ahead of a slow consumer. A waiting thread retries a few times and
+ * then sleeps on a condition variable until the other thread moves its index, so threads waiting for a
+ * slow stage do not keep the processor busy.
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <utility>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @brief Number of times a full or empty ring is checked again before the waiting thread sleeps
+ * 
+ */
+constexpr uint32_t Ring_Spin_Count = 16;
+
+template <typename T>
+class spscRing
+{
+public:
+    /**
+     * @brief Construct a new ring buffer object
+     * 
+     * @param capacity Maximum number of items in the ring
+     */
+    spscRing(uint32_t capacity) : slots(max(capacity, (uint32_t)1)), head(0), tail(0), sleepers(0)
+    {
+    }
+
+    /**
+     * @brief Add an item at the tail of the ring, if there is room. Only called by the producer thread
+     * 
+     * @param item Item to be added, swapped with the previous contents of the slot
+     * @return True if the item was added
+     */
+    bool tryPush(T &item)
+    {
+        if (!addItem(item))
+        {
+            return false;
+        }
+        wakeSleepers();
+        return true;
+    }
+
+    /**
+     * @brief Take the item at the head of the ring, if there is one. Only called by the consumer thread
+     * 
+     * @param item Receives the item, its previous contents are left in the slot for the producer to reuse
+     * @return True if an item was taken
+     */
+    bool tryPop(T &item)
+    {
+        if (!takeItem(item))
+        {
+            return false;
+        }
+        wakeSleepers();
+        return true;
+    }
+
+    /**
+     * @brief Add an item at the tail of the ring, waiting until there is room
+     * 
+     * @param item Item to be added, swapped with the previous contents of the slot
+     */
+    void push(T &item)
+    {
+        for (uint32_t i = 0; i < Ring_Spin_Count; i++)
+        {
+            if (tryPush(item))
+            {
+                return;
+            }
+            this_thread::yield();
+        }
+        sleepUntil([this, &item] { return addItem(item); });
+        wakeSleepers();
+    }
+
+    /**
+     * @brief Take the item at the head of the ring, waiting until there is one
+     * 
+     * @param item Receives the item
+     */
+    void pop(T &item)
+    {
+        for (uint32_t i = 0; i < Ring_Spin_Count; i++)
+        {
+            if (tryPop(item))
+            {
+                return;
+            }
+            this_thread::yield();
+        }
+        sleepUntil([this, &item] { return takeItem(item); });
+        wakeSleepers();
+    }
+
+private:
+    /**
+     * @brief Add an item at the tail of the ring if there is room, without waking the consumer
+     * 
+     * @param item Item to be added, swapped with the previous contents of the slot
+     * @return True if the item was added
+     */
+    bool addItem(T &item)
+    {
+        uint64_t currentTail = tail.load(memory_order_relaxed);
+        if (currentTail - head.load(memory_order_acquire) == slots.size())
+        {
+            return false;
+        }
+
+        swap(slots[currentTail % slots.size()], item);
+        tail.store(currentTail + 1, memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Take the item at the head of the ring if there is one, without waking the producer
+     * 
+     * @param item Receives the item, its previous contents are left in the slot for the producer to reuse
+     * @return True if an item was taken
+     */
+    bool takeItem(T &item)
+    {
+        uint64_t currentHead = head.load(memory_order_relaxed);
+        if (currentHead == tail.load(memory_order_acquire))
+        {
+            return false;
+        }
+
+        swap(slots[currentHead % slots.size()], item);
+        head.store(currentHead + 1, memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Sleep on the condition variable until the given check succeeds
+     * 
+     * The sleeper is counted before the ring is checked again, so the other thread either sees the
+     * sleeper and wakes it, or the check sees the index the other thread moved. The check is made with
+     * the lock held, so it must not wake the other thread itself
+     * 
+     * @param ready Check to be repeated each time the thread wakes up
+     */
+    template <typename Check>
+    void sleepUntil(Check ready)
+    {
+        unique_lock<mutex> lock(sleepLock);
+        sleepers.fetch_add(1, memory_order_seq_cst);
+        atomic_thread_fence(memory_order_seq_cst);
+        indexMoved.wait(lock, ready);
+        sleepers.fetch_sub(1, memory_order_relaxed);
+    }
+
+    /**
+     * @brief Wake the other thread if it sleeps waiting for an index to move
+     * 
+     */
+    void wakeSleepers()
+    {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (sleepers.load(memory_order_relaxed) != 0)
+        {
+            // -- Taking the lock waits until the sleeper is actually waiting on the condition variable
+            lock_guard<mutex> guard(sleepLock);
+            indexMoved.notify_all();
+        }
+    }
+
+    /**
+     * @brief Slots holding the items
+     * 
+     */
+    vector<T> slots;
+
+    /**
+     * @brief Number of items taken so far, only written by the consumer thread
+     * 
+     */
+    alignas(64) atomic<uint64_t> head;
+
+    /**
+     * @brief Number of items added so far, only written by the producer thread
+     * 
+     */
+    alignas(64) atomic<uint64_t> tail;
+
+    /**
+     * @brief Number of threads sleeping on the condition variable
+     * 
+     */
+    alignas(64) atomic<uint32_t> sleepers;
+
+    /**
+     * @brief Lock guarding the condition variable
+     * 
+     */
+    mutex sleepLock;
+
+    /**
+     * @brief Signalled when a sleeping thread may find that an index moved
+     * 
+     */
+    condition_variable indexMoved;
+};
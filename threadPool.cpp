@@ -0,0 +1,194 @@
+/**
+ * @file threadPool.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the threadPool class
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include "threadPool.hpp"
+
+using namespace std;
+
+threadPool::threadPool(uint32_t threadCount)
+{
+    currentTask = NULL;
+    workGeneration = 0;
+    busyWorkers = 0;
+    stopping = false;
+
+    if (threadCount == 0)
+    {
+        threadCount = max(thread::hardware_concurrency(), 1u);
+    }
+
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        queues.emplace_back(new taskQueue());
+    }
+
+    // -- The calling thread also runs tasks, so one thread less is started
+    for (uint32_t i = 1; i < threadCount; i++)
+    {
+        workers.emplace_back(&threadPool::workerLoop, this, i);
+    }
+}
+
+threadPool::~threadPool()
+{
+    {
+        lock_guard<mutex> guard(workLock);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    for (uint64_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+uint32_t threadPool::getThreadCount()
+{
+    return (uint32_t)workers.size() + 1;
+}
+
+bool threadPool::takeTask(uint32_t self, uint64_t &task)
+{
+    {
+        taskQueue &own = *queues[self];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    // -- Steal from the other queues, starting with the next thread so thieves spread over their victims
+    for (uint32_t i = 1; i < (uint32_t)queues.size(); i++)
+    {
+        taskQueue &victim = *queues[(self + i) % queues.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void threadPool::runTasks(uint32_t self)
+{
+    // -- No tasks are added while the work runs, so once every queue is empty this thread is done
+    uint64_t task;
+    while (takeTask(self, task))
+    {
+        try
+        {
+            (*currentTask)(task);
+        }
+        catch (...)
+        {
+            // -- Keep the first error for the calling thread, an exception must not leave a worker thread
+            lock_guard<mutex> guard(workLock);
+            if (!taskError)
+            {
+                taskError = current_exception();
+            }
+        }
+    }
+}
+
+void threadPool::workerLoop(uint32_t self)
+{
+    uint64_t seenGeneration = 0;
+
+    while (true)
+    {
+        {
+            unique_lock<mutex> guard(workLock);
+            workAvailable.wait(guard, [&] { return stopping || workGeneration != seenGeneration; });
+            if (stopping)
+            {
+                return;
+            }
+            seenGeneration = workGeneration;
+        }
+
+        runTasks(self);
+
+        {
+            lock_guard<mutex> guard(workLock);
+            busyWorkers--;
+        }
+        workFinished.notify_one();
+    }
+}
+
+void threadPool::parallelFor(uint64_t taskCount, const function<void(uint64_t)> &task)
+{
+    if (workers.empty() || taskCount < 2)
+    {
+        // -- As on several threads, every task runs and the first exception is rethrown at the end
+        exception_ptr error = NULL;
+        for (uint64_t i = 0; i < taskCount; i++)
+        {
+            try
+            {
+                task(i);
+            }
+            catch (...)
+            {
+                if (!error)
+                {
+                    error = current_exception();
+                }
+            }
+        }
+        if (error)
+        {
+            rethrow_exception(error);
+        }
+        return;
+    }
+
+    {
+        lock_guard<mutex> guard(workLock);
+        currentTask = &task;
+
+        // -- Every thread starts with a contiguous share of the tasks
+        for (uint32_t i = 0; i < (uint32_t)queues.size(); i++)
+        {
+            lock_guard<mutex> queueGuard(queues[i]->lock);
+            for (uint64_t t = taskCount * i / queues.size(); t < taskCount * (i + 1) / queues.size(); t++)
+            {
+                queues[i]->tasks.push_back(t);
+            }
+        }
+        busyWorkers = (uint32_t)workers.size();
+        workGeneration++;
+    }
+    workAvailable.notify_all();
+
+    runTasks(0);
+
+    // -- The task function lives on the stack of the caller, so wait for every worker thread to let go of it
+    unique_lock<mutex> guard(workLock);
+    workFinished.wait(guard, [&] { return busyWorkers == 0; });
+    currentTask = NULL;
+
+    if (taskError)
+    {
+        exception_ptr error = taskError;
+        taskError = NULL;
+        rethrow_exception(error);
+    }
+}
@@ -0,0 +1,168 @@
+/**
+ * @file threadPool.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition for a pool of worker threads
+ * 
+ * The worker threads are started once and then wait for work, so the cost of starting threads is not
+ * paid for every filter. Work is handed out as a number of independent tasks. Every thread starts with a
+ * contiguous share of the tasks in a queue of its own and runs them in order. A thread whose queue runs
+ * empty steals tasks from the end of the queues of the other threads, so threads that draw long tasks
+ * hand their remaining tasks to threads that drew short ones.
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include <cstdint>
+
+using namespace std;
+
+class threadPool
+{
+public:
+    /**
+     * @brief Construct a new thread pool object
+     * 
+     * @param threadCount Number of threads working on the tasks, including the calling thread. 0 uses one thread per processor core
+     */
+    threadPool(uint32_t threadCount);
+
+    /**
+     * @brief Destructor, stops the worker threads
+     * 
+     */
+    ~threadPool();
+
+    /**
+     * @brief Running threads cannot be copied
+     * 
+     */
+    threadPool(const threadPool &obj) = delete;
+    threadPool &operator=(const threadPool &obj) = delete;
+
+    /**
+     * @brief Gets the number of threads working on the tasks, including the calling thread
+     * 
+     * @return Returns the number of threads
+     */
+    uint32_t getThreadCount();
+
+    /**
+     * @brief Run the tasks 0 to taskCount - 1 and wait until all of them are done
+     * 
+     * The tasks are run concurrently in any order, so they must not depend on each other. Each thread
+     * runs its share from the lowest task number up, while stolen tasks are taken from the highest task
+     * number down, so callers that order their tasks from long to short get the long ones started first.
+     * If a task throws, the other tasks still run and the first exception thrown is rethrown once all are done
+     * 
+     * @param taskCount Number of tasks
+     * @param task Function called with the number of each task
+     */
+    void parallelFor(uint64_t taskCount, const function<void(uint64_t)> &task);
+
+private:
+    /**
+     * @brief Queue of tasks of one thread, also taken from by other threads once their own queue is empty
+     * 
+     */
+    struct taskQueue
+    {
+        mutex lock;
+        deque<uint64_t> tasks;
+    };
+
+    /**
+     * @brief Main loop of the worker threads, waiting for tasks and running them
+     * 
+     * @param self Index of the queue of the worker thread
+     */
+    void workerLoop(uint32_t self);
+
+    /**
+     * @brief Run tasks of the current work until no queue has any left
+     * 
+     * @param self Index of the queue of the running thread
+     */
+    void runTasks(uint32_t self);
+
+    /**
+     * @brief Take the next task of the own queue, or steal one from the end of another queue
+     * 
+     * @param self Index of the queue of the running thread
+     * @param task Set to the task taken
+     * @return True if a task was taken, false if all queues are empty
+     */
+    bool takeTask(uint32_t self, uint64_t &task);
+
+    /**
+     * @brief Worker threads
+     * 
+     */
+    vector<thread> workers;
+
+    /**
+     * @brief Protects the fields below, the task queues have locks of their own
+     * 
+     */
+    mutex workLock;
+
+    /**
+     * @brief Signalled when new work is available or the pool is stopped
+     * 
+     */
+    condition_variable workAvailable;
+
+    /**
+     * @brief Signalled when a worker thread has finished its part of the work
+     * 
+     */
+    condition_variable workFinished;
+
+    /**
+     * @brief Function of the current work
+     * 
+     */
+    const function<void(uint64_t)> *currentTask;
+
+    /**
+     * @brief First exception thrown by a task of the current work, rethrown by parallelFor
+     * 
+     */
+    exception_ptr taskError;
+
+    /**
+     * @brief Task queues, the calling thread uses the first one and worker thread i the queue i + 1
+     * 
+     */
+    vector<unique_ptr<taskQueue>> queues;
+
+    /**
+     * @brief Incremented for every new work, so worker threads can tell new work from old work
+     * 
+     */
+    uint64_t workGeneration;
+
+    /**
+     * @brief Number of worker threads still running tasks of the current work
+     * 
+     */
+    uint32_t busyWorkers;
+
+    /**
+     * @brief Set when the worker threads have to stop
+     * 
+     */
+    bool stopping;
+};
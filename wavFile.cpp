@@ -1,123 +1,493 @@
-/**
- * @file wavFile.cpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief Implementation of the wavFile class
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-#include <vector>
-#include <cstddef>
-#include <fstream>
-#include <iostream>
-#include "wavFile.hpp"
-
-using namespace std;
-
-wavFile::wavFile()
-{
-    // -- Default constructor
-}
-
-wavFile::wavFile(FILE *fp) : header(fp), filter()
-{
-    // -- Initialize some properties of the wave file
-    bytesPerSample = header.getbytesPerSample();
-    numberOfSamples = header.getNumberOfSamples();
-    samplesPerSecond = header.getSamplesPerSecond();
-
-    audioData.resize(numberOfSamples);
-    outputData.resize(numberOfSamples);
-
-    // -- Read raw audio data into the data buffer
-    uint64_t sampleCount;
-    int16_t sample;
-    sampleCount = 0;
-    sample = 0;
-
-    do
-    {
-        // -- Reading 16 bit audio data
-        if (fread(&sample, sizeof(int16_t), 1, fp) != 1)
-        {
-            // -- Nothing left to read
-            break;
-        }
-
-        sampleCount++;
-        audioData[sampleCount] = sample;
-
-    } while (sampleCount < numberOfSamples);
-
-    // -- Check if audio data was able to be read
-    if (sampleCount == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read raw audio data from input file";
-        exit(1);
-    }
-
-    // -- Initialize output data with the input audio data
-    copy(audioData.begin(), audioData.end(), outputData.begin());
-}
-
-wavFile::wavFile(const wavFile &obj) : header(obj.header), filter(obj.filter)
-{
-    // -- Copy constructor
-    audioData = obj.audioData;
-    outputData = obj.outputData;
-    bytesPerSample = obj.bytesPerSample;
-    numberOfSamples = obj.numberOfSamples;
-    samplesPerSecond = obj.samplesPerSecond;
-}
-
-void wavFile::processFirFilter(vector<double> filterCoeffs, uint16_t filterCoeffsLen)
-{
-    uint64_t batches, remaining;
-    vector<int16_t> batchData;
-
-    // -- Split up the total number of samples into processable chunks
-    batches = numberOfSamples / samplesPerSecond;
-    remaining = numberOfSamples % samplesPerSecond;
-    batchData.resize(samplesPerSecond);
-    fill(batchData.begin(), batchData.end(), 0);
-    fill(outputData.begin(), outputData.end(), 0);
-
-    // -- For each chunk apply the filter and repeat until all sample data has been processed
-
-    for (uint64_t i = 0; i < batches; i++)
-    {
-        // -- Calculate the vector offsets for where to start reading and writting the batch data
-        uint64_t audioDataStartOffset, audioDataEndOffset, outputDataOffset;
-        audioDataStartOffset = (i * samplesPerSecond);
-        audioDataEndOffset = ((i + 1) * samplesPerSecond - 1);
-        outputDataOffset = (i * samplesPerSecond);
-
-        copy(audioData.begin() + audioDataStartOffset, audioData.begin() + audioDataEndOffset, batchData.begin());
-        batchData = filter.applyFirFilter(batchData, filterCoeffs, filterCoeffsLen, samplesPerSecond);
-        copy(batchData.begin(), batchData.end(), outputData.begin() + outputDataOffset);
-    }
-
-    // -- Filter the last remaining samples that were not divisible by the batch size
-    fill(batchData.begin(), batchData.end(), 0);
-    copy(audioData.end() - remaining, audioData.end(), batchData.begin());
-    batchData = filter.applyFirFilter(batchData, filterCoeffs, filterCoeffsLen, samplesPerSecond);
-    copy(batchData.begin(), batchData.begin() + remaining, outputData.end() - remaining);
-}
-
-void wavFile::writeWavFile(FILE *fp)
-{
-    // -- Write the file header
-    header.writeHeader(fp);
-
-    // -- Write the data buffer to the output file
-    if (fwrite(&outputData[0], bytesPerSample, outputData.size(), fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not write audio data into output file";
-        exit(1);
-    }
-}
+/**
+ * @file wavFile.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the wavFile class
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include "wavFile.hpp"
+#include "filterError.hpp"
+#include "firKernels.hpp"
+
+using namespace std;
+
+wavFile::wavFile()
+{
+    // -- Default constructor
+    bytesPerSample = 0;
+    numberOfSamples = 0;
+    samplesPerSecond = 0;
+    format = sampleFormat::int16;
+    numChannels = 1;
+    inputData = NULL;
+    pool = NULL;
+    dither = false;
+    clippedSamples = 0;
+    stats = NULL;
+    stageNumber = 1;
+}
+
+wavFile::wavFile(FILE *fp, runStats *stats) : header(fp, stats), filter()
+{
+    scopedTimer timer(stats, (stats != NULL) ? stats->addPhase("read") : 0);
+
+    // -- Initialize some properties of the wave file
+    bytesPerSample = header.getbytesPerSample();
+    format = header.getSampleFormat();
+    numberOfSamples = header.getNumberOfSamples();
+    samplesPerSecond = header.getSamplesPerSecond();
+    numChannels = header.getNumChannels();
+    selectedChannels = header.selectChannels(vector<uint32_t>());
+    inputData = NULL;
+    pool = NULL;
+    dither = false;
+    clippedSamples = 0;
+    this->stats = stats;
+    stageNumber = 1;
+
+    // -- Programs writing the file to a pipe may not know the size of the audio data in advance,
+    // -- in which case the audio data runs until the end of the file
+    bool sizeKnown = header.isDataSizeKnown();
+    uint64_t dataOffset = header.getDataOffset();
+
+    if (inputMap.mapInput(fp) && dataOffset < inputMap.getSize())
+    {
+        // -- Use the audio data in place in the mapped file, a truncated file only yields the samples that are present
+        uint64_t samplesPresent = (inputMap.getSize() - dataOffset) / bytesPerSample;
+        numberOfSamples = sizeKnown ? min(numberOfSamples, samplesPresent) : samplesPresent;
+        inputData = inputMap.getData() + dataOffset;
+    }
+    else if (!sizeKnown)
+    {
+        // -- Read raw audio data into the data buffer until the end of the file
+        vector<unsigned char> block((uint64_t)max(samplesPerSecond, (uint32_t)1) * bytesPerSample);
+        uint64_t count;
+
+        while ((count = fread(&block[0], 1, block.size(), fp)) > 0)
+        {
+            audioData.insert(audioData.end(), block.begin(), block.begin() + count);
+        }
+        numberOfSamples = audioData.size() / bytesPerSample;
+    }
+    else
+    {
+        // -- Read raw audio data into the data buffer, a truncated file only yields the samples that are present
+        audioData.resize(numberOfSamples * bytesPerSample);
+        audioData.resize(fread(&audioData[0], 1, audioData.size(), fp));
+        numberOfSamples = audioData.size() / bytesPerSample;
+    }
+
+    // -- Only whole frames, holding one sample of every channel, are filtered
+    numberOfSamples -= numberOfSamples % numChannels;
+
+    // -- Check if audio data was able to be read
+    if (numberOfSamples == 0)
+    {
+        throw filterError("Error! could not read raw audio data from input file");
+    }
+
+    if (inputData == NULL)
+    {
+        inputData = &audioData[0];
+    }
+
+    // -- Mapped audio data is only read from the file when the first filter touches it
+    timer.count(numberOfSamples, numberOfSamples * bytesPerSample, 0);
+}
+
+wavFile::wavFile(const wavFile &obj) : header(obj.header), filter(obj.filter)
+{
+    // -- Copy constructor. The mapping of the input file stays with the source, so mapped
+    // -- audio data is copied into audioData
+    audioData.assign(obj.inputData, obj.inputData + obj.numberOfSamples * obj.bytesPerSample);
+    outputData = obj.outputData;
+    channelData = obj.channelData;
+    bytesPerSample = obj.bytesPerSample;
+    format = obj.format;
+    numberOfSamples = obj.numberOfSamples;
+    samplesPerSecond = obj.samplesPerSecond;
+    numChannels = obj.numChannels;
+    selectedChannels = obj.selectedChannels;
+    inputData = audioData.data();
+    pool = obj.pool;
+    dither = obj.dither;
+    clippedSamples = obj.clippedSamples;
+    stats = obj.stats;
+    stageNumber = obj.stageNumber;
+}
+
+void wavFile::nextStage()
+{
+    // -- The output of this filter is the input of the next one, still in double precision
+    channelData.swap(outputData);
+    outputData.clear();
+    stageNumber++;
+}
+
+void wavFile::countStage(scopedTimer &timer, uint32_t filterCoeffsLen)
+{
+    // -- Every filtered sample costs one multiply-accumulate per coefficient in the direct form
+    uint64_t filteredSamples = numberOfSamples / numChannels * selectedChannels.size();
+    timer.count(filteredSamples, 0, filteredSamples * filterCoeffsLen);
+}
+
+void wavFile::setThreadPool(threadPool *pool)
+{
+    this->pool = pool;
+}
+
+void wavFile::setChannels(const vector<uint32_t> &channels)
+{
+    selectedChannels = header.selectChannels(channels);
+}
+
+uint64_t wavFile::getNumberOfSamples()
+{
+    return numberOfSamples;
+}
+
+uint32_t wavFile::getSamplesPerSecond()
+{
+    return samplesPerSecond;
+}
+
+void wavFile::setDither(bool dither)
+{
+    this->dither = dither;
+}
+
+uint64_t wavFile::getClippedSamples()
+{
+    return clippedSamples;
+}
+
+void wavFile::processSegments(const batchFilter &applyBatch, uint64_t historyLen, uint32_t alignment)
+{
+    // -- Start from an empty filter history so the previous pass does not leak into this one
+    filter.reset();
+
+    // -- Split up the samples of each channel into processable chunks of samplesPerSecond samples, and the chunks
+    // -- into segments, so that every thread gets one segment of one channel. Segments start on a chunk boundary,
+    // -- so every chunk is filtered exactly as it would be by a single thread
+    uint64_t frameCount = numberOfSamples / numChannels;
+    uint64_t channelCount = selectedChannels.size();
+    outputData.assign(channelCount, vector<double>(frameCount));
+    uint64_t batchCount = (frameCount + samplesPerSecond - 1) / samplesPerSecond;
+    uint64_t segmentCount = 1;
+    if (pool != NULL)
+    {
+        segmentCount = min(batchCount, (pool->getThreadCount() + channelCount - 1) / channelCount);
+    }
+
+    auto filterSegment = [&](uint64_t task)
+    {
+        uint64_t channelIndex = task / segmentCount;
+        uint64_t segment = task % segmentCount;
+        uint64_t start = segment * batchCount / segmentCount * samplesPerSecond;
+        uint64_t end = min(frameCount, (segment + 1) * batchCount / segmentCount * samplesPerSecond);
+
+        // -- Each segment has a filter of its own, whose history is built up by filtering the input before the
+        // -- segment and discarding the output. The partitioned convolution also needs its blocks to line up
+        // -- with those of a single thread, so its first chunk starts on a multiple of the partition size
+        firFilter segmentFilter(filter);
+        uint64_t historyBatches = (historyLen + samplesPerSecond - 1) / samplesPerSecond;
+        uint64_t offset = start - min(start, historyBatches * samplesPerSecond);
+        offset -= offset % alignment;
+
+        vector<double> batchData;
+        while (offset < end)
+        {
+            uint64_t batchEnd = min(end, (offset / samplesPerSecond + 1) * samplesPerSecond);
+            batchData.resize(batchEnd - offset);
+            readChannel(channelIndex, offset, batchData);
+            batchData = applyBatch(segmentFilter, batchData);
+
+            // -- Each segment writes its output straight into its own part of the output data
+            if (offset >= start)
+            {
+                copy(batchData.begin(), batchData.end(), outputData[channelIndex].begin() + offset);
+            }
+            offset = batchEnd;
+        }
+    };
+
+    if (channelCount * segmentCount > 1 && pool != NULL)
+    {
+        pool->parallelFor(channelCount * segmentCount, filterSegment);
+    }
+    else
+    {
+        for (uint64_t task = 0; task < channelCount * segmentCount; task++)
+        {
+            filterSegment(task);
+        }
+    }
+}
+
+void wavFile::readChannel(uint64_t channelIndex, uint64_t offset, vector<double> &batchData)
+{
+    if (channelData.empty())
+    {
+        // -- Take the samples of this channel out of the interleaved audio data of the input file
+        uint16_t channel = selectedChannels[channelIndex];
+        sampleCodec::unpack(format, inputData + (offset * numChannels + channel) * bytesPerSample, numChannels, &batchData[0], batchData.size());
+    }
+    else
+    {
+        copy(channelData[channelIndex].begin() + offset, channelData[channelIndex].begin() + offset + batchData.size(), batchData.begin());
+    }
+}
+
+void wavFile::packOutput(const vector<vector<double>> &processedData, unsigned char *data)
+{
+    // -- The channels that are not filtered keep their input samples
+    if (selectedChannels.size() != numChannels)
+    {
+        memcpy(data, inputData, numberOfSamples * bytesPerSample);
+    }
+
+    // -- Split up each channel into one segment per thread, as the conversion is done on its own pass. Segments
+    // -- start on a batch boundary and every batch seeds its own dither noise, as when streaming
+    uint64_t frameCount = numberOfSamples / numChannels;
+    uint64_t channelCount = selectedChannels.size();
+    uint64_t batchCount = (frameCount + samplesPerSecond - 1) / samplesPerSecond;
+    uint64_t segmentCount = 1;
+    if (pool != NULL)
+    {
+        segmentCount = min(batchCount, (pool->getThreadCount() + channelCount - 1) / channelCount);
+    }
+    vector<uint64_t> segmentClips(channelCount * segmentCount, 0);
+
+    auto packSegment = [&](uint64_t task)
+    {
+        uint64_t channelIndex = task / segmentCount;
+        uint64_t segment = task % segmentCount;
+        uint16_t channel = selectedChannels[channelIndex];
+        packState state;
+        state.dither = dither;
+
+        for (uint64_t batch = segment * batchCount / segmentCount; batch < (segment + 1) * batchCount / segmentCount; batch++)
+        {
+            uint64_t start = batch * samplesPerSecond;
+            uint64_t end = min(frameCount, start + samplesPerSecond);
+            state.ditherSeed = ((uint64_t)channel << 40) ^ batch;
+            sampleCodec::pack(format, &processedData[channelIndex][start], data + (start * numChannels + channel) * bytesPerSample, numChannels, end - start, state);
+        }
+        segmentClips[task] = state.clippedSamples;
+    };
+
+    if (channelCount * segmentCount > 1 && pool != NULL)
+    {
+        pool->parallelFor(channelCount * segmentCount, packSegment);
+    }
+    else
+    {
+        for (uint64_t task = 0; task < channelCount * segmentCount; task++)
+        {
+            packSegment(task);
+        }
+    }
+
+    clippedSamples = 0;
+    for (uint64_t i = 0; i < segmentClips.size(); i++)
+    {
+        clippedSamples += segmentClips[i];
+    }
+}
+
+void wavFile::processFirFilter(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t partitionSize)
+{
+    scopedTimer timer(stats, (stats != NULL) ? stats->addPhase("filter " + to_string(stageNumber), filterCoeffsLen) : 0);
+    countStage(timer, filterCoeffsLen);
+
+    // -- The partitioned convolution looks back further than the coefficients, over whole partitions
+    processSegments([&](firFilter &segmentFilter, const vector<double> &batchData)
+                    { return segmentFilter.applyBestFilter(batchData, filterCoeffs, filterCoeffsLen, samplesPerSecond, partitionSize); },
+                    (uint64_t)filterCoeffsLen + 2 * (uint64_t)partitionSize, max(partitionSize, (uint32_t)1));
+}
+
+double wavFile::processQ15Filter(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, int32_t headroomBits)
+{
+    double signalEnergy = 0;
+    double noiseEnergy = 0;
+
+    if (format != sampleFormat::int16)
+    {
+        throw filterError("Error! Q15 filtering needs 16 bit integer samples, the input file holds " + sampleCodec::getFormatName(format) + " samples");
+    }
+
+    scopedTimer timer(stats, (stats != NULL) ? stats->addPhase("filter " + to_string(stageNumber), filterCoeffsLen) : 0);
+    countStage(timer, filterCoeffsLen);
+    processSegments([&](firFilter &segmentFilter, const vector<double> &batchData)
+                    {
+                        // -- The samples are whole 16 bit numbers, unpacked from the file or put out by the previous
+                        // -- Q15 filter, so the conversions are exact
+                        vector<int16_t> q15Data(batchData.begin(), batchData.end());
+                        q15Data = segmentFilter.applyQ15Filter(q15Data, filterCoeffs, filterCoeffsLen, headroomBits);
+                        return vector<double>(q15Data.begin(), q15Data.end()); },
+                    filterCoeffsLen, 1);
+    timer.stop();
+
+    // -- Measure the quantisation noise on the first batch of the first filtered channel against the double precision filter
+    uint64_t count = min((uint64_t)samplesPerSecond, numberOfSamples / numChannels);
+    vector<double> batchData(count);
+    readChannel(0, 0, batchData);
+    firFilter reference;
+    vector<double> referenceData = reference.applyFirFilter(batchData, filterCoeffs, filterCoeffsLen, samplesPerSecond);
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        double error = referenceData[i] - outputData[0][i];
+        signalEnergy += referenceData[i] * referenceData[i];
+        noiseEnergy += error * error;
+    }
+
+    if (noiseEnergy == 0)
+    {
+        return INFINITY;
+    }
+    return 10 * log10(signalEnergy / noiseEnergy);
+}
+
+void wavFile::processIirFilter(const vector<biquadSection> &sections)
+{
+    uint32_t multiplies = iirFilter::getMultiplies(sections);
+    scopedTimer timer(stats, (stats != NULL) ? stats->addPhase("filter " + to_string(stageNumber), 0, multiplies) : 0);
+    countStage(timer, multiplies);
+
+    uint64_t frameCount = numberOfSamples / numChannels;
+    uint64_t channelCount = selectedChannels.size();
+    outputData.assign(channelCount, vector<double>(frameCount));
+    uint64_t groupCount = (channelCount + Iir_Lanes - 1) / Iir_Lanes;
+
+    auto filterGroup = [&](uint64_t group)
+    {
+        // -- Each group of channels has a filter of its own, which keeps the state of its channels from one batch to the next
+        uint64_t first = group * Iir_Lanes;
+        uint64_t laneCount = min((uint64_t)Iir_Lanes, channelCount - first);
+        iirFilter groupFilter;
+        vector<vector<double>> batchData(laneCount);
+        for (uint64_t offset = 0; offset < frameCount; offset += samplesPerSecond)
+        {
+            uint64_t batchLen = min((uint64_t)samplesPerSecond, frameCount - offset);
+            for (uint64_t l = 0; l < laneCount; l++)
+            {
+                batchData[l].resize(batchLen);
+                readChannel(first + l, offset, batchData[l]);
+            }
+            groupFilter.applyIirFilter(batchData, sections);
+            for (uint64_t l = 0; l < laneCount; l++)
+            {
+                copy(batchData[l].begin(), batchData[l].end(), outputData[first + l].begin() + offset);
+            }
+        }
+    };
+
+    if (groupCount > 1 && pool != NULL)
+    {
+        pool->parallelFor(groupCount, filterGroup);
+    }
+    else
+    {
+        for (uint64_t group = 0; group < groupCount; group++)
+        {
+            filterGroup(group);
+        }
+    }
+}
+
+void wavFile::processMultirateFilter(const multirateStage &stage)
+{
+    uint32_t multiplies = multirateFilter::getMultiplies(stage);
+    scopedTimer timer(stats, (stats != NULL) ? stats->addPhase("filter " + to_string(stageNumber), 0, multiplies) : 0);
+    countStage(timer, multiplies);
+
+    uint64_t frameCount = numberOfSamples / numChannels;
+    uint64_t channelCount = selectedChannels.size();
+    outputData.assign(channelCount, vector<double>(frameCount));
+
+    auto filterChannel = [&](uint64_t channel)
+    {
+        // -- Each channel has a filter of its own, which keeps the history of the channel from one batch to the next
+        multirateFilter channelFilter;
+        vector<vector<double>> batchData(1);
+        for (uint64_t offset = 0; offset < frameCount; offset += samplesPerSecond)
+        {
+            uint64_t batchLen = min((uint64_t)samplesPerSecond, frameCount - offset);
+            batchData[0].resize(batchLen);
+            readChannel(channel, offset, batchData[0]);
+            channelFilter.applyMultirateFilter(batchData, stage);
+            copy(batchData[0].begin(), batchData[0].end(), outputData[channel].begin() + offset);
+        }
+    };
+
+    if (channelCount > 1 && pool != NULL)
+    {
+        pool->parallelFor(channelCount, filterChannel);
+    }
+    else
+    {
+        for (uint64_t channel = 0; channel < channelCount; channel++)
+        {
+            filterChannel(channel);
+        }
+    }
+}
+
+void wavFile::writeWavFile(FILE *fp)
+{
+    // -- Before any filter is applied, the output is the input audio data
+    const vector<vector<double>> &processedData = outputData.empty() ? channelData : outputData;
+    clippedSamples = 0;
+    uint64_t dataSize = numberOfSamples * bytesPerSample;
+    scopedTimer timer(stats, (stats != NULL) ? stats->addPhase("write") : 0);
+
+    // -- Write the file header, with the size of the audio data that is actually written
+    header.setDataSize(dataSize);
+    header.writeHeader(fp);
+
+    // -- Convert the audio data straight into the mapped output file when possible. The mapped file is
+    // -- created filled with zeros, which includes the pad byte after audio data of an odd size
+    mappedFile outputMap;
+    uint64_t dataOffset = header.getDataOffset();
+    uint64_t fileSize = dataOffset + dataSize + (dataSize & 1);
+    timer.count(numberOfSamples, fileSize, 0);
+    if (fflush(fp) == 0 && outputMap.mapOutput(fp, fileSize))
+    {
+        if (processedData.empty())
+        {
+            memcpy(outputMap.getData() + dataOffset, inputData, dataSize);
+        }
+        else
+        {
+            packOutput(processedData, outputMap.getData() + dataOffset);
+        }
+        outputMap.unmap();
+        return;
+    }
+
+    // -- Write the data buffer to the output file
+    const unsigned char *data = inputData;
+    vector<unsigned char> packedData;
+    if (!processedData.empty())
+    {
+        packedData.resize(dataSize);
+        packOutput(processedData, &packedData[0]);
+        data = &packedData[0];
+    }
+    if (fwrite(data, 1, dataSize, fp) != dataSize)
+    {
+        throw filterError("Error! could not write audio data into output file");
+    }
+    header.writePadByte(fp);
+}
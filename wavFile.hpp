@@ -1,113 +1,342 @@
-/**
- * @file wavFile.hpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief Class definition to read, write and begin the processing of the audio wave files
- * 
- * This class defines the data structure used to store the information found in a wav file.
- * This class contains functions to read a wav file, write information to create a new wav file
- * and calls the fir filter to process the wav file audio data.
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-#pragma once
-
-#include <vector>
-#include <cstddef>
-#include "wavHeader.hpp"
-#include "firFilter.hpp"
-
-using namespace std;
-
-class wavFile
-{
-public:
-    /**
-     * @brief Input audio data
-     * 
-     */
-    vector<int16_t> audioData;
-
-    /**
-     * @brief Output processed audio data
-     * 
-     */
-    vector<int16_t> outputData;
-
-    /**
-     * @brief Default constructor to create a new wav file object
-     * 
-     */
-    wavFile();
-
-    /**
-     * @brief Construct a new wav File object given an input wave file
-     * 
-     * @param fp a pointer to the input wav audio file
-     */
-    wavFile(FILE *fp);
-
-    /**
-     * @brief Copy constructor
-     * 
-     * @param obj The source wave file to be copied over
-     */
-    wavFile(const wavFile &obj);
-
-    /**
-     * @brief Write the wav file info the output file
-     * 
-     * Takes the stored input wave file and copies its header information along
-     * with the output processed data to the new file
-     * 
-     * @param fp a pointer to the output wav audio file
-     */
-    void writeWavFile(FILE *fp);
-
-    /**
-     * @brief Process the input audio data with the specified filter coefficients
-     * 
-     * Calls the fir filter to process the input audio data with the specified filter coefficients.
-     * As the fir filter can only process a limited number of samples at a time (specified by
-     * samplesPerSecond), the input audio data has to be batched into appropriate chunks. The fir filter
-     * is called for each chunk and the resulting output data is stored in outputData vector
-     * 
-     * @param filterCoeffs Set of filter coefficients
-     * @param filterCoeffsLen number of filter coefficients
-     */
-    void processFirFilter(vector<double> filterCoeffs, uint16_t filterCoeffsLen);
-
-private:
-    /**
-     * @brief Header component of the wav file
-     * 
-     */
-    wavHeader header;
-
-    /**
-     * @brief Instance of the fir filter for this audio file
-     * 
-     */
-    firFilter filter;
-
-    /**
-     * @brief Number of bytes per sample for the wav file
-     * 
-     */
-    uint16_t bytesPerSample;
-
-    /**
-     * @brief Number of samples for the wav file
-     * 
-     */
-    uint64_t numberOfSamples;
-
-    /**
-     * @brief Sample rate for the wav file
-     * 
-     */
-    uint32_t samplesPerSecond;
-};
+/**
+ * @file wavFile.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition to read, write and begin the processing of the audio wave files
+ * 
+ * This class defines the data structure used to store the information found in a wav file.
+ * This class contains functions to read a wav file, write information to create a new wav file
+ * and calls the fir filter to process the wav file audio data.
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include "wavHeader.hpp"
+#include "firFilter.hpp"
+#include "iirFilter.hpp"
+#include "multirateFilter.hpp"
+#include "mappedFile.hpp"
+#include "threadPool.hpp"
+#include "runStats.hpp"
+
+using namespace std;
+
+/**
+ * @brief Function applying a filter to one batch of samples with the given fir filter
+ * 
+ */
+typedef function<vector<double>(firFilter &, const vector<double> &)> batchFilter;
+
+class wavFile
+{
+public:
+    /**
+     * @brief Input audio data, as stored in the file. Empty when the audio data is used in place in the mapped input file
+     * 
+     */
+    vector<unsigned char> audioData;
+
+    /**
+     * @brief Output processed audio data in double precision, one vector per channel chosen with setChannels.
+     *        Empty until a filter is applied
+     * 
+     */
+    vector<vector<double>> outputData;
+
+    /**
+     * @brief Default constructor to create a new wav file object
+     * 
+     */
+    wavFile();
+
+    /**
+     * @brief Construct a new wav File object given an input wave file
+     * 
+     * Regular files are mapped into memory and their audio data is used in place, other files such as
+     * pipes are read into audioData
+     * 
+     * @param fp a pointer to the input wav audio file
+     * @param stats Statistics receiving the time of reading the header, reading the audio data, each filter
+     *              and writing the output, NULL to not collect any
+     */
+    wavFile(FILE *fp, runStats *stats = NULL);
+
+    /**
+     * @brief Copy constructor
+     * 
+     * @param obj The source wave file to be copied over
+     */
+    wavFile(const wavFile &obj);
+
+    /**
+     * @brief Filter long files with several threads
+     * 
+     * The audio data is split into one segment per thread, each of which is filtered by a thread of the pool.
+     * The output is the same as with a single thread
+     * 
+     * @param pool Pool of threads to be used, NULL to filter with the calling thread only
+     */
+    void setThreadPool(threadPool *pool);
+
+    /**
+     * @brief Choose the channels to be filtered
+     * 
+     * The samples of the other channels are copied to the output unchanged
+     * 
+     * @param channels Channel numbers starting at 1, empty to filter every channel
+     */
+    void setChannels(const vector<uint32_t> &channels);
+
+    /**
+     * @brief Gets the number of samples of the audio data, counting every channel
+     * 
+     * @return Returns the number of samples
+     */
+    uint64_t getNumberOfSamples();
+
+    /**
+     * @brief Gets the sample rate of the audio data
+     * 
+     * @return Number of samples per second of each channel
+     */
+    uint32_t getSamplesPerSecond();
+
+    /**
+     * @brief Choose whether integer output samples are dithered
+     * 
+     * @param dither Add triangular dither of up to 1 least significant bit before rounding
+     */
+    void setDither(bool dither);
+
+    /**
+     * @brief Gets the number of output samples that were outside the range of the sample format
+     * 
+     * @return Number of samples saturated by the last writeWavFile
+     */
+    uint64_t getClippedSamples();
+
+    /**
+     * @brief Make the output processed audio data the input of the next filter
+     * 
+     */
+    void nextStage();
+
+    /**
+     * @brief Write the wav file info the output file
+     * 
+     * Takes the stored input wave file and copies its header information along
+     * with the output processed data to the new file. The processed data is only converted to the
+     * sample format of the input here, once at the end of the chain of filters. If the output file
+     * is a regular file opened for reading and writing, it is sized up front and the audio data is
+     * converted straight into it through a mapping
+     * 
+     * @param fp a pointer to the output wav audio file
+     */
+    void writeWavFile(FILE *fp);
+
+    /**
+     * @brief Process the input audio data with the specified filter coefficients
+     * 
+     * Calls the fir filter to process the input audio data with the specified filter coefficients.
+     * As the fir filter can only process a limited number of samples at a time (specified by
+     * samplesPerSecond), the input audio data has to be batched into appropriate chunks. The fir filter
+     * is called for each chunk and the resulting output data is stored in outputData vector, in double precision
+     * so the next filter does not have to convert the samples back from the sample format of the file. Sets of
+     * at least firKernels::getFftCrossoverCoeffsLen() coefficients are applied with the fft based convolution, unless
+     * a partition size is given in which case the partitioned convolution is used. With a thread pool, the
+     * chunks are split over the threads. Every channel chosen with setChannels is filtered on its own, so with a
+     * thread pool the channels are also filtered at the same time
+     * 
+     * @param filterCoeffs Set of filter coefficients
+     * @param filterCoeffsLen number of filter coefficients
+     * @param partitionSize Partition size of the partitioned convolution, 0 to choose the engine from filterCoeffsLen
+     */
+    void processFirFilter(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, uint32_t partitionSize = 0);
+
+    /**
+     * @brief Process the input audio data with the specified filter coefficients in Q15 fixed point
+     * 
+     * Same as processFirFilter, but the coefficients are quantised to Q15 and the samples are filtered
+     * with 16 bit integer arithmetic. To report the accuracy, the first batch is also filtered in double
+     * precision and the signal to noise ratio of the fixed point output against it is returned. Only files
+     * holding 16 bit samples can be filtered in Q15
+     * 
+     * @param filterCoeffs Set of filter coefficients
+     * @param filterCoeffsLen number of filter coefficients
+     * @param headroomBits Number of bits the coefficients are scaled below Q15, or -1 to choose automatically
+     * @return Signal to noise ratio in dB of the first batch, infinity if it matches the double precision output
+     */
+    double processQ15Filter(const vector<double> &filterCoeffs, uint32_t filterCoeffsLen, int32_t headroomBits = -1);
+
+    /**
+     * @brief Process the input audio data with a cascade of biquad sections
+     * 
+     * Every output sample of an iir filter depends on all samples before it, so a channel cannot be split into
+     * segments. Instead up to Iir_Lanes channels are filtered together batch by batch, and with a thread pool
+     * the groups of channels are filtered at the same time. The samples are filtered in double precision, also
+     * after Q15 filters
+     * 
+     * @param sections Sections of the cascade, in the order they are applied
+     */
+    void processIirFilter(const vector<biquadSection> &sections);
+
+    /**
+     * @brief Process the input audio data with a multirate filter
+     * 
+     * The samples kept by the decimation are counted from the start of the audio data, so a channel is not split
+     * into segments. Every channel is filtered batch by batch, and with a thread pool the channels are filtered
+     * at the same time. The samples are filtered in double precision, also after Q15 filters
+     * 
+     * @param stage Filters of the multirate filter
+     */
+    void processMultirateFilter(const multirateStage &stage);
+
+private:
+    /**
+     * @brief Apply a filter to the input samples, batch by batch, writing the outputData
+     * 
+     * Every selected channel is filtered on its own, one batch at a time. The first filter takes the samples of the
+     * channel out of the interleaved audio data and unpacks them to double precision, later filters take the output
+     * of the previous filter as it is. Each segment of a
+     * channel is filtered with a copy of the fir filter of this file. Before the first batch of a segment, the
+     * historyLen samples before it are filtered as well, so the copy has the same history as it would have when
+     * filtering the channel from the start
+     * 
+     * @param applyBatch Function applying the filter to a batch
+     * @param historyLen Number of samples of one channel the filter looks back
+     * @param alignment The samples filtered before a segment start on a multiple of this number of samples of one channel
+     */
+    void processSegments(const batchFilter &applyBatch, uint64_t historyLen, uint32_t alignment);
+
+    /**
+     * @brief Take the samples of a selected channel the next filter is applied to
+     * 
+     * @param channelIndex Position of the channel in selectedChannels
+     * @param offset First sample of the channel
+     * @param batchData Receives the samples, its size gives the number of samples
+     */
+    void readChannel(uint64_t channelIndex, uint64_t offset, vector<double> &batchData);
+
+    /**
+     * @brief Convert the processed samples to the sample format of the input, saturating integer samples
+     * 
+     * The channels that are not filtered are copied from the input. With a thread pool, the channels and
+     * segments of each channel are converted at the same time. The dither noise of every batch is seeded from
+     * its channel and position, so the output does not depend on the number of threads
+     * 
+     * @param processedData Processed samples, one vector per selected channel
+     * @param data Receives the interleaved audio data
+     */
+    void packOutput(const vector<vector<double>> &processedData, unsigned char *data);
+
+    /**
+     * @brief Header component of the wav file
+     * 
+     */
+    wavHeader header;
+
+    /**
+     * @brief Instance of the fir filter for this audio file
+     * 
+     */
+    firFilter filter;
+
+    /**
+     * @brief Number of bytes per sample for the wav file
+     * 
+     */
+    uint16_t bytesPerSample;
+
+    /**
+     * @brief Storage type of the samples of the wav file
+     * 
+     */
+    sampleFormat format;
+
+    /**
+     * @brief Number of samples for the wav file
+     * 
+     */
+    uint64_t numberOfSamples;
+
+    /**
+     * @brief Sample rate for the wav file
+     * 
+     */
+    uint32_t samplesPerSecond;
+
+    /**
+     * @brief Number of interleaved channels for the wav file
+     * 
+     */
+    uint16_t numChannels;
+
+    /**
+     * @brief Channels to be filtered, starting at 0
+     * 
+     */
+    vector<uint16_t> selectedChannels;
+
+    /**
+     * @brief Mapping of the input file, if it could be mapped
+     * 
+     */
+    mappedFile inputMap;
+
+    /**
+     * @brief Samples of the input file, either in the mapped input file or in audioData
+     * 
+     */
+    const unsigned char *inputData;
+
+    /**
+     * @brief Samples the next filter is applied to, in double precision, one vector per selected channel.
+     *        Empty before the first filter, which unpacks the samples of the input file batch by batch instead
+     * 
+     */
+    vector<vector<double>> channelData;
+
+    /**
+     * @brief Pool of threads filtering the segments of the audio data, NULL to use the calling thread only
+     * 
+     */
+    threadPool *pool;
+
+    /**
+     * @brief Whether integer output samples are dithered
+     * 
+     */
+    bool dither;
+
+    /**
+     * @brief Number of output samples saturated by the last writeWavFile
+     * 
+     */
+    uint64_t clippedSamples;
+
+    /**
+     * @brief Statistics of the run, NULL if not collected
+     * 
+     */
+    runStats *stats;
+
+    /**
+     * @brief Position of the next filter in the chain, starting at 1
+     * 
+     */
+    uint32_t stageNumber;
+
+    /**
+     * @brief Add the time of one filter of the chain to the statistics of the run
+     * 
+     * @param timer Timer started before the filter was applied
+     * @param filterCoeffsLen Number of coefficients of the filter
+     */
+    void countStage(scopedTimer &timer, uint32_t filterCoeffsLen);
+};
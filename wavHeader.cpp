@@ -1,285 +1,432 @@
-/**
- * @file wavHeader.cpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief Implementation of the wavHeader class
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-#include <fstream>
-#include <iostream>
-#include "wavHeader.hpp"
-
-using namespace std;
-
-wavHeader::wavHeader()
-{
-    // -- Default constructor
-}
-
-wavHeader::wavHeader(FILE *fp)
-{
-    // -- Read the components of the wav file header
-    fseek(fp, 0, SEEK_SET);
-
-    // -- RIFF Chunk Descriptor
-    if (fread(chunkID, sizeof(chunkID[0]) * 4, 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read chunkID in file header";
-        exit(1);
-    }
-    if (!(chunkID[0] == 'R' && chunkID[1] == 'I' && chunkID[2] == 'F' && chunkID[3] == 'F'))
-    {
-        fclose(fp);
-        cout << "Error in file header, incorrect chunkID";
-        exit(1);
-    }
-    if (fread(&chunkSize, sizeof(chunkSize), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read chunkSize in file header";
-        exit(1);
-    }
-    if (fread(format, sizeof(format[0]) * 4, 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read format in file header";
-        exit(1);
-    }
-    if (!(format[0] == 'W' && format[1] == 'A' && format[2] == 'V' && format[3] == 'E'))
-    {
-        fclose(fp);
-        cout << "Error in file header, incorrect format";
-        exit(1);
-    }
-
-    // -- Fmt sub-chunk
-    if (fread(subchunk1ID, sizeof(subchunk1ID[0]) * 4, 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read subchunk1ID in file header";
-        exit(1);
-    }
-    if (!(subchunk1ID[0] == 'f' && subchunk1ID[1] == 'm' && subchunk1ID[2] == 't' && subchunk1ID[3] == ' '))
-    {
-        fclose(fp);
-        cout << "Error in file header, incorrect subchunk1ID";
-        exit(1);
-    }
-    if (fread(&subchunk1Size, sizeof(subchunk1Size), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read subchunk1Size in file header";
-        exit(1);
-    }
-    if (fread(&audioFormat, sizeof(audioFormat), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read audioFormat in file header";
-        exit(1);
-    }
-    if (fread(&numChannels, sizeof(numChannels), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read numChannels in file header";
-        exit(1);
-    }
-    if (fread(&sampleRate, sizeof(sampleRate), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read sampleRate in file header";
-        exit(1);
-    }
-    if (fread(&byteRate, sizeof(byteRate), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read byteRate in file header";
-        exit(1);
-    }
-    if (fread(&blockAlign, sizeof(blockAlign), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read blockAlign in file header";
-        exit(1);
-    }
-    if (fread(&bitsPerSample, sizeof(bitsPerSample), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read bitsPerSample in file header";
-        exit(1);
-    }
-    if (bitsPerSample != 16)
-    {
-        fclose(fp);
-        cout << "Error in file header, bitsPerSample is not 16. Audio file must be 16 bits per sample";
-        exit(1);
-    }
-
-    // -- Data sub-chunk
-    if (fread(subchunk2Id, sizeof(subchunk2Id[0]) * 4, 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read subchunk2Id in file header";
-        exit(1);
-    }
-    if (!(subchunk2Id[0] == 'd' && subchunk2Id[1] == 'a' && subchunk2Id[2] == 't' && subchunk2Id[3] == 'a'))
-    {
-        fclose(fp);
-        cout << "Error in file header, incorrect subchunk2Id";
-        exit(1);
-    }
-    if (fread(&subchunk2Size, sizeof(subchunk2Size), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read subchunk2Size in file header";
-        exit(1);
-    }
-}
-
-wavHeader::wavHeader(const wavHeader &obj)
-{
-    // -- Copy constructor
-    chunkID[0] = obj.chunkID[0];
-    chunkID[1] = obj.chunkID[1];
-    chunkID[2] = obj.chunkID[2];
-    chunkID[3] = obj.chunkID[3];
-    chunkSize = obj.chunkSize;
-    format[0] = obj.format[0];
-    format[1] = obj.format[1];
-    format[2] = obj.format[2];
-    format[3] = obj.format[3];
-    subchunk1ID[0] = obj.subchunk1ID[0];
-    subchunk1ID[1] = obj.subchunk1ID[1];
-    subchunk1ID[2] = obj.subchunk1ID[2];
-    subchunk1ID[3] = obj.subchunk1ID[3];
-    subchunk1Size = obj.subchunk1Size;
-    audioFormat = obj.audioFormat;
-    numChannels = obj.numChannels;
-    sampleRate = obj.sampleRate;
-    byteRate = obj.byteRate;
-    blockAlign = obj.blockAlign;
-    bitsPerSample = obj.bitsPerSample;
-    subchunk2Id[0] = obj.subchunk2Id[0];
-    subchunk2Id[1] = obj.subchunk2Id[1];
-    subchunk2Id[2] = obj.subchunk2Id[2];
-    subchunk2Id[3] = obj.subchunk2Id[3];
-    subchunk2Size = obj.subchunk2Size;
-}
-
-uint16_t wavHeader::getbytesPerSample()
-{
-    // -- Calculate bytes per sample
-    uint16_t bytesPerSample;
-    bytesPerSample = (uint16_t)bitsPerSample / 8;
-    return bytesPerSample;
-}
-
-uint64_t wavHeader::getNumberOfSamples()
-{
-    // -- Calculate number of samples
-    uint64_t numberOfSamples;
-    numberOfSamples = (uint64_t)chunkSize / (bitsPerSample / 8);
-    return numberOfSamples;
-}
-
-uint32_t wavHeader::getSamplesPerSecond()
-{
-    // -- Find the samples per second
-    uint32_t samplesPerSecond;
-    samplesPerSecond = (uint32_t)sampleRate;
-    return samplesPerSecond;
-}
-
-void wavHeader::writeHeader(FILE *fp)
-{
-    // -- Write the components of the wav file header
-    fseek(fp, 0, SEEK_SET);
-
-    // -- RIFF Chunk Descriptor
-    if (fwrite(chunkID, sizeof(chunkID[0]) * 4, 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read chunkID in file header";
-        exit(1);
-    }
-    if (fwrite(&chunkSize, sizeof(chunkSize), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read chunkSize in file header";
-        exit(1);
-    }
-    if (fwrite(format, sizeof(format[0]) * 4, 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read format in file header";
-        exit(1);
-    }
-
-    // -- Fmt sub-chunk
-    if (fwrite(subchunk1ID, sizeof(subchunk1ID[0]) * 4, 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read subchunk1ID in file header";
-        exit(1);
-    }
-    if (fwrite(&subchunk1Size, sizeof(subchunk1Size), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read subchunk1Size in file header";
-        exit(1);
-    }
-    if (fwrite(&audioFormat, sizeof(audioFormat), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read audioFormat in file header";
-        exit(1);
-    }
-    if (fwrite(&numChannels, sizeof(numChannels), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read numChannels in file header";
-        exit(1);
-    }
-    if (fwrite(&sampleRate, sizeof(sampleRate), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read sampleRate in file header";
-        exit(1);
-    }
-    if (fwrite(&byteRate, sizeof(byteRate), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read byteRate in file header";
-        exit(1);
-    }
-    if (fwrite(&blockAlign, sizeof(blockAlign), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read blockAlign in file header";
-        exit(1);
-    }
-    if (fwrite(&bitsPerSample, sizeof(bitsPerSample), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read bitsPerSample in file header";
-        exit(1);
-    }
-
-    // -- Data sub-chunk
-    if (fwrite(subchunk2Id, sizeof(subchunk2Id[0]) * 4, 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read subchunk2Id in file header";
-        exit(1);
-    }
-    if (fwrite(&subchunk2Size, sizeof(subchunk2Size), 1, fp) == 0)
-    {
-        fclose(fp);
-        cout << "Error! could not read subchunk2Size in file header";
-        exit(1);
-    }
-}
+/**
+ * @file wavHeader.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the wavHeader class
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <cstring>
+#include <climits>
+#include <fstream>
+#include "wavHeader.hpp"
+#include "filterError.hpp"
+
+using namespace std;
+
+wavHeader::wavHeader()
+{
+    // -- Default constructor
+    memcpy(chunkID, "RIFF", 4);
+    chunkSize = 0;
+    memcpy(format, "WAVE", 4);
+    memcpy(subchunk1ID, "fmt ", 4);
+    subchunk1Size = 16;
+    audioFormat = Wave_Format_Pcm;
+    numChannels = 1;
+    sampleRate = 0;
+    byteRate = 0;
+    blockAlign = 2;
+    bitsPerSample = 16;
+    storageFormat = sampleFormat::int16;
+    validBitsPerSample = 16;
+    channelMask = 0;
+    memset(subFormat, 0, sizeof(subFormat));
+    memcpy(subchunk2Id, "data", 4);
+    subchunk2Size = 0;
+    dataSize = 0;
+    dataSizeKnown = false;
+    dataOffset = 0;
+    position = 0;
+    ds64Reserved = false;
+    headerWritten = false;
+}
+
+wavHeader::wavHeader(FILE *fp, runStats *stats) : wavHeader()
+{
+    scopedTimer timer(stats, (stats != NULL) ? stats->addPhase("header") : 0);
+
+    // -- Read the components of the wav file header
+    fseek(fp, 0, SEEK_SET);
+
+    // -- RIFF Chunk Descriptor. RF64 and BW64 files give their sizes in a ds64 chunk instead
+    readBytes(fp, chunkID, sizeof(chunkID), "chunkID");
+    bool rf64 = memcmp(chunkID, "RF64", 4) == 0 || memcmp(chunkID, "BW64", 4) == 0;
+    if (!rf64 && memcmp(chunkID, "RIFF", 4) != 0)
+    {
+        throw filterError("Error in file header, incorrect chunkID");
+    }
+    readBytes(fp, &chunkSize, sizeof(chunkSize), "chunkSize");
+    readBytes(fp, format, sizeof(format), "format");
+    if (memcmp(format, "WAVE", 4) != 0)
+    {
+        throw filterError("Error in file header, incorrect format");
+    }
+
+    // -- Walk the chunks up to the data chunk, skipping the chunks that are not needed
+    bool formatFound = false;
+    bool ds64Found = false;
+    uint64_t ds64DataSize = 0;
+
+    while (true)
+    {
+        unsigned char id[4];
+        uint32_t size;
+
+        if (fread(id, sizeof(id), 1, fp) == 0)
+        {
+            throw filterError("Error in file header, no data sub-chunk found");
+        }
+        position += sizeof(id);
+        readBytes(fp, &size, sizeof(size), "chunk size");
+
+        if (memcmp(id, "fmt ", 4) == 0)
+        {
+            readFormat(fp, size);
+            formatFound = true;
+        }
+        else if (memcmp(id, "ds64", 4) == 0 && rf64)
+        {
+            // -- The 64 bit sizes of the RIFF chunk and the data chunk, followed by the sample count and a table
+            // -- of the sizes of other large chunks, which are not needed
+            uint64_t riffSize;
+            if (size < 2 * sizeof(uint64_t))
+            {
+                throw filterError("Error in file header, ds64 sub-chunk is too short");
+            }
+            readBytes(fp, &riffSize, sizeof(riffSize), "ds64 RIFF size");
+            readBytes(fp, &ds64DataSize, sizeof(ds64DataSize), "ds64 data size");
+            skipBytes(fp, (uint64_t)size - 2 * sizeof(uint64_t) + (size & 1));
+            ds64Found = true;
+        }
+        else if (memcmp(id, "data", 4) == 0)
+        {
+            if (!formatFound)
+            {
+                throw filterError("Error in file header, the data sub-chunk comes before the fmt sub-chunk");
+            }
+
+            memcpy(subchunk2Id, id, sizeof(id));
+            subchunk2Size = size;
+            if (rf64 && size == Unknown_Data_Size)
+            {
+                if (!ds64Found)
+                {
+                    throw filterError("Error in file header, RF64 file without a ds64 sub-chunk");
+                }
+                dataSize = ds64DataSize;
+            }
+            else
+            {
+                dataSize = size;
+            }
+
+            // -- Programs streaming a wav file without knowing its length write a size of 0 or Unknown_Data_Size
+            dataSizeKnown = dataSize != 0 && (rf64 || dataSize != Unknown_Data_Size);
+            dataOffset = position;
+            break;
+        }
+        else
+        {
+            // -- Chunks are padded to an even number of bytes
+            skipBytes(fp, (uint64_t)size + (size & 1));
+        }
+    }
+    timer.count(0, dataOffset, 0);
+}
+
+wavHeader::wavHeader(const wavHeader &obj)
+{
+    // -- Copy constructor
+    memcpy(chunkID, obj.chunkID, sizeof(chunkID));
+    chunkSize = obj.chunkSize;
+    memcpy(format, obj.format, sizeof(format));
+    memcpy(subchunk1ID, obj.subchunk1ID, sizeof(subchunk1ID));
+    subchunk1Size = obj.subchunk1Size;
+    audioFormat = obj.audioFormat;
+    numChannels = obj.numChannels;
+    sampleRate = obj.sampleRate;
+    byteRate = obj.byteRate;
+    blockAlign = obj.blockAlign;
+    bitsPerSample = obj.bitsPerSample;
+    storageFormat = obj.storageFormat;
+    validBitsPerSample = obj.validBitsPerSample;
+    channelMask = obj.channelMask;
+    memcpy(subFormat, obj.subFormat, sizeof(subFormat));
+    memcpy(subchunk2Id, obj.subchunk2Id, sizeof(subchunk2Id));
+    subchunk2Size = obj.subchunk2Size;
+    dataSize = obj.dataSize;
+    dataSizeKnown = obj.dataSizeKnown;
+    dataOffset = obj.dataOffset;
+    position = obj.position;
+    ds64Reserved = obj.ds64Reserved;
+    headerWritten = obj.headerWritten;
+}
+
+void wavHeader::readBytes(FILE *fp, void *data, uint64_t size, const char *name)
+{
+    if (size > 0 && fread(data, size, 1, fp) == 0)
+    {
+        throw filterError("Error! could not read " + string(name) + " in file header");
+    }
+    position += size;
+}
+
+void wavHeader::skipBytes(FILE *fp, uint64_t size)
+{
+    // -- Seek over the bytes when the file allows it, pipes have to be read through
+    if (size <= (uint64_t)LONG_MAX && fseek(fp, (long)size, SEEK_CUR) == 0)
+    {
+        position += size;
+        return;
+    }
+
+    unsigned char block[4096];
+    while (size > 0)
+    {
+        uint64_t count = min(size, (uint64_t)sizeof(block));
+        readBytes(fp, block, count, "skipped sub-chunk");
+        size -= count;
+    }
+}
+
+void wavHeader::writeBytes(FILE *fp, const void *data, uint64_t size, const char *name)
+{
+    if (fwrite(data, size, 1, fp) == 0)
+    {
+        throw filterError("Error! could not write " + string(name) + " in file header");
+    }
+}
+
+void wavHeader::readFormat(FILE *fp, uint64_t size)
+{
+    if (size < 16)
+    {
+        throw filterError("Error in file header, fmt sub-chunk is too short");
+    }
+
+    memcpy(subchunk1ID, "fmt ", 4);
+    subchunk1Size = (uint32_t)size;
+    readBytes(fp, &audioFormat, sizeof(audioFormat), "audioFormat");
+    readBytes(fp, &numChannels, sizeof(numChannels), "numChannels");
+    readBytes(fp, &sampleRate, sizeof(sampleRate), "sampleRate");
+    readBytes(fp, &byteRate, sizeof(byteRate), "byteRate");
+    readBytes(fp, &blockAlign, sizeof(blockAlign), "blockAlign");
+    readBytes(fp, &bitsPerSample, sizeof(bitsPerSample), "bitsPerSample");
+    uint64_t remaining = size - 16;
+
+    // -- The extensible format keeps the actual format tag in the first two bytes of its sub format
+    uint16_t formatTag = audioFormat;
+    validBitsPerSample = bitsPerSample;
+    if (audioFormat == Wave_Format_Extensible)
+    {
+        uint16_t extensionSize;
+        if (remaining < 24)
+        {
+            throw filterError("Error in file header, extensible fmt sub-chunk is too short");
+        }
+        readBytes(fp, &extensionSize, sizeof(extensionSize), "cbSize");
+        readBytes(fp, &validBitsPerSample, sizeof(validBitsPerSample), "validBitsPerSample");
+        readBytes(fp, &channelMask, sizeof(channelMask), "channelMask");
+        readBytes(fp, subFormat, sizeof(subFormat), "subFormat");
+        remaining -= 24;
+        formatTag = (uint16_t)(subFormat[0] | (subFormat[1] << 8));
+    }
+    skipBytes(fp, remaining + (size & 1));
+
+    if (numChannels == 0)
+    {
+        throw filterError("Error in file header, numChannels is 0");
+    }
+
+    // -- The samples may be 16, 24 or 32 bit integers or 32 bit floats
+    if (formatTag == Wave_Format_Pcm && bitsPerSample == 16)
+    {
+        storageFormat = sampleFormat::int16;
+    }
+    else if (formatTag == Wave_Format_Pcm && bitsPerSample == 24)
+    {
+        storageFormat = sampleFormat::int24;
+    }
+    else if (formatTag == Wave_Format_Pcm && bitsPerSample == 32)
+    {
+        storageFormat = sampleFormat::int32;
+    }
+    else if (formatTag == Wave_Format_Ieee_Float && bitsPerSample == 32)
+    {
+        storageFormat = sampleFormat::float32;
+    }
+    else if (formatTag == Wave_Format_Pcm || formatTag == Wave_Format_Ieee_Float)
+    {
+        throw filterError("Error in file header, bitsPerSample is " + to_string(bitsPerSample) + ". Audio file must hold 16, 24 or 32 bit integer samples or 32 bit float samples");
+    }
+    else
+    {
+        throw filterError("Error in file header, audioFormat is neither PCM nor IEEE float. Audio file must hold integer or float samples");
+    }
+    if (blockAlign != numChannels * sampleCodec::getBytesPerSample(storageFormat))
+    {
+        throw filterError("Error in file header, blockAlign does not match numChannels and bitsPerSample");
+    }
+}
+
+uint16_t wavHeader::getbytesPerSample()
+{
+    // -- Calculate bytes per sample
+    uint16_t bytesPerSample;
+    bytesPerSample = (uint16_t)bitsPerSample / 8;
+    return bytesPerSample;
+}
+
+uint64_t wavHeader::getNumberOfSamples()
+{
+    // -- Calculate number of samples
+    uint64_t numberOfSamples;
+    numberOfSamples = dataSize / (bitsPerSample / 8);
+    return numberOfSamples;
+}
+
+sampleFormat wavHeader::getSampleFormat()
+{
+    return storageFormat;
+}
+
+uint64_t wavHeader::getDataSize()
+{
+    return dataSize;
+}
+
+bool wavHeader::isDataSizeKnown()
+{
+    return dataSizeKnown;
+}
+
+uint64_t wavHeader::getDataOffset()
+{
+    return dataOffset;
+}
+
+void wavHeader::setDataSize(uint64_t dataSize)
+{
+    this->dataSize = dataSize;
+    dataSizeKnown = true;
+}
+
+uint32_t wavHeader::getSamplesPerSecond()
+{
+    // -- Find the samples per second
+    uint32_t samplesPerSecond;
+    samplesPerSecond = (uint32_t)sampleRate;
+    return samplesPerSecond;
+}
+
+uint16_t wavHeader::getNumChannels()
+{
+    return numChannels;
+}
+
+vector<uint16_t> wavHeader::selectChannels(const vector<uint32_t> &channels)
+{
+    vector<bool> selected(numChannels, channels.empty());
+    for (uint64_t i = 0; i < channels.size(); i++)
+    {
+        if (channels[i] < 1 || channels[i] > numChannels)
+        {
+            throw filterError("Error! channel " + to_string(channels[i]) + " was chosen, but the input file only has " + to_string(numChannels) + " channels");
+        }
+        selected[channels[i] - 1] = true;
+    }
+
+    vector<uint16_t> indices;
+    for (uint16_t c = 0; c < numChannels; c++)
+    {
+        if (selected[c])
+        {
+            indices.push_back(c);
+        }
+    }
+    return indices;
+}
+
+void wavHeader::writeHeader(FILE *fp)
+{
+    // -- Write the components of the wav file header
+    fseek(fp, 0, SEEK_SET);
+
+    // -- The layout of the header is fixed the first time it is written, keeping room for a ds64 chunk if the
+    // -- audio data may not fit in a RIFF file, so the audio data after the header never has to move
+    bool extensible = audioFormat == Wave_Format_Extensible;
+    uint32_t formatSize = extensible ? 40 : 16;
+    uint64_t maxHeaderSize = 12 + 8 + Ds64_Chunk_Size + 8 + formatSize + 8;
+    if (!headerWritten)
+    {
+        ds64Reserved = !dataSizeKnown || dataSize + maxHeaderSize - 8 > Unknown_Data_Size;
+        headerWritten = true;
+    }
+
+    uint64_t headerSize = 12 + (ds64Reserved ? 8 + Ds64_Chunk_Size : 0) + 8 + formatSize + 8;
+    // -- The pad byte after audio data of an odd size belongs to the RIFF chunk
+    uint64_t riffSize = headerSize - 8 + dataSize + (dataSize & 1);
+    bool fits = dataSizeKnown && riffSize < Unknown_Data_Size;
+    bool rf64 = dataSizeKnown && !fits && ds64Reserved;
+    chunkSize = fits ? (uint32_t)riffSize : Unknown_Data_Size;
+    subchunk2Size = fits ? (uint32_t)dataSize : Unknown_Data_Size;
+    subchunk1Size = formatSize;
+
+    // -- RIFF Chunk Descriptor
+    writeBytes(fp, rf64 ? "RF64" : "RIFF", 4, "chunkID");
+    writeBytes(fp, &chunkSize, sizeof(chunkSize), "chunkSize");
+    writeBytes(fp, "WAVE", 4, "format");
+
+    // -- ds64 sub-chunk with the 64 bit sizes, or a JUNK chunk of the same size keeping room for it
+    if (ds64Reserved)
+    {
+        unsigned char ds64[Ds64_Chunk_Size] = {};
+        uint32_t ds64Size = Ds64_Chunk_Size;
+        if (rf64)
+        {
+            uint64_t sampleCount = dataSize / max(blockAlign, (uint16_t)1);
+            memcpy(ds64, &riffSize, 8);
+            memcpy(ds64 + 8, &dataSize, 8);
+            memcpy(ds64 + 16, &sampleCount, 8);
+        }
+        writeBytes(fp, rf64 ? "ds64" : "JUNK", 4, "ds64 chunk ID");
+        writeBytes(fp, &ds64Size, sizeof(ds64Size), "ds64 chunk size");
+        writeBytes(fp, ds64, sizeof(ds64), "ds64 sub-chunk");
+    }
+
+    // -- Fmt sub-chunk
+    writeBytes(fp, "fmt ", 4, "subchunk1ID");
+    writeBytes(fp, &subchunk1Size, sizeof(subchunk1Size), "subchunk1Size");
+    writeBytes(fp, &audioFormat, sizeof(audioFormat), "audioFormat");
+    writeBytes(fp, &numChannels, sizeof(numChannels), "numChannels");
+    writeBytes(fp, &sampleRate, sizeof(sampleRate), "sampleRate");
+    writeBytes(fp, &byteRate, sizeof(byteRate), "byteRate");
+    writeBytes(fp, &blockAlign, sizeof(blockAlign), "blockAlign");
+    writeBytes(fp, &bitsPerSample, sizeof(bitsPerSample), "bitsPerSample");
+    if (extensible)
+    {
+        uint16_t extensionSize = 22;
+        writeBytes(fp, &extensionSize, sizeof(extensionSize), "cbSize");
+        writeBytes(fp, &validBitsPerSample, sizeof(validBitsPerSample), "validBitsPerSample");
+        writeBytes(fp, &channelMask, sizeof(channelMask), "channelMask");
+        writeBytes(fp, subFormat, sizeof(subFormat), "subFormat");
+    }
+
+    // -- Data sub-chunk
+    writeBytes(fp, "data", 4, "subchunk2Id");
+    writeBytes(fp, &subchunk2Size, sizeof(subchunk2Size), "subchunk2Size");
+    dataOffset = headerSize;
+}
+
+void wavHeader::writePadByte(FILE *fp)
+{
+    if (dataSize & 1)
+    {
+        unsigned char padByte = 0;
+        writeBytes(fp, &padByte, sizeof(padByte), "pad byte");
+    }
+}
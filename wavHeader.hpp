@@ -1,99 +1,298 @@
-/**
- * @file wavHeader.hpp
- * @author Pranali Rathi (pranali.r@fourthoracle.com)
- * @brief Class definition to read and write the header of audio wav files.
- * 
- * This class defines the data structure used to store the information found in a wav file header.
- * This class contains functions to read a wav file header, write information to create a new wav file
- * header and retrieve certain properties of the wav file header
- * 
- * @version 0.1
- * @date 2021-12-18
- * 
- * @copyright Copyright (c) 2021
- * 
- */
-#pragma once
-
-#include <fstream>
-#include <cstdint>
-
-class wavHeader
-{
-public:
-    /**
-     * @brief Default constructor to create a new wav Header object
-     * 
-     */
-    wavHeader();
-    /**
-     * @brief Construct a new wav Header object given an input wave file 
-     * 
-     * @param fp A pointer to the input wav audio file
-     */
-    wavHeader(FILE *fp);
-
-    /**
-     * @brief Copy constructor
-     * 
-     * @param obj The source wave header to be copied over
-     */
-    wavHeader(const wavHeader &obj);
-
-    /**
-     * @brief Gets the number of bytes per sample for the audio file
-     * 
-     * @return Returns bytesPerSample
-     */
-    uint16_t getbytesPerSample();
-
-    /**
-     * @brief Gets the number of samples for the audio file
-     * 
-     * @return Returns numberOfSamples
-     */
-    uint64_t getNumberOfSamples();
-
-    /**
-     * @brief Gets the sample rate for the audio file
-     * 
-     * @return Returns samplesPerSecond
-     */
-    uint32_t getSamplesPerSecond();
-
-    /**
-     * @brief Write the header data to the output wav file
-     * 
-     * @param fp A pointer to the output wav audio file
-     */
-    void writeHeader(FILE *fp);
-
-private:
-    /**
-     * @brief RIFF Chunk Descriptor
-     * 
-     */
-    unsigned char chunkID[4];
-    uint32_t chunkSize;
-    unsigned char format[4];
-
-    /**
-     * @brief Fmt sub-chunk
-     * 
-     */
-    unsigned char subchunk1ID[4];
-    uint32_t subchunk1Size;
-    uint16_t audioFormat;
-    uint16_t numChannels;
-    uint32_t sampleRate;
-    uint32_t byteRate;
-    uint16_t blockAlign;
-    uint16_t bitsPerSample;
-
-    /**
-     * @brief Data sub-chunk
-     * 
-     */
-    unsigned char subchunk2Id[4];
-    uint32_t subchunk2Size;
-};
+/**
+ * @file wavHeader.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition to read and write the header of audio wav files.
+ * 
+ * This class defines the data structure used to store the information found in a wav file header.
+ * This class contains functions to read a wav file header, write information to create a new wav file
+ * header and retrieve certain properties of the wav file header.
+ * 
+ * The header is read by walking the chunks of the file up to the data chunk, so chunks such as LIST,
+ * bext or fact may come before or between the fmt and data chunks. Chunks other than fmt, ds64 and data
+ * are skipped. Files larger than 4 GB are read from RF64 and BW64 files, whose ds64 chunk holds the
+ * 64 bit sizes, and the fmt chunk may use WAVE_FORMAT_EXTENSIBLE. The samples may be 16, 24 or 32 bit
+ * integers or 32 bit floats.
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#pragma once
+
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include "sampleCodec.hpp"
+#include "runStats.hpp"
+
+using namespace std;
+
+/**
+ * @brief Data size written by programs that stream a wav file without knowing its length in advance
+ * 
+ */
+constexpr uint32_t Unknown_Data_Size = 0xFFFFFFFF;
+
+/**
+ * @brief Format tag of integer pulse code modulation audio data
+ * 
+ */
+constexpr uint16_t Wave_Format_Pcm = 0x0001;
+
+/**
+ * @brief Format tag of floating point audio data
+ * 
+ */
+constexpr uint16_t Wave_Format_Ieee_Float = 0x0003;
+
+/**
+ * @brief Format tag of the extensible fmt chunk, whose sub format holds the actual format tag
+ * 
+ */
+constexpr uint16_t Wave_Format_Extensible = 0xFFFE;
+
+/**
+ * @brief Size of the contents of the ds64 chunk without the table of chunk sizes, also written as a JUNK chunk
+ *        to keep room for a ds64 chunk
+ * 
+ */
+constexpr uint32_t Ds64_Chunk_Size = 28;
+
+class wavHeader
+{
+public:
+    /**
+     * @brief Default constructor to create a new wav Header object
+     * 
+     */
+    wavHeader();
+    /**
+     * @brief Construct a new wav Header object given an input wave file
+     * 
+     * Reads the chunks of the file up to the start of the audio data, skipping the chunks that are not
+     * needed. Files that can be seeked are skipped through without reading the skipped chunks. The file
+     * is left positioned at the first sample
+     * 
+     * @param fp A pointer to the input wav audio file
+     * @param stats Statistics receiving the time of reading the header, NULL to not collect any
+     */
+    wavHeader(FILE *fp, runStats *stats = NULL);
+
+    /**
+     * @brief Copy constructor
+     * 
+     * @param obj The source wave header to be copied over
+     */
+    wavHeader(const wavHeader &obj);
+
+    /**
+     * @brief Gets the number of bytes per sample for the audio file
+     * 
+     * @return Returns bytesPerSample
+     */
+    uint16_t getbytesPerSample();
+
+    /**
+     * @brief Gets the number of samples for the audio file
+     * 
+     * @return Returns numberOfSamples
+     */
+    uint64_t getNumberOfSamples();
+
+    /**
+     * @brief Gets the storage type of the samples
+     * 
+     * @return 16, 24 or 32 bit integer, or 32 bit float
+     */
+    sampleFormat getSampleFormat();
+
+    /**
+     * @brief Gets the size of the audio data in bytes
+     * 
+     * @return Returns the size of the data chunk, taken from the ds64 chunk for RF64 and BW64 files
+     */
+    uint64_t getDataSize();
+
+    /**
+     * @brief Checks if the size of the audio data is given in the header
+     * 
+     * @return False if the file was written without knowing the size of the audio data in advance
+     */
+    bool isDataSizeKnown();
+
+    /**
+     * @brief Gets the position of the first sample in the file
+     * 
+     * @return Number of bytes before the audio data
+     */
+    uint64_t getDataOffset();
+
+    /**
+     * @brief Sets the size of the audio data in bytes, updating the RIFF chunk size to match
+     * 
+     * @param dataSize Number of bytes of audio data
+     */
+    void setDataSize(uint64_t dataSize);
+
+    /**
+     * @brief Gets the sample rate for the audio file
+     * 
+     * @return Returns samplesPerSecond
+     */
+    uint32_t getSamplesPerSecond();
+
+    /**
+     * @brief Gets the number of channels for the audio file, whose samples are interleaved in the audio data
+     * 
+     * @return Returns numChannels
+     */
+    uint16_t getNumChannels();
+
+    /**
+     * @brief Turns the channels chosen on the command line into the channels to be filtered
+     * 
+     * @param channels Channel numbers starting at 1, empty to filter every channel
+     * @return Channel indices starting at 0 in increasing order, each at most once
+     */
+    vector<uint16_t> selectChannels(const vector<uint32_t> &channels);
+
+    /**
+     * @brief Write the header data to the output wav file
+     * 
+     * Writes the RIFF chunk descriptor, the fmt chunk and the start of the data chunk. Audio data that
+     * does not fit in the 32 bit sizes of a RIFF file is written as an RF64 file with a ds64 chunk. If the
+     * size of the audio data is not known when the header is first written, a JUNK chunk keeps room for the
+     * ds64 chunk, so the header can be written again with its final sizes without moving the audio data
+     * 
+     * @param fp A pointer to the output wav audio file
+     */
+    void writeHeader(FILE *fp);
+
+    /**
+     * @brief Write the byte padding the data chunk to an even number of bytes
+     * 
+     * Chunks of a wav file are padded to an even number of bytes, so a zero byte follows audio data of an
+     * odd size. Nothing is written for audio data of an even size
+     * 
+     * @param fp A pointer to the output wav audio file, positioned after the audio data
+     */
+    void writePadByte(FILE *fp);
+
+private:
+    /**
+     * @brief Read bytes of the header, throwing a filterError if the file ends first
+     * 
+     * @param fp A pointer to the input wav audio file
+     * @param data Receives the bytes read
+     * @param size Number of bytes to read
+     * @param name Name of the field, for the error message
+     */
+    void readBytes(FILE *fp, void *data, uint64_t size, const char *name);
+
+    /**
+     * @brief Skip bytes of the input file, seeking over them if possible
+     * 
+     * @param fp A pointer to the input wav audio file
+     * @param size Number of bytes to skip
+     */
+    void skipBytes(FILE *fp, uint64_t size);
+
+    /**
+     * @brief Write bytes of the header, throwing a filterError if they cannot be written
+     * 
+     * @param fp A pointer to the output wav audio file
+     * @param data Bytes to write
+     * @param size Number of bytes to write
+     * @param name Name of the field, for the error message
+     */
+    void writeBytes(FILE *fp, const void *data, uint64_t size, const char *name);
+
+    /**
+     * @brief Parse the contents of the fmt chunk
+     * 
+     * @param fp A pointer to the input wav audio file, positioned after the chunk size
+     * @param size Size of the contents of the fmt chunk
+     */
+    void readFormat(FILE *fp, uint64_t size);
+
+    /**
+     * @brief RIFF Chunk Descriptor
+     * 
+     */
+    unsigned char chunkID[4];
+    uint32_t chunkSize;
+    unsigned char format[4];
+
+    /**
+     * @brief Fmt sub-chunk
+     * 
+     */
+    unsigned char subchunk1ID[4];
+    uint32_t subchunk1Size;
+    uint16_t audioFormat;
+    uint16_t numChannels;
+    uint32_t sampleRate;
+    uint32_t byteRate;
+    uint16_t blockAlign;
+    uint16_t bitsPerSample;
+
+    /**
+     * @brief Storage type of the samples, given by the format tag and bitsPerSample
+     * 
+     */
+    sampleFormat storageFormat;
+
+    /**
+     * @brief Extension of the fmt sub-chunk, used when audioFormat is Wave_Format_Extensible
+     * 
+     */
+    uint16_t validBitsPerSample;
+    uint32_t channelMask;
+    unsigned char subFormat[16];
+
+    /**
+     * @brief Data sub-chunk
+     * 
+     */
+    unsigned char subchunk2Id[4];
+    uint32_t subchunk2Size;
+
+    /**
+     * @brief Size of the audio data in bytes, which may not fit in subchunk2Size
+     * 
+     */
+    uint64_t dataSize;
+
+    /**
+     * @brief Whether the size of the audio data is known
+     * 
+     */
+    bool dataSizeKnown;
+
+    /**
+     * @brief Position of the first sample in the input file, or in the output file once the header is written
+     * 
+     */
+    uint64_t dataOffset;
+
+    /**
+     * @brief Number of bytes read from the input file so far, which also works for files that cannot be seeked
+     * 
+     */
+    uint64_t position;
+
+    /**
+     * @brief Whether the output header keeps room for a ds64 chunk. Decided when the header is first written,
+     *        so that writing it again does not move the audio data
+     * 
+     */
+    bool ds64Reserved;
+
+    /**
+     * @brief Whether the header has been written to the output file
+     * 
+     */
+    bool headerWritten;
+};
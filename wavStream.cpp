@@ -0,0 +1,368 @@
+/**
+ * @file wavStream.cpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Implementation of the wavStream class
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <cstdio>
+#include "wavStream.hpp"
+#include "filterError.hpp"
+#include "spscRing.hpp"
+
+using namespace std;
+
+wavStream::wavStream(FILE *inputFp, FILE *outputFp, runStats *stats) : header(inputFp, stats)
+{
+    input = inputFp;
+    output = outputFp;
+    samplesPerSecond = header.getSamplesPerSecond();
+    numChannels = header.getNumChannels();
+    format = header.getSampleFormat();
+    bytesPerSample = sampleCodec::getBytesPerSample(format);
+    selectedChannels = header.selectChannels(vector<uint32_t>());
+    stages = NULL;
+    partitionSize = 0;
+    q15 = false;
+    q15HeadroomBits = -1;
+    sizeKnown = false;
+    samplesLeft = 0;
+    samplesWritten = 0;
+    blocksWritten = 0;
+    dither = false;
+    clippedSamples = 0;
+    this->stats = stats;
+    readPhase = 0;
+    writePhase = 0;
+}
+
+void wavStream::setChannels(const vector<uint32_t> &channels)
+{
+    selectedChannels = header.selectChannels(channels);
+}
+
+uint32_t wavStream::getSamplesPerSecond()
+{
+    return samplesPerSecond;
+}
+
+void wavStream::setIirStages(const vector<vector<biquadSection>> &iirStages)
+{
+    this->iirStages = iirStages;
+}
+
+void wavStream::setMultirateStages(const vector<multirateStage> &multirateStages)
+{
+    this->multirateStages = multirateStages;
+}
+
+uint64_t wavStream::getStageCount()
+{
+    return stages->size() + multirateStages.size() + iirStages.size();
+}
+
+void wavStream::setDither(bool dither)
+{
+    this->dither = dither;
+}
+
+uint64_t wavStream::getClippedSamples()
+{
+    return clippedSamples;
+}
+
+uint64_t wavStream::readBlock(streamBlock &block)
+{
+    scopedTimer timer(stats, readPhase);
+    uint64_t count = (uint64_t)max(samplesPerSecond, (uint32_t)1) * numChannels;
+    if (sizeKnown)
+    {
+        count = min(count, samplesLeft);
+    }
+
+    vector<unsigned char> &blockData = block.storedData;
+    blockData.resize(count * bytesPerSample);
+    count = (count == 0) ? 0 : fread(&blockData[0], 1, blockData.size(), input) / bytesPerSample;
+    samplesLeft -= sizeKnown ? count : 0;
+
+    // -- Only whole frames, holding one sample of every channel, are filtered
+    count -= count % numChannels;
+    blockData.resize(count * bytesPerSample);
+
+    // -- Unpack the selected channels once, the filters pass them on in double precision
+    block.channelData.resize(selectedChannels.size());
+    for (uint64_t k = 0; k < selectedChannels.size(); k++)
+    {
+        block.channelData[k].resize(count / numChannels);
+        if (count > 0)
+        {
+            sampleCodec::unpack(format, &blockData[selectedChannels[k] * bytesPerSample], numChannels, &block.channelData[k][0], count / numChannels);
+        }
+    }
+    timer.count(count, blockData.size(), 0);
+    return count;
+}
+
+void wavStream::filterBlock(uint64_t stage, streamBlock &block)
+{
+    scopedTimer timer(stats, (stats != NULL) ? filterPhases[stage] : 0);
+    uint64_t samples = block.channelData.empty() ? 0 : block.channelData[0].size() * block.channelData.size();
+    uint64_t firstIirStage = stages->size() + multirateStages.size();
+    if (stage >= firstIirStage)
+    {
+        // -- The iir filters take every selected channel at once, in double precision
+        const vector<biquadSection> &sections = iirStages[stage - firstIirStage];
+        iirFilters[stage - firstIirStage].applyIirFilter(block.channelData, sections);
+        timer.count(samples, 0, samples * iirFilter::getMultiplies(sections));
+        return;
+    }
+    if (stage >= stages->size())
+    {
+        // -- As do the multirate filters
+        const multirateStage &multirate = multirateStages[stage - stages->size()];
+        multirateFilters[stage - stages->size()].applyMultirateFilter(block.channelData, multirate);
+        timer.count(samples, 0, samples * multirateFilter::getMultiplies(multirate));
+        return;
+    }
+
+    const vector<double> &coeffs = (*stages)[stage];
+
+    for (uint64_t k = 0; k < selectedChannels.size(); k++)
+    {
+        firFilter &filter = filters[stage * selectedChannels.size() + k];
+        vector<double> &channelData = block.channelData[k];
+
+        if (q15)
+        {
+            // -- The samples are whole 16 bit numbers, unpacked from the file or put out by the previous
+            // -- Q15 filter, so the conversions are exact
+            vector<int16_t> q15Data(channelData.begin(), channelData.end());
+            q15Data = filter.applyQ15Filter(q15Data, coeffs, (uint32_t)coeffs.size(), q15HeadroomBits);
+            channelData.assign(q15Data.begin(), q15Data.end());
+        }
+        else
+        {
+            channelData = filter.applyBestFilter(channelData, coeffs, (uint32_t)coeffs.size(), samplesPerSecond, partitionSize);
+        }
+        timer.count(channelData.size(), 0, channelData.size() * coeffs.size());
+    }
+}
+
+void wavStream::writeBlock(streamBlock &block)
+{
+    // -- Put the filtered channels back into the block in the sample format of the file
+    scopedTimer timer(stats, writePhase);
+    vector<unsigned char> &blockData = block.storedData;
+    packState state;
+    state.dither = dither;
+    for (uint64_t k = 0; k < selectedChannels.size(); k++)
+    {
+        state.ditherSeed = ((uint64_t)selectedChannels[k] << 40) ^ blocksWritten;
+        sampleCodec::pack(format, &block.channelData[k][0], &blockData[selectedChannels[k] * bytesPerSample], numChannels, block.channelData[k].size(), state);
+    }
+    clippedSamples += state.clippedSamples;
+    blocksWritten++;
+
+    if (fwrite(&blockData[0], 1, blockData.size(), output) != blockData.size())
+    {
+        throw filterError("Error! could not write audio data into output file");
+    }
+    samplesWritten += blockData.size() / bytesPerSample;
+    timer.count(blockData.size() / bytesPerSample, blockData.size(), 0);
+}
+
+void wavStream::runPipeline()
+{
+    // -- Ring i carries the blocks into stage i, the last ring carries them to the writer. An empty
+    // -- block marks the end of the audio data
+    uint64_t stageCount = getStageCount();
+    vector<unique_ptr<spscRing<streamBlock>>> rings;
+    for (uint64_t i = 0; i <= stageCount; i++)
+    {
+        rings.push_back(make_unique<spscRing<streamBlock>>(Pipeline_Ring_Blocks));
+    }
+
+    // -- A thread that runs into an error keeps passing the blocks on without working on them, so the
+    // -- other threads still reach the end of the audio data, and the first error is rethrown after joining
+    mutex errorLock;
+    exception_ptr error;
+    auto keepError = [&errorLock, &error]
+    {
+        lock_guard<mutex> guard(errorLock);
+        if (!error)
+        {
+            error = current_exception();
+        }
+    };
+
+    vector<thread> threads;
+    for (uint64_t i = 0; i < stageCount; i++)
+    {
+        threads.emplace_back([this, &rings, &keepError, i]
+                             {
+                                 streamBlock block;
+                                 bool last = false;
+                                 bool failed = false;
+                                 while (!last)
+                                 {
+                                     // -- Pushing swaps in a used buffer, so check for the end before
+                                     rings[i]->pop(block);
+                                     last = block.storedData.empty();
+                                     if (!last && !failed)
+                                     {
+                                         try
+                                         {
+                                             filterBlock(i, block);
+                                         }
+                                         catch (...)
+                                         {
+                                             keepError();
+                                             failed = true;
+                                         }
+                                     }
+                                     rings[i + 1]->push(block);
+                                 } });
+    }
+
+    threads.emplace_back([this, &rings, &keepError, stageCount]
+                         {
+                             streamBlock block;
+                             bool failed = false;
+                             while (true)
+                             {
+                                 rings[stageCount]->pop(block);
+                                 if (block.storedData.empty())
+                                 {
+                                     break;
+                                 }
+                                 if (!failed)
+                                 {
+                                     try
+                                     {
+                                         writeBlock(block);
+                                     }
+                                     catch (...)
+                                     {
+                                         keepError();
+                                         failed = true;
+                                     }
+                                 }
+                             } });
+
+    // -- The calling thread reads the input
+    streamBlock block;
+    try
+    {
+        while (readBlock(block) > 0)
+        {
+            rings[0]->push(block);
+        }
+    }
+    catch (...)
+    {
+        keepError();
+    }
+    block.storedData.clear();
+    rings[0]->push(block);
+
+    for (uint64_t i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+
+    if (error)
+    {
+        rethrow_exception(error);
+    }
+}
+
+uint64_t wavStream::processStream(const vector<vector<double>> &stages, uint32_t partitionSize, bool q15, int32_t q15HeadroomBits, bool pipelined)
+{
+    // -- Every filter keeps its own history from one block to the next
+    this->stages = &stages;
+    this->partitionSize = partitionSize;
+    this->q15 = q15;
+    this->q15HeadroomBits = q15HeadroomBits;
+    filters.clear();
+    filters.resize(stages.size() * selectedChannels.size());
+    multirateFilters.assign(multirateStages.size(), multirateFilter());
+    iirFilters.assign(iirStages.size(), iirFilter());
+    if (q15 && format != sampleFormat::int16)
+    {
+        throw filterError("Error! Q15 filtering needs 16 bit integer samples, the input file holds " + sampleCodec::getFormatName(format) + " samples");
+    }
+    samplesWritten = 0;
+    blocksWritten = 0;
+    clippedSamples = 0;
+
+    // -- The phases are added before the pipeline threads start, which only record into them
+    if (stats != NULL)
+    {
+        readPhase = stats->addPhase("read");
+        filterPhases.clear();
+        for (uint64_t i = 0; i < stages.size(); i++)
+        {
+            filterPhases.push_back(stats->addPhase("filter " + to_string(i + 1), (uint32_t)stages[i].size()));
+        }
+        for (uint64_t i = 0; i < multirateStages.size(); i++)
+        {
+            filterPhases.push_back(stats->addPhase("filter " + to_string(filterPhases.size() + 1), 0, multirateFilter::getMultiplies(multirateStages[i])));
+        }
+        for (uint64_t i = 0; i < iirStages.size(); i++)
+        {
+            filterPhases.push_back(stats->addPhase("filter " + to_string(filterPhases.size() + 1), 0, iirFilter::getMultiplies(iirStages[i])));
+        }
+        writePhase = stats->addPhase("write");
+    }
+
+    // -- Only read as much audio data as the header announces, so chunks after the audio data are skipped
+    sizeKnown = header.isDataSizeKnown();
+    samplesLeft = header.getNumberOfSamples();
+
+    header.writeHeader(output);
+
+    if (pipelined)
+    {
+        runPipeline();
+    }
+    else
+    {
+        streamBlock block;
+        while (readBlock(block) > 0)
+        {
+            // -- Run the block through the whole chain of filters
+            for (uint64_t i = 0; i < getStageCount(); i++)
+            {
+                filterBlock(i, block);
+            }
+            writeBlock(block);
+        }
+    }
+
+    // -- Check if audio data was able to be read
+    if (samplesWritten == 0)
+    {
+        throw filterError("Error! could not read raw audio data from input file");
+    }
+
+    // -- Correct the sizes in the header once the amount of audio data is known. Pipes cannot be
+    // -- seeked, so the header written to a pipe keeps the sizes of the input header
+    header.setDataSize(samplesWritten * bytesPerSample);
+    header.writePadByte(output);
+    if (fseek(output, 0, SEEK_SET) == 0)
+    {
+        header.writeHeader(output);
+        fseek(output, 0, SEEK_END);
+    }
+
+    return samplesWritten;
+}
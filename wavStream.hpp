@@ -0,0 +1,343 @@
+/**
+ * @file wavStream.hpp
+ * @author Pranali Rathi (pranali.r@fourthoracle.com)
+ * @brief Class definition to filter audio wave files block by block
+ * 
+ * This class reads the audio data of a wav file one block at a time, runs each block through every
+ * filter of the chain and writes it to the output file straight away. Each filter keeps the history of
+ * the previous block, so the output is the same as filtering the whole file at once, while the memory
+ * used only depends on the block size and the number of filter coefficients and not on the length of
+ * the file. The input and output can be pipes.
+ * 
+ * @version 0.1
+ * @date 2021-12-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#pragma once
+
+#include <vector>
+#include <cstdio>
+#include <cstddef>
+#include "wavHeader.hpp"
+#include "firFilter.hpp"
+#include "iirFilter.hpp"
+#include "multirateFilter.hpp"
+#include "runStats.hpp"
+
+using namespace std;
+
+/**
+ * @brief Number of blocks each ring buffer of the pipeline can hold before the stage feeding it has to wait
+ * 
+ */
+constexpr uint32_t Pipeline_Ring_Blocks = 4;
+
+/**
+ * @brief Block of audio data passed along the chain of filters
+ * 
+ */
+struct streamBlock
+{
+    /**
+     * @brief Interleaved samples as stored in the file. Holds the channels that are not filtered, and receives
+     *        the filtered channels once the block has been through every filter
+     * 
+     */
+    vector<unsigned char> storedData;
+
+    /**
+     * @brief Samples of every selected channel in double precision, as they pass from one filter to the next
+     * 
+     */
+    vector<vector<double>> channelData;
+};
+
+class wavStream
+{
+public:
+    /**
+     * @brief Construct a new wav Stream object given an input and an output wave file
+     * 
+     * Reads the header of the input file, the audio data is read by processStream
+     * 
+     * @param inputFp a pointer to the input wav audio file, positioned at the start of the file
+     * @param outputFp a pointer to the output wav audio file
+     * @param stats Statistics receiving the time of reading the header and of reading, filtering and writing
+     *              every block, NULL to not collect any. When pipelined, the phases overlap
+     */
+    wavStream(FILE *inputFp, FILE *outputFp, runStats *stats = NULL);
+
+    /**
+     * @brief Filter the audio data of the input file into the output file
+     * 
+     * Writes the header, then reads one second of audio data at a time, applies every filter to it and
+     * writes the result. If the size of the audio data is given in the input header, no more than that is
+     * read, otherwise the audio data runs until the end of the input. Once all audio data is written, the
+     * sizes in the output header are corrected if the output file can be seeked, otherwise they are left
+     * as they were in the input header.
+     * 
+     * When pipelined, reading, each filter and writing run on threads of their own and pass the blocks on
+     * through lock-free ring buffers, so all of them work at the same time on different blocks. The output
+     * is the same either way
+     * 
+     * @param stages Sets of filter coefficients in the order they are to be applied, followed by the multirate
+     *               filters chosen with setMultirateStages and the iir filters chosen with setIirStages
+     * @param partitionSize Partition size of the partitioned convolution, 0 to choose the engine from the number of coefficients
+     * @param q15 Filter in Q15 fixed point instead of double precision
+     * @param q15HeadroomBits Number of bits the Q15 coefficients are scaled down, -1 to choose automatically
+     * @param pipelined Run every filter on a thread of its own
+     * @return Number of samples written
+     */
+    uint64_t processStream(const vector<vector<double>> &stages, uint32_t partitionSize, bool q15, int32_t q15HeadroomBits, bool pipelined = false);
+
+    /**
+     * @brief Choose the channels to be filtered
+     * 
+     * The samples of the other channels are copied to the output unchanged
+     * 
+     * @param channels Channel numbers starting at 1, empty to filter every channel
+     */
+    void setChannels(const vector<uint32_t> &channels);
+
+    /**
+     * @brief Choose the iir filters applied after the fir filters given to processStream
+     * 
+     * @param iirStages Sections of each iir filter, in the order they are to be applied
+     */
+    void setIirStages(const vector<vector<biquadSection>> &iirStages);
+
+    /**
+     * @brief Choose the multirate filters applied after the fir filters given to processStream, before the iir filters
+     * 
+     * @param multirateStages Filters of each multirate filter, in the order they are to be applied
+     */
+    void setMultirateStages(const vector<multirateStage> &multirateStages);
+
+    /**
+     * @brief Gets the sample rate of the audio data
+     * 
+     * @return Number of samples per second of each channel
+     */
+    uint32_t getSamplesPerSecond();
+
+    /**
+     * @brief Choose whether integer output samples are dithered
+     * 
+     * @param dither Add triangular dither of up to 1 least significant bit before rounding
+     */
+    void setDither(bool dither);
+
+    /**
+     * @brief Gets the number of output samples that were outside the range of the sample format
+     * 
+     * @return Number of samples saturated by the last processStream
+     */
+    uint64_t getClippedSamples();
+
+private:
+    /**
+     * @brief Read the next block of audio data
+     * 
+     * The samples of every selected channel are taken out of the block and unpacked to double precision
+     * 
+     * @param block Receives the samples of the block
+     * @return Number of samples read, 0 at the end of the audio data
+     */
+    uint64_t readBlock(streamBlock &block);
+
+    /**
+     * @brief Apply one filter of the chain to a block of audio data
+     * 
+     * Every selected channel is filtered with a fir filter of its own, the other channels are left as they are.
+     * The samples stay in double precision from one filter to the next
+     * 
+     * @param stage Position of the filter in the chain, the multirate filters come after the fir filters and
+     *              the iir filters last
+     * @param block Samples of the block, replaced by the filtered samples
+     */
+    void filterBlock(uint64_t stage, streamBlock &block);
+
+    /**
+     * @brief Gets the number of filters in the chain
+     * 
+     * @return The fir, multirate and iir filters
+     */
+    uint64_t getStageCount();
+
+    /**
+     * @brief Write a block of audio data to the output file
+     * 
+     * The filtered channels are converted back to the sample format of the file, saturating integer samples,
+     * once at the end of the chain of filters. The dither noise of every channel of the block is seeded from the
+     * channel and the position of the block, so the output is the same as when filtering the whole file
+     * 
+     * @param block Samples of the block
+     */
+    void writeBlock(streamBlock &block);
+
+    /**
+     * @brief Read, filter and write the audio data with one thread per filter and one thread writing
+     * 
+     */
+    void runPipeline();
+
+    /**
+     * @brief Header component of the input wav file, written to the output file
+     * 
+     */
+    wavHeader header;
+
+    /**
+     * @brief Input wav audio file
+     * 
+     */
+    FILE *input;
+
+    /**
+     * @brief Output wav audio file
+     * 
+     */
+    FILE *output;
+
+    /**
+     * @brief Sample rate for the wav file, which is also the number of samples of each channel per block
+     * 
+     */
+    uint32_t samplesPerSecond;
+
+    /**
+     * @brief Number of interleaved channels for the wav file
+     * 
+     */
+    uint16_t numChannels;
+
+    /**
+     * @brief Storage type of the samples of the stream
+     * 
+     */
+    sampleFormat format;
+
+    /**
+     * @brief Number of bytes per stored sample
+     * 
+     */
+    uint32_t bytesPerSample;
+
+    /**
+     * @brief Channels to be filtered, starting at 0
+     * 
+     */
+    vector<uint16_t> selectedChannels;
+
+    /**
+     * @brief Sets of filter coefficients being applied
+     * 
+     */
+    const vector<vector<double>> *stages;
+
+    /**
+     * @brief One fir filter per set of coefficients and selected channel, each holding the history of its own input.
+     *        The filter of stage i and the k-th selected channel is at i * selectedChannels.size() + k
+     * 
+     */
+    vector<firFilter> filters;
+
+    /**
+     * @brief Filters of the multirate filters applied after the fir filters
+     * 
+     */
+    vector<multirateStage> multirateStages;
+
+    /**
+     * @brief One multirate filter per multirate stage, each holding the history of every selected channel
+     * 
+     */
+    vector<multirateFilter> multirateFilters;
+
+    /**
+     * @brief Sections of the iir filters applied after the fir filters
+     * 
+     */
+    vector<vector<biquadSection>> iirStages;
+
+    /**
+     * @brief One iir filter per iir stage, each holding the state of every selected channel
+     * 
+     */
+    vector<iirFilter> iirFilters;
+
+    /**
+     * @brief Partition size of the partitioned convolution, 0 to choose the engine from the number of coefficients
+     * 
+     */
+    uint32_t partitionSize;
+
+    /**
+     * @brief Filter in Q15 fixed point instead of double precision
+     * 
+     */
+    bool q15;
+
+    /**
+     * @brief Number of bits the Q15 coefficients are scaled down, -1 to choose automatically
+     * 
+     */
+    int32_t q15HeadroomBits;
+
+    /**
+     * @brief Whether the input header gives the size of the audio data
+     * 
+     */
+    bool sizeKnown;
+
+    /**
+     * @brief Number of samples left to read, counting every channel, if the size of the audio data is known
+     * 
+     */
+    uint64_t samplesLeft;
+
+    /**
+     * @brief Number of samples written so far
+     * 
+     */
+    uint64_t samplesWritten;
+
+    /**
+     * @brief Number of blocks written so far
+     * 
+     */
+    uint64_t blocksWritten;
+
+    /**
+     * @brief Whether integer output samples are dithered
+     * 
+     */
+    bool dither;
+
+    /**
+     * @brief Number of output samples saturated so far
+     * 
+     */
+    uint64_t clippedSamples;
+
+    /**
+     * @brief Statistics of the run, NULL if not collected
+     * 
+     */
+    runStats *stats;
+
+    /**
+     * @brief Phases of the statistics for reading and writing the blocks
+     * 
+     */
+    uint32_t readPhase;
+    uint32_t writePhase;
+
+    /**
+     * @brief Phase of the statistics for each filter
+     * 
+     */
+    vector<uint32_t> filterPhases;
+};